@@ -0,0 +1,179 @@
+/* Fixed local echo server for the benchmarks, built to stay out of the way of what is being
+ * measured: one thread per client reads as much as the socket holds, unmasks every complete
+ * frame of the read into one output buffer and writes all the echoes back with a single send,
+ * so the server costs a couple of syscalls per batch rather than per frame. Answers PING with
+ * PONG and CLOSE with CLOSE; listens on 127.0.0.1 (port 0 = ephemeral). */
+#ifndef WIBESOCKET_BENCH_ECHO_H
+#define WIBESOCKET_BENCH_ECHO_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "../src/handshake.h"
+
+#define BENCH_ECHO_READ (256 * 1024)
+
+typedef struct {
+    int       listen_fd;
+    int       port;
+    pthread_t thread;
+} bench_echo_t;
+
+typedef struct {
+    uint8_t* p;
+    size_t   len, cap;
+} bench_buf_t;
+
+static int bench_buf_reserve(bench_buf_t* b, size_t more) {
+    if (b->len + more <= b->cap) return 0;
+    size_t cap = b->cap ? b->cap : BENCH_ECHO_READ;
+    while (cap < b->len + more) cap *= 2;
+    uint8_t* p = (uint8_t*)realloc(b->p, cap);
+    if (!p) return -1;
+    b->p = p; b->cap = cap;
+    return 0;
+}
+
+static int bench_write_all(int fd, const uint8_t* p, size_t n) {
+    while (n) {
+        ssize_t w = send(fd, p, n, MSG_NOSIGNAL);
+        if (w <= 0) return -1;
+        p += w; n -= (size_t)w;
+    }
+    return 0;
+}
+
+/* Append an unmasked server frame carrying the masked payload src */
+static int bench_echo_frame(bench_buf_t* out, uint8_t b0, const uint8_t* src, size_t n, const uint8_t mk[4]) {
+    if (bench_buf_reserve(out, n + 10) < 0) return -1;
+    uint8_t* h = out->p + out->len;
+    size_t hl = 0;
+    h[hl++] = b0;
+    if (n <= 125) h[hl++] = (uint8_t)n;
+    else if (n <= 0xFFFF) { h[hl++] = 126; h[hl++] = (uint8_t)(n >> 8); h[hl++] = (uint8_t)n; }
+    else { h[hl++] = 127; for (int i = 7; i >= 0; i--) h[hl++] = (uint8_t)((uint64_t)n >> (8 * i)); }
+    uint8_t* d = h + hl;
+    uint64_t m8; uint8_t m[8] = { mk[0], mk[1], mk[2], mk[3], mk[0], mk[1], mk[2], mk[3] };
+    memcpy(&m8, m, 8);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) { uint64_t v; memcpy(&v, src + i, 8); v ^= m8; memcpy(d + i, &v, 8); }
+    for (; i < n; i++) d[i] = src[i] ^ mk[i & 3];
+    out->len += hl + n;
+    return 0;
+}
+
+static int bench_echo_handshake(int fd, bench_buf_t* in) {
+    for (;;) {
+        if (bench_buf_reserve(in, 4096) < 0) return -1;
+        ssize_t r = recv(fd, in->p + in->len, in->cap - in->len - 1, 0);
+        if (r <= 0) return -1;
+        in->len += (size_t)r;
+        in->p[in->len] = 0;
+        char* end = strstr((char*)in->p, "\r\n\r\n");
+        if (!end) { if (in->len > 16384) return -1; continue; }
+        const char* k = strstr((char*)in->p, "Sec-WebSocket-Key: ");
+        if (!k) return -1;
+        char key[64]; size_t kl = 0; k += 19;
+        while (k[kl] && k[kl] != '\r' && kl < sizeof(key) - 1) { key[kl] = k[kl]; kl++; }
+        key[kl] = 0;
+        char accept[29]; ws_compute_accept(key, accept);
+        char resp[256];
+        int n = snprintf(resp, sizeof(resp), "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n"
+                         "Connection: Upgrade\r\nSec-WebSocket-Accept: %s\r\n\r\n", accept);
+        if (bench_write_all(fd, (const uint8_t*)resp, (size_t)n) < 0) return -1;
+        size_t used = (size_t)(end + 4 - (char*)in->p);
+        memmove(in->p, in->p + used, in->len - used);
+        in->len -= used;
+        return 0;
+    }
+}
+
+static void* bench_echo_client(void* arg) {
+    int fd = (int)(intptr_t)arg;
+    bench_buf_t in = {0}, out = {0};
+    if (bench_echo_handshake(fd, &in) < 0) goto done;
+    for (int closing = 0; !closing; ) {
+        size_t off = 0;
+        while (in.len - off >= 2) {
+            const uint8_t* f = in.p + off;
+            uint64_t n = f[1] & 0x7F;
+            size_t hl = 2;
+            if (n == 126) { if (in.len - off < 4) break; n = ((uint64_t)f[2] << 8) | f[3]; hl = 4; }
+            else if (n == 127) {
+                if (in.len - off < 10) break;
+                n = 0; for (int i = 0; i < 8; i++) n = (n << 8) | f[2 + i];
+                hl = 10;
+            }
+            uint8_t mk[4] = {0, 0, 0, 0};
+            if (f[1] & 0x80) { if (in.len - off < hl + 4) break; memcpy(mk, f + hl, 4); hl += 4; }
+            if (in.len - off < hl + n) {
+                if (bench_buf_reserve(&in, hl + (size_t)n) < 0) goto done; /* a frame larger than the buffer */
+                break;
+            }
+            uint8_t op = f[0] & 0x0F;
+            int rc = 0;
+            if (op == 0x8) { rc = bench_echo_frame(&out, 0x88, f + hl, n < 2 ? (size_t)n : 2, mk); closing = 1; }
+            else if (op == 0x9) rc = bench_echo_frame(&out, 0x8A, f + hl, (size_t)n, mk);
+            else if (op != 0xA) rc = bench_echo_frame(&out, f[0], f + hl, (size_t)n, mk);
+            if (rc < 0) goto done;
+            off += hl + (size_t)n;
+            if (closing) break;
+        }
+        if (out.len) {
+            if (bench_write_all(fd, out.p, out.len) < 0) goto done;
+            out.len = 0;
+        }
+        if (closing) break;
+        memmove(in.p, in.p + off, in.len - off);
+        in.len -= off;
+        if (bench_buf_reserve(&in, 4096) < 0) goto done;
+        ssize_t r = recv(fd, in.p + in.len, in.cap - in.len, 0);
+        if (r <= 0) break;
+        in.len += (size_t)r;
+    }
+done:
+    free(in.p);
+    free(out.p);
+    close(fd);
+    return NULL;
+}
+
+static void* bench_echo_accept(void* arg) {
+    bench_echo_t* s = (bench_echo_t*)arg;
+    for (;;) {
+        int fd = accept(s->listen_fd, NULL, NULL);
+        if (fd < 0) return NULL;
+        int one = 1; (void)setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        pthread_t t;
+        if (pthread_create(&t, NULL, bench_echo_client, (void*)(intptr_t)fd) != 0) { close(fd); continue; }
+        pthread_detach(t);
+    }
+}
+
+static int bench_echo_start(bench_echo_t* s, int port) {
+    memset(s, 0, sizeof(*s));
+    s->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (s->listen_fd < 0) return -1;
+    int one = 1; (void)setsockopt(s->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in a; memset(&a, 0, sizeof(a));
+    a.sin_family = AF_INET; a.sin_addr.s_addr = htonl(INADDR_LOOPBACK); a.sin_port = htons((uint16_t)port);
+    socklen_t al = sizeof(a);
+    if (bind(s->listen_fd, (struct sockaddr*)&a, sizeof(a)) < 0 || listen(s->listen_fd, 1024) < 0 ||
+        getsockname(s->listen_fd, (struct sockaddr*)&a, &al) < 0) {
+        close(s->listen_fd); return -1;
+    }
+    s->port = ntohs(a.sin_port);
+    if (pthread_create(&s->thread, NULL, bench_echo_accept, s) != 0) { close(s->listen_fd); return -1; }
+    pthread_detach(s->thread);
+    return 0;
+}
+
+#endif /* WIBESOCKET_BENCH_ECHO_H */
@@ -0,0 +1,16 @@
+#define _POSIX_C_SOURCE 200809L
+/* Standalone fixed echo server for benchmarking any client against the same peer:
+ * bench_echo_server [port]. Prints the port it listens on, then serves until killed. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "bench_echo.h"
+
+int main(int argc, char** argv) {
+    int port = argc > 1 ? atoi(argv[1]) : 0;
+    bench_echo_t srv;
+    if (bench_echo_start(&srv, port) != 0) { perror("bench_echo_server"); return 1; }
+    printf("port=%d\n", srv.port);
+    fflush(stdout);
+    for (;;) pause();
+}
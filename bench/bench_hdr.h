@@ -0,0 +1,81 @@
+/* HDR-style latency histogram for the benchmarks: values below 128 ns get a bucket each, and
+ * every power of two above is split into 128 linear buckets, so any recorded value is known to
+ * within 1/128 (under 0.8%) across the whole 64-bit range, at a fixed 58 KiB per histogram.
+ * Percentiles report the highest value of their bucket. One histogram per thread, merged at the
+ * end; no locking. */
+#ifndef WIBESOCKET_BENCH_HDR_H
+#define WIBESOCKET_BENCH_HDR_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define HDR_SUB_BITS 7
+#define HDR_SUB      (1u << HDR_SUB_BITS)
+#define HDR_BUCKETS  ((64 - HDR_SUB_BITS + 1) * HDR_SUB)
+
+typedef struct {
+    uint64_t counts[HDR_BUCKETS];
+    uint64_t total;
+    uint64_t min, max;
+    double   sum;
+} hdr_hist_t;
+
+static inline void hdr_init(hdr_hist_t* h) {
+    memset(h, 0, sizeof(*h));
+    h->min = UINT64_MAX;
+}
+
+static inline unsigned hdr_index(uint64_t v) {
+    if (v < HDR_SUB) return (unsigned)v;
+    unsigned e = 63u - (unsigned)__builtin_clzll(v);
+    unsigned top = (unsigned)(v >> (e - HDR_SUB_BITS)); /* HDR_SUB .. 2*HDR_SUB-1 */
+    return (e - HDR_SUB_BITS + 1) * HDR_SUB + (top - HDR_SUB);
+}
+
+/* Largest value that lands in bucket i */
+static inline uint64_t hdr_bucket_high(unsigned i) {
+    if (i < HDR_SUB) return i;
+    unsigned shift = i / HDR_SUB - 1;
+    uint64_t sub = (uint64_t)(i % HDR_SUB) + HDR_SUB;
+    uint64_t next = (sub + 1) << shift;
+    return next ? next - 1 : UINT64_MAX;
+}
+
+static inline void hdr_record(hdr_hist_t* h, uint64_t v) {
+    h->counts[hdr_index(v)]++;
+    h->total++;
+    h->sum += (double)v;
+    if (v < h->min) h->min = v;
+    if (v > h->max) h->max = v;
+}
+
+static inline void hdr_merge(hdr_hist_t* into, const hdr_hist_t* from) {
+    for (unsigned i = 0; i < HDR_BUCKETS; i++) into->counts[i] += from->counts[i];
+    into->total += from->total;
+    into->sum += from->sum;
+    if (from->min < into->min) into->min = from->min;
+    if (from->max > into->max) into->max = from->max;
+}
+
+/* Value at percentile pct (0..100); 0 when empty, the exact max at 100 */
+static inline uint64_t hdr_percentile(const hdr_hist_t* h, double pct) {
+    if (h->total == 0) return 0;
+    if (pct >= 100.0) return h->max;
+    uint64_t want = (uint64_t)((pct / 100.0) * (double)h->total + 0.5);
+    if (want == 0) want = 1;
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < HDR_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen >= want) {
+            uint64_t v = hdr_bucket_high(i);
+            return v < h->max ? v : h->max;
+        }
+    }
+    return h->max;
+}
+
+static inline double hdr_mean(const hdr_hist_t* h) {
+    return h->total ? h->sum / (double)h->total : 0.0;
+}
+
+#endif /* WIBESOCKET_BENCH_HDR_H */
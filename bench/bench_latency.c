@@ -1,43 +1,56 @@
 #define _POSIX_C_SOURCE 200809L
+/* Ping-pong latency on one connection: one message in flight, each echo checked, samples in
+ * an HDR histogram. A recv that fails or times out counts as a failure, not as a sample.
+ * Runs twice, one line each: recv sleeping in epoll, then spinning for busy_us (default 50;
+ * 0 skips that run) with config.busy_poll_us.
+ *   bench_latency ws://host:port/path [iters] [busy_us] */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include "wibesocket/wibesocket.h"
+#include "bench_hdr.h"
 
 static uint64_t now_ns(void){ struct timespec ts; clock_gettime(CLOCK_MONOTONIC,&ts); return (uint64_t)ts.tv_sec*1000000000ull+ts.tv_nsec; }
 
-int main(int argc, char** argv) {
-    const char* uri = argc > 1 ? argv[1] : getenv("WIBESOCKET_BENCH_URI");
-    size_t iters = (argc > 2) ? (size_t)strtoul(argv[2], NULL, 10) : 10000;
-    if (!uri) { fprintf(stderr, "usage: %s ws://host:port/path [iters]\n", argv[0]); return 2; }
-
+static int run(const char* uri, size_t iters, uint32_t busy_us) {
     wibesocket_config_t cfg = {0}; cfg.handshake_timeout_ms = 5000; cfg.max_frame_size = (1u<<20);
+    cfg.busy_poll_us = busy_us;
     wibesocket_conn_t* c = wibesocket_connect(uri, &cfg);
     if (!c) { fprintf(stderr, "connect failed\n"); return 1; }
 
-    const char* ping = "x";
-    uint64_t* samples = (uint64_t*)malloc(iters * sizeof(uint64_t));
-    size_t n = 0;
+    static hdr_hist_t hist;
+    hdr_init(&hist);
+    size_t failures = 0;
     for (size_t i = 0; i < iters; i++) {
+        char ping[8];
+        memcpy(ping, &i, sizeof(ping));
         uint64_t t0 = now_ns();
-        (void)wibesocket_send_text(c, ping, 1);
+        if (wibesocket_send_binary(c, ping, sizeof(ping)) != WIBESOCKET_OK) { failures++; continue; }
         wibesocket_message_t msg; memset(&msg, 0, sizeof(msg));
-        (void)wibesocket_recv(c, &msg, 1000);
+        wibesocket_error_t e = wibesocket_recv(c, &msg, 1000);
         uint64_t t1 = now_ns();
-        if (n < iters) samples[n++] = (t1 - t0);
-    }
-    /* compute p50/p90/p99 */
-    for (size_t i = 0; i + 1 < n; i++) {
-        for (size_t j = i + 1; j < n; j++) if (samples[j] < samples[i]) { uint64_t tmp = samples[i]; samples[i] = samples[j]; samples[j] = tmp; }
+        if (e != WIBESOCKET_OK) { failures++; continue; }
+        if (msg.payload_len == sizeof(ping) && memcmp(msg.payload, ping, sizeof(ping)) == 0) hdr_record(&hist, t1 - t0);
+        else failures++;
+        wibesocket_release_message(c, &msg);
     }
-    uint64_t p50 = samples[(size_t)(n * 0.50)];
-    uint64_t p90 = samples[(size_t)(n * 0.90)];
-    uint64_t p99 = samples[(size_t)(n * 0.99)];
-    printf("latency: p50=%.3fms p90=%.3fms p99=%.3fms\n", p50/1e6, p90/1e6, p99/1e6);
-    free(samples);
+    printf("latency: mode=%s busy_us=%u p50=%.4fms p90=%.4fms p99=%.4fms p99.9=%.4fms p99.99=%.4fms max=%.4fms samples=%llu failures=%zu\n",
+           busy_us ? "busy_poll" : "epoll", busy_us,
+           hdr_percentile(&hist, 50.0) / 1e6, hdr_percentile(&hist, 90.0) / 1e6, hdr_percentile(&hist, 99.0) / 1e6,
+           hdr_percentile(&hist, 99.9) / 1e6, hdr_percentile(&hist, 99.99) / 1e6, hdr_percentile(&hist, 100.0) / 1e6,
+           (unsigned long long)hist.total, failures);
+    fflush(stdout);
     (void)wibesocket_close(c);
-    return 0;
+    return failures ? 1 : 0;
 }
 
-
+int main(int argc, char** argv) {
+    const char* uri = argc > 1 ? argv[1] : getenv("WIBESOCKET_BENCH_URI");
+    size_t iters = (argc > 2) ? (size_t)strtoul(argv[2], NULL, 10) : 10000;
+    uint32_t busy_us = (argc > 3) ? (uint32_t)strtoul(argv[3], NULL, 10) : 50;
+    if (!uri) { fprintf(stderr, "usage: %s ws://host:port/path [iters] [busy_us]\n", argv[0]); return 2; }
+    int rc = run(uri, iters, 0);
+    if (busy_us) rc |= run(uri, iters, busy_us);
+    return rc;
+}
@@ -0,0 +1,314 @@
+#define _GNU_SOURCE
+/* Multi-connection load generator: N connections spread over M threads, each thread running
+ * its own wibesocket loop. Every message carries its sequence number and a timestamp; echoes
+ * are checked for order and content, and their latency goes into a per-thread HDR histogram.
+ *
+ * Closed loop (-r 0, the default) keeps -W messages in flight per connection and measures
+ * throughput. Open loop (-r msgs/s over all connections) sends on a fixed schedule and stamps
+ * each message with the time it was due, not the time it went out, so a stall delays the
+ * schedule in the numbers as it would for real traffic (no coordinated omission). CPU per
+ * message is the client threads' CPU time while sending and receiving; in open loop it
+ * includes the spinning between sends that are less than a millisecond apart.
+ *
+ * Without -u a fixed echo server (bench_echo.h) runs in a child process, off the client's
+ * CPU accounting. Prints one line of key=value results. */
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "wibesocket/wibesocket.h"
+#include "wibesocket/event_loop.h"
+#include "bench_echo.h"
+#include "bench_hdr.h"
+
+#define LOAD_HDR     16   /* seq, stamp */
+#define LOAD_BATCH   32
+#define LOAD_DRAIN_NS (5ull * 1000000000ull)
+
+typedef struct worker worker_t;
+
+typedef struct {
+    wibesocket_conn_t* c;
+    worker_t*          w;
+    uint32_t           id;
+    int                failed;
+    uint64_t           next_seq;   /* next to send */
+    uint64_t           expect_seq; /* next echo expected */
+    uint64_t           next_due;   /* open loop: when next_seq is due */
+} lconn_t;
+
+struct worker {
+    pthread_t          th;
+    lconn_t*           conns;
+    size_t             n;
+    wibesocket_loop_t* loop;
+    uint8_t*           buf;
+    hdr_hist_t         hist;
+    uint64_t           sent, received, corrupt, send_full, errors;
+    uint64_t           last_recv_ns, cpu_ns;
+};
+
+static struct {
+    const char* uri;
+    size_t      size, window;
+    double      rate;
+    uint64_t    interval_ns;       /* open loop, per connection; 0 = closed loop */
+    uint64_t    start_ns, warm_ns, end_ns;
+    size_t      nconns;
+    uint8_t*    pattern;           /* payload bytes; connection id picks the offset */
+    pthread_barrier_t ready, go;
+} g;
+
+static uint64_t now_ns(void) {
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t thread_cpu_ns(void) {
+    struct timespec ts; clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static const uint8_t* conn_pattern(const lconn_t* lc) { return g.pattern + lc->id % 251; }
+
+static void lconn_fail(lconn_t* lc) {
+    if (lc->failed) return;
+    lc->failed = 1;
+    lc->w->errors++;
+}
+
+/* 1 sent, 0 queue full (try later), -1 failed */
+static int lconn_send(lconn_t* lc, uint64_t stamp) {
+    worker_t* w = lc->w;
+    uint64_t h[2] = { lc->next_seq, stamp };
+    memcpy(w->buf, h, LOAD_HDR);
+    memcpy(w->buf + LOAD_HDR, conn_pattern(lc) + LOAD_HDR, g.size - LOAD_HDR);
+    wibesocket_error_t e = wibesocket_send_binary(lc->c, w->buf, g.size);
+    if (e == WIBESOCKET_ERROR_BUFFER_FULL) { w->send_full++; return 0; }
+    if (e != WIBESOCKET_OK) { lconn_fail(lc); return -1; }
+    lc->next_seq++;
+    w->sent++;
+    return 1;
+}
+
+static void on_event(wibesocket_loop_t* loop, wibesocket_conn_t* conn, uint32_t events, void* ud) {
+    (void)loop;
+    lconn_t* lc = (lconn_t*)ud;
+    worker_t* w = lc->w;
+    if (events & WIBESOCKET_EVENT_ERROR) { lconn_fail(lc); return; }
+    if (!(events & WIBESOCKET_EVENT_READABLE)) return;
+    wibesocket_message_t m[LOAD_BATCH];
+    for (;;) {
+        size_t n = 0;
+        wibesocket_error_t e = wibesocket_recv_batch(conn, m, LOAD_BATCH, &n, 0);
+        if (e == WIBESOCKET_ERROR_TIMEOUT || e == WIBESOCKET_ERROR_NOT_READY) break;
+        if (e != WIBESOCKET_OK) { lconn_fail(lc); break; }
+        uint64_t now = now_ns();
+        for (size_t i = 0; i < n; i++) {
+            uint64_t h[2];
+            if (m[i].payload_len != g.size) { w->corrupt++; continue; }
+            memcpy(h, m[i].payload, LOAD_HDR);
+            if (h[0] != lc->expect_seq ||
+                memcmp((const uint8_t*)m[i].payload + LOAD_HDR, conn_pattern(lc) + LOAD_HDR, g.size - LOAD_HDR) != 0) {
+                w->corrupt++;
+                lc->expect_seq = h[0] + 1;
+                continue;
+            }
+            lc->expect_seq++;
+            w->received++;
+            if (h[1] >= g.warm_ns) hdr_record(&w->hist, now > h[1] ? now - h[1] : 0);
+        }
+        w->last_recv_ns = now;
+        wibesocket_release_message(conn, &m[0]);
+    }
+}
+
+static int all_answered(const worker_t* w) {
+    for (size_t i = 0; i < w->n; i++) {
+        const lconn_t* lc = &w->conns[i];
+        if (!lc->failed && lc->expect_seq < lc->next_seq) return 0;
+    }
+    return 1;
+}
+
+static void* worker_main(void* arg) {
+    worker_t* w = (worker_t*)arg;
+    wibesocket_config_t cfg; memset(&cfg, 0, sizeof(cfg));
+    cfg.handshake_timeout_ms = 5000;
+    cfg.max_frame_size = (uint32_t)(g.size + 64 > (1u << 20) ? g.size + 64 : (1u << 20));
+    w->loop = wibesocket_loop_create();
+    for (size_t i = 0; i < w->n; i++) {
+        lconn_t* lc = &w->conns[i];
+        lc->w = w;
+        lc->c = w->loop ? wibesocket_connect(g.uri, &cfg) : NULL;
+        if (!lc->c || wibesocket_loop_add(w->loop, lc->c, on_event, lc) != WIBESOCKET_OK) lconn_fail(lc);
+    }
+    pthread_barrier_wait(&g.ready);
+    pthread_barrier_wait(&g.go);
+    uint64_t cpu0 = thread_cpu_ns();
+    for (size_t i = 0; i < w->n; i++) {
+        /* Staggered so the connections do not all fire at once */
+        w->conns[i].next_due = g.start_ns + g.interval_ns * w->conns[i].id / (g.nconns ? g.nconns : 1);
+    }
+    for (;;) {
+        uint64_t now = now_ns();
+        int sending = now < g.end_ns;
+        if (!sending && (all_answered(w) || now >= g.end_ns + LOAD_DRAIN_NS)) break;
+        uint64_t wake = UINT64_MAX;
+        for (size_t i = 0; sending && i < w->n; i++) {
+            lconn_t* lc = &w->conns[i];
+            if (lc->failed) continue;
+            if (g.interval_ns) {
+                while (lc->next_due <= now && lconn_send(lc, lc->next_due) > 0) lc->next_due += g.interval_ns;
+                if (lc->next_due < wake) wake = lc->next_due;
+            } else {
+                while (lc->next_seq - lc->expect_seq < g.window && lconn_send(lc, now) > 0) {}
+            }
+        }
+        int timeout = 10;
+        if (sending && g.interval_ns) {
+            uint64_t until = wake > now ? wake - now : 0;
+            if (until < 10000000ull) timeout = (int)(until / 1000000ull);
+        }
+        if (wibesocket_loop_run_once(w->loop, timeout) < 0) { w->errors++; break; }
+    }
+    w->cpu_ns = thread_cpu_ns() - cpu0;
+    for (size_t i = 0; i < w->n; i++) {
+        if (w->conns[i].c) (void)wibesocket_close(w->conns[i].c);
+    }
+    wibesocket_loop_destroy(w->loop);
+    return NULL;
+}
+
+/* Fork the fixed echo server; its URI goes into uri */
+static pid_t spawn_echo(char* uri, size_t cap) {
+    int fds[2];
+    if (pipe(fds) != 0) return -1;
+    pid_t pid = fork();
+    if (pid < 0) return -1;
+    if (pid == 0) {
+        close(fds[0]);
+        bench_echo_t srv;
+        int port = bench_echo_start(&srv, 0) == 0 ? srv.port : -1;
+        if (write(fds[1], &port, sizeof(port)) != (ssize_t)sizeof(port) || port < 0) _exit(1);
+        close(fds[1]);
+        for (;;) pause();
+    }
+    close(fds[1]);
+    int port = -1;
+    ssize_t r = read(fds[0], &port, sizeof(port));
+    close(fds[0]);
+    if (r != (ssize_t)sizeof(port) || port < 0) { kill(pid, SIGKILL); waitpid(pid, NULL, 0); return -1; }
+    snprintf(uri, cap, "ws://127.0.0.1:%d/", port);
+    return pid;
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s [-u uri] [-c conns] [-t threads] [-s size] [-W window] [-r rate] [-d secs] [-w warmup]\n"
+            "  -c connections (1)   -t threads (1)   -s payload bytes, >= %d (125)\n"
+            "  -W in flight per connection, closed loop (1)\n"
+            "  -r total msgs/s, open loop; 0 = closed loop (0)\n"
+            "  -d seconds of sending (3)   -w seconds left out of the latency histogram (0.5)\n"
+            "  without -u a local echo server is started\n", argv0, LOAD_HDR);
+}
+
+int main(int argc, char** argv) {
+    size_t nconns = 1, nthreads = 1;
+    double secs = 3.0, warm = 0.5;
+    g.size = 125; g.window = 1;
+    for (int o; (o = getopt(argc, argv, "u:c:t:s:W:r:d:w:h")) != -1; ) {
+        switch (o) {
+        case 'u': g.uri = optarg; break;
+        case 'c': nconns = strtoul(optarg, NULL, 10); break;
+        case 't': nthreads = strtoul(optarg, NULL, 10); break;
+        case 's': g.size = strtoul(optarg, NULL, 10); break;
+        case 'W': g.window = strtoul(optarg, NULL, 10); break;
+        case 'r': g.rate = strtod(optarg, NULL); break;
+        case 'd': secs = strtod(optarg, NULL); break;
+        case 'w': warm = strtod(optarg, NULL); break;
+        default: usage(argv[0]); return 2;
+        }
+    }
+    if (nconns == 0 || nthreads == 0 || g.window == 0 || g.size < LOAD_HDR || secs <= 0.0) { usage(argv[0]); return 2; }
+    if (nthreads > nconns) nthreads = nconns;
+    g.nconns = nconns;
+    if (g.rate > 0.0) g.interval_ns = (uint64_t)(1e9 * (double)nconns / g.rate);
+    if (g.rate > 0.0 && g.interval_ns == 0) g.interval_ns = 1;
+
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        (void)setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    char local_uri[64];
+    pid_t echo_pid = -1;
+    if (!g.uri) {
+        echo_pid = spawn_echo(local_uri, sizeof(local_uri));
+        if (echo_pid < 0) { fprintf(stderr, "echo server failed to start\n"); return 1; }
+        g.uri = local_uri;
+    }
+
+    g.pattern = (uint8_t*)malloc(g.size + 256);
+    for (size_t j = 0; j < g.size + 256; j++) g.pattern[j] = (uint8_t)(j * 13 + 7);
+    worker_t* ws = (worker_t*)calloc(nthreads, sizeof(*ws));
+    lconn_t* conns = (lconn_t*)calloc(nconns, sizeof(*conns));
+    pthread_barrier_init(&g.ready, NULL, (unsigned)nthreads + 1);
+    pthread_barrier_init(&g.go, NULL, (unsigned)nthreads + 1);
+    for (size_t i = 0, at = 0; i < nthreads; i++) {
+        worker_t* w = &ws[i];
+        w->n = nconns / nthreads + (i < nconns % nthreads);
+        w->conns = conns + at;
+        for (size_t k = 0; k < w->n; k++) w->conns[k].id = (uint32_t)(at + k);
+        at += w->n;
+        w->buf = (uint8_t*)malloc(g.size);
+        hdr_init(&w->hist);
+        pthread_create(&w->th, NULL, worker_main, w);
+    }
+    pthread_barrier_wait(&g.ready);
+    g.start_ns = now_ns();
+    g.warm_ns = g.start_ns + (uint64_t)(warm * 1e9);
+    g.end_ns = g.start_ns + (uint64_t)(secs * 1e9);
+    pthread_barrier_wait(&g.go);
+
+    hdr_hist_t all; hdr_init(&all);
+    uint64_t sent = 0, received = 0, corrupt = 0, send_full = 0, errors = 0, last = g.start_ns, cpu = 0;
+    for (size_t i = 0; i < nthreads; i++) {
+        worker_t* w = &ws[i];
+        pthread_join(w->th, NULL);
+        hdr_merge(&all, &w->hist);
+        sent += w->sent; received += w->received; corrupt += w->corrupt;
+        send_full += w->send_full; errors += w->errors; cpu += w->cpu_ns;
+        if (w->last_recv_ns > last) last = w->last_recv_ns;
+        free(w->buf);
+    }
+    uint64_t lost = sent - received - corrupt;
+    double elapsed = (double)(last - g.start_ns) / 1e9;
+    double mps = elapsed > 0.0 ? (double)received / elapsed : 0.0;
+    printf("load: conns=%zu threads=%zu size=%zu window=%zu rate=%.0f time=%.3fs sent=%" PRIu64 " received=%" PRIu64
+           " msgs/s=%.2f MB/s=%.2f p50_us=%.2f p90_us=%.2f p99_us=%.2f p99.9_us=%.2f p99.99_us=%.2f max_us=%.2f"
+           " mean_us=%.2f cpu_us/msg=%.3f corrupt=%" PRIu64 " lost=%" PRIu64 " errors=%" PRIu64 " send_full=%" PRIu64 "\n",
+           nconns, nthreads, g.size, g.window, g.rate, elapsed, sent, received,
+           mps, mps * (double)g.size / 1e6,
+           hdr_percentile(&all, 50.0) / 1e3, hdr_percentile(&all, 90.0) / 1e3, hdr_percentile(&all, 99.0) / 1e3,
+           hdr_percentile(&all, 99.9) / 1e3, hdr_percentile(&all, 99.99) / 1e3, hdr_percentile(&all, 100.0) / 1e3,
+           hdr_mean(&all) / 1e3, received ? (double)cpu / 1e3 / (double)received : 0.0,
+           corrupt, lost, errors, send_full);
+
+    pthread_barrier_destroy(&g.ready);
+    pthread_barrier_destroy(&g.go);
+    free(ws);
+    free(conns);
+    free(g.pattern);
+    if (echo_pid > 0) { kill(echo_pid, SIGKILL); waitpid(echo_pid, NULL, 0); }
+    return (corrupt || lost || errors || received == 0) ? 1 : 0;
+}
@@ -0,0 +1,306 @@
+#define _POSIX_C_SOURCE 200809L
+/* In-process microbenchmarks for the hot internals: ws_parser_feed, ws_build_frame,
+ * ws_mask_copy, ws_utf8_is_valid and the ws_ringbuf zero-copy cycle, swept over payload sizes
+ * 0, 125, 126, 64K and 1M, plus the upgrade request template and the response header parser. Each case repeats until it has run for the target time and prints
+ * one line: micro: case=<name> size=<bytes> ns/op=.. GB/s=.. cycles/byte=..
+ * cycles/byte uses the TSC where there is one (a constant-rate clock, not core cycles) and is
+ * 0 elsewhere. A case name filter and the target milliseconds can be given:
+ *   bench_micro [filter] [ms] */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+#include "../src/internal/frame.h"
+#include "../src/internal/mask.h"
+#include "../src/internal/ringbuf.h"
+#include "../src/internal/utf8.h"
+#include "../src/handshake.h"
+
+static uint64_t now_ns(void){ struct timespec ts; clock_gettime(CLOCK_MONOTONIC,&ts); return (uint64_t)ts.tv_sec*1000000000ull+ts.tv_nsec; }
+
+static uint64_t cycles(void) {
+#ifdef HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static const size_t sizes[] = { 0, 125, 126, 64 * 1024, 1024 * 1024 };
+#define NSIZES (sizeof(sizes) / sizeof(sizes[0]))
+#define MAX_SIZE (1024 * 1024)
+
+static const char* filter;
+static uint64_t target_ns = 200000000ull;
+static volatile uint64_t sink;
+
+typedef struct {
+    const uint8_t* in;     /* case input */
+    size_t         in_len;
+    uint8_t*       out;    /* scratch output */
+    size_t         out_cap;
+    size_t         size;   /* payload size being swept */
+    size_t         seg;    /* parser: feed segment (0 = whole) */
+    ws_ringbuf_t*  rb;
+} ctx_t;
+
+typedef uint64_t (*case_fn)(ctx_t* c); /* one operation; returns something to keep alive */
+
+/* Run fn until target_ns has passed, doubling the batch so the clock is read rarely */
+static void run(const char* name, size_t size, case_fn fn, ctx_t* c, size_t bytes_per_op) {
+    if (filter && !strstr(name, filter)) return;
+    for (int i = 0; i < 3; i++) sink += fn(c); /* warm caches and the dispatch */
+    uint64_t ops = 0, batch = 1, t0 = now_ns(), c0 = cycles(), t1;
+    do {
+        for (uint64_t i = 0; i < batch; i++) sink += fn(c);
+        ops += batch;
+        if (batch < (1u << 20)) batch *= 2;
+        t1 = now_ns();
+    } while (t1 - t0 < target_ns);
+    uint64_t cyc = cycles() - c0;
+    double ns = (double)(t1 - t0) / (double)ops;
+    double bytes = (double)bytes_per_op * (double)ops;
+    printf("micro: case=%s size=%zu ns/op=%.2f GB/s=%.3f cycles/byte=%.3f\n", name, size, ns,
+           bytes > 0.0 ? bytes / (double)(t1 - t0) : 0.0, bytes > 0.0 ? (double)cyc / bytes : 0.0);
+    fflush(stdout);
+}
+
+static const uint8_t key[4] = { 0x12, 0x34, 0x56, 0x78 };
+
+/* ---- parser ---- */
+
+static uint64_t op_parse(ctx_t* c) {
+    ws_parser_t p; ws_parser_init(&p, (uint64_t)MAX_SIZE * 2);
+    uint64_t got = 0;
+    size_t off = 0;
+    while (off < c->in_len) {
+        size_t end = (c->seg == 0 || c->in_len - off < c->seg) ? c->in_len : off + c->seg;
+        while (off < end) {
+            size_t used = 0; ws_parsed_frame_t f;
+            ws_parser_status_t s = ws_parser_feed(&p, c->in + off, end - off, &used, &f);
+            if (s < 0) { fprintf(stderr, "parse error %d\n", (int)s); exit(1); }
+            off += used;
+            if (s == WS_PARSER_FRAME || s == WS_PARSER_CHUNK) got += f.payload_len + 1;
+            else if (s == WS_PARSER_NEED_MORE) break;
+        }
+    }
+    return got;
+}
+
+/* One message of size bytes as nfrag server frames (op then CONTINUATIONs); returns length */
+static size_t build_message(uint8_t* out, size_t cap, ws_opcode_t op, const uint8_t* payload, size_t size, size_t nfrag) {
+    size_t n = 0, off = 0;
+    for (size_t i = 0; i < nfrag; i++) {
+        size_t part = (i + 1 == nfrag) ? size - off : size / nfrag;
+        n += ws_build_frame(out + n, cap - n, i + 1 == nfrag, i ? WS_OPCODE_CONTINUATION : op,
+                            NULL, payload + off, part);
+        off += part;
+    }
+    return n;
+}
+
+static void bench_parser(const uint8_t* payload, const uint8_t* text, uint8_t* frames, size_t frames_cap) {
+    /* whole: binary frames back to back, fed at once (headers decoded in place);
+     * split: the same fed in 1021-byte segments, so headers straddle feeds and large payloads stream;
+     * frag4: each message as 4 continuation fragments, fed at once;
+     * text:  ASCII text frames fed at once, so the payload is UTF-8 validated as it is parsed */
+    for (size_t k = 0; k < NSIZES; k++) {
+        size_t size = sizes[k];
+        /* Enough frames per op that small sizes are not dominated by parser setup */
+        size_t count = size < 4096 ? 64 : 1;
+        ctx_t c; memset(&c, 0, sizeof(c));
+        c.size = size;
+
+        size_t n = 0;
+        for (size_t i = 0; i < count; i++) n += build_message(frames + n, frames_cap - n, WS_OPCODE_BINARY, payload, size, 1);
+        c.in = frames; c.in_len = n;
+        c.seg = 0; run("parser.whole", size, op_parse, &c, n);
+        c.seg = 1021; run("parser.split", size, op_parse, &c, n);
+
+        n = 0;
+        for (size_t i = 0; i < count; i++) n += build_message(frames + n, frames_cap - n, WS_OPCODE_BINARY, payload, size, 4);
+        c.in_len = n; c.seg = 0;
+        run("parser.frag4", size, op_parse, &c, n);
+
+        n = 0;
+        for (size_t i = 0; i < count; i++) n += build_message(frames + n, frames_cap - n, WS_OPCODE_TEXT, text, size, 1);
+        c.in_len = n;
+        run("parser.text", size, op_parse, &c, n);
+    }
+}
+
+/* ---- builder ---- */
+
+static uint64_t op_build(ctx_t* c) {
+    return ws_build_frame(c->out, c->out_cap, 1, WS_OPCODE_BINARY, key, c->in, c->size);
+}
+
+static uint64_t op_build_header(ctx_t* c) {
+    return ws_build_frame_header(c->out, 1, 0, WS_OPCODE_BINARY, key, c->size);
+}
+
+/* ---- masking ---- */
+
+static uint64_t op_mask(ctx_t* c) {
+    ws_mask_copy(c->out, c->in, c->size, key, 0);
+    return c->out[0];
+}
+
+static uint64_t op_mask_inplace(ctx_t* c) {
+    ws_mask_copy(c->out, c->out, c->size, key, 1);
+    return c->out[0];
+}
+
+/* ---- UTF-8 ---- */
+
+static uint64_t op_utf8(ctx_t* c) {
+    if (!ws_utf8_is_valid(c->in, c->size)) { fprintf(stderr, "utf8 input rejected\n"); exit(1); }
+    return 1;
+}
+
+/* size bytes of valid UTF-8: ASCII with a multibyte codepoint every `every` bytes (0 = none),
+ * cycling through 2-, 3- and 4-byte sequences; padded with ASCII so it ends on a boundary */
+static void fill_text(uint8_t* p, size_t size, size_t every) {
+    static const uint8_t seqs[3][4] = { { 0xC3, 0xA9 }, { 0xE2, 0x82, 0xAC }, { 0xF0, 0x9F, 0x98, 0x80 } };
+    size_t i = 0, k = 0;
+    while (i < size) {
+        if (every && (i / every) != ((i + 4) / every)) {
+            size_t len = (size_t)(k % 3) + 2;
+            if (i + len <= size) { memcpy(p + i, seqs[k % 3], len); i += len; k++; continue; }
+        }
+        p[i] = (uint8_t)('a' + i % 26);
+        i++;
+    }
+}
+
+/* All 3-byte codepoints (CJK-like text) */
+static void fill_cjk(uint8_t* p, size_t size) {
+    size_t i = 0;
+    for (; i + 3 <= size; i += 3) { p[i] = 0xE4; p[i + 1] = (uint8_t)(0x80 + (i / 3) % 64); p[i + 2] = 0x80 + (uint8_t)(i % 64); }
+    for (; i < size; i++) p[i] = 'x';
+}
+
+/* ---- ring buffer ---- */
+
+/* Write size bytes through peek_write/commit and read them back through peek_read/consume */
+static uint64_t op_ring(ctx_t* c) {
+    ws_ringbuf_t* rb = c->rb;
+    uint64_t seen = 0;
+    size_t left = c->size, put = 0;
+    while (put < c->size) {
+        uint8_t* w; size_t room = ws_ringbuf_peek_write(rb, &w);
+        size_t n = room < left ? room : left;
+        memcpy(w, c->in + put, n);
+        ws_ringbuf_commit(rb, n);
+        put += n; left -= n;
+        const uint8_t* r; size_t have = ws_ringbuf_peek_read(rb, &r);
+        seen += r[have - 1];
+        ws_ringbuf_consume(rb, have);
+    }
+    return seen;
+}
+
+/* ---- handshake ---- */
+
+static const char upgrade_resp[] =
+    "HTTP/1.1 101 Switching Protocols\r\n"
+    "Upgrade: websocket\r\n"
+    "Connection: Upgrade\r\n"
+    "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n"
+    "Sec-WebSocket-Protocol: chat\r\n"
+    "Sec-WebSocket-Extensions: permessage-deflate; client_max_window_bits=15\r\n"
+    "Server: bench\r\n"
+    "\r\n";
+
+/* A reconnect's request: the template copied into the send buffer with a fresh key in place */
+static uint64_t op_request(ctx_t* c) {
+    memcpy(c->out, c->in, c->in_len);
+    ws_handshake_set_key((char*)c->out, c->seg, "dGhlIHNhbXBsZSBub25jZQ==");
+    return c->out[c->in_len - 1];
+}
+
+static uint64_t op_response(ctx_t* c) {
+    ws_http_response_t r;
+    size_t used;
+    ws_http_response_init(&r);
+    if (ws_http_response_feed(&r, (const char*)c->in, c->in_len, &used) != WS_HTTP_DONE ||
+        ws_http_response_check(&r, "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=", "chat") != 0) {
+        fprintf(stderr, "handshake response rejected\n");
+        exit(1);
+    }
+    return used;
+}
+
+int main(int argc, char** argv) {
+    filter = argc > 1 && strcmp(argv[1], "all") != 0 ? argv[1] : NULL;
+    if (argc > 2) target_ns = (uint64_t)strtoull(argv[2], NULL, 10) * 1000000ull;
+
+    uint8_t* payload = (uint8_t*)malloc(MAX_SIZE);
+    for (size_t i = 0; i < MAX_SIZE; i++) payload[i] = (uint8_t)(i * 31 + 7);
+    size_t frames_cap = 64 * (4096 + 4 * WS_MAX_HEADER_SIZE) + MAX_SIZE + 4 * WS_MAX_HEADER_SIZE;
+    uint8_t* frames = (uint8_t*)malloc(frames_cap);
+    uint8_t* out = (uint8_t*)malloc(MAX_SIZE + WS_MAX_HEADER_SIZE);
+    uint8_t* text = (uint8_t*)malloc(MAX_SIZE);
+
+    fill_text(text, MAX_SIZE, 0);
+    bench_parser(payload, text, frames, frames_cap);
+
+    ctx_t c; memset(&c, 0, sizeof(c));
+    c.in = payload; c.out = out; c.out_cap = MAX_SIZE + WS_MAX_HEADER_SIZE;
+    for (size_t k = 0; k < NSIZES; k++) {
+        c.size = sizes[k];
+        run("build.header", c.size, op_build_header, &c, 0);
+        run("build.frame", c.size, op_build, &c, c.size);
+        run("mask.copy", c.size, op_mask, &c, c.size);
+        run("mask.inplace", c.size, op_mask_inplace, &c, c.size);
+    }
+
+    /* ascii: pure ASCII; mixed: a multibyte codepoint about every 16 bytes; cjk: all 3-byte */
+    c.in = text;
+    for (size_t k = 0; k < NSIZES; k++) { c.size = sizes[k]; run("utf8.ascii", c.size, op_utf8, &c, c.size); }
+    for (size_t k = 0; k < NSIZES; k++) {
+        c.size = sizes[k];
+        fill_text(text, c.size, 16);
+        run("utf8.mixed", c.size, op_utf8, &c, c.size);
+    }
+    for (size_t k = 0; k < NSIZES; k++) {
+        c.size = sizes[k];
+        fill_cjk(text, c.size);
+        run("utf8.cjk", c.size, op_utf8, &c, c.size);
+    }
+
+    /* A 64 KiB ring as the connection uses it, mirrored where the platform allows; payloads
+     * beyond the ring's size go through in ring-sized pieces */
+    ws_ringbuf_t rb;
+    const char* ring_names[] = { "ring.mirrored", "ring.plain" };
+    for (int mirrored = 1; mirrored >= 0; mirrored--) {
+        int rc = mirrored ? ws_ringbuf_init_mirrored(&rb, 64 * 1024) : ws_ringbuf_init(&rb, 64 * 1024);
+        if (rc != 0) continue;
+        /* Start mid-ring so writes wrap */
+        ws_ringbuf_commit(&rb, 1000); ws_ringbuf_consume(&rb, 1000);
+        c.in = payload; c.rb = &rb;
+        for (size_t k = 1; k < NSIZES; k++) { c.size = sizes[k]; run(ring_names[1 - mirrored], c.size, op_ring, &c, c.size); }
+        ws_ringbuf_free(&rb);
+    }
+
+    char tmpl[1024];
+    size_t key_off = 0;
+    int n = ws_build_handshake_template("example.com", 443, "/stream", "bench/1", NULL, "chat",
+                                        "permessage-deflate; client_max_window_bits", tmpl, sizeof(tmpl), &key_off);
+    if (n > 0) {
+        c.in = (const uint8_t*)tmpl; c.in_len = (size_t)n; c.seg = key_off; c.size = (size_t)n;
+        run("handshake.request", c.size, op_request, &c, c.size);
+    }
+    c.in = (const uint8_t*)upgrade_resp; c.in_len = c.size = sizeof(upgrade_resp) - 1;
+    run("handshake.response", c.size, op_response, &c, c.size);
+
+    free(text);
+    free(out);
+    free(frames);
+    free(payload);
+    return 0;
+}
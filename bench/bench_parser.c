@@ -0,0 +1,62 @@
+#define _POSIX_C_SOURCE 200809L
+/* Parser microbenchmark: small binary frames back to back, fed whole (headers decoded in place)
+ * and in odd-sized segments (headers that straddle a feed take the byte accumulator) */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../src/internal/frame.h"
+
+static uint64_t now_ns(void){ struct timespec ts; clock_gettime(CLOCK_MONOTONIC,&ts); return (uint64_t)ts.tv_sec*1000000000ull+ts.tv_nsec; }
+
+/* Parse buf in segments of seg bytes (0 = all at once); returns frames seen */
+static size_t parse_all(ws_parser_t* p, const uint8_t* buf, size_t n, size_t seg, uint64_t* sink) {
+    size_t frames = 0, off = 0;
+    while (off < n) {
+        size_t end = (seg == 0 || n - off < seg) ? n : off + seg;
+        while (off < end) {
+            size_t c = 0; ws_parsed_frame_t f;
+            ws_parser_status_t s = ws_parser_feed(p, buf + off, end - off, &c, &f);
+            if (s < 0) { fprintf(stderr, "parse error %d\n", (int)s); exit(1); }
+            off += c;
+            if (s == WS_PARSER_FRAME) { frames++; *sink += f.payload_len; }
+            else if (s == WS_PARSER_NEED_MORE) break;
+        }
+    }
+    return frames;
+}
+
+int main(int argc, char** argv) {
+    size_t msg_len = (argc > 1) ? (size_t)strtoul(argv[1], NULL, 10) : 16;
+    size_t count = (argc > 2) ? (size_t)strtoul(argv[2], NULL, 10) : 4096;
+    size_t rounds = (argc > 3) ? (size_t)strtoul(argv[3], NULL, 10) : 2000;
+
+    uint8_t* payload = (uint8_t*)malloc(msg_len + 1); memset(payload, 'A', msg_len);
+    size_t frame_cap = msg_len + WS_MAX_HEADER_SIZE;
+    uint8_t* buf = (uint8_t*)malloc(frame_cap * count);
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        n += ws_build_frame(buf + n, frame_cap, 1, WS_OPCODE_BINARY, NULL, payload, msg_len);
+    }
+
+    /* 0 = whole buffer per feed; 1021 is prime so headers land on every offset of a segment */
+    const size_t segs[] = { 0, 1021 };
+    const char* names[] = { "whole", "split" };
+    uint64_t sink = 0;
+    for (size_t k = 0; k < sizeof(segs) / sizeof(segs[0]); k++) {
+        ws_parser_t p; ws_parser_init(&p, 1u << 20);
+        (void)parse_all(&p, buf, n, segs[k], &sink); /* warm up */
+        size_t frames = 0;
+        uint64_t t0 = now_ns();
+        for (size_t r = 0; r < rounds; r++) frames += parse_all(&p, buf, n, segs[k], &sink);
+        uint64_t t1 = now_ns();
+        double secs = (double)(t1 - t0) / 1e9;
+        printf("%s: len=%zu frames=%zu time=%.3fs frames/s=%.2f ns/frame=%.2f\n",
+               names[k], msg_len, frames, secs, secs > 0.0 ? (double)frames / secs : 0.0,
+               frames ? (double)(t1 - t0) / (double)frames : 0.0);
+    }
+    if (sink == 0 && msg_len) return 1; /* keep the work observable */
+    free(buf);
+    free(payload);
+    return 0;
+}
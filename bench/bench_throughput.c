@@ -1,34 +1,67 @@
 #define _POSIX_C_SOURCE 200809L
+/* Round-trip throughput on one connection: keeps up to `window` messages in flight and counts
+ * a message only once its echo is back and byte-for-byte equal to what was sent, so the clock
+ * covers the bytes being flushed, echoed and received rather than just queued. */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include "wibesocket/wibesocket.h"
 
-static uint64_t now_ms(void){ struct timespec ts; clock_gettime(CLOCK_MONOTONIC,&ts); return (uint64_t)ts.tv_sec*1000ull+ts.tv_nsec/1000000ull; }
+static uint64_t now_ns(void){ struct timespec ts; clock_gettime(CLOCK_MONOTONIC,&ts); return (uint64_t)ts.tv_sec*1000000000ull+ts.tv_nsec; }
+
+/* Message i: its index, then a pattern that shifts with it */
+static void fill(char* p, size_t len, size_t i) {
+    size_t head = len < sizeof(i) ? len : sizeof(i);
+    memcpy(p, &i, head);
+    for (size_t j = head; j < len; j++) p[j] = (char)(i + j * 7);
+}
 
 int main(int argc, char** argv) {
     const char* uri = argc > 1 ? argv[1] : getenv("WIBESOCKET_BENCH_URI");
     size_t msg_len = (argc > 2) ? (size_t)strtoul(argv[2], NULL, 10) : 125;
     size_t num = (argc > 3) ? (size_t)strtoul(argv[3], NULL, 10) : 100000;
-    if (!uri) { fprintf(stderr, "usage: %s ws://host:port/path [len] [count]\n", argv[0]); return 2; }
+    size_t window = (argc > 4) ? (size_t)strtoul(argv[4], NULL, 10) : 64;
+    if (!uri || window == 0) { fprintf(stderr, "usage: %s ws://host:port/path [len] [count] [window]\n", argv[0]); return 2; }
 
-    wibesocket_config_t cfg = {0}; cfg.handshake_timeout_ms = 5000; cfg.max_frame_size = (1u<<20);
+    wibesocket_config_t cfg = {0}; cfg.handshake_timeout_ms = 5000;
+    cfg.max_frame_size = (uint32_t)(msg_len + 64 > (1u<<20) ? msg_len + 64 : (1u<<20));
     wibesocket_conn_t* c = wibesocket_connect(uri, &cfg);
     if (!c) { fprintf(stderr, "connect failed\n"); return 1; }
 
-    char* payload = (char*)malloc(msg_len); memset(payload, 'A', msg_len);
-    uint64_t start = now_ms();
-    for (size_t i = 0; i < num; i++) {
-        (void)wibesocket_send_binary(c, payload, msg_len);
+    char* out = (char*)malloc(msg_len ? msg_len : 1);
+    char* want = (char*)malloc(msg_len ? msg_len : 1);
+    size_t sent = 0, got = 0, bad = 0, failures = 0;
+    uint64_t start = now_ns();
+    while (got + bad < num) {
+        if (sent < num && sent - got - bad < window) {
+            wibesocket_error_t e = wibesocket_send_begin(c);
+            while (e == WIBESOCKET_OK && sent < num && sent - got - bad < window) {
+                fill(out, msg_len, sent);
+                e = wibesocket_send_binary(c, out, msg_len);
+                if (e == WIBESOCKET_OK) sent++;
+            }
+            (void)wibesocket_send_commit(c);
+            if (e != WIBESOCKET_OK && e != WIBESOCKET_ERROR_BUFFER_FULL) { failures++; break; }
+        }
+        wibesocket_message_t m[64];
+        size_t n = 0;
+        wibesocket_error_t e = wibesocket_recv_batch(c, m, 64, &n, 5000);
+        if (e != WIBESOCKET_OK) { failures++; break; } /* a timeout here means echoes went missing */
+        for (size_t i = 0; i < n; i++) {
+            fill(want, msg_len, got + bad);
+            if (m[i].payload_len == msg_len && memcmp(m[i].payload, want, msg_len) == 0) got++;
+            else bad++;
+        }
+        wibesocket_release_message(c, &m[0]);
     }
-    uint64_t end = now_ms();
-    double secs = (double)(end - start) / 1000.0;
-    double throughput = (secs > 0.0) ? (double)num / secs : 0.0;
-    printf("len=%zu count=%zu time=%.3fs msgs/s=%.2f\n", msg_len, num, secs, throughput);
-    free(payload);
+    uint64_t end = now_ns();
+    double secs = (double)(end - start) / 1e9;
+    double throughput = (secs > 0.0) ? (double)got / secs : 0.0;
+    printf("len=%zu count=%zu window=%zu time=%.3fs msgs/s=%.2f MB/s=%.2f corrupt=%zu failures=%zu\n",
+           msg_len, got, window, secs, throughput, throughput * (double)msg_len / 1e6, bad, failures);
+    free(out);
+    free(want);
     (void)wibesocket_close(c);
-    return 0;
+    return (bad || failures) ? 1 : 0;
 }
-
-
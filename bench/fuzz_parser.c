@@ -0,0 +1,146 @@
+#define _POSIX_C_SOURCE 200809L
+/* Parser fuzz target. LLVMFuzzerTestOneInput feeds one input through ws_parser_feed the way
+ * the connection does, in segments whose sizes come from the first input byte, and aborts if a
+ * parser invariant breaks (consumed past the input, payload outside it, a chunk past its frame).
+ *
+ * Built with -DWS_LIBFUZZER (cmake -DWS_FUZZ=ON with clang) it is a libFuzzer binary, which
+ * reports exec/s itself. Otherwise main() is a standalone driver that mutates a seeded corpus of
+ * valid frame streams for a fixed time and prints exec/s, so fuzz throughput can be tracked on
+ * any compiler:
+ *   fuzz_parser [seconds] [seed] */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../src/internal/frame.h"
+
+#define FUZZ_MAX_FRAME (1u << 16)
+
+static void check(int ok, const char* what) {
+    if (!ok) { fprintf(stderr, "fuzz_parser: %s\n", what); abort(); }
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    if (size == 0) return 0;
+    /* Low bits: segment size (0 = whole input per feed); bit 7: RSV1 allowed */
+    size_t seg = (size_t)(data[0] & 0x7F);
+    ws_parser_t p; ws_parser_init(&p, FUZZ_MAX_FRAME);
+    p.allow_rsv1 = (data[0] & 0x80) != 0;
+    data++; size--;
+
+    size_t off = 0;
+    while (off < size) {
+        size_t end = (seg == 0 || size - off < seg) ? size : off + seg;
+        while (off < end) {
+            size_t used = 0; ws_parsed_frame_t f;
+            ws_parser_status_t s = ws_parser_feed(&p, data + off, end - off, &used, &f);
+            check(used <= end - off, "consumed past the input");
+            if (s < 0) return 0; /* a protocol error ends the connection */
+            if (s == WS_PARSER_FRAME || s == WS_PARSER_CHUNK) {
+                const uint8_t* pl = (const uint8_t*)f.payload;
+                int in_input = f.payload_len == 0 ||
+                               (pl >= data + off && pl + f.payload_len <= data + off + used);
+                int in_ctrl = f.payload_len <= sizeof(p.ctrl_buf) && pl >= p.ctrl_buf &&
+                              pl + f.payload_len <= p.ctrl_buf + sizeof(p.ctrl_buf);
+                check(in_input || in_ctrl, "payload outside the input");
+                check(f.offset + f.payload_len <= f.frame_len, "chunk past the end of its frame");
+                check(f.frame_len <= FUZZ_MAX_FRAME, "frame over max_frame_size");
+                if (s == WS_PARSER_FRAME) check(f.offset + f.payload_len == f.frame_len, "frame reported before its end");
+            }
+            off += used;
+            if (s == WS_PARSER_NEED_MORE) {
+                check(off == end, "NEED_MORE with input left");
+                break;
+            }
+            check(used > 0 || s != WS_PARSER_OK, "no progress");
+        }
+    }
+    return 0;
+}
+
+#ifndef WS_LIBFUZZER
+
+static uint64_t now_ns(void){ struct timespec ts; clock_gettime(CLOCK_MONOTONIC,&ts); return (uint64_t)ts.tv_sec*1000000000ull+ts.tv_nsec; }
+
+static uint64_t rng_state;
+static uint64_t rng(void) {
+    rng_state ^= rng_state << 13; rng_state ^= rng_state >> 7; rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+#define SEED_MAX 4096
+#define NSEEDS 64
+
+/* A valid server stream: a few data messages, some fragmented, with control frames between */
+static size_t make_seed(uint8_t* out) {
+    static const ws_opcode_t ctl[] = { WS_OPCODE_PING, WS_OPCODE_PONG, WS_OPCODE_CLOSE };
+    uint8_t payload[512];
+    size_t n = 0;
+    out[n++] = (uint8_t)(rng() & 0x7F);
+    for (int m = 0, msgs = 1 + (int)(rng() % 4); m < msgs; m++) {
+        ws_opcode_t op = (rng() & 1) ? WS_OPCODE_TEXT : WS_OPCODE_BINARY;
+        int frags = 1 + (int)(rng() % 3);
+        for (int f = 0; f < frags; f++) {
+            size_t len = (size_t)(rng() % ((rng() & 3) ? 126 : sizeof(payload)));
+            for (size_t i = 0; i < len; i++) payload[i] = (uint8_t)(op == WS_OPCODE_TEXT ? 'a' + rng() % 26 : rng());
+            n += ws_build_frame(out + n, SEED_MAX - n, f + 1 == frags, f ? WS_OPCODE_CONTINUATION : op,
+                                NULL, payload, len);
+            if (rng() % 4 == 0) n += ws_build_frame(out + n, SEED_MAX - n, 1, ctl[rng() % 3], NULL, payload, 2);
+        }
+    }
+    return n;
+}
+
+/* Byte flips, overwrites with boundary values, truncation and block duplication */
+static size_t mutate(uint8_t* buf, size_t len, size_t cap) {
+    static const uint8_t special[] = { 0x00, 0x7D, 0x7E, 0x7F, 0x80, 0x81, 0x88, 0x89, 0x8A, 0xFF };
+    for (int k = 0, edits = 1 + (int)(rng() % 4); k < edits && len > 0; k++) {
+        size_t at = (size_t)(rng() % len);
+        switch (rng() % 4) {
+        case 0: buf[at] ^= (uint8_t)(1u << (rng() % 8)); break;
+        case 1: buf[at] = special[rng() % sizeof(special)]; break;
+        case 2: if (at > 1) len = at; break;
+        default: {
+            size_t blk = 1 + (size_t)(rng() % 32);
+            if (at + blk <= len && len + blk <= cap) {
+                memmove(buf + at + blk, buf + at, len - at);
+                len += blk;
+            }
+        }
+        }
+    }
+    return len;
+}
+
+int main(int argc, char** argv) {
+    double secs = argc > 1 ? strtod(argv[1], NULL) : 2.0;
+    rng_state = argc > 2 ? strtoull(argv[2], NULL, 10) : 0x9E3779B97F4A7C15ull;
+    if (rng_state == 0) rng_state = 1;
+
+    static uint8_t seeds[NSEEDS][SEED_MAX];
+    static size_t seed_len[NSEEDS];
+    for (int i = 0; i < NSEEDS; i++) seed_len[i] = make_seed(seeds[i]);
+
+    static uint8_t buf[SEED_MAX * 2];
+    uint64_t execs = 0, bytes = 0;
+    uint64_t t0 = now_ns(), end = t0 + (uint64_t)(secs * 1e9), t1;
+    do {
+        for (int i = 0; i < 256; i++) {
+            int s = (int)(rng() % NSEEDS);
+            memcpy(buf, seeds[s], seed_len[s]);
+            size_t len = (i & 7) ? mutate(buf, seed_len[s], sizeof(buf)) : seed_len[s];
+            (void)LLVMFuzzerTestOneInput(buf, len);
+            execs++;
+            bytes += len;
+        }
+        t1 = now_ns();
+    } while (t1 < end);
+    double el = (double)(t1 - t0) / 1e9;
+    printf("fuzz: execs=%llu time=%.3fs exec/s=%.0f MB/s=%.2f\n", (unsigned long long)execs, el,
+           el > 0.0 ? (double)execs / el : 0.0, el > 0.0 ? (double)bytes / el / 1e6 : 0.0);
+    return 0;
+}
+
+#endif /* WS_LIBFUZZER */
@@ -27,7 +27,7 @@ def ensure_built() -> None:
         if rc != 0:
             print(err or out, file=sys.stderr)
             sys.exit(2)
-    for tgt in ("bench_throughput", "bench_latency"):
+    for tgt in ("bench_throughput", "bench_latency", "bench_load", "bench_echo_server", "bench_micro", "fuzz_parser"):
         exe = os.path.join(BUILD, tgt)
         if not os.path.exists(exe):
             rc, out, err = run_cmd(["cmake", "--build", BUILD, "--target", tgt, "-j"])
@@ -294,109 +294,196 @@ def lws_client_throughput(uri: str, payload_len: int, count: int) -> float:
     return float("nan")
 
 
+def parse_kv(line: str) -> Dict[str, float]:
+    """key=value tokens of a bench output line as floats (units like 's' or 'ms' stripped)."""
+    vals: Dict[str, float] = {}
+    for tok in line.split():
+        if "=" not in tok:
+            continue
+        k, v = tok.split("=", 1)
+        try:
+            vals[k] = float(v.rstrip("ms"))
+        except ValueError:
+            pass
+    return vals
+
+
 def bench_ours_throughput(uri: str, payload_len: int, count: int) -> Optional[float]:
     ensure_built()
     exe = os.path.join(BUILD, "bench_throughput")
     rc, out, err = run_cmd([exe, uri, str(payload_len), str(count)])
-    if rc != 0:
+    if rc != 0 or not out:
         print(err or out, file=sys.stderr)
         return None
-    try:
-        last = out.strip().splitlines()[-1]
-        parts = last.split()
-        for token in parts:
-            if token.startswith("msgs/s="):
-                return float(token.split("=", 1)[1])
-    except Exception:
-        pass
-    return None
+    return parse_kv(out.splitlines()[-1]).get("msgs/s")
+
 
+LATENCY_MODES = ("epoll", "busy_poll")
 
-def bench_ours_latency(uri: str, iters: int) -> Optional[Tuple[float, float, float]]:
+
+def bench_ours_latency(uri: str, iters: int) -> Optional[Dict[str, Tuple[float, float, float]]]:
+    """(p50, p90, p99) per receive mode: sleeping in epoll, and busy-polling."""
     ensure_built()
     exe = os.path.join(BUILD, "bench_latency")
     rc, out, err = run_cmd([exe, uri, str(iters)])
+    if rc != 0 or not out:
+        print(err or out, file=sys.stderr)
+        return None
+    modes: Dict[str, Tuple[float, float, float]] = {}
+    for line in out.splitlines():
+        mode = next((m for m in LATENCY_MODES if f"mode={m} " in line), None)
+        kv = parse_kv(line)
+        if mode and all(k in kv for k in ("p50", "p90", "p99")):
+            modes[mode] = (kv["p50"], kv["p90"], kv["p99"])
+    return modes if "epoll" in modes else None
+
+
+# Fixed load scenarios for bench_load: (name, args). Closed loop unless -r is given.
+LOAD_SCENARIOS: List[Tuple[str, List[str]]] = [
+    ("pingpong_1c_125", ["-c", "1", "-t", "1", "-s", "125", "-W", "1"]),
+    ("pipelined_1c_125", ["-c", "1", "-t", "1", "-s", "125", "-W", "64"]),
+    ("fanout_64c_4t_125", ["-c", "64", "-t", "4", "-s", "125", "-W", "8"]),
+    ("bulk_4c_2t_64k", ["-c", "4", "-t", "2", "-s", "65536", "-W", "4"]),
+    ("open_16c_2t_20k", ["-c", "16", "-t", "2", "-s", "125", "-r", "20000"]),
+]
+
+
+def bench_ours_load(uri: str, args: List[str], secs: float) -> Optional[Dict[str, float]]:
+    ensure_built()
+    exe = os.path.join(BUILD, "bench_load")
+    rc, out, err = run_cmd([exe, "-u", uri, "-d", str(secs)] + args)
+    if not out:
+        print(err, file=sys.stderr)
+        return None
+    kv = parse_kv(out.splitlines()[-1])
+    if rc != 0:
+        print(f"bench_load {' '.join(args)}: corrupt={kv.get('corrupt')} lost={kv.get('lost')} errors={kv.get('errors')}",
+              file=sys.stderr)
+        return None
+    return kv
+
+
+def bench_ours_micro(ms: int) -> Dict[str, Dict[str, float]]:
+    """bench_micro results keyed by "<case>.<size>"."""
+    ensure_built()
+    rc, out, err = run_cmd([os.path.join(BUILD, "bench_micro"), "all", str(ms)])
     if rc != 0:
+        print(err or out, file=sys.stderr)
+        return {}
+    res: Dict[str, Dict[str, float]] = {}
+    for line in out.splitlines():
+        if not line.startswith("micro:"):
+            continue
+        case = line.split("case=", 1)[1].split()[0]
+        kv = parse_kv(line)
+        res[f"{case}.{int(kv['size'])}"] = kv
+    return res
+
+
+def bench_ours_fuzz(secs: float) -> Optional[float]:
+    ensure_built()
+    rc, out, err = run_cmd([os.path.join(BUILD, "fuzz_parser"), str(secs)])
+    if rc != 0 or not out:
         print(err or out, file=sys.stderr)
         return None
-    try:
-        last = out.strip().splitlines()[-1]
-        tokens = last.replace(",", " ").replace("=", " ").split()
-        p50 = float(tokens[tokens.index("p50") + 1].rstrip("ms"))
-        p90 = float(tokens[tokens.index("p90") + 1].rstrip("ms"))
-        p99 = float(tokens[tokens.index("p99") + 1].rstrip("ms"))
-        return (p50, p90, p99)
-    except Exception:
+    return parse_kv(out.splitlines()[-1]).get("exec/s")
+
+
+def best_of(runs: List[Optional[Dict[str, float]]]) -> Optional[Dict[str, float]]:
+    """Per metric, the best of several runs: highest rate, lowest latency and CPU."""
+    runs = [r for r in runs if r]
+    if not runs:
         return None
+    best: Dict[str, float] = {}
+    for k in runs[0]:
+        vals = [r[k] for r in runs if k in r]
+        best[k] = max(vals) if higher_is_better(k) else min(vals)
+    return best
+
+
+def higher_is_better(metric: str) -> bool:
+    return any(k in metric for k in ("msgs/s", "msgs_per_sec", "MB/s", "GB/s", "exec/s", "execs_per_sec"))
+
+
+def start_echo_server() -> Tuple[subprocess.Popen, str]:
+    """The fixed C echo server (bench_echo_server) on an ephemeral port."""
+    ensure_built()
+    p = subprocess.Popen([os.path.join(BUILD, "bench_echo_server")], stdout=subprocess.PIPE, text=True)
+    line = p.stdout.readline().strip() if p.stdout else ""
+    if not line.startswith("port="):
+        p.kill()
+        print("bench_echo_server failed to start", file=sys.stderr)
+        sys.exit(2)
+    return p, f"ws://127.0.0.1:{int(line.split('=', 1)[1])}/"
+
+
+def gate(baseline: Dict, metrics: Dict[str, float], threshold: float) -> List[str]:
+    """Metrics more than threshold worse than the baseline's."""
+    base = baseline.get("metrics") or {}
+    regressions = []
+    for name, cur in sorted(metrics.items()):
+        old = base.get(name)
+        if old is None or cur is None or old <= 0:
+            continue
+        worse = (old - cur) / old if higher_is_better(name) else (cur - old) / old
+        if worse > threshold:
+            regressions.append(f"{name}: {old:.4g} -> {cur:.4g} ({worse * 100:.1f}% worse)")
+    return regressions
+
+
+SUITE_VERSION = 2  # bump when a metric changes meaning; older baselines are then not compared
 
 
 def main() -> None:
-    ap = argparse.ArgumentParser(description="Run WibeSocket benchmarks and compare with Python websockets")
-    ap.add_argument("uri", nargs="?", default=os.environ.get("WIBESOCKET_BENCH_URI"), help="ws://host:port/path echo endpoint")
+    global BUILD
+    ap = argparse.ArgumentParser(description="Run WibeSocket benchmarks, compare with other clients, and gate on regressions")
+    ap.add_argument("uri", nargs="?", default=os.environ.get("WIBESOCKET_BENCH_URI"),
+                    help="ws://host:port/path echo endpoint (default: start the local bench_echo_server)")
+    ap.add_argument("--build-dir", default=BUILD, help="CMake build directory holding the bench binaries")
     ap.add_argument("--sizes", nargs="*", type=int, default=[125, 16 * 1024, 64 * 1024], help="payload sizes for throughput")
     ap.add_argument("--count", type=int, default=50000, help="messages per size for throughput")
     ap.add_argument("--iters", type=int, default=2000, help="iterations for latency")
+    ap.add_argument("--load-secs", type=float, default=2.0, help="seconds per bench_load scenario")
+    ap.add_argument("--micro-ms", type=int, default=100, help="milliseconds per bench_micro case (0 skips micro and fuzz)")
+    ap.add_argument("--repeat", type=int, default=3, help="runs of each of our benches; the best is kept")
+    ap.add_argument("--ours-only", action="store_true", help="skip the other clients (what the regression gate needs)")
+    ap.add_argument("--baseline", default=os.path.join(ROOT, "bench", "results", "latest.json"), help="results to compare against")
+    ap.add_argument("--threshold", type=float, default=0.05, help="relative slowdown that fails the gate")
+    ap.add_argument("--save", action="store_true",
+                    help="write the results as the new baseline, and RESULTS.md unless --ours-only")
     ap.add_argument("--install-missing", action="store_true", help="attempt to pip install missing python competitors in this interpreter")
     args = ap.parse_args()
-    if not args.uri:
-        print("Provide URI via arg or WIBESOCKET_BENCH_URI", file=sys.stderr)
-        sys.exit(2)
+    BUILD = os.path.abspath(args.build_dir)
 
-    # Auto-start a local echo server if URI targets localhost and 'websockets' is available
     echo_proc = None
-    echo_thread = None
-    echo_stop = None
+    if not args.uri:
+        echo_proc, args.uri = start_echo_server()
     try:
-        parsed = urllib.parse.urlsplit(args.uri)
-        host = parsed.hostname or ""
-        port = parsed.port
-        if host in ("127.0.0.1", "localhost", "::1"):
-            try:
-                if args.install_missing:
-                    ensure_python_package("websockets", "websockets")
-                import websockets  # type: ignore
-                import threading, queue
-                addr_host = host if host != "localhost" else "127.0.0.1"
-                port_q: "queue.Queue[int]" = queue.Queue(maxsize=1)
-                stop_ev = threading.Event()
-
-                def _run_server():
-                    import asyncio as _aio
-                    async def echo(ws):
-                        async for m in ws:
-                            await ws.send(m)
-                    async def runner():
-                        server = await websockets.serve(echo, addr_host, 0, max_size=None)
-                        sel_port = server.sockets[0].getsockname()[1]
-                        port_q.put(sel_port)
-                        try:
-                            while not stop_ev.is_set():
-                                await _aio.sleep(0.1)
-                        finally:
-                            server.close()
-                            await server.wait_closed()
-                    _aio.run(runner())
-
-                t = threading.Thread(target=_run_server, daemon=True)
-                t.start()
-                try:
-                    sel_port = port_q.get(timeout=5.0)
-                    args.uri = f"ws://{addr_host}:{sel_port}/"
-                    echo_thread = t
-                    echo_stop = stop_ev
-                except Exception:
-                    print("Warning: local echo server failed to start within timeout", file=sys.stderr)
-            except Exception:
-                print("Note: couldn't auto-start local echo server (install 'websockets' in this interpreter)", file=sys.stderr)
-    except Exception:
-        pass
+        code = run_suite(args)
+    finally:
+        if echo_proc is not None:
+            echo_proc.kill()
+            echo_proc.wait()
+    sys.exit(code)
 
+
+def run_suite(args: argparse.Namespace) -> int:
     print(f"URI: {args.uri}")
-    results: Dict[str, Dict] = {"uri": args.uri, "throughput": {}, "latency": {}}
+    results: Dict[str, Dict] = {"uri": args.uri, "suite": SUITE_VERSION, "throughput": {}, "latency": {}, "load": {}, "micro": {},
+                               "metrics": {}}
+    metrics = results["metrics"]
+    reps = max(1, args.repeat)
     print("== Throughput (round-trip msgs/s) ==")
     for sz in args.sizes:
-        ours = bench_ours_throughput(args.uri, sz, args.count)
+        runs = [bench_ours_throughput(args.uri, sz, args.count) for _ in range(reps)]
+        runs = [r for r in runs if r]
+        ours = max(runs) if runs else None
         print(f" ours  sz={sz:6d}: {ours:.2f} msgs/s" if ours else f" ours  sz={sz:6d}: n/a")
+        if ours:
+            metrics[f"throughput.{sz}.msgs_per_sec"] = ours
+        row = results["throughput"][str(sz)] = {"ours_msgs_per_sec": float(ours) if ours else None}
+        if args.ours_only:
+            continue
         # Python websockets
         if args.install_missing:
             ensure_python_package("websockets", "websockets")
@@ -438,128 +525,148 @@ def main() -> None:
             print(f" libwebsockets sz={sz:6d}: {tlws:.2f} msgs/s")
         else:
             print(f" libwebsockets sz={sz:6d}: n/a")
-        results["throughput"][str(sz)] = {
-            "ours_msgs_per_sec": float(ours) if ours else None,
-            "websockets_msgs_per_sec": float(t) if t else None,
+        row.update({
+            "websockets_msgs_per_sec": float(t) if t == t and t else None,
             "websocket_client_msgs_per_sec": float(tc) if tc == tc else None,
             "aiohttp_msgs_per_sec": float(ta) if ta == ta else None,
             "websocat_msgs_per_sec": float(tw) if tw == tw else None,
             "libwebsockets_msgs_per_sec": float(tlws) if tlws == tlws else None,
-        }
+        })
 
     print("\n== Latency (ms) ==")
-    ol = bench_ours_latency(args.uri, args.iters)
-    if ol:
-        print(f" ours: p50={ol[0]:.3f} p90={ol[1]:.3f} p99={ol[2]:.3f}")
-    if args.install_missing:
-        ensure_python_package("websockets", "websockets")
-        ensure_python_package("websocket", "websocket-client")
-        ensure_python_package("aiohttp", "aiohttp")
-    try:
-        p50, p90, p99 = asyncio.run(ws_websockets_latency(args.uri, args.iters))
-        print(f" websockets: p50={p50:.3f} p90={p90:.3f} p99={p99:.3f}")
-    except Exception as e:
-        print(f" websockets: n/a ({e})")
-        p50 = p90 = p99 = None
-    try:
-        cp50, cp90, cp99 = ws_websocket_client_latency(args.uri, args.iters)
-        if cp50 == cp50:
-            print(f" websocket-client: p50={cp50:.3f} p90={cp90:.3f} p99={cp99:.3f}")
+    lruns = [bench_ours_latency(args.uri, args.iters) for _ in range(reps)]
+    lruns = [r for r in lruns if r]
+    for mode in LATENCY_MODES:
+        key = "ours_ms" if mode == "epoll" else f"ours_{mode}_ms"
+        runs = [r[mode] for r in lruns if mode in r]
+        ol = min(runs, key=lambda r: r[1]) if runs else None
+        if ol:
+            print(f" ours ({mode}): p50={ol[0]:.4f} p90={ol[1]:.4f} p99={ol[2]:.4f}")
+            results["latency"][key] = {"p50": float(ol[0]), "p90": float(ol[1]), "p99": float(ol[2])}
+            prefix = "latency" if mode == "epoll" else f"latency.{mode}"
+            metrics[f"{prefix}.p50_ms"] = ol[0]
+            metrics[f"{prefix}.p99_ms"] = ol[2]
         else:
-            print(" websocket-client: n/a")
-    except Exception:
-        cp50 = cp90 = cp99 = None
+            results["latency"][key] = {"p50": None, "p90": None, "p99": None}
+    if not args.ours_only:
+        if args.install_missing:
+            ensure_python_package("websockets", "websockets")
+            ensure_python_package("websocket", "websocket-client")
+            ensure_python_package("aiohttp", "aiohttp")
+        for key, label, fn in (
+            ("websockets_ms", "websockets", lambda: asyncio.run(ws_websockets_latency(args.uri, args.iters))),
+            ("websocket_client_ms", "websocket-client", lambda: ws_websocket_client_latency(args.uri, args.iters)),
+            ("aiohttp_ms", "aiohttp", lambda: asyncio.run(aiohttp_latency(args.uri, args.iters))),
+            ("websocat_ms", "websocat", lambda: websocat_latency(args.uri, args.iters)),
+        ):
+            try:
+                p50, p90, p99 = fn()
+            except Exception:
+                p50 = p90 = p99 = float("nan")
+            if p50 == p50:
+                print(f" {label}: p50={p50:.3f} p90={p90:.3f} p99={p99:.3f}")
+                results["latency"][key] = {"p50": float(p50), "p90": float(p90), "p99": float(p99)}
+            else:
+                print(f" {label}: n/a")
+                results["latency"][key] = {"p50": None, "p90": None, "p99": None}
+
+    print("\n== Load (bench_load) ==")
+    for name, largs in LOAD_SCENARIOS:
+        kv = best_of([bench_ours_load(args.uri, largs, args.load_secs) for _ in range(reps)])
+        if not kv:
+            print(f" {name}: failed")
+            continue
+        print(f" {name}: {kv['msgs/s']:.0f} msgs/s p50={kv['p50_us']:.1f}us p99={kv['p99_us']:.1f}us "
+              f"p99.99={kv['p99.99_us']:.1f}us cpu={kv['cpu_us/msg']:.2f}us/msg")
+        results["load"][name] = kv
+        metrics[f"load.{name}.p50_us"] = kv["p50_us"]
+        metrics[f"load.{name}.p99_us"] = kv["p99_us"]
+        if "-r" not in largs:  # open loop: the rate is fixed and CPU includes spinning between sends
+            metrics[f"load.{name}.msgs_per_sec"] = kv["msgs/s"]
+            metrics[f"load.{name}.cpu_us_per_msg"] = kv["cpu_us/msg"]
+
+    if args.micro_ms > 0:
+        print("\n== Micro (bench_micro, fuzz_parser) ==")
+        runs = [bench_ours_micro(args.micro_ms) for _ in range(reps)]
+        for name in dict.fromkeys(n for r in runs for n in r):
+            kv = best_of([r.get(name) for r in runs])
+            if not kv:
+                continue
+            print(f" {name}: {kv['ns/op']:.2f} ns/op {kv['GB/s']:.3f} GB/s {kv['cycles/byte']:.3f} cycles/byte")
+            results["micro"][name] = kv
+            metrics[f"micro.{name}.ns_per_op"] = kv["ns/op"]
+        execs = [e for e in (bench_ours_fuzz(max(args.micro_ms / 100.0, 0.5)) for _ in range(reps)) if e]
+        if execs:
+            print(f" fuzz_parser: {max(execs):.0f} exec/s")
+            results["micro"]["fuzz_parser"] = {"exec/s": max(execs)}
+            metrics["micro.fuzz_parser.execs_per_sec"] = max(execs)
+
+    # Regression gate against the saved baseline
+    code = 0
+    baseline = None
     try:
-        ap50, ap90, ap99 = asyncio.run(aiohttp_latency(args.uri, args.iters))
-        if ap50 == ap50:
-            print(f" aiohttp: p50={ap50:.3f} p90={ap90:.3f} p99={ap99:.3f}")
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+    except (OSError, ValueError):
+        print(f"\nNo baseline at {args.baseline}; nothing to compare against")
+    if baseline is not None:
+        if baseline.get("suite") != SUITE_VERSION:
+            print(f"\nBaseline {args.baseline} is from another suite version; rerun with --save to replace it")
         else:
-            print(" aiohttp: n/a")
-    except Exception:
-        ap50 = ap90 = ap99 = None
+            regressions = gate(baseline, metrics, args.threshold)
+            if regressions:
+                print(f"\nREGRESSIONS (> {args.threshold * 100:.0f}% worse than {args.baseline}):")
+                for r in regressions:
+                    print(f" {r}")
+                code = 1
+            else:
+                print(f"\nNo regressions beyond {args.threshold * 100:.0f}% against {args.baseline}")
 
-    # websocat latency (optional)
-    try:
-        swp50, swp90, swp99 = websocat_latency(args.uri, args.iters)
-        if swp50 == swp50:
-            print(f" websocat: p50={swp50:.3f} p90={swp90:.3f} p99={swp99:.3f}")
-        else:
-            print(" websocat: n/a")
-    except Exception:
-        swp50 = swp90 = swp99 = None
-
-    if ol:
-        results["latency"]["ours_ms"] = {"p50": float(ol[0]), "p90": float(ol[1]), "p99": float(ol[2])}
-    else:
-        results["latency"]["ours_ms"] = {"p50": None, "p90": None, "p99": None}
-    results["latency"]["websockets_ms"] = {"p50": (float(p50) if p50 is not None else None),
-                                              "p90": (float(p90) if p90 is not None else None),
-                                              "p99": (float(p99) if p99 is not None else None)}
-    results["latency"]["websocket_client_ms"] = {"p50": (float(cp50) if 'cp50' in locals() and cp50 == cp50 else None),
-                                                   "p90": (float(cp90) if 'cp90' in locals() and cp90 == cp90 else None),
-                                                   "p99": (float(cp99) if 'cp99' in locals() and cp99 == cp99 else None)}
-    results["latency"]["aiohttp_ms"] = {"p50": (float(ap50) if 'ap50' in locals() and ap50 == ap50 else None),
-                                          "p90": (float(ap90) if 'ap90' in locals() and ap90 == ap90 else None),
-                                          "p99": (float(ap99) if 'ap99' in locals() and ap99 == ap99 else None)}
-    if 'swp50' in locals():
-        results["latency"]["websocat_ms"] = {"p50": (float(swp50) if swp50 == swp50 else None),
-                                               "p90": (float(swp90) if swp90 == swp90 else None),
-                                               "p99": (float(swp99) if swp99 == swp99 else None)}
-
-    print("\nTip: install 'websockets' for Python comparison: pip install websockets")
-
-    # Persist JSON and Markdown summary in bench/
-    out_dir = os.path.join(ROOT, "bench", "results")
-    os.makedirs(out_dir, exist_ok=True)
-    json_path = os.path.join(out_dir, "latest.json")
+    if args.save:
+        save_results(results, args)
+    return code
+
+
+def save_results(results: Dict, args: argparse.Namespace) -> None:
+    json_path = args.baseline
+    os.makedirs(os.path.dirname(json_path), exist_ok=True)
     with open(json_path, "w") as f:
         json.dump(results, f, indent=2)
 
+    def fmt(v) -> str:
+        return "n/a" if v is None else (f"{v:.2f}" if isinstance(v, float) else str(v))
+
     md_lines = []
     md_lines.append(f"# WibeSocket Benchmarks\n\nURI: `{results['uri']}`\n")
-    md_lines.append("## Throughput (msgs/s)\n")
+    md_lines.append("## Throughput (round-trip msgs/s)\n")
     md_lines.append("| Size | Ours | websockets | websocket-client | aiohttp | websocat | libwebsockets |\n|---:|---:|---:|---:|---:|---:|---:|")
     for sz in args.sizes:
         row = results["throughput"].get(str(sz), {})
-        ours_v = row.get("ours_msgs_per_sec")
-        ws_v = row.get("websockets_msgs_per_sec")
-        wsc_v = row.get("websocket_client_msgs_per_sec")
-        aio_v = row.get("aiohttp_msgs_per_sec")
-        wc_v = row.get("websocat_msgs_per_sec")
-        lws_v = row.get("libwebsockets_msgs_per_sec")
-        md_lines.append(f"| {sz} | {ours_v if ours_v is not None else 'n/a'} | {ws_v if ws_v is not None else 'n/a'} | {wsc_v if wsc_v is not None else 'n/a'} | {aio_v if aio_v is not None else 'n/a'} | {wc_v if wc_v is not None else 'n/a'} | {lws_v if lws_v is not None else 'n/a'} |")
+        cols = ("ours", "websockets", "websocket_client", "aiohttp", "websocat", "libwebsockets")
+        md_lines.append(f"| {sz} | " + " | ".join(fmt(row.get(f"{c}_msgs_per_sec")) for c in cols) + " |")
     md_lines.append("\n## Latency (ms)\n")
-    lm = results["latency"]
     md_lines.append("| Impl | p50 | p90 | p99 |\n|:--|--:|--:|--:|")
-    om = lm.get("ours_ms", {})
-    wm = lm.get("websockets_ms", {})
-    md_lines.append(f"| Ours | {om.get('p50','n/a')} | {om.get('p90','n/a')} | {om.get('p99','n/a')} |")
-    md_lines.append(f"| websockets | {wm.get('p50','n/a')} | {wm.get('p90','n/a')} | {wm.get('p99','n/a')} |")
-    wcm = lm.get("websocket_client_ms", {})
-    md_lines.append(f"| websocket-client | {wcm.get('p50','n/a')} | {wcm.get('p90','n/a')} | {wcm.get('p99','n/a')} |")
-    am = lm.get("aiohttp_ms", {})
-    md_lines.append(f"| aiohttp | {am.get('p50','n/a')} | {am.get('p90','n/a')} | {am.get('p99','n/a')} |")
-    # include websocat if available (latency)
-    j = os.path.join(out_dir, "latest.json")
-    wsm = results["latency"].get("websocat_ms", {}) if "websocat_ms" in results["latency"] else {}
-    if wsm:
-        md_lines.append(f"| websocat | {wsm.get('p50','n/a')} | {wsm.get('p90','n/a')} | {wsm.get('p99','n/a')} |")
+    for key, label in (("ours_ms", "Ours"), ("ours_busy_poll_ms", "Ours (busy poll)"), ("websockets_ms", "websockets"), ("websocket_client_ms", "websocket-client"),
+                       ("aiohttp_ms", "aiohttp"), ("websocat_ms", "websocat")):
+        m = results["latency"].get(key)
+        if m:
+            md_lines.append(f"| {label} | {fmt(m.get('p50'))} | {fmt(m.get('p90'))} | {fmt(m.get('p99'))} |")
+    md_lines.append("\n## Load (bench_load, ours)\n")
+    md_lines.append("| Scenario | msgs/s | MB/s | p50 us | p99 us | p99.9 us | p99.99 us | CPU us/msg |\n|:--|--:|--:|--:|--:|--:|--:|--:|")
+    for name, _ in LOAD_SCENARIOS:
+        kv = results["load"].get(name)
+        if kv:
+            md_lines.append(f"| {name} | {kv['msgs/s']:.0f} | {kv['MB/s']:.1f} | {kv['p50_us']:.1f} | {kv['p99_us']:.1f} | "
+                            f"{kv['p99.9_us']:.1f} | {kv['p99.99_us']:.1f} | {kv['cpu_us/msg']:.2f} |")
     md_lines.append("\n")
+    print(f"\nSaved: {json_path}")
+    if args.ours_only:
+        return  # keep the comparison with the other clients from the last full run
     md_path = os.path.join(ROOT, "bench", "RESULTS.md")
     with open(md_path, "w") as f:
         f.write("\n".join(md_lines) + "\n")
-    print(f"\nSaved: {json_path}\nSaved: {md_path}")
+    print(f"Saved: {md_path}")
 
-    # Tear down local echo server if we started one
-    if echo_proc is not None:
-        try:
-            echo_proc.terminate()
-        except Exception:
-            pass
-    if echo_stop is not None:
-        echo_stop.set()
 
 if __name__ == "__main__":
     main()
-
-
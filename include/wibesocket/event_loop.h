@@ -0,0 +1,123 @@
+#ifndef WIBESOCKET_EVENT_LOOP_H
+#define WIBESOCKET_EVENT_LOOP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wibesocket/wibesocket.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* One epoll set shared by many connections (Linux, like the rest of the library). A
+ * connection added to a loop gives up its private epoll fd; the loop watches it edge-triggered
+ * and only asks for write readiness while the connection has unsent bytes queued. Frames other
+ * threads hand in with wibesocket_post_send are flushed by the loop as they arrive.
+ */
+typedef struct wibesocket_loop wibesocket_loop_t;
+
+typedef enum {
+    WIBESOCKET_EVENT_READABLE  = 1u << 0, /* messages may be ready: recv with timeout 0 */
+    WIBESOCKET_EVENT_WRITABLE  = 1u << 1, /* the send queue was flushed further */
+    WIBESOCKET_EVENT_ERROR     = 1u << 2, /* socket error, hangup or failed connect */
+    WIBESOCKET_EVENT_CONNECTED = 1u << 3, /* an async connect finished its handshake */
+    WIBESOCKET_EVENT_DRAINED   = 1u << 4  /* after a BUFFER_FULL, the queue fell to the low mark */
+} wibesocket_event_t;
+
+/* Called from wibesocket_loop_run_once. On READABLE call wibesocket_recv/recv_batch with
+ * timeout 0; a callback that returns before recv reports TIMEOUT is called again on the next
+ * run, so it may take messages a few at a time. The callback may send, remove or close conn.
+ */
+typedef void (*wibesocket_loop_cb)(wibesocket_loop_t* loop, wibesocket_conn_t* conn,
+                                   uint32_t events, void* user_data);
+
+wibesocket_loop_t* wibesocket_loop_create(void);
+/* Detaches remaining connections (they keep working standalone); does not close them. */
+void               wibesocket_loop_destroy(wibesocket_loop_t* loop);
+
+/* A connection belongs to at most one loop; wibesocket_close removes it automatically.
+ * Connections from wibesocket_connect_start may be added while still connecting: the loop
+ * drives the handshake, enforces handshake_timeout_ms, and reports CONNECTED or ERROR.
+ */
+wibesocket_error_t wibesocket_loop_add(wibesocket_loop_t* loop, wibesocket_conn_t* conn,
+                                       wibesocket_loop_cb cb, void* user_data);
+wibesocket_error_t wibesocket_loop_remove(wibesocket_loop_t* loop, wibesocket_conn_t* conn);
+
+/* Wait up to timeout_ms (-1 infinite) and dispatch. Returns connections dispatched, or -1. */
+int                wibesocket_loop_run_once(wibesocket_loop_t* loop, int timeout_ms);
+/* Dispatch until wibesocket_loop_stop is called or the loop fails. */
+wibesocket_error_t wibesocket_loop_run(wibesocket_loop_t* loop);
+/* Any thread; a run in progress returns after the current round. */
+void               wibesocket_loop_stop(wibesocket_loop_t* loop);
+
+/* Run fn(loop, arg) on the loop's thread during its next run_once. Safe from any thread and
+ * lock-free: the task goes on an MPSC queue and an eventfd wakes the loop. Tasks still queued
+ * when the loop is destroyed run from wibesocket_loop_destroy. */
+typedef void (*wibesocket_loop_task_fn)(wibesocket_loop_t* loop, void* arg);
+wibesocket_error_t wibesocket_loop_post(wibesocket_loop_t* loop, wibesocket_loop_task_fn fn, void* arg);
+
+/* N loops, each owned by one worker thread (optionally pinned to a CPU). A connection lives on
+ * one shard for its lifetime; all of its I/O and callbacks happen on that thread, so the hot
+ * path takes no locks. Other threads talk to a shard only through its task queue. */
+typedef struct wibesocket_shards wibesocket_shards_t;
+
+/* n_threads 0 = one per online CPU. */
+wibesocket_shards_t* wibesocket_shards_create(size_t n_threads, int pin_to_cpus);
+/* Stops and joins the workers, then destroys their loops; connections are detached, not
+ * closed, and may be closed by the caller afterwards. */
+void                 wibesocket_shards_destroy(wibesocket_shards_t* shards);
+size_t               wibesocket_shards_count(const wibesocket_shards_t* shards);
+
+/* Hand conn to a shard: shard < 0 picks round-robin, otherwise shard % count (pass a hash to
+ * keep related connections together). The calling thread gives up conn: from here on only
+ * callbacks and tasks on the owning shard may touch it. If the shard cannot register it, cb
+ * runs there with WIBESOCKET_EVENT_ERROR so it can be closed. */
+wibesocket_error_t   wibesocket_shards_add(wibesocket_shards_t* shards, wibesocket_conn_t* conn,
+                                           int shard, wibesocket_loop_cb cb, void* user_data,
+                                           size_t* out_shard);
+/* Run fn on a shard's thread (wibesocket_loop_post on its loop). */
+wibesocket_error_t   wibesocket_shards_post(wibesocket_shards_t* shards, size_t shard,
+                                            wibesocket_loop_task_fn fn, void* arg);
+/* From any thread: wibesocket_post_send for a connection owned by a shard. Returns once the
+ * frame is queued; send errors surface on the connection itself. */
+wibesocket_error_t   wibesocket_shards_send(wibesocket_shards_t* shards, wibesocket_conn_t* conn,
+                                            wibesocket_frame_type_t type, const void* data, size_t len);
+
+/* Warm connections per URI on a loop, for callers that open many short-lived sessions. The
+ * pool keeps up to `warm` connections to each URI it has been asked for open and handshaken,
+ * reconnecting in the background on the loop as they are handed out or drop. Host lookups are
+ * cached for dns_ttl_ms and shared by every connection to the URI; one async lookup refreshes
+ * them once stale, and a failed connect forgets them. All calls on the loop's thread.
+ */
+typedef struct wibesocket_pool wibesocket_pool_t;
+
+typedef struct {
+    /* For every pooled connection; copied, strings it points to must outlive the pool.
+     * NULL = defaults. */
+    const wibesocket_config_t* config;
+    size_t   warm;        /* open connections kept ready per URI; 0 = 4 */
+    uint32_t dns_ttl_ms;  /* reuse a lookup this long; 0 = 30 s */
+} wibesocket_pool_config_t;
+
+/* config NULL = defaults. Destroy the pool before its loop. */
+wibesocket_pool_t* wibesocket_pool_create(wibesocket_loop_t* loop, const wibesocket_pool_config_t* config);
+/* Closes the connections the pool still holds; handed-out ones are the caller's. */
+void               wibesocket_pool_destroy(wibesocket_pool_t* pool);
+/* Start keeping connections to uri warm ahead of the first acquire. */
+wibesocket_error_t wibesocket_pool_prewarm(wibesocket_pool_t* pool, const char* uri);
+/* An open connection to uri: a warm one if any is ready (O(1)), which also starts its
+ * replacement. With none ready, timeout_ms 0 returns NULL at once; otherwise it connects now,
+ * blocking for at most timeout_ms (negative: config.handshake_timeout_ms), from the cached
+ * addresses where there are fresh ones. The connection belongs to the caller and is in no
+ * loop: close it when done, or add it to a loop. An idle connection that receives a message
+ * (pings are answered), a close or an error is retired rather than handed out. */
+wibesocket_conn_t* wibesocket_pool_acquire(wibesocket_pool_t* pool, const char* uri, int timeout_ms);
+/* Connections to uri open and ready to hand out */
+size_t             wibesocket_pool_ready(const wibesocket_pool_t* pool, const char* uri);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WIBESOCKET_EVENT_LOOP_H */
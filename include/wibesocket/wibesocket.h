@@ -4,6 +4,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <sys/uio.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -42,6 +43,54 @@ typedef enum {
     WIBESOCKET_CLOSE_INTERNAL_ERROR   = 1011
 } wibesocket_close_code_t;
 
+typedef enum {
+    WIBESOCKET_IO_EPOLL = 0, /* readiness (epoll) + recv/send */
+    WIBESOCKET_IO_URING      /* io_uring: multishot recv into provided buffers, linked sends */
+} wibesocket_io_backend_t;
+
+/* Heap hook for a connection's buffers and its struct: send queue, reassembly and inflate
+ * buffers, posted frames. Called from whichever thread touches the connection (producers of
+ * wibesocket_post_send included), so it must be thread-safe; free gets the size that was
+ * asked for. The mirrored receive ring is mapped memory and does not go through it. NULL in
+ * the config = the library's pools: connection structs from a slab, buffers from shared
+ * power-of-two size classes. */
+typedef struct {
+    void* (*alloc)(void* ctx, size_t size);
+    void  (*free)(void* ctx, void* ptr, size_t size);
+    void*   ctx;
+} wibesocket_allocator_t;
+
+/* Durations in nanoseconds, HDR-style: values below 4 get a bucket each, and every power of
+ * two above is split into 4 linear buckets, so a bucket is never wider than a quarter of the
+ * values in it. The last bucket also takes anything beyond it (about half an hour). */
+#define WIBESOCKET_HIST_BUCKETS 160
+typedef struct {
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+    uint64_t buckets[WIBESOCKET_HIST_BUCKETS];
+} wibesocket_histogram_t;
+
+/* Counters of a connection opened with enable_stats, or of all of them together. */
+typedef struct {
+    /* Whole frames on the wire, headers included, indexed by opcode (wibesocket_frame_type_t);
+     * compressed messages count at their compressed size */
+    uint64_t frames_in[16];
+    uint64_t bytes_in[16];
+    uint64_t frames_out[16];
+    uint64_t bytes_out[16];
+    uint64_t syscalls;          /* recv, send, readiness waits and wakeup reads */
+    uint64_t eagain;            /* recv or send calls that found the socket not ready */
+    uint64_t send_queue_peak;   /* most bytes queued and not yet written; global: the largest */
+    uint64_t recv_bytes_moved;  /* bytes slid back when released frames are compacted away */
+    uint64_t handshake_us;      /* connect start to open; global: the sum */
+    uint64_t connections;       /* 1 once open; global: connections opened with stats */
+    uint64_t zerocopy_abandoned; /* payloads the kernel still held at close, left unreleased */
+    /* Frame queued to its last byte written, sampled once per drained backlog (for the oldest
+     * frame in it); 0 when the send went out at once */
+    wibesocket_histogram_t send_delay;
+} wibesocket_stats_t;
+
 typedef struct {
     const char* user_agent;
     const char* origin;
@@ -49,6 +98,26 @@ typedef struct {
     uint32_t    handshake_timeout_ms;
     uint32_t    max_frame_size;
     bool        enable_compression;
+    uint32_t    recv_buffer_size;      /* receive ring cap, bytes; 0 = min(max_frame_size + 16, 256 KiB) */
+    wibesocket_io_backend_t io_backend; /* engine once open; IO_URING falls back to epoll when unavailable */
+    size_t      send_high_watermark;   /* backlog bytes past which sends are BUFFER_FULL; 0 = 64 MiB */
+    size_t      send_low_watermark;    /* backlog bytes that report DRAINED after a refusal; 0 = high / 4 */
+    uint8_t     compression_client_max_window_bits;     /* permessage-deflate window, 9..15; 0 = 15 */
+    uint8_t     compression_server_max_window_bits;     /* window asked of the server, 9..15; 0 = 15 */
+    bool        compression_client_no_context_takeover; /* reset our compressor every message */
+    bool        compression_server_no_context_takeover; /* ask the server to reset its compressor */
+    uint32_t    compression_threshold; /* shortest message compressed, in bytes; 0 = 64 */
+    const wibesocket_allocator_t* allocator; /* buffer allocator, copied at connect; NULL = built-in pools */
+    bool        recv_buffer_lending;   /* borrow the receive ring only while bytes are buffered */
+    uint32_t    ping_interval_ms;      /* PING after this long without receiving; 0 = off */
+    uint32_t    idle_timeout_ms;       /* fail with TIMEOUT after this long without receiving; 0 = off */
+    uint32_t    close_timeout_ms;      /* wait for the server's CLOSE reply; 0 = 500 */
+    bool        enable_stats;          /* keep wibesocket_stats_t counters for this connection */
+    uint32_t    zerocopy_threshold;    /* payloads this size and up go out with MSG_ZEROCOPY; 0 = off */
+    uint32_t    busy_poll_us;          /* spin in recv this long before sleeping, in microseconds; 0 = off */
+    bool        busy_poll_socket;      /* also set SO_BUSY_POLL and SO_PREFER_BUSY_POLL on the socket */
+    uint32_t    coalesce_bytes;        /* coalesced sends go out at this many bytes; 0 = 16 KiB */
+    uint32_t    coalesce_delay_us;     /* or after the first frame waited this long; 0 = no coalescing */
 } wibesocket_config_t;
 
 typedef struct {
@@ -56,6 +125,7 @@ typedef struct {
     const void*             payload;
     size_t                  payload_len;
     bool                    is_final;
+    uint32_t                pin;  /* keeps payload valid; shared by the messages of one recv call */
 } wibesocket_message_t;
 
 typedef enum {
@@ -68,25 +138,136 @@ typedef enum {
     WIBESOCKET_ERROR_TIMEOUT,
     WIBESOCKET_ERROR_CLOSED,
     WIBESOCKET_ERROR_BUFFER_FULL,
-    WIBESOCKET_ERROR_NOT_READY
+    WIBESOCKET_ERROR_NOT_READY,
+    WIBESOCKET_ERROR_SYSTEM
 } wibesocket_error_t;
 
 wibesocket_conn_t* wibesocket_connect(const char* uri, const wibesocket_config_t* config);
+/* Non-blocking connect: returns at once with the connection CONNECTING (NULL only for a bad
+ * URI or out of memory). Progress it with wibesocket_connect_step when its fd is ready, or add
+ * it to a wibesocket_loop_t. Failures, including handshake_timeout_ms, leave it in ERROR.
+ */
+wibesocket_conn_t* wibesocket_connect_start(const char* uri, const wibesocket_config_t* config);
+/* OK once open, NOT_READY while in progress, otherwise the failure. Never blocks. */
+wibesocket_error_t wibesocket_connect_step(wibesocket_conn_t* conn);
+/* Server side: run the upgrade on fd, a connected socket from accept(), and return the open
+ * connection (NULL on failure, after a best-effort 400 to a bad request). The connection owns
+ * fd from the call on and closes it on failure too. Its frames go out unmasked and the client's
+ * must be masked; a subprotocol is chosen from config.protocol (see wibesocket_get_protocol).
+ * Compression is not negotiated; user_agent and origin are unused. */
+wibesocket_conn_t* wibesocket_accept(int fd, const wibesocket_config_t* config);
+/* The same without blocking, CONNECTING until the handshake is done: progress it like
+ * wibesocket_connect_start, with wibesocket_connect_step or a loop. */
+wibesocket_conn_t* wibesocket_accept_start(int fd, const wibesocket_config_t* config);
 wibesocket_error_t wibesocket_send_text(wibesocket_conn_t* conn, const char* text, size_t len);
 wibesocket_error_t wibesocket_send_binary(wibesocket_conn_t* conn, const void* data, size_t len);
 wibesocket_error_t wibesocket_send_ping(wibesocket_conn_t* conn, const void* data, size_t len);
 wibesocket_error_t wibesocket_send_close(wibesocket_conn_t* conn, uint16_t code, const char* reason);
+/* Corking: between send_begin and send_commit, send_* calls only queue their frames; commit
+ * flushes the whole burst with as few syscalls as the socket allows. send_close uncorks.
+ */
+wibesocket_error_t wibesocket_send_begin(wibesocket_conn_t* conn);
+wibesocket_error_t wibesocket_send_commit(wibesocket_conn_t* conn);
+/* Write out everything queued now, whether corked or held back by coalescing */
+wibesocket_error_t wibesocket_flush(wibesocket_conn_t* conn);
+/* Send count messages of one type (TEXT or BINARY), one frame per iovec, in a single flush.
+ * The batch is queued entirely or not at all.
+ */
+wibesocket_error_t wibesocket_send_batch(wibesocket_conn_t* conn, wibesocket_frame_type_t type,
+                                         const struct iovec* iov, size_t count);
+/* Thread-safe send, for producers that do not own conn. The frame is built and masked on the
+ * calling thread and pushed onto the connection's lock-free queue; the owner splices it into
+ * the send queue on its next flush, woken through an eventfd so a blocked recv or a loop sends
+ * it promptly. Frames from one producer keep their order. type: TEXT, BINARY or PING. conn
+ * must stay open until producers have stopped posting. Posted frames are never compressed. */
+wibesocket_error_t wibesocket_post_send(wibesocket_conn_t* conn, wibesocket_frame_type_t type,
+                                        const void* data, size_t len);
+/* Gives back a buffer handed to wibesocket_send_donated */
+typedef void (*wibesocket_release_fn)(void* ctx, void* buf, size_t len);
+/* Send a TEXT or BINARY message straight from buf, with no copy in user space: the payload is
+ * masked in place (buf no longer holds it afterwards) and written from there, with
+ * MSG_ZEROCOPY where the socket supports it. Once the message is queued the connection owns
+ * buf and calls release(ctx, buf, len) exactly once on its owning thread, when the kernel is
+ * done with it or the connection fails or closes; that includes a NETWORK error from the
+ * flush that follows. Any other error leaves buf untouched and the caller's. Under IO_URING
+ * the payload is copied into the queue and released at once. Never compressed. */
+wibesocket_error_t wibesocket_send_donated(wibesocket_conn_t* conn, wibesocket_frame_type_t type,
+                                           void* buf, size_t len, wibesocket_release_fn release, void* ctx);
+/* Fan-out for server connections: a TEXT or BINARY message framed once, unmasked, into a
+ * reference-counted buffer that any number of connections send from without copying it (as
+ * wibesocket_send_donated does, MSG_ZEROCOPY included; under IO_URING it is copied into the
+ * queue). Each send holds a reference until its connection is done with the bytes; create's
+ * reference is dropped with wibesocket_broadcast_release. Connections on different threads
+ * may send the same message. Never compressed. */
+typedef struct wibesocket_broadcast wibesocket_broadcast_t;
+wibesocket_broadcast_t* wibesocket_broadcast_create(wibesocket_frame_type_t type, const void* data, size_t len);
+/* INVALID_ARGS on a client connection, BUFFER_FULL past the high watermark */
+wibesocket_error_t wibesocket_broadcast_send(wibesocket_conn_t* conn, wibesocket_broadcast_t* msg);
+/* broadcast_send to each of conns; returns how many accepted the message */
+size_t             wibesocket_broadcast(wibesocket_conn_t* const* conns, size_t count, wibesocket_broadcast_t* msg);
+void               wibesocket_broadcast_release(wibesocket_broadcast_t* msg);
+/* A received payload stays valid until its pin is released. Pins of earlier calls may be held
+ * while receiving continues; recv is NOT_READY only once 256 of them are outstanding. */
 wibesocket_error_t wibesocket_recv(wibesocket_conn_t* conn, wibesocket_message_t* msg, int timeout_ms);
+/* Batch receive: fills msgs with every complete frame in the current receive window (up to
+ * max_msgs), waiting up to timeout_ms only when nothing is buffered. All returned payloads share
+ * one pin and are released together by a single wibesocket_release_message() on any of them.
+ */
+wibesocket_error_t wibesocket_recv_batch(wibesocket_conn_t* conn, wibesocket_message_t* msgs, size_t max_msgs,
+                                         size_t* out_count, int timeout_ms);
 wibesocket_state_t wibesocket_get_state(const wibesocket_conn_t* conn);
 wibesocket_error_t wibesocket_get_error(const wibesocket_conn_t* conn);
+/* Subprotocol the server selected from config.protocol, or NULL if it selected none (on an
+ * accepted connection: the one this side selected) */
+const char*        wibesocket_get_protocol(const wibesocket_conn_t* conn);
+/* Waits up to close_timeout_ms for the CLOSE reply; a looped connection returns at once and
+ * the loop finishes the handshake and frees it */
 wibesocket_error_t wibesocket_close(wibesocket_conn_t* conn);
 const char*        wibesocket_error_string(wibesocket_error_t error);
 
-/* Advanced: zero-copy payload lifetime management for FFI bindings */
+/* Zero-copy payload lifetime: a recv call's pin starts with one reference; retain adds one and
+ * release drops one, the payloads going away with the last. Pins can be released in any order. */
+void               wibesocket_retain_message(wibesocket_conn_t* conn, const wibesocket_message_t* msg);
+void               wibesocket_release_message(wibesocket_conn_t* conn, const wibesocket_message_t* msg);
+/* The same on the most recent recv call's pin, for callers that hold one at a time */
 void               wibesocket_retain_payload(wibesocket_conn_t* conn);
 void               wibesocket_release_payload(wibesocket_conn_t* conn);
 
-/* File descriptor access for event loop integration */
+/* Bytes accepted for sending but not yet written to the socket (including posted frames) */
+size_t             wibesocket_get_buffered_amount(const wibesocket_conn_t* conn);
+/* Flush and wait until the backlog is at or below the low watermark. OK, TIMEOUT, or the
+ * connection's error once it failed. */
+wibesocket_error_t wibesocket_wait_writable(wibesocket_conn_t* conn, int timeout_ms);
+
+/* Round trip of the last timed PING, from send to its PONG, in microseconds; 0 until one is
+ * answered. Pings from wibesocket_send_ping and ping_interval_ms are timed, one at a time. */
+uint64_t           wibesocket_get_rtt_us(const wibesocket_conn_t* conn);
+
+/* Snapshot of the connection's counters; NOT_READY when it was opened without enable_stats */
+wibesocket_error_t wibesocket_get_stats(const wibesocket_conn_t* conn, wibesocket_stats_t* out);
+/* Totals over every connection opened with enable_stats, live and closed. Thread-safe. */
+void               wibesocket_get_global_stats(wibesocket_stats_t* out);
+/* Upper bound of the bucket holding the pct-th percentile (0..100); 0 when empty */
+uint64_t           wibesocket_histogram_percentile(const wibesocket_histogram_t* hist, double pct);
+
+/* Bytes of buffers the connection holds right now: receive ring, send queue, reassembly and
+ * inflate buffers. Excludes the connection struct, zlib and kernel socket buffers. */
+size_t             wibesocket_get_memory_usage(const wibesocket_conn_t* conn);
+
+/* True once the server accepted permessage-deflate: sends above the threshold are compressed
+ * and compressed messages are delivered inflated. */
+bool               wibesocket_compression_negotiated(const wibesocket_conn_t* conn);
+/* Engine actually in use; differs from config.io_backend when io_uring was unavailable */
+wibesocket_io_backend_t wibesocket_get_io_backend(const wibesocket_conn_t* conn);
+
+/* Pin the calling thread, which should be the connection's owner, to cpu, and ask the kernel
+ * to process conn's incoming packets on the same CPU (SO_INCOMING_CPU; a best-effort hint,
+ * honoured with RSS/RFS steering). conn may be NULL to pin the thread only. SYSTEM when the
+ * thread could not be pinned (cpu outside its allowed set, say). Linux; NOT_READY elsewhere. */
+wibesocket_error_t wibesocket_set_cpu_affinity(wibesocket_conn_t* conn, int cpu);
+
+/* File descriptor access for event loop integration (the ring fd under IO_URING: it turns
+ * readable on completions, while the socket's own data is consumed by the kernel) */
 int                wibesocket_fileno(const wibesocket_conn_t* conn);
 
 /* Poll for I/O readiness without reading; backend should use epoll/kqueue/io_uring.
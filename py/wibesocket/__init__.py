@@ -12,11 +12,17 @@ try:
         connect,
         send_text,
         send_binary,
+        send_many,
         recv,
+        recv_many,
         release_payload,
         fileno,
+        poll_events,
+        writable,
+        buffered_amount,
         send_close,
         close,
+        Reader,
     )
 except Exception as _e:  # pragma: no cover - used only during docs/import fallback
     def _stub(*_args, **_kwargs):  # type: ignore
@@ -28,21 +34,33 @@ except Exception as _e:  # pragma: no cover - used only during docs/import fallb
     connect = _stub
     send_text = _stub
     send_binary = _stub
+    send_many = _stub
     recv = _stub
+    recv_many = _stub
     release_payload = _stub
     fileno = _stub
+    poll_events = _stub
+    writable = _stub
+    buffered_amount = _stub
     send_close = _stub
     close = _stub
+    Reader = _stub
 
 __all__ = [
     "connect",
     "send_text",
     "send_binary",
+    "send_many",
     "recv",
+    "recv_many",
     "release_payload",
     "fileno",
+    "poll_events",
+    "writable",
+    "buffered_amount",
     "send_close",
     "close",
+    "Reader",
     "WebSocket",
     "AsyncWebSocket",
     "Frame",
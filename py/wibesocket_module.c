@@ -5,26 +5,57 @@
 #include "wibesocket/wibesocket.h"
 
 #define CONN_CAPSULE_NAME "wibesocket.conn"
+/* recv_many without max_n */
+#define RECV_MANY_DEFAULT 64
+/* Reader: frames queued before it stops reading, and pulled per recv_batch */
+#define READER_HIGH_DEFAULT 256
+#define READER_BATCH 64
+
+/* Blocking calls run without the GIL, so each connection is guarded by its own lock: threads
+ * sharing one take turns as they did under the GIL, and close cannot free it under a recv. */
+typedef struct {
+    wibesocket_conn_t*  conn; /* NULL once closed */
+    PyThread_type_lock  lock;
+} py_conn_t;
 
 static void conn_capsule_destructor(PyObject* capsule) {
-    (void)capsule; /* no-op destructor; require explicit close via API */
+    /* The connection itself needs an explicit close via the API */
+    py_conn_t* pc = (py_conn_t*)PyCapsule_GetPointer(capsule, CONN_CAPSULE_NAME);
+    if (!pc) return;
+    PyThread_free_lock(pc->lock);
+    PyMem_Free(pc);
+}
+
+/* Lock the capsule's connection; NULL (unlocked) when it is not one or already closed */
+static py_conn_t* conn_acquire(PyObject* capsule) {
+    py_conn_t* pc = (py_conn_t*)PyCapsule_GetPointer(capsule, CONN_CAPSULE_NAME);
+    if (!pc) { PyErr_Clear(); return NULL; }
+    if (!PyThread_acquire_lock(pc->lock, NOWAIT_LOCK)) {
+        Py_BEGIN_ALLOW_THREADS
+        PyThread_acquire_lock(pc->lock, WAIT_LOCK);
+        Py_END_ALLOW_THREADS
+    }
+    if (!pc->conn) { PyThread_release_lock(pc->lock); return NULL; }
+    return pc;
 }
 
-static wibesocket_conn_t* get_conn(PyObject* capsule) {
-    return (wibesocket_conn_t*)PyCapsule_GetPointer(capsule, CONN_CAPSULE_NAME);
+static void conn_release(py_conn_t* pc) {
+    PyThread_release_lock(pc->lock);
 }
 
 static PyObject* py_connect(PyObject* self, PyObject* args, PyObject* kwargs) {
     const char* uri = NULL;
-    static char* kwlist[] = {"uri", "handshake_timeout_ms", "max_frame_size", "user_agent", "origin", "protocol", NULL};
+    static char* kwlist[] = {"uri", "handshake_timeout_ms", "max_frame_size", "user_agent", "origin", "protocol",
+                             "send_high_watermark", "send_low_watermark", NULL};
     int handshake_timeout_ms = 5000;
     unsigned long max_frame_size = 1UL << 20;
     const char* user_agent = NULL;
     const char* origin = NULL;
     const char* protocol = NULL;
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|i$kzzz", kwlist,
+    Py_ssize_t send_high = 0, send_low = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|i$kzzznn", kwlist,
                                      &uri, &handshake_timeout_ms, &max_frame_size,
-                                     &user_agent, &origin, &protocol)) {
+                                     &user_agent, &origin, &protocol, &send_high, &send_low)) {
         return NULL;
     }
     wibesocket_config_t cfg; memset(&cfg, 0, sizeof(cfg));
@@ -33,118 +64,457 @@ static PyObject* py_connect(PyObject* self, PyObject* args, PyObject* kwargs) {
     cfg.user_agent = user_agent;
     cfg.origin = origin;
     cfg.protocol = protocol;
-    wibesocket_conn_t* c = wibesocket_connect(uri, &cfg);
-    if (!c) Py_RETURN_NONE;
-    return PyCapsule_New((void*)c, CONN_CAPSULE_NAME, conn_capsule_destructor);
+    cfg.send_high_watermark = send_high > 0 ? (size_t)send_high : 0;
+    cfg.send_low_watermark = send_low > 0 ? (size_t)send_low : 0;
+    py_conn_t* pc = (py_conn_t*)PyMem_Malloc(sizeof(*pc));
+    if (!pc) return PyErr_NoMemory();
+    pc->lock = PyThread_allocate_lock();
+    if (!pc->lock) { PyMem_Free(pc); return PyErr_NoMemory(); }
+    /* The handshake blocks: let other threads run meanwhile */
+    wibesocket_conn_t* c;
+    Py_BEGIN_ALLOW_THREADS
+    c = wibesocket_connect(uri, &cfg);
+    Py_END_ALLOW_THREADS
+    if (!c) { PyThread_free_lock(pc->lock); PyMem_Free(pc); Py_RETURN_NONE; }
+    pc->conn = c;
+    PyObject* capsule = PyCapsule_New((void*)pc, CONN_CAPSULE_NAME, conn_capsule_destructor);
+    if (!capsule) { wibesocket_close(c); PyThread_free_lock(pc->lock); PyMem_Free(pc); }
+    return capsule;
 }
 
-static PyObject* py_send_text(PyObject* self, PyObject* args) {
-    PyObject* capsule; PyObject* obj;
-    if (!PyArg_ParseTuple(args, "OO", &capsule, &obj)) return NULL;
-    wibesocket_conn_t* c = get_conn(capsule);
-    if (!c) Py_RETURN_FALSE;
+/* Queue one message: str as TEXT; bytes as TEXT when as_text, else any buffer as BINARY.
+ * -1 with an exception set when obj has the wrong type. */
+static int send_obj(wibesocket_conn_t* c, PyObject* obj, int as_text, wibesocket_error_t* out) {
     if (PyUnicode_Check(obj)) {
-        PyObject* utf8 = PyUnicode_AsUTF8String(obj);
-        if (!utf8) return NULL;
-        char* data = PyBytes_AsString(utf8);
-        Py_ssize_t len = PyBytes_Size(utf8);
-        wibesocket_error_t e = wibesocket_send_text(c, data, (size_t)len);
-        Py_DECREF(utf8);
-        if (e != WIBESOCKET_OK) Py_RETURN_FALSE;
-        Py_RETURN_TRUE;
-    } else if (PyBytes_Check(obj)) {
+        Py_ssize_t len = 0;
+        const char* data = PyUnicode_AsUTF8AndSize(obj, &len);
+        if (!data) return -1;
+        *out = wibesocket_send_text(c, data, (size_t)len);
+        return 0;
+    }
+    if (as_text) {
         char* data = NULL; Py_ssize_t len = 0;
-        if (PyBytes_AsStringAndSize(obj, &data, &len) < 0) return NULL;
-        wibesocket_error_t e = wibesocket_send_text(c, data, (size_t)len);
-        if (e != WIBESOCKET_OK) Py_RETURN_FALSE;
-        Py_RETURN_TRUE;
+        if (!PyBytes_Check(obj)) {
+            PyErr_SetString(PyExc_TypeError, "send_text expects str or bytes");
+            return -1;
+        }
+        if (PyBytes_AsStringAndSize(obj, &data, &len) < 0) return -1;
+        *out = wibesocket_send_text(c, data, (size_t)len);
+        return 0;
     }
-    PyErr_SetString(PyExc_TypeError, "send_text expects str or bytes");
-    return NULL;
+    Py_buffer view;
+    if (PyObject_GetBuffer(obj, &view, PyBUF_SIMPLE) < 0) return -1;
+    *out = wibesocket_send_binary(c, view.buf, (size_t)view.len);
+    PyBuffer_Release(&view);
+    return 0;
+}
+
+/* Sends only queue and write what the socket takes at once; they keep the GIL */
+static PyObject* py_send_text(PyObject* self, PyObject* args) {
+    PyObject* capsule; PyObject* obj;
+    if (!PyArg_ParseTuple(args, "OO", &capsule, &obj)) return NULL;
+    py_conn_t* pc = conn_acquire(capsule);
+    if (!pc) Py_RETURN_FALSE;
+    wibesocket_error_t e = WIBESOCKET_OK;
+    int r = send_obj(pc->conn, obj, 1, &e);
+    conn_release(pc);
+    if (r < 0) return NULL;
+    if (e != WIBESOCKET_OK) Py_RETURN_FALSE;
+    Py_RETURN_TRUE;
 }
 
 static PyObject* py_send_binary(PyObject* self, PyObject* args) {
     PyObject* capsule; Py_buffer view;
     if (!PyArg_ParseTuple(args, "Oy*", &capsule, &view)) return NULL;
-    wibesocket_conn_t* c = get_conn(capsule);
-    if (!c) { PyBuffer_Release(&view); Py_RETURN_FALSE; }
-    wibesocket_error_t e = wibesocket_send_binary(c, view.buf, (size_t)view.len);
+    py_conn_t* pc = conn_acquire(capsule);
+    if (!pc) { PyBuffer_Release(&view); Py_RETURN_FALSE; }
+    wibesocket_error_t e = wibesocket_send_binary(pc->conn, view.buf, (size_t)view.len);
+    conn_release(pc);
     PyBuffer_Release(&view);
     if (e != WIBESOCKET_OK) Py_RETURN_FALSE;
     Py_RETURN_TRUE;
 }
 
+/* Corked: every message is queued first, then the whole batch goes out in as few writes as
+ * the socket allows. Returns how many were queued; stops at the first refused one. */
+static PyObject* py_send_many(PyObject* self, PyObject* args) {
+    PyObject* capsule; PyObject* iterable;
+    if (!PyArg_ParseTuple(args, "OO", &capsule, &iterable)) return NULL;
+    /* Drained before taking the connection: a generator may call back into this module */
+    PyObject* seq = PySequence_Fast(iterable, "send_many expects an iterable");
+    if (!seq) return NULL;
+    py_conn_t* pc = conn_acquire(capsule);
+    if (!pc) { Py_DECREF(seq); return PyLong_FromLong(0); }
+    Py_ssize_t n = PySequence_Fast_GET_SIZE(seq), sent = 0;
+    int failed = 0;
+    wibesocket_error_t e = wibesocket_send_begin(pc->conn);
+    for (Py_ssize_t i = 0; e == WIBESOCKET_OK && i < n; i++) {
+        failed = send_obj(pc->conn, PySequence_Fast_GET_ITEM(seq, i), 0, &e) < 0;
+        if (failed) break;
+        if (e == WIBESOCKET_OK) sent++;
+    }
+    (void)wibesocket_send_commit(pc->conn);
+    conn_release(pc);
+    Py_DECREF(seq);
+    if (failed) return NULL;
+    return PyLong_FromSsize_t(sent);
+}
+
+/* (type, memoryview, is_final, pin) for one received message */
+static PyObject* frame_tuple(const wibesocket_message_t* m) {
+    /* Zero-copy: memoryview over the payload, valid until release_payload(conn, pin) */
+    PyObject* mem = PyMemoryView_FromMemory((char*)m->payload, (Py_ssize_t)m->payload_len, PyBUF_READ);
+    if (!mem) return NULL;
+    return Py_BuildValue("iNiI", (int)m->type, mem, (int)m->is_final, (unsigned int)m->pin);
+}
+
 static PyObject* py_recv(PyObject* self, PyObject* args, PyObject* kwargs) {
     PyObject* capsule; int timeout_ms = 1000;
     static char* kwlist[] = {"conn", "timeout_ms", NULL};
     if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|i", kwlist, &capsule, &timeout_ms)) return NULL;
-    wibesocket_conn_t* c = get_conn(capsule);
-    if (!c) Py_RETURN_NONE;
+    py_conn_t* pc = conn_acquire(capsule);
+    if (!pc) Py_RETURN_NONE;
+    wibesocket_conn_t* c = pc->conn;
     wibesocket_message_t msg; memset(&msg, 0, sizeof(msg));
-    wibesocket_error_t e = wibesocket_recv(c, &msg, timeout_ms);
+    wibesocket_error_t e;
+    if (timeout_ms == 0) {
+        e = wibesocket_recv(c, &msg, 0); /* cannot block: not worth dropping the GIL */
+    } else {
+        Py_BEGIN_ALLOW_THREADS
+        e = wibesocket_recv(c, &msg, timeout_ms);
+        Py_END_ALLOW_THREADS
+    }
+    PyObject* res = NULL;
+    if (e == WIBESOCKET_OK) {
+        res = frame_tuple(&msg);
+        if (!res) wibesocket_release_message(c, &msg);
+    }
+    conn_release(pc);
     if (e == WIBESOCKET_ERROR_TIMEOUT || e == WIBESOCKET_ERROR_NOT_READY) Py_RETURN_NONE;
     if (e != WIBESOCKET_OK) {
         PyErr_SetString(PyExc_RuntimeError, wibesocket_error_string(e));
         return NULL;
     }
-    /* Zero-copy: create memoryview over the payload; caller must call release_payload(conn) */
-    wibesocket_retain_payload(c);
-    PyObject* mem = PyMemoryView_FromMemory((char*)msg.payload, (Py_ssize_t)msg.payload_len, PyBUF_READ);
-    if (!mem) { wibesocket_release_payload(c); return NULL; }
-    return Py_BuildValue("iNi", (int)msg.type, mem, (int)msg.is_final);
+    return res;
+}
+
+/* Every frame already buffered, up to max_n, in one call; waits up to timeout_ms only when
+ * there are none. The frames share one C pin, which takes a reference per frame so each can
+ * be released on its own. An empty list on timeout. */
+static PyObject* py_recv_many(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject* capsule; Py_ssize_t max_n = RECV_MANY_DEFAULT; int timeout_ms = 1000;
+    static char* kwlist[] = {"conn", "max_n", "timeout_ms", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|ni", kwlist, &capsule, &max_n, &timeout_ms)) return NULL;
+    if (max_n <= 0) {
+        PyErr_SetString(PyExc_ValueError, "max_n must be positive");
+        return NULL;
+    }
+    wibesocket_message_t* msgs = PyMem_New(wibesocket_message_t, (size_t)max_n);
+    if (!msgs) return PyErr_NoMemory();
+    py_conn_t* pc = conn_acquire(capsule);
+    if (!pc) { PyMem_Free(msgs); return PyList_New(0); }
+    wibesocket_conn_t* c = pc->conn;
+    size_t n = 0;
+    wibesocket_error_t e;
+    if (timeout_ms == 0) {
+        e = wibesocket_recv_batch(c, msgs, (size_t)max_n, &n, 0);
+    } else {
+        Py_BEGIN_ALLOW_THREADS
+        e = wibesocket_recv_batch(c, msgs, (size_t)max_n, &n, timeout_ms);
+        Py_END_ALLOW_THREADS
+    }
+    PyObject* list = NULL;
+    if (e == WIBESOCKET_OK) {
+        for (size_t i = 1; i < n; i++) wibesocket_retain_message(c, &msgs[i]);
+        list = PyList_New((Py_ssize_t)n);
+        for (size_t i = 0; list && i < n; i++) {
+            PyObject* t = frame_tuple(&msgs[i]);
+            if (!t) { Py_CLEAR(list); break; }
+            PyList_SET_ITEM(list, (Py_ssize_t)i, t);
+        }
+        /* Nobody will see any of them: one release per reference taken */
+        if (!list) for (size_t i = 0; i < n; i++) wibesocket_release_message(c, &msgs[i]);
+    }
+    conn_release(pc);
+    PyMem_Free(msgs);
+    if (e == WIBESOCKET_ERROR_TIMEOUT || e == WIBESOCKET_ERROR_NOT_READY) return PyList_New(0);
+    if (e != WIBESOCKET_OK) {
+        PyErr_SetString(PyExc_RuntimeError, wibesocket_error_string(e));
+        return NULL;
+    }
+    return list;
 }
 
 static PyObject* py_close(PyObject* self, PyObject* args) {
     PyObject* capsule;
     if (!PyArg_ParseTuple(args, "O", &capsule)) return NULL;
-    wibesocket_conn_t* c = get_conn(capsule);
-    if (c) (void)wibesocket_close(c);
+    py_conn_t* pc = conn_acquire(capsule);
+    if (!pc) Py_RETURN_NONE;
+    wibesocket_conn_t* c = pc->conn;
+    pc->conn = NULL;
+    /* Waits for the server's CLOSE, up to the close timeout */
+    Py_BEGIN_ALLOW_THREADS
+    (void)wibesocket_close(c);
+    Py_END_ALLOW_THREADS
+    conn_release(pc);
     Py_RETURN_NONE;
 }
 
 static PyObject* py_send_close(PyObject* self, PyObject* args) {
     PyObject* capsule; int code; const char* reason = NULL;
     if (!PyArg_ParseTuple(args, "Oi|z", &capsule, &code, &reason)) return NULL;
-    wibesocket_conn_t* c = get_conn(capsule);
-    if (!c) Py_RETURN_FALSE;
-    wibesocket_error_t e = wibesocket_send_close(c, (uint16_t)code, reason);
+    py_conn_t* pc = conn_acquire(capsule);
+    if (!pc) Py_RETURN_FALSE;
+    wibesocket_error_t e = wibesocket_send_close(pc->conn, (uint16_t)code, reason);
+    conn_release(pc);
     if (e != WIBESOCKET_OK) Py_RETURN_FALSE;
     Py_RETURN_TRUE;
 }
 
 static PyObject* py_fileno(PyObject* self, PyObject* args) {
     PyObject* capsule; if (!PyArg_ParseTuple(args, "O", &capsule)) return NULL;
-    wibesocket_conn_t* c = get_conn(capsule); if (!c) Py_RETURN_NONE;
-    int fd = wibesocket_fileno(c);
+    py_conn_t* pc = conn_acquire(capsule); if (!pc) Py_RETURN_NONE;
+    int fd = wibesocket_fileno(pc->conn);
+    conn_release(pc);
     return PyLong_FromLong(fd);
 }
 
 static PyObject* py_release_payload(PyObject* self, PyObject* args) {
-    PyObject* capsule; if (!PyArg_ParseTuple(args, "O", &capsule)) return NULL;
-    wibesocket_conn_t* c = get_conn(capsule); if (!c) Py_RETURN_NONE;
-    wibesocket_release_payload(c);
+    PyObject* capsule; unsigned int pin = 0;
+    if (!PyArg_ParseTuple(args, "O|I", &capsule, &pin)) return NULL;
+    py_conn_t* pc = conn_acquire(capsule); if (!pc) Py_RETURN_NONE;
+    if (pin) {
+        wibesocket_message_t msg; memset(&msg, 0, sizeof(msg));
+        msg.pin = (uint32_t)pin;
+        wibesocket_release_message(pc->conn, &msg);
+    } else {
+        wibesocket_release_payload(pc->conn);
+    }
+    conn_release(pc);
     Py_RETURN_NONE;
 }
 
 static PyObject* py_poll_events(PyObject* self, PyObject* args, PyObject* kwargs) {
     PyObject* capsule; int timeout_ms = 0; static char* kwlist[] = {"conn", "timeout_ms", NULL};
     if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|i", kwlist, &capsule, &timeout_ms)) return NULL;
-    wibesocket_conn_t* c = get_conn(capsule); if (!c) Py_RETURN_FALSE;
-    wibesocket_error_t e = wibesocket_poll_events(c, timeout_ms);
+    py_conn_t* pc = conn_acquire(capsule); if (!pc) Py_RETURN_FALSE;
+    wibesocket_error_t e;
+    Py_BEGIN_ALLOW_THREADS
+    e = wibesocket_poll_events(pc->conn, timeout_ms);
+    Py_END_ALLOW_THREADS
+    conn_release(pc);
     if (e == WIBESOCKET_OK) Py_RETURN_TRUE;
     if (e == WIBESOCKET_ERROR_TIMEOUT) Py_RETURN_FALSE;
     PyErr_SetString(PyExc_RuntimeError, wibesocket_error_string(e));
     return NULL;
 }
 
+/* Flush what the socket takes now; True once the backlog is at or below the low watermark */
+static PyObject* py_writable(PyObject* self, PyObject* args) {
+    PyObject* capsule;
+    if (!PyArg_ParseTuple(args, "O", &capsule)) return NULL;
+    py_conn_t* pc = conn_acquire(capsule);
+    if (!pc) { PyErr_SetString(PyExc_ConnectionError, "connection closed"); return NULL; }
+    wibesocket_error_t e = wibesocket_wait_writable(pc->conn, 0);
+    conn_release(pc);
+    if (e == WIBESOCKET_OK) Py_RETURN_TRUE;
+    if (e == WIBESOCKET_ERROR_TIMEOUT) Py_RETURN_FALSE;
+    PyErr_SetString(PyExc_ConnectionError, wibesocket_error_string(e));
+    return NULL;
+}
+
+static PyObject* py_buffered_amount(PyObject* self, PyObject* args) {
+    PyObject* capsule;
+    if (!PyArg_ParseTuple(args, "O", &capsule)) return NULL;
+    py_conn_t* pc = conn_acquire(capsule);
+    if (!pc) return PyLong_FromLong(0);
+    size_t n = wibesocket_get_buffered_amount(pc->conn);
+    conn_release(pc);
+    return PyLong_FromSize_t(n);
+}
+
+/* Reader: a persistent receive side for event loops. feed() runs on each readiness callback
+ * and drains every frame already buffered into a FIFO of frame tuples, so none is left behind
+ * waiting for the socket to fire again; it stops at the high mark (full) or when every C pin
+ * is held by frames the caller has not released (starved), which is when the loop should stop
+ * watching the fd. pop() hands frames out in order without touching the connection. */
+typedef struct {
+    PyObject_HEAD
+    PyObject*   capsule;
+    PyObject**  q;       /* ring of frame tuples, cap = high */
+    Py_ssize_t  head, len, high;
+    int         starved; /* the last feed found every pin held */
+    int         eof;     /* closed or failed: nothing more will be queued */
+    PyObject*   error;   /* why it failed, or None on a clean close */
+} py_reader_t;
+
+static void reader_set_eof(py_reader_t* r, wibesocket_error_t e) {
+    r->eof = 1;
+    Py_CLEAR(r->error);
+    if (e != WIBESOCKET_OK && e != WIBESOCKET_ERROR_CLOSED) r->error = PyUnicode_FromString(wibesocket_error_string(e));
+}
+
+/* Queue n messages of one batch; each tuple owns one reference on their shared pin */
+static int reader_push(py_reader_t* r, wibesocket_conn_t* c, const wibesocket_message_t* msgs, size_t n) {
+    for (size_t i = 1; i < n; i++) wibesocket_retain_message(c, &msgs[i]);
+    for (size_t i = 0; i < n; i++) {
+        PyObject* t = frame_tuple(&msgs[i]);
+        if (!t) {
+            for (; i < n; i++) wibesocket_release_message(c, &msgs[i]);
+            return -1;
+        }
+        r->q[(r->head + r->len) % r->high] = t;
+        r->len++;
+    }
+    return 0;
+}
+
+static int reader_init(py_reader_t* r, PyObject* args, PyObject* kwargs) {
+    PyObject* capsule; Py_ssize_t high = READER_HIGH_DEFAULT;
+    static char* kwlist[] = {"conn", "high", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|n", kwlist, &capsule, &high)) return -1;
+    if (!PyCapsule_IsValid(capsule, CONN_CAPSULE_NAME)) {
+        PyErr_SetString(PyExc_TypeError, "Reader expects a connection");
+        return -1;
+    }
+    if (high <= 0) {
+        PyErr_SetString(PyExc_ValueError, "high must be positive");
+        return -1;
+    }
+    if (r->q) return 0; /* already initialized */
+    r->q = PyMem_New(PyObject*, (size_t)high);
+    if (!r->q) { PyErr_NoMemory(); return -1; }
+    Py_INCREF(capsule);
+    r->capsule = capsule;
+    r->high = high;
+    r->error = Py_None; Py_INCREF(Py_None);
+    return 0;
+}
+
+/* Release every frame still queued; the caller never saw them */
+static void reader_drop_queued(py_reader_t* r) {
+    if (!r->q || r->len == 0) return;
+    py_conn_t* pc = r->capsule ? conn_acquire(r->capsule) : NULL;
+    while (r->len > 0) {
+        PyObject* t = r->q[r->head];
+        r->head = (r->head + 1) % r->high;
+        r->len--;
+        if (pc) {
+            wibesocket_message_t m; memset(&m, 0, sizeof(m));
+            m.pin = (uint32_t)PyLong_AsUnsignedLong(PyTuple_GET_ITEM(t, 3));
+            wibesocket_release_message(pc->conn, &m);
+        }
+        Py_DECREF(t);
+    }
+    if (pc) conn_release(pc);
+}
+
+static void reader_dealloc(py_reader_t* r) {
+    reader_drop_queued(r);
+    PyMem_Free(r->q);
+    Py_XDECREF(r->capsule);
+    Py_XDECREF(r->error);
+    Py_TYPE(r)->tp_free((PyObject*)r);
+}
+
+static PyObject* reader_feed(py_reader_t* r, PyObject* unused) {
+    if (!r->q) { PyErr_SetString(PyExc_RuntimeError, "Reader not initialized"); return NULL; }
+    if (r->eof) return PyLong_FromLong(0);
+    py_conn_t* pc = conn_acquire(r->capsule);
+    if (!pc) { reader_set_eof(r, WIBESOCKET_ERROR_CLOSED); return PyLong_FromLong(0); }
+    wibesocket_message_t msgs[READER_BATCH];
+    Py_ssize_t added = 0;
+    int failed = 0;
+    r->starved = 0;
+    while (r->len < r->high) {
+        size_t want = (size_t)(r->high - r->len), n = 0;
+        if (want > READER_BATCH) want = READER_BATCH;
+        wibesocket_error_t e = wibesocket_recv_batch(pc->conn, msgs, want, &n, 0);
+        if (e == WIBESOCKET_ERROR_TIMEOUT) break;
+        if (e == WIBESOCKET_ERROR_NOT_READY) {
+            wibesocket_state_t st = wibesocket_get_state(pc->conn);
+            if (st == WIBESOCKET_STATE_OPEN || st == WIBESOCKET_STATE_CLOSING) r->starved = 1;
+            else reader_set_eof(r, wibesocket_get_error(pc->conn));
+            break;
+        }
+        if (e != WIBESOCKET_OK) { reader_set_eof(r, e); break; }
+        if (reader_push(r, pc->conn, msgs, n) < 0) { failed = 1; break; }
+        added += (Py_ssize_t)n;
+    }
+    conn_release(pc);
+    if (failed) return NULL;
+    return PyLong_FromSsize_t(added);
+}
+
+static PyObject* reader_pop(py_reader_t* r, PyObject* unused) {
+    if (r->len == 0) Py_RETURN_NONE;
+    PyObject* t = r->q[r->head];
+    r->head = (r->head + 1) % r->high;
+    r->len--;
+    return t; /* the queue's reference moves to the caller */
+}
+
+static PyObject* reader_clear(py_reader_t* r, PyObject* unused) {
+    reader_drop_queued(r);
+    Py_RETURN_NONE;
+}
+
+static Py_ssize_t reader_length(py_reader_t* r) { return r->len; }
+
+static PyObject* reader_get_full(py_reader_t* r, void* closure) { return PyBool_FromLong(r->len >= r->high); }
+static PyObject* reader_get_starved(py_reader_t* r, void* closure) { return PyBool_FromLong(r->starved); }
+static PyObject* reader_get_eof(py_reader_t* r, void* closure) { return PyBool_FromLong(r->eof); }
+static PyObject* reader_get_error(py_reader_t* r, void* closure) {
+    PyObject* e = r->error ? r->error : Py_None;
+    Py_INCREF(e);
+    return e;
+}
+
+static PyMethodDef reader_methods[] = {
+    {"feed", (PyCFunction)reader_feed, METH_NOARGS, "Queue every frame already buffered, up to the high mark; returns how many were added."},
+    {"pop", (PyCFunction)reader_pop, METH_NOARGS, "Oldest queued (type, memoryview, is_final, pin), or None."},
+    {"clear", (PyCFunction)reader_clear, METH_NOARGS, "Release every queued frame."},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyGetSetDef reader_getset[] = {
+    {"full", (getter)reader_get_full, NULL, "The queue holds high frames: stop reading until some are popped.", NULL},
+    {"starved", (getter)reader_get_starved, NULL, "Every pin is held by unreleased frames: stop reading until one is released.", NULL},
+    {"eof", (getter)reader_get_eof, NULL, "The connection closed or failed.", NULL},
+    {"error", (getter)reader_get_error, NULL, "Why the connection failed, or None.", NULL},
+    {NULL, NULL, NULL, NULL, NULL}
+};
+
+static PySequenceMethods reader_as_sequence = {
+    .sq_length = (lenfunc)reader_length,
+};
+
+static PyTypeObject ReaderType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "wibesocket._core.Reader",
+    .tp_doc = "Reader(conn, high=256): drains received frames into a queue for event loops.",
+    .tp_basicsize = sizeof(py_reader_t),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = PyType_GenericNew,
+    .tp_init = (initproc)reader_init,
+    .tp_dealloc = (destructor)reader_dealloc,
+    .tp_methods = reader_methods,
+    .tp_getset = reader_getset,
+    .tp_as_sequence = &reader_as_sequence,
+};
+
 static PyMethodDef Methods[] = {
-    {"connect", (PyCFunction)py_connect, METH_VARARGS | METH_KEYWORDS, "Connect to a WebSocket (non-blocking)."},
+    {"connect", (PyCFunction)py_connect, METH_VARARGS | METH_KEYWORDS, "Connect to a WebSocket (blocks for the handshake without holding the GIL)."},
     {"send_text", py_send_text, METH_VARARGS, "Send a text message (str or bytes)."},
     {"send_binary", py_send_binary, METH_VARARGS, "Send binary data (bytes-like)."},
-    {"recv", (PyCFunction)py_recv, METH_VARARGS | METH_KEYWORDS, "Receive a message; returns (type, bytes, is_final) or None on timeout."},
+    {"send_many", py_send_many, METH_VARARGS, "Send every message of an iterable (str as text, bytes-like as binary) in one flush; returns how many were queued."},
+    {"recv", (PyCFunction)py_recv, METH_VARARGS | METH_KEYWORDS, "Receive a message; returns (type, memoryview, is_final, pin) or None on timeout."},
+    {"recv_many", (PyCFunction)py_recv_many, METH_VARARGS | METH_KEYWORDS, "Receive up to max_n buffered messages; returns a list of (type, memoryview, is_final, pin), empty on timeout."},
     {"fileno", py_fileno, METH_VARARGS, "Return underlying socket fd for asyncio integration."},
-    {"release_payload", py_release_payload, METH_VARARGS, "Release pinned recv payload to allow subsequent recv calls."},
+    {"release_payload", py_release_payload, METH_VARARGS, "Release a received payload by its pin (default: the most recent one)."},
     {"poll_events", (PyCFunction)py_poll_events, METH_VARARGS | METH_KEYWORDS, "Poll for readiness; returns True if ready, False on timeout."},
+    {"writable", py_writable, METH_VARARGS, "Flush without blocking; True once the send backlog is at or below the low watermark."},
+    {"buffered_amount", py_buffered_amount, METH_VARARGS, "Bytes accepted for sending but not yet written."},
     {"send_close", py_send_close, METH_VARARGS, "Send a close frame (code, optional reason)."},
     {"close", py_close, METH_VARARGS, "Close connection."},
     {NULL, NULL, 0, NULL}
@@ -154,6 +524,15 @@ static struct PyModuleDef module = {
     PyModuleDef_HEAD_INIT, "wibesocket._core", NULL, -1, Methods
 };
 
-PyMODINIT_FUNC PyInit__core(void) { return PyModule_Create(&module); }
-
-
+PyMODINIT_FUNC PyInit__core(void) {
+    if (PyType_Ready(&ReaderType) < 0) return NULL;
+    PyObject* m = PyModule_Create(&module);
+    if (!m) return NULL;
+    Py_INCREF(&ReaderType);
+    if (PyModule_AddObject(m, "Reader", (PyObject*)&ReaderType) < 0) {
+        Py_DECREF(&ReaderType);
+        Py_DECREF(m);
+        return NULL;
+    }
+    return m;
+}
@@ -1,12 +1,10 @@
-from __future__ import annotations
-
 """High-level, pythonic wrappers over the zero-copy C extension.
 
 Exposes:
 - FrameType: IntEnum of RFC 6455 frame types
 - Frame: zero-copy frame wrapper (context-manageable), with helper to decode text
 - WebSocket: async-first client with sync fallbacks
-- AsyncWebSocket: thin asyncio adapter using add_reader (no background threads)
+- AsyncWebSocket: asyncio client fed by one persistent reader, with drain()
 
 Design goals
 - Zero-copy receive path: payload is a memoryview into the C buffer
@@ -19,233 +17,12 @@ Notes
 - Close explicitly to teardown cleanly; do not rely on GC
 """
 
-import asyncio
-from dataclasses import dataclass
-from enum import IntEnum
-from typing import Optional
-
-import wibesocket as _c
-
-
-def _run_sync(coro):
-    """Run an async coroutine from sync code safely."""
-    try:
-        loop = asyncio.get_event_loop()
-        if loop.is_running():
-            return asyncio.run(coro)
-        return loop.run_until_complete(coro)
-    except RuntimeError:
-        return asyncio.run(coro)
-
-
-class FrameType(IntEnum):
-    """WebSocket frame types per RFC 6455."""
-
-    CONTINUATION = 0x0
-    TEXT = 0x1
-    BINARY = 0x2
-    CLOSE = 0x8
-    PING = 0x9
-    PONG = 0xA
-
-
-@dataclass
-class Frame:
-    """Zero-copy received frame.
-
-    Use as a context manager or call release() promptly to allow subsequent recv() calls.
-
-    Attributes:
-        conn: Capsule object referencing the underlying C connection
-        type: FrameType for this frame
-        data: memoryview over the payload (no copy)
-        is_final: whether this is the final fragment in a message
-    """
-
-    conn: object  # C capsule
-    type: FrameType
-    data: memoryview
-    is_final: bool
-    _released: bool = False
-
-    def release(self) -> None:
-        """Release the pinned payload buffer back to the C layer."""
-        if not self._released:
-            _c.release_payload(self.conn)
-            self._released = True
-
-    def __enter__(self) -> "Frame":
-        return self
-
-    def __exit__(self, exc_type, exc, tb) -> None:
-        self.release()
-
-    def __del__(self) -> None:
-        # Avoid C calls in GC context; rely on explicit release or context manager
-        self._released = True
-
-    def text(self, errors: str = "strict") -> str:
-        return self.data.tobytes().decode("utf-8", errors)
-
-
-class WebSocket:
-    """Zero-copy WebSocket client with async-first API and sync fallbacks."""
-
-    def __init__(self, capsule: object):
-        self._c = capsule
-
-    @classmethod
-    async def connect(
-        cls,
-        uri: str,
-        *,
-        handshake_timeout_ms: int = 5000,
-        max_frame_size: int = 1 << 20,
-        user_agent: Optional[str] = None,
-        origin: Optional[str] = None,
-        protocol: Optional[str] = None,
-    ) -> "WebSocket":
-        c = _c.connect(
-            uri,
-            handshake_timeout_ms=handshake_timeout_ms,
-            max_frame_size=max_frame_size,
-            user_agent=user_agent,
-            origin=origin,
-            protocol=protocol,
-        )
-        if c is None:
-            raise ConnectionError("wibesocket connect failed")
-        return cls(c)
-
-    @classmethod
-    def connect_sync(
-        cls,
-        uri: str,
-        *,
-        handshake_timeout_ms: int = 5000,
-        max_frame_size: int = 1 << 20,
-        user_agent: Optional[str] = None,
-        origin: Optional[str] = None,
-        protocol: Optional[str] = None,
-    ) -> "WebSocket":
-        return _run_sync(
-            cls.connect(
-                uri,
-                handshake_timeout_ms=handshake_timeout_ms,
-                max_frame_size=max_frame_size,
-                user_agent=user_agent,
-                origin=origin,
-                protocol=protocol,
-            )
-        )
-
-    # Sending
-    async def send(self, data: bytes | str) -> None:
-        if isinstance(data, (bytes, memoryview)):
-            ok = _c.send_binary(self._c, memoryview(data))
-        else:
-            ok = _c.send_text(self._c, data)
-        if not ok:
-            raise RuntimeError("send failed")
-
-    def send_sync(self, data: bytes | str) -> None:
-        _run_sync(self.send(data))
-
-    # Receiving
-    async def recv(self, timeout_ms: int = 0) -> Optional[Frame]:
-        # Poll for readiness, then do a non-blocking recv
-        ready = _c.poll_events(self._c, timeout_ms=timeout_ms)
-        if not ready:
-            return None
-        res = _c.recv(self._c, timeout_ms=0)
-        if res is None:
-            return None
-        ftype, data, is_final = res
-        return Frame(self._c, FrameType(ftype), data, bool(is_final))
-
-    def recv_sync(self, timeout_ms: int = 0) -> Optional[Frame]:
-        return _run_sync(self.recv(timeout_ms=timeout_ms))
-
-    async def ping(self, data: bytes = b"") -> None:
-        return None
-
-    async def close(self, code: int = 1000, reason: Optional[str] = None) -> None:
-        _c.send_close(self._c, code, reason or "")
-        _c.close(self._c)
-
-    def close_sync(self, code: int = 1000, reason: Optional[str] = None) -> None:
-        _run_sync(self.close(code, reason))
-
-    # Integration
-    def fileno(self) -> int:
-        return int(_c.fileno(self._c))
-
-
-class AsyncWebSocket:
-    """Asyncio wrapper using add_reader for zero-copy reads."""
-
-    def __init__(self, ws: WebSocket, loop: Optional[asyncio.AbstractEventLoop] = None):
-        self._ws = ws
-        self._loop = loop or asyncio.get_running_loop()
-        self._fd = ws.fileno()
-        self._fut: Optional[asyncio.Future] = None
-
-    @classmethod
-    async def connect(cls, uri: str, **kwargs) -> "AsyncWebSocket":
-        return cls(await WebSocket.connect(uri, **kwargs))
-
-    def _on_readable(self) -> None:
-        if not self._fut or self._fut.done():
-            return
-        fr = self._ws.recv_sync(timeout_ms=0)
-        if fr is not None:
-            self._fut.set_result(fr)
-
-    async def recv(self, timeout: float | None = None) -> Frame:
-        """Await a frame with an optional timeout (seconds)."""
-        self._fut = self._loop.create_future()
-        self._loop.add_reader(self._fd, self._on_readable)
-        try:
-            return await asyncio.wait_for(self._fut, timeout=timeout)
-        finally:
-            self._loop.remove_reader(self._fd)
-
-    # Proxy helpers
-    def send_text(self, data: str | bytes) -> None:
-        self._ws.send_sync(data)
-
-    def send_binary(self, data: bytes | memoryview) -> None:
-        self._ws.send_sync(data)
-
-    def close(self, code: int = 1000, reason: Optional[str] = None) -> None:
-        self._ws.close_sync(code, reason)
-
 from __future__ import annotations
 
-"""High-level, pythonic wrappers over the zero-copy C extension.
-
-Exposes:
-- FrameType: IntEnum of RFC 6455 frame types
-- Frame: zero-copy frame wrapper (context-manageable), with helper to decode text
-- WebSocket: async-first client with sync fallbacks
-- AsyncWebSocket: thin asyncio adapter using add_reader
-
-Design goals
-- Zero-copy receive path: payload is a memoryview into the C buffer
-- Explicit lifetime: call Frame.release() or use "with Frame:" to release promptly
-- No hidden threads; non-blocking I/O via readiness polling
-- Predictable ownership: you own the FD as long as the WebSocket exists
-
-Notes
-- Always release frames quickly to avoid backpressure on the recv buffer
-- Close explicitly to teardown cleanly; do not rely on GC
-"""
-
 import asyncio
-import contextlib
 from dataclasses import dataclass
 from enum import IntEnum
-from typing import Optional
+from typing import Callable, Optional
 
 import wibesocket as _c
 
@@ -265,30 +42,36 @@ class FrameType(IntEnum):
 class Frame:
     """Zero-copy received frame.
 
-    Use as a context manager or call release() promptly to allow subsequent recv() calls.
+    Use as a context manager or call release() once done. Several frames may be held at
+    once; each keeps its own payload valid until released.
 
     Attributes:
         conn: Capsule object referencing the underlying C connection
         type: FrameType for this frame
         data: memoryview over the payload (no copy)
         is_final: whether this is the final fragment in a message
+        pin: C-level pin keeping data valid
     """
 
     conn: object  # C capsule
     type: FrameType
     data: memoryview
     is_final: bool
+    pin: int = 0
     _released: bool = False
+    _on_release: Optional[Callable[[], None]] = None
 
     def release(self) -> None:
         """Release the pinned payload buffer back to the C layer.
 
-        This invalidates the memoryview. Always call before recv() again,
-        or use "with frame:" to release automatically.
+        This invalidates the memoryview. Frames can be released in any order;
+        use "with frame:" to release automatically.
         """
         if not self._released:
-            _c.release_payload(self.conn)
+            _c.release_payload(self.conn, self.pin)
             self._released = True
+            if self._on_release is not None:
+                self._on_release()
 
     def __enter__(self) -> "Frame":
         return self
@@ -338,6 +121,8 @@ class WebSocket:
         user_agent: Optional[str] = None,
         origin: Optional[str] = None,
         protocol: Optional[str] = None,
+        send_high_watermark: int = 0,
+        send_low_watermark: int = 0,
     ) -> "WebSocket":
         """Connect to a WebSocket server.
 
@@ -348,6 +133,8 @@ class WebSocket:
             user_agent: optional User-Agent
             origin: optional Origin
             protocol: optional subprotocol
+            send_high_watermark: backlog at which sends are refused (0 = 64 MiB)
+            send_low_watermark: backlog drain() waits for (0 = high / 4)
         """
         c = _c.connect(
             uri,
@@ -356,6 +143,8 @@ class WebSocket:
             user_agent=user_agent,
             origin=origin,
             protocol=protocol,
+            send_high_watermark=send_high_watermark,
+            send_low_watermark=send_low_watermark,
         )
         if c is None:
             raise ConnectionError("wibesocket connect failed")
@@ -397,8 +186,26 @@ class WebSocket:
         res = _c.recv(self._c, timeout_ms=timeout_ms)
         if res is None:
             return None
-        ftype, data, is_final = res
-        return Frame(self._c, FrameType(ftype), data, bool(is_final))
+        ftype, data, is_final, pin = res
+        return Frame(self._c, FrameType(ftype), data, bool(is_final), pin)
+
+    def recv_many(self, max_n: int = 64, timeout_ms: int = 0) -> list[Frame]:
+        """Receive every frame already buffered, up to max_n, in one call.
+
+        Waits up to timeout_ms only when none is buffered; returns an empty
+        list on timeout. Each Frame is released on its own.
+        """
+        return [
+            Frame(self._c, FrameType(ftype), data, bool(is_final), pin)
+            for ftype, data, is_final, pin in _c.recv_many(self._c, max_n, timeout_ms)
+        ]
+
+    def send_many(self, messages) -> int:
+        """Send an iterable of messages in one flush: str as text, bytes-like as binary.
+
+        Returns how many were queued; fewer than given once one is refused.
+        """
+        return int(_c.send_many(self._c, messages))
 
     # Control
     def ping(self, data: bytes = b"") -> None:
@@ -418,8 +225,16 @@ class WebSocket:
         return int(_c.fileno(self._c))
 
 
+
+
 class AsyncWebSocket:
-    """Asyncio wrapper using add_reader for zero-copy reads.
+    """Asyncio client: one persistent reader drains every buffered frame into a queue.
+
+    A single reader callback stays registered on the fd and queues every frame already
+    buffered, up to max_queue, in one C call; recv() and "async for" take frames from
+    that queue. Reading pauses while the queue is full or every received payload is
+    still held, and resumes once frames are taken or released. drain() waits until the
+    send backlog falls to the low watermark.
 
     Example:
         >>> import asyncio
@@ -427,47 +242,153 @@ class AsyncWebSocket:
         >>> async def main():
         ...     aws = await AsyncWebSocket.connect("ws://127.0.0.1:8765")
         ...     aws.send_text("hello")
-        ...     fr = await aws.recv(timeout=3)
-        ...     with fr:
-        ...         print(fr.text())
+        ...     await aws.drain()
+        ...     async for fr in aws:
+        ...         with fr:
+        ...             print(fr.text())
+        ...         break
         ...     aws.close()
     """
 
-    def __init__(self, ws: WebSocket, loop: Optional[asyncio.AbstractEventLoop] = None):
+    def __init__(
+        self,
+        ws: WebSocket,
+        loop: Optional[asyncio.AbstractEventLoop] = None,
+        *,
+        max_queue: int = 256,
+    ):
         self._ws = ws
         self._loop = loop or asyncio.get_running_loop()
         self._fd = ws.fileno()
-        self._fut: Optional[asyncio.Future] = None
+        self._reader = _c.Reader(ws._c, max_queue)
+        self._low = max_queue // 2
+        self._waiter: Optional[asyncio.Future] = None
+        self._reading = False
+        self._paused = False  # by the caller, through pause_reading()
+        self._closed = False
+        self.resume_reading()
 
     @classmethod
-    async def connect(cls, uri: str, **kwargs) -> "AsyncWebSocket":
-        """Async constructor building on the sync connect."""
-        return cls(WebSocket.connect(uri, **kwargs))
+    async def connect(cls, uri: str, *, max_queue: int = 256, **kwargs) -> "AsyncWebSocket":
+        """Connect (the handshake runs in a thread) and start reading."""
+        loop = asyncio.get_running_loop()
+        ws = await loop.run_in_executor(None, lambda: WebSocket.connect(uri, **kwargs))
+        return cls(ws, loop, max_queue=max_queue)
+
+    # Reading
+    def _start(self) -> None:
+        if not self._reading and not self._closed:
+            self._loop.add_reader(self._fd, self._on_readable)
+            self._reading = True
+
+    def _stop(self) -> None:
+        if self._reading:
+            self._loop.remove_reader(self._fd)
+            self._reading = False
 
     def _on_readable(self) -> None:
-        if not self._fut or self._fut.done():
+        r = self._reader
+        if r.feed() or r.eof:
+            w = self._waiter
+            if w is not None and not w.done():
+                w.set_result(None)
+        if r.full or r.starved or r.eof:
+            self._stop()
+
+    def _on_frame_released(self) -> None:
+        if self._reader.starved and not self._paused:
+            self.resume_reading()
+
+    def pause_reading(self) -> None:
+        """Stop reading from the socket; frames already queued can still be received."""
+        self._paused = True
+        self._stop()
+
+    def resume_reading(self) -> None:
+        """Read again, first queueing whatever arrived while paused."""
+        self._paused = False
+        if self._closed or self._reader.eof:
             return
-        fr = self._ws.recv(timeout_ms=0)
-        if fr is not None:
-            self._fut.set_result(fr)
+        self._start()
+        # Frames may already be buffered with no new data to make the fd fire
+        self._on_readable()
+
+    def _frame(self, t: tuple) -> Frame:
+        ftype, data, is_final, pin = t
+        return Frame(self._ws._c, FrameType(ftype), data, bool(is_final), pin,
+                     _on_release=self._on_frame_released)
 
     async def recv(self, timeout: float | None = None) -> Frame:
-        """Await a frame with an optional timeout (seconds)."""
-        self._fut = self._loop.create_future()
-        self._loop.add_reader(self._fd, self._on_readable)
+        """Await the next frame; TimeoutError after timeout seconds, ConnectionError once closed."""
+        r = self._reader
+        while True:
+            t = r.pop()
+            if t is not None:
+                if not self._reading and not self._paused and len(r) <= self._low:
+                    self.resume_reading()
+                return self._frame(t)
+            if r.eof or self._closed:
+                raise ConnectionError(r.error or "connection closed")
+            self._waiter = self._loop.create_future()
+            try:
+                await asyncio.wait_for(self._waiter, timeout=timeout)
+            finally:
+                self._waiter = None
+
+    def recv_nowait(self) -> Optional[Frame]:
+        """A queued frame, or None when the queue is empty."""
+        t = self._reader.pop()
+        if t is None:
+            return None
+        if not self._reading and not self._paused and len(self._reader) <= self._low:
+            self.resume_reading()
+        return self._frame(t)
+
+    def __aiter__(self) -> "AsyncWebSocket":
+        return self
+
+    async def __anext__(self) -> Frame:
         try:
-            return await asyncio.wait_for(self._fut, timeout=timeout)
-        finally:
-            self._loop.remove_reader(self._fd)
+            return await self.recv()
+        except ConnectionError:
+            if self._reader.error is None:
+                raise StopAsyncIteration
+            raise
 
-    # Proxy helpers
+    # Sending
     def send_text(self, data: str | bytes) -> None:
         self._ws.send_text(data)
 
     def send_binary(self, data: bytes | memoryview) -> None:
         self._ws.send_binary(data)
 
+    def send_many(self, messages) -> int:
+        return self._ws.send_many(messages)
+
+    async def drain(self) -> None:
+        """Wait until the send backlog is at or below the low watermark, flushing as the socket allows."""
+        conn = self._ws._c
+        while not _c.writable(conn):
+            fut = self._loop.create_future()
+            self._loop.add_writer(self._fd, lambda: fut.done() or fut.set_result(None))
+            try:
+                await fut
+            finally:
+                self._loop.remove_writer(self._fd)
+
+    @property
+    def buffered_amount(self) -> int:
+        """Bytes accepted for sending but not yet written."""
+        return int(_c.buffered_amount(self._ws._c))
+
     def close(self, code: int = 1000, reason: Optional[str] = None) -> None:
+        """Stop reading, release queued frames, then close like WebSocket.close."""
+        if self._closed:
+            return
+        self._closed = True
+        self._stop()
+        self._reader.clear()
+        w = self._waiter
+        if w is not None and not w.done():
+            w.set_result(None)
         self._ws.close(code, reason)
-
-
@@ -0,0 +1,474 @@
+#include "event_loop.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+
+#include "internal/mpsc.h"
+#include "internal/slab.h"
+#include "internal/timerwheel.h"
+
+#define WS_LOOP_MAX_EVENTS 256
+
+typedef struct {
+    ws_mpsc_node_t          node;
+    wibesocket_loop_task_fn fn;
+    void*                   arg;
+} ws_loop_task_t;
+
+/* What an event's data pointer refers to: one per watched fd of an entry */
+typedef enum { WS_TAG_CONN = 0, WS_TAG_POST } ws_loop_tag_kind_t;
+typedef struct {
+    ws_loop_tag_kind_t  kind;
+    ws_loop_entry_t*    entry;
+} ws_loop_tag_t;
+
+struct ws_loop_entry {
+    ws_timer_t          timer;     /* first: the wheel hands it back as the entry */
+    ws_loop_tag_t       tag;       /* socket (or io_uring ring) fd */
+    ws_loop_tag_t       post_tag;  /* wibesocket_post_send wakeups */
+    wibesocket_loop_t*  loop;
+    wibesocket_conn_t*  conn;      /* NULL once removed */
+    wibesocket_loop_cb  cb;
+    void*               user_data;
+    int                 fd;
+    int                 post_fd;
+    int                 want_write;
+    int                 pending;   /* on the pending list */
+    ws_loop_entry_t*    next_pending;
+    int                 flushing;  /* on the flush list, due at flush_due_us */
+    uint64_t            flush_due_us;
+    ws_loop_entry_t*    next_flush;
+    ws_loop_entry_t*    prev;      /* all live entries, for destroy */
+    ws_loop_entry_t*    next;
+    ws_loop_entry_t*    next_dead;
+};
+
+struct wibesocket_loop {
+    int              fd;       /* epoll */
+    ws_loop_entry_t* entries;
+    ws_loop_entry_t* pending;  /* readable without a new edge: dispatched on the next run */
+    /* Connections holding coalesced sends back until a deadline, kept to the microsecond
+     * (the wheel ticks in milliseconds) */
+    ws_loop_entry_t* flushes;
+    int              no_pwait2; /* epoll_pwait2 missing: waits round up to milliseconds */
+    /* One timer per connection, at its earliest deadline: handshake, keepalive ping, idle
+     * limit or close handshake. Rearmed after each dispatch, only ever moved earlier; one that
+     * fires early just finds nothing due and is set again. */
+    ws_timerwheel_t  wheel;
+    int              timer_dispatched; /* dispatches made from timer callbacks this round */
+    ws_loop_entry_t* dead;     /* removed entries, freed after the current dispatch round */
+    int              dispatching;
+    atomic_int       stopped;
+    /* Cross-thread inbox: producers push a task, then raise the wakeup unless one is already
+     * outstanding; the loop clears the flag before draining, so no push goes unnoticed */
+    ws_mpsc_t        tasks;
+    atomic_int       woken;
+    int              wake_fd;  /* eventfd */
+};
+
+/* Entries come and go with every connection; recycle them across loops */
+static ws_slab_t g_entry_slab = WS_SLAB_INIT(sizeof(struct ws_loop_entry));
+
+static uint64_t loop_now_ms(void) {
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)(ts.tv_nsec / 1000000ULL);
+}
+
+static uint64_t loop_now_us(void) {
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)(ts.tv_nsec / 1000ULL);
+}
+
+static void entry_timer_fire(ws_timer_t* t, uint64_t now_ms);
+
+static int backend_add(wibesocket_loop_t* loop, ws_loop_entry_t* e) {
+    struct epoll_event ev; memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET | (e->want_write ? EPOLLOUT : 0);
+    ev.data.ptr = &e->tag;
+    return epoll_ctl(loop->fd, EPOLL_CTL_ADD, e->fd, &ev);
+}
+
+static int backend_set_write(wibesocket_loop_t* loop, ws_loop_entry_t* e, int want) {
+    struct epoll_event ev; memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET | (want ? EPOLLOUT : 0);
+    ev.data.ptr = &e->tag;
+    return epoll_ctl(loop->fd, EPOLL_CTL_MOD, e->fd, &ev);
+}
+
+static int backend_add_post(wibesocket_loop_t* loop, ws_loop_entry_t* e) {
+    struct epoll_event ev; memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = &e->post_tag;
+    return epoll_ctl(loop->fd, EPOLL_CTL_ADD, e->post_fd, &ev);
+}
+
+static void backend_del_post(wibesocket_loop_t* loop, ws_loop_entry_t* e) {
+    struct epoll_event ev; memset(&ev, 0, sizeof(ev));
+    (void)epoll_ctl(loop->fd, EPOLL_CTL_DEL, e->post_fd, &ev);
+}
+
+static void backend_del(wibesocket_loop_t* loop, ws_loop_entry_t* e) {
+    struct epoll_event ev; memset(&ev, 0, sizeof(ev));
+    (void)epoll_ctl(loop->fd, EPOLL_CTL_DEL, e->fd, &ev);
+}
+
+/* The wakeup event carries the loop itself as its tag; entries never alias it */
+static int backend_add_wakeup(wibesocket_loop_t* loop) {
+    loop->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (loop->wake_fd < 0) return -1;
+    struct epoll_event ev; memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = loop;
+    return epoll_ctl(loop->fd, EPOLL_CTL_ADD, loop->wake_fd, &ev);
+}
+
+static void loop_wake(wibesocket_loop_t* loop) {
+    if (atomic_exchange(&loop->woken, 1)) return;
+    uint64_t one = 1;
+    ssize_t w = write(loop->wake_fd, &one, sizeof(one));
+    (void)w; /* EAGAIN means the counter is already non-zero */
+}
+
+static void run_tasks(wibesocket_loop_t* loop) {
+    uint64_t cnt;
+    ssize_t r = read(loop->wake_fd, &cnt, sizeof(cnt));
+    (void)r;
+    atomic_store(&loop->woken, 0);
+    ws_mpsc_node_t* n;
+    while ((n = ws_mpsc_pop(&loop->tasks)) != NULL) {
+        ws_loop_task_t* t = (ws_loop_task_t*)n;
+        t->fn(loop, t->arg);
+        free(t);
+    }
+}
+
+wibesocket_loop_t* wibesocket_loop_create(void) {
+    wibesocket_loop_t* loop = (wibesocket_loop_t*)calloc(1, sizeof(*loop));
+    if (!loop) return NULL;
+    ws_mpsc_init(&loop->tasks);
+    ws_timerwheel_init(&loop->wheel, loop_now_ms());
+    loop->fd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->fd < 0) { free(loop); return NULL; }
+    if (backend_add_wakeup(loop) < 0) {
+        if (loop->wake_fd >= 0) close(loop->wake_fd);
+        close(loop->fd);
+        free(loop);
+        return NULL;
+    }
+    return loop;
+}
+
+wibesocket_error_t wibesocket_loop_post(wibesocket_loop_t* loop, wibesocket_loop_task_fn fn, void* arg) {
+    if (!loop || !fn) return WIBESOCKET_ERROR_INVALID_ARGS;
+    ws_loop_task_t* t = (ws_loop_task_t*)malloc(sizeof(*t));
+    if (!t) return WIBESOCKET_ERROR_MEMORY;
+    t->fn = fn; t->arg = arg;
+    ws_mpsc_push(&loop->tasks, &t->node);
+    loop_wake(loop);
+    return WIBESOCKET_OK;
+}
+
+/* Entries still linked on a pending or flush list stay until a later round unlinks them. */
+static void free_dead(wibesocket_loop_t* loop, int all) {
+    ws_loop_entry_t** pp = &loop->dead;
+    while (*pp) {
+        ws_loop_entry_t* e = *pp;
+        if ((e->pending || e->flushing) && !all) { pp = &e->next_dead; continue; }
+        *pp = e->next_dead;
+        ws_slab_free(&g_entry_slab, e);
+    }
+}
+
+void wibesocket_loop_destroy(wibesocket_loop_t* loop) {
+    if (!loop) return;
+    /* Posted tasks own their arguments: run them (they may still add connections) first */
+    run_tasks(loop);
+    while (loop->entries) {
+        /* Closed by the user and still waiting for the server's CLOSE: finish them off */
+        ws_loop_entry_t* e = loop->entries;
+        if (e->conn && ws_conn_lingering(e->conn)) ws_conn_finish_close(e->conn);
+        else ws_loop_entry_remove(e);
+    }
+    loop->pending = NULL;
+    loop->flushes = NULL;
+    free_dead(loop, 1);
+    if (loop->wake_fd >= 0) close(loop->wake_fd);
+    close(loop->fd);
+    free(loop);
+}
+
+wibesocket_error_t wibesocket_loop_add(wibesocket_loop_t* loop, wibesocket_conn_t* conn,
+                                       wibesocket_loop_cb cb, void* user_data) {
+    if (!loop || !conn || !cb) return WIBESOCKET_ERROR_INVALID_ARGS;
+    if (ws_conn_loop_entry(conn)) return WIBESOCKET_ERROR_INVALID_ARGS;
+    ws_loop_entry_t* e = (ws_loop_entry_t*)ws_slab_alloc(&g_entry_slab);
+    if (!e) return WIBESOCKET_ERROR_MEMORY;
+    e->loop = loop; e->conn = conn; e->cb = cb; e->user_data = user_data;
+    e->tag.kind = WS_TAG_CONN; e->tag.entry = e;
+    e->post_tag.kind = WS_TAG_POST; e->post_tag.entry = e;
+    e->post_fd = ws_conn_post_fd(conn);
+    /* While connecting, writability signals connect() completion and request progress */
+    e->want_write = ws_conn_connecting(conn) || ws_conn_wants_write(conn);
+    if (ws_conn_loop_attach(conn, e, &e->fd) < 0) { ws_slab_free(&g_entry_slab, e); return WIBESOCKET_ERROR_NOT_READY; }
+    if (e->fd >= 0 && backend_add(loop, e) < 0) {
+        ws_conn_loop_detach(conn);
+        ws_slab_free(&g_entry_slab, e);
+        return WIBESOCKET_ERROR_NETWORK;
+    }
+    if (e->post_fd >= 0 && backend_add_post(loop, e) < 0) {
+        if (e->fd >= 0) backend_del(loop, e);
+        ws_conn_loop_detach(conn);
+        ws_slab_free(&g_entry_slab, e);
+        return WIBESOCKET_ERROR_NETWORK;
+    }
+    e->next = loop->entries;
+    if (loop->entries) loop->entries->prev = e;
+    loop->entries = e;
+    ws_timer_init(&e->timer, entry_timer_fire);
+    ws_loop_entry_rearm(e);
+    /* Bytes may already be buffered or queued in the kernel from before the add */
+    if (!ws_conn_connecting(conn)) ws_loop_entry_mark_pending(e);
+    return WIBESOCKET_OK;
+}
+
+wibesocket_error_t wibesocket_loop_remove(wibesocket_loop_t* loop, wibesocket_conn_t* conn) {
+    if (!loop || !conn) return WIBESOCKET_ERROR_INVALID_ARGS;
+    ws_loop_entry_t* e = ws_conn_loop_entry(conn);
+    if (!e || e->loop != loop) return WIBESOCKET_ERROR_INVALID_ARGS;
+    ws_loop_entry_remove(e);
+    return WIBESOCKET_OK;
+}
+
+void ws_loop_entry_remove(ws_loop_entry_t* e) {
+    wibesocket_loop_t* loop = e->loop;
+    if (!e->conn) return;
+    if (e->fd >= 0) backend_del(loop, e);
+    if (e->post_fd >= 0) backend_del_post(loop, e);
+    ws_conn_loop_detach(e->conn);
+    e->conn = NULL;
+    ws_timer_cancel(&loop->wheel, &e->timer);
+    if (e->prev) e->prev->next = e->next; else loop->entries = e->next;
+    if (e->next) e->next->prev = e->prev;
+    /* Events for e may still sit in the array being dispatched; free it after the round */
+    if (e->pending || e->flushing || loop->dispatching) {
+        e->next_dead = loop->dead; loop->dead = e;
+    } else {
+        ws_slab_free(&g_entry_slab, e);
+    }
+}
+
+void ws_loop_entry_set_fd(ws_loop_entry_t* e, int fd) {
+    if (e->fd >= 0) backend_del(e->loop, e);
+    e->fd = fd;
+    if (fd >= 0) {
+        e->want_write = 1;
+        (void)backend_add(e->loop, e);
+    }
+}
+
+void ws_loop_entry_want_write(ws_loop_entry_t* e, int want) {
+    want = want ? 1 : 0;
+    if (e->want_write == want || e->fd < 0) return;
+    if (backend_set_write(e->loop, e, want) == 0) e->want_write = want;
+}
+
+void ws_loop_entry_mark_pending(ws_loop_entry_t* e) {
+    if (e->pending || !e->conn) return;
+    e->pending = 1;
+    e->next_pending = e->loop->pending;
+    e->loop->pending = e;
+}
+
+void ws_loop_entry_flush_at(ws_loop_entry_t* e, uint64_t due_us) {
+    if (!e->conn) return;
+    e->flush_due_us = due_us;
+    if (e->flushing) return;
+    e->flushing = 1;
+    e->next_flush = e->loop->flushes;
+    e->loop->flushes = e;
+}
+
+/* Earliest coalescing deadline, 0 = none */
+static uint64_t next_flush_us(const wibesocket_loop_t* loop) {
+    uint64_t due = 0;
+    for (const ws_loop_entry_t* e = loop->flushes; e; e = e->next_flush) {
+        if (e->conn && (!due || e->flush_due_us < due)) due = e->flush_due_us;
+    }
+    return due;
+}
+
+/* Run the callback, then queue the connection for another round if it still has input. */
+static int dispatch(ws_loop_entry_t* e, uint32_t events) {
+    if (!e->conn) return 0;
+    if (ws_conn_lingering(e->conn)) {
+        /* Already closed by the user: only the close handshake is left, no callbacks */
+        ws_conn_linger_step(e->conn);
+        return 0;
+    }
+    if (ws_conn_take_drained(e->conn)) events |= WIBESOCKET_EVENT_DRAINED;
+    e->cb(e->loop, e->conn, events, e->user_data);
+    if (e->conn && ws_conn_has_pending(e->conn)) ws_loop_entry_mark_pending(e);
+    return 1;
+}
+
+/* Advance an async connect; returns the events to report, 0 while still in progress. */
+static uint32_t step_connect(ws_loop_entry_t* e) {
+    wibesocket_error_t r = wibesocket_connect_step(e->conn);
+    if (r == WIBESOCKET_ERROR_NOT_READY) return 0;
+    return (r == WIBESOCKET_OK) ? WIBESOCKET_EVENT_CONNECTED : WIBESOCKET_EVENT_ERROR;
+}
+
+void ws_loop_entry_rearm(ws_loop_entry_t* e) {
+    if (!e->conn) return;
+    uint64_t due = ws_conn_timer_deadline(e->conn, loop_now_ms());
+    if (due && (!ws_timer_active(&e->timer) || due < e->timer.expires_ms)) {
+        ws_timer_schedule(&e->loop->wheel, &e->timer, due);
+    }
+}
+
+/* Flush the connections whose coalescing deadline passed; removed entries are unlinked here */
+static int run_flushes(wibesocket_loop_t* loop) {
+    int dispatched = 0;
+    uint64_t now = loop_now_us();
+    ws_loop_entry_t** pp = &loop->flushes;
+    while (*pp) {
+        ws_loop_entry_t* e = *pp;
+        if (e->conn && e->flush_due_us > now) { pp = &e->next_flush; continue; }
+        *pp = e->next_flush;
+        e->flushing = 0;
+        if (e->conn && ws_conn_flush_due(e->conn) < 0) dispatched += dispatch(e, WIBESOCKET_EVENT_ERROR);
+    }
+    return dispatched;
+}
+
+/* epoll_wait to the microsecond where the kernel has epoll_pwait2 (5.11+) */
+static int loop_epoll_wait_us(wibesocket_loop_t* loop, struct epoll_event* evs, uint64_t wait_us) {
+#if defined(SYS_epoll_pwait2)
+    if (!loop->no_pwait2) {
+        struct timespec ts = { (time_t)(wait_us / 1000000ULL), (long)(wait_us % 1000000ULL) * 1000L };
+        int n = (int)syscall(SYS_epoll_pwait2, loop->fd, evs, WS_LOOP_MAX_EVENTS, &ts, NULL, 0);
+        if (n >= 0 || errno != ENOSYS) return n;
+        loop->no_pwait2 = 1;
+    }
+#endif
+    return epoll_wait(loop->fd, evs, WS_LOOP_MAX_EVENTS, (int)((wait_us + 999) / 1000));
+}
+
+static void entry_timer_fire(ws_timer_t* t, uint64_t now_ms) {
+    ws_loop_entry_t* e = (ws_loop_entry_t*)t;
+    if (!e->conn) return;
+    uint32_t flags = ws_conn_connecting(e->conn) ? step_connect(e) : ws_conn_on_timer(e->conn, now_ms);
+    if (flags) e->loop->timer_dispatched += dispatch(e, flags);
+    ws_loop_entry_rearm(e);
+}
+
+int wibesocket_loop_run_once(wibesocket_loop_t* loop, int timeout_ms) {
+    if (!loop) return -1;
+    /* Take the pending list first: those connections must not wait for an edge */
+    ws_loop_entry_t* pend = loop->pending;
+    loop->pending = NULL;
+    if (pend) timeout_ms = 0;
+    /* Wake for the nearest connection deadline */
+    if (timeout_ms != 0) {
+        int w = ws_timerwheel_next_ms(&loop->wheel, loop_now_ms(), timeout_ms);
+        if (w >= 0) timeout_ms = w;
+    }
+    /* ...or a coalescing deadline, when it comes sooner */
+    int64_t wait_us = -1;
+    uint64_t flush_due = timeout_ms != 0 ? next_flush_us(loop) : 0;
+    if (flush_due) {
+        uint64_t now = loop_now_us();
+        uint64_t left = flush_due > now ? flush_due - now : 0;
+        if (timeout_ms < 0 || left < (uint64_t)timeout_ms * 1000ULL) wait_us = (int64_t)left;
+    }
+
+    struct epoll_event evs[WS_LOOP_MAX_EVENTS];
+    int n = wait_us >= 0 ? loop_epoll_wait_us(loop, evs, (uint64_t)wait_us)
+                         : epoll_wait(loop->fd, evs, WS_LOOP_MAX_EVENTS, timeout_ms);
+    if (n < 0) {
+        if (errno != EINTR) { loop->pending = pend; return -1; }
+        n = 0;
+    }
+
+    int dispatched = 0;
+    int woken = 0;
+    loop->dispatching = 1;
+    /* Entries keep their pending flag until reached, so re-marking one is a no-op and the
+     * snapshot's links stay intact while callbacks run */
+    while (pend) {
+        ws_loop_entry_t* e = pend;
+        pend = e->next_pending;
+        e->pending = 0;
+        dispatched += dispatch(e, WIBESOCKET_EVENT_READABLE);
+        ws_loop_entry_rearm(e);
+    }
+    for (int i = 0; i < n; i++) {
+        uint32_t flags = 0;
+        if (evs[i].data.ptr == loop) { woken = 1; continue; }
+        ws_loop_tag_t* tag = (ws_loop_tag_t*)evs[i].data.ptr;
+        ws_loop_entry_t* e = tag->entry;
+        uint32_t ev = evs[i].events;
+        /* MSG_ZEROCOPY completions raise EPOLLERR on a healthy socket: reap them there */
+        if ((ev & EPOLLERR) && !(ev & EPOLLHUP) && e->conn && ws_conn_on_errqueue(e->conn)) {
+            ev &= ~(uint32_t)EPOLLERR;
+        }
+        int readable = (ev & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) != 0;
+        int writable = (ev & EPOLLOUT) != 0;
+        if (ev & (EPOLLHUP | EPOLLERR)) flags |= WIBESOCKET_EVENT_ERROR;
+        if (!e->conn) continue;
+        if (tag->kind == WS_TAG_POST) {
+            /* Frames from other threads: splice and flush; connecting ones wait for OPEN */
+            if (!ws_conn_connecting(e->conn) && ws_conn_on_writable(e->conn) < 0) {
+                dispatched += dispatch(e, WIBESOCKET_EVENT_ERROR);
+            }
+            continue;
+        }
+        if (ws_conn_connecting(e->conn)) {
+            uint32_t done = step_connect(e);
+            if (done) dispatched += dispatch(e, done);
+            ws_loop_entry_rearm(e);
+            continue;
+        }
+        if (writable) {
+            if (ws_conn_on_writable(e->conn) < 0) flags |= WIBESOCKET_EVENT_ERROR;
+            flags |= WIBESOCKET_EVENT_WRITABLE;
+        }
+        if (readable) {
+            ws_conn_on_readable(e->conn);
+            flags |= WIBESOCKET_EVENT_READABLE;
+        }
+        if (flags) dispatched += dispatch(e, flags);
+        ws_loop_entry_rearm(e);
+    }
+    if (woken) run_tasks(loop);
+    if (loop->flushes) dispatched += run_flushes(loop);
+    loop->timer_dispatched = 0;
+    ws_timerwheel_advance(&loop->wheel, loop_now_ms());
+    dispatched += loop->timer_dispatched;
+    loop->dispatching = 0;
+    free_dead(loop, 0);
+    return dispatched;
+}
+
+wibesocket_error_t wibesocket_loop_run(wibesocket_loop_t* loop) {
+    if (!loop) return WIBESOCKET_ERROR_INVALID_ARGS;
+    atomic_store(&loop->stopped, 0);
+    while (!atomic_load(&loop->stopped)) {
+        if (wibesocket_loop_run_once(loop, -1) < 0) return WIBESOCKET_ERROR_NETWORK;
+    }
+    return WIBESOCKET_OK;
+}
+
+void wibesocket_loop_stop(wibesocket_loop_t* loop) {
+    if (!loop) return;
+    atomic_store(&loop->stopped, 1);
+    loop_wake(loop);
+}
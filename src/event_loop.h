@@ -0,0 +1,73 @@
+#ifndef WIBESOCKET_SRC_EVENT_LOOP_H
+#define WIBESOCKET_SRC_EVENT_LOOP_H
+
+#include <stdint.h>
+
+#include "wibesocket/event_loop.h"
+
+/* Glue between a connection (wibesocket.c) and the loop it is registered with (event_loop.c).
+ * A registered connection holds a pointer to its entry; the entry lives until the loop has
+ * finished the dispatch round in which it was removed. */
+typedef struct ws_loop_entry ws_loop_entry_t;
+
+/* Connection side, implemented in wibesocket.c */
+/* Returns -1 unless the connection is open or connecting; *out_fd is -1 until it has a socket */
+int  ws_conn_loop_attach(wibesocket_conn_t* conn, ws_loop_entry_t* entry, int* out_fd);
+void ws_conn_loop_detach(wibesocket_conn_t* conn);
+ws_loop_entry_t* ws_conn_loop_entry(const wibesocket_conn_t* conn);
+void ws_conn_on_readable(wibesocket_conn_t* conn);
+int  ws_conn_on_writable(wibesocket_conn_t* conn); /* flushes (and takes posted frames); -1 on socket error */
+int  ws_conn_wants_write(const wibesocket_conn_t* conn);
+/* Coalesced frames reached their deadline: flush them (re-registers if not due yet); -1 on error */
+int  ws_conn_flush_due(wibesocket_conn_t* conn);
+/* EPOLLERR on an open socket: reaps MSG_ZEROCOPY completions; 1 if that was all it meant */
+int  ws_conn_on_errqueue(wibesocket_conn_t* conn);
+int  ws_conn_post_fd(const wibesocket_conn_t* conn); /* raised by wibesocket_post_send */
+int  ws_conn_has_pending(const wibesocket_conn_t* conn); /* more to read (or report) without a new edge */
+int  ws_conn_take_drained(wibesocket_conn_t* conn); /* 1 once after the queue fell to the low mark */
+int  ws_conn_connecting(const wibesocket_conn_t* conn);
+/* Earliest time the connection needs attention without an event (handshake deadline or DNS
+ * re-check, keepalive ping, idle limit, close timeout); 0 = none */
+uint64_t ws_conn_timer_deadline(const wibesocket_conn_t* conn, uint64_t now_ms);
+/* Its timer fired (connecting ones are stepped instead): events to report, 0 for none. May
+ * finish closing a lingering connection, removing its entry. */
+uint32_t ws_conn_on_timer(wibesocket_conn_t* conn, uint64_t now_ms);
+/* wibesocket_close was called while the server's CLOSE was still outstanding: the loop now
+ * owns the connection. linger_step reads towards that CLOSE; finish_close frees it. */
+int  ws_conn_lingering(const wibesocket_conn_t* conn);
+void ws_conn_linger_step(wibesocket_conn_t* conn);
+void ws_conn_finish_close(wibesocket_conn_t* conn);
+/* Owning shard (shards.c), -1 when not sharded; written once before the handoff */
+void ws_conn_set_shard(wibesocket_conn_t* conn, int shard);
+int  ws_conn_shard(const wibesocket_conn_t* conn);
+
+/* Connection pools (pool.c): per-URI state, including the cached address lookup */
+typedef struct ws_pool_host ws_pool_host_t;
+struct addrinfo;
+
+/* Connection side: connects for a pool. With addrs it connects to a copy of them and looks
+ * nothing up; otherwise the lookup's result goes to ws_pool_host_resolved. start is
+ * asynchronous like wibesocket_connect_start; connect blocks like wibesocket_connect, for at
+ * most timeout_ms when that is positive. */
+wibesocket_conn_t* ws_conn_start_pooled(const char* uri, const wibesocket_config_t* config,
+                                        ws_pool_host_t* host, const struct addrinfo* addrs);
+wibesocket_conn_t* ws_conn_connect_pooled(const char* uri, const wibesocket_config_t* config,
+                                          ws_pool_host_t* host, const struct addrinfo* addrs, int timeout_ms);
+
+/* Pool side */
+void ws_pool_host_resolved(ws_pool_host_t* host, const struct addrinfo* addrs);
+/* Deep copy of an addrinfo list in one malloc block (free() releases it); NULL on ENOMEM */
+struct addrinfo* ws_addrinfo_dup(const struct addrinfo* ai);
+
+/* Loop side, implemented in event_loop.c */
+void ws_loop_entry_want_write(ws_loop_entry_t* entry, int want);
+void ws_loop_entry_mark_pending(ws_loop_entry_t* entry);
+/* Call ws_conn_flush_due once the monotonic clock passes due_us; a later call moves it */
+void ws_loop_entry_flush_at(ws_loop_entry_t* entry, uint64_t due_us);
+void ws_loop_entry_remove(ws_loop_entry_t* entry);
+/* The connection's deadline may have moved earlier: reschedule its timer */
+void ws_loop_entry_rearm(ws_loop_entry_t* entry);
+/* The connection's socket changed during connect: -1 before closing the old one, then the new */
+void ws_loop_entry_set_fd(ws_loop_entry_t* entry, int fd);
+
+#endif /* WIBESOCKET_SRC_EVENT_LOOP_H */
@@ -1,13 +1,12 @@
 #include "handshake.h"
 #include "internal/sha1.h"
 #include "internal/base64.h"
+#include "internal/random.h"
 
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <time.h>
 #include <ctype.h>
-#include <string.h>
 
 void ws_compute_accept(const char* base64_key, char out_accept[29]) {
     /* accept = base64( SHA1( key + GUID ) ) */
@@ -28,134 +27,483 @@ void ws_compute_accept(const char* base64_key, char out_accept[29]) {
 int ws_generate_client_key(char out_key[25]) {
     /* 16 random bytes -> base64 => 24 chars */
     unsigned char rnd[16];
-    /* Prefer getrandom if available; fallback to rand() */
-#if defined(__linux__)
-    #include <sys/random.h>
-    ssize_t r = getrandom(rnd, sizeof(rnd), 0);
-    if (r != (ssize_t)sizeof(rnd)) {
-        srand((unsigned)time(NULL));
-        for (int i = 0; i < 16; i++) rnd[i] = (unsigned char)(rand() & 0xFF);
-    }
-#else
-    srand((unsigned)time(NULL));
-    for (int i = 0; i < 16; i++) rnd[i] = (unsigned char)(rand() & 0xFF);
-#endif
+    ws_random_bytes(rnd, sizeof(rnd));
     (void)ws_base64_encode(rnd, sizeof(rnd), out_key, 1);
     return 0;
 }
 
+/* Bounded appends into a caller buffer; ok drops to 0 once something did not fit */
+typedef struct {
+    char*  p;
+    size_t left;
+    int    ok;
+} ws_out_t;
+
+static void ws_put(ws_out_t* o, const char* s, size_t n) {
+    if (n > o->left) { o->ok = 0; o->left = 0; return; }
+    memcpy(o->p, s, n);
+    o->p += n;
+    o->left -= n;
+}
+
+static void ws_puts(ws_out_t* o, const char* s) { ws_put(o, s, strlen(s)); }
+
+static void ws_put_uint(ws_out_t* o, unsigned v) {
+    char tmp[10];
+    size_t i = sizeof(tmp);
+    do { tmp[--i] = (char)('0' + v % 10); v /= 10; } while (v && i > 0);
+    ws_put(o, tmp + i, sizeof(tmp) - i);
+}
+
+static void ws_put_header(ws_out_t* o, const char* name, const char* value) {
+    if (!value || !*value) return;
+    ws_puts(o, name);
+    ws_puts(o, value);
+    ws_put(o, "\r\n", 2);
+}
+
+/* The request with key (key_len bytes) in its slot, NUL-terminated like snprintf would */
+static int ws_build_request(const char* host, int port, const char* path,
+                            const char* key, size_t key_len,
+                            const char* user_agent, const char* origin,
+                            const char* protocol, const char* extensions,
+                            char* out, size_t out_cap, size_t* key_off) {
+    if (!host || !path || !key || !out || port < 0) return -1;
+    ws_out_t o = { out, out_cap, 1 };
+    ws_puts(&o, "GET ");
+    ws_puts(&o, path);
+    ws_puts(&o, " HTTP/1.1\r\nHost: ");
+    ws_puts(&o, host);
+    ws_put(&o, ":", 1);
+    ws_put_uint(&o, (unsigned)port);
+    ws_puts(&o, "\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Key: ");
+    if (key_off) *key_off = (size_t)(o.p - out);
+    ws_put(&o, key, key_len);
+    ws_puts(&o, "\r\nSec-WebSocket-Version: 13\r\n");
+    ws_put_header(&o, "User-Agent: ", user_agent);
+    ws_put_header(&o, "Origin: ", origin);
+    ws_put_header(&o, "Sec-WebSocket-Protocol: ", protocol);
+    ws_put_header(&o, "Sec-WebSocket-Extensions: ", extensions);
+    ws_put(&o, "\r\n", 2);
+    if (!o.ok || o.left == 0) return -1;
+    *o.p = 0;
+    return (int)(o.p - out);
+}
+
 int ws_build_handshake_request(const char* host, int port, const char* path,
                                const char* sec_websocket_key,
                                const char* user_agent,
                                const char* origin,
                                const char* protocol,
+                               const char* extensions,
                                char* out, size_t out_cap) {
-    if (!host || !path || !sec_websocket_key || !out) return -1;
-    int n = snprintf(out, out_cap,
-        "GET %s HTTP/1.1\r\n"
-        "Host: %s:%d\r\n"
-        "Upgrade: websocket\r\n"
-        "Connection: Upgrade\r\n"
-        "Sec-WebSocket-Key: %s\r\n"
-        "Sec-WebSocket-Version: 13\r\n",
-        path, host, port, sec_websocket_key);
+    if (!sec_websocket_key) return -1;
+    return ws_build_request(host, port, path, sec_websocket_key, strlen(sec_websocket_key),
+                            user_agent, origin, protocol, extensions, out, out_cap, NULL);
+}
+
+int ws_build_handshake_template(const char* host, int port, const char* path,
+                                const char* user_agent, const char* origin,
+                                const char* protocol, const char* extensions,
+                                char* out, size_t out_cap, size_t* key_off) {
+    static const char blank[24] = "                        ";
+    if (!key_off) return -1;
+    return ws_build_request(host, port, path, blank, sizeof(blank), user_agent, origin, protocol,
+                            extensions, out, out_cap, key_off);
+}
+
+void ws_handshake_set_key(char* request, size_t key_off, const char key[25]) {
+    memcpy(request + key_off, key, 24);
+}
+
+static void ws_trim_lws(const char** start, const char** end) {
+    const char* s = *start;
+    const char* e = *end;
+    while (s < e && (*s == ' ' || *s == '\t')) s++;
+    while (e > s && (e[-1] == ' ' || e[-1] == '\t' || e[-1] == '\r')) e--;
+    *start = s; *end = e;
+}
+
+static char ws_lower(char ch) {
+    return (ch >= 'A' && ch <= 'Z') ? (char)(ch - 'A' + 'a') : ch;
+}
+
+/* token (n bytes) is one of the entries of a comma-separated list (ci: ignoring ASCII case) */
+static int ws_list_has(const char* list, const char* token, size_t n, int ci) {
+    if (!list || !token) return 0;
+    while (*list) {
+        const char* s = list;
+        const char* e = strchr(s, ',');
+        if (!e) e = s + strlen(s);
+        list = *e ? e + 1 : e;
+        ws_trim_lws(&s, &e);
+        if ((size_t)(e - s) != n) continue;
+        size_t i = 0;
+        while (i < n && (ci ? ws_lower(s[i]) == ws_lower(token[i]) : s[i] == token[i])) i++;
+        if (i == n) return 1;
+    }
+    return 0;
+}
+
+enum {
+    WS_HTTP_ST_STATUS = 0, /* status line */
+    WS_HTTP_ST_LINE,       /* start of a header line, or of the blank line */
+    WS_HTTP_ST_NAME,
+    WS_HTTP_ST_LWS,        /* whitespace before a value */
+    WS_HTTP_ST_VALUE,
+    WS_HTTP_ST_END,        /* CR of the blank line seen */
+    WS_HTTP_ST_DONE,
+    WS_HTTP_ST_ERROR
+};
+
+/* Lowercase names of the headers captured, indexed by WS_HTTP_* */
+static const char* const ws_http_names[WS_HTTP_NHEADERS] = {
+    "upgrade", "connection", "sec-websocket-accept", "sec-websocket-protocol", "sec-websocket-extensions",
+    "sec-websocket-key", "sec-websocket-version",
+};
+
+void ws_http_response_init(ws_http_response_t* r) {
+    memset(r, 0, sizeof(*r));
+    r->state = WS_HTTP_ST_STATUS;
+}
+
+void ws_http_request_init(ws_http_response_t* r) {
+    ws_http_response_init(r);
+    r->request = 1;
+}
+
+static uint8_t ws_http_lookup(const ws_http_response_t* r) {
+    if (r->name_len > WS_HTTP_NAME_MAX) return WS_HTTP_NHEADERS;
+    for (uint8_t h = 0; h < WS_HTTP_NHEADERS; h++) {
+        if (strlen(ws_http_names[h]) == r->name_len && memcmp(ws_http_names[h], r->name, r->name_len) == 0) return h;
+    }
+    return WS_HTTP_NHEADERS;
+}
+
+/* A header name ended at ':'. All but Upgrade and Connection may come once. */
+static int ws_http_begin_value(ws_http_response_t* r) {
+    r->header = ws_http_lookup(r);
+    if (r->header == WS_HTTP_NHEADERS) return 0;
+    if (r->header >= WS_HTTP_ACCEPT && (r->seen & (1u << r->header))) return -1;
+    r->seen |= (uint16_t)(1u << r->header);
+    r->value_start = r->values_len;
+    return 0;
+}
+
+/* The value's line ended: trim it, then check (Upgrade, Connection) or keep it */
+static int ws_http_end_value(ws_http_response_t* r) {
+    if (r->header == WS_HTTP_NHEADERS) return 0;
+    while (r->values_len > r->value_start) {
+        char ch = r->values[r->values_len - 1];
+        if (ch != ' ' && ch != '\t' && ch != '\r') break;
+        r->values_len--;
+    }
+    if (r->values_len >= WS_HTTP_VALUES) return -1;
+    r->values[r->values_len++] = 0;
+    const char* v = r->values + r->value_start;
+    if (r->header == WS_HTTP_UPGRADE || r->header == WS_HTTP_CONNECTION) {
+        if (r->header == WS_HTTP_UPGRADE) r->upgrade_ok |= (uint8_t)ws_list_has(v, "websocket", 9, 1);
+        else r->connection_ok |= (uint8_t)ws_list_has(v, "upgrade", 7, 1);
+        r->values_len = r->value_start;
+        return 0;
+    }
+    r->value_off[r->header] = r->value_start;
+    return 0;
+}
+
+/* One byte of "GET <target> HTTP/1.1": the method is matched as it comes, the last bytes are
+ * kept in name (unused until the headers) to match the version against at the newline */
+static int ws_http_request_line(ws_http_response_t* r, char ch) {
+    static const char method[] = "GET ";
+    static const char version[] = " HTTP/1.1";
+    if (ch == '\n') return r->pos >= 14 && memcmp(r->name, version, 9) == 0 ? 1 : -1;
+    if (r->pos < 4 && ch != method[r->pos]) return -1;
+    r->pos++;
+    if (ch != '\r') {
+        memmove(r->name, r->name + 1, 8);
+        r->name[8] = ch;
+    }
+    return 0;
+}
+
+ws_http_status_t ws_http_response_feed(ws_http_response_t* r, const char* data, size_t len, size_t* used) {
+    static const char version[] = "HTTP/1.1 ";
+    ws_http_status_t st = r->state == WS_HTTP_ST_ERROR ? WS_HTTP_ERROR
+                        : r->state == WS_HTTP_ST_DONE ? WS_HTTP_DONE : WS_HTTP_NEED_MORE;
+    size_t i = 0;
+    for (; i < len && st == WS_HTTP_NEED_MORE; i++) {
+        char ch = data[i];
+        if (++r->total > WS_HTTP_MAX_HEADER) { st = WS_HTTP_ERROR; break; }
+        switch (r->state) {
+        case WS_HTTP_ST_STATUS:
+            if (r->request) {
+                int line = ws_http_request_line(r, ch);
+                if (line < 0) st = WS_HTTP_ERROR;
+                else if (line > 0) r->state = WS_HTTP_ST_LINE;
+                break;
+            }
+            if (ch == '\n') {
+                if (r->pos < 12) st = WS_HTTP_ERROR;
+                r->state = WS_HTTP_ST_LINE;
+                break;
+            }
+            if (r->pos < 9) {
+                if (ch != version[r->pos]) st = WS_HTTP_ERROR;
+            } else if (r->pos < 12) {
+                if (ch < '0' || ch > '9') st = WS_HTTP_ERROR;
+                r->status = (uint16_t)(r->status * 10 + (ch - '0'));
+            }
+            if (r->pos < 12) r->pos++;
+            break;
+        case WS_HTTP_ST_LINE:
+            if (ch == '\r') { r->state = WS_HTTP_ST_END; break; }
+            if (ch == '\n') { st = WS_HTTP_DONE; break; }
+            /* Folded continuation lines are obsolete; an empty name is malformed */
+            if (ch == ' ' || ch == '\t' || ch == ':') { st = WS_HTTP_ERROR; break; }
+            r->name_len = 0;
+            r->state = WS_HTTP_ST_NAME;
+            /* fall through */
+        case WS_HTTP_ST_NAME:
+            if (ch == ':') {
+                if (ws_http_begin_value(r) < 0) st = WS_HTTP_ERROR;
+                r->state = WS_HTTP_ST_LWS;
+                break;
+            }
+            if (ch == '\n') { st = WS_HTTP_ERROR; break; }
+            if (r->name_len < WS_HTTP_NAME_MAX) r->name[r->name_len] = ws_lower(ch);
+            if (r->name_len <= WS_HTTP_NAME_MAX) r->name_len++;
+            break;
+        case WS_HTTP_ST_LWS:
+            if (ch == ' ' || ch == '\t') break;
+            r->state = WS_HTTP_ST_VALUE;
+            /* fall through */
+        case WS_HTTP_ST_VALUE:
+            if (ch == '\n') {
+                if (ws_http_end_value(r) < 0) st = WS_HTTP_ERROR;
+                r->state = WS_HTTP_ST_LINE;
+                break;
+            }
+            if (r->header != WS_HTTP_NHEADERS) {
+                if (r->values_len + 1 >= WS_HTTP_VALUES) { st = WS_HTTP_ERROR; break; }
+                r->values[r->values_len++] = ch;
+            }
+            break;
+        case WS_HTTP_ST_END:
+            st = ch == '\n' ? WS_HTTP_DONE : WS_HTTP_ERROR;
+            break;
+        default:
+            st = WS_HTTP_ERROR;
+            break;
+        }
+    }
+    if (st == WS_HTTP_DONE) r->state = WS_HTTP_ST_DONE;
+    else if (st == WS_HTTP_ERROR) r->state = WS_HTTP_ST_ERROR;
+    *used = i;
+    return st;
+}
+
+const char* ws_http_response_value(const ws_http_response_t* r, int header) {
+    if (header < WS_HTTP_ACCEPT || header >= WS_HTTP_NHEADERS || !(r->seen & (1u << header))) return NULL;
+    return r->values + r->value_off[header];
+}
+
+int ws_http_response_check(const ws_http_response_t* r, const char* expected_accept, const char* protocol) {
+    if (r->state != WS_HTTP_ST_DONE) return -1;
+    if (r->status != 101) return -2;
+    if (!r->upgrade_ok || !r->connection_ok) return -3;
+    const char* accept = ws_http_response_value(r, WS_HTTP_ACCEPT);
+    if (!accept || !expected_accept || strcmp(accept, expected_accept) != 0) return -4;
+    /* Subprotocol names are case-sensitive */
+    const char* chosen = ws_http_response_value(r, WS_HTTP_PROTOCOL);
+    if (chosen && !ws_list_has(protocol, chosen, strlen(chosen), 0)) return -5;
+    return 0;
+}
+
+int ws_http_request_check(const ws_http_response_t* r, char accept_out[29]) {
+    if (r->state != WS_HTTP_ST_DONE || !r->request) return -1;
+    if (!r->upgrade_ok || !r->connection_ok) return -3;
+    const char* version = ws_http_response_value(r, WS_HTTP_VERSION);
+    if (!version || strcmp(version, "13") != 0) return -2;
+    const char* key = ws_http_response_value(r, WS_HTTP_KEY);
+    if (!key || strlen(key) != 24) return -4;
+    ws_compute_accept(key, accept_out);
+    return 0;
+}
+
+const char* ws_select_protocol(const char* offered, const char* supported, size_t* len) {
+    if (!offered || !supported) return NULL;
+    while (*offered) {
+        const char* s = offered;
+        const char* e = strchr(s, ',');
+        if (!e) e = s + strlen(s);
+        offered = *e ? e + 1 : e;
+        ws_trim_lws(&s, &e);
+        if (e > s && ws_list_has(supported, s, (size_t)(e - s), 0)) {
+            *len = (size_t)(e - s);
+            return s;
+        }
+    }
+    return NULL;
+}
+
+int ws_build_handshake_reply(const char* accept, const char* protocol, size_t protocol_len,
+                             char* out, size_t out_cap) {
+    if (!accept || !out) return -1;
+    ws_out_t o = { out, out_cap, 1 };
+    ws_puts(&o, "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                "Sec-WebSocket-Accept: ");
+    ws_puts(&o, accept);
+    if (protocol && protocol_len > 0) {
+        ws_puts(&o, "\r\nSec-WebSocket-Protocol: ");
+        ws_put(&o, protocol, protocol_len);
+    }
+    ws_put(&o, "\r\n\r\n", 4);
+    if (!o.ok || o.left == 0) return -1;
+    *o.p = 0;
+    return (int)(o.p - out);
+}
+
+/* A whole response held in one string */
+static int ws_http_parse_all(ws_http_response_t* r, const char* response) {
+    size_t used = 0;
+    ws_http_response_init(r);
+    return ws_http_response_feed(r, response, strlen(response), &used) == WS_HTTP_DONE ? 0 : -1;
+}
+
+int ws_validate_handshake_response(const char* response, const char* expected_accept) {
+    if (!response || !expected_accept) return -1;
+    ws_http_response_t r;
+    if (ws_http_parse_all(&r, response) != 0) return -1;
+    return ws_http_response_check(&r, expected_accept, NULL);
+}
+
+int ws_format_deflate_offer(const ws_deflate_params_t* offer, char* out, size_t out_cap) {
+    if (!offer || !out) return -1;
+    /* A bare client_max_window_bits tells the server it may shrink our window */
+    int n;
+    if (offer->client_max_window_bits > 0 && offer->client_max_window_bits < 15) {
+        n = snprintf(out, out_cap, "permessage-deflate; client_max_window_bits=%d",
+                     offer->client_max_window_bits);
+    } else {
+        n = snprintf(out, out_cap, "permessage-deflate; client_max_window_bits");
+    }
     if (n < 0 || (size_t)n >= out_cap) return -1;
     size_t off = (size_t)n;
-
-    if (user_agent && *user_agent) {
-        n = snprintf(out + off, out_cap - off, "User-Agent: %s\r\n", user_agent);
+    if (offer->server_max_window_bits > 0 && offer->server_max_window_bits < 15) {
+        n = snprintf(out + off, out_cap - off, "; server_max_window_bits=%d", offer->server_max_window_bits);
         if (n < 0 || (size_t)n >= out_cap - off) return -1;
         off += (size_t)n;
     }
-    if (origin && *origin) {
-        n = snprintf(out + off, out_cap - off, "Origin: %s\r\n", origin);
+    if (offer->client_no_context_takeover) {
+        n = snprintf(out + off, out_cap - off, "; client_no_context_takeover");
         if (n < 0 || (size_t)n >= out_cap - off) return -1;
         off += (size_t)n;
     }
-    if (protocol && *protocol) {
-        n = snprintf(out + off, out_cap - off, "Sec-WebSocket-Protocol: %s\r\n", protocol);
+    if (offer->server_no_context_takeover) {
+        n = snprintf(out + off, out_cap - off, "; server_no_context_takeover");
         if (n < 0 || (size_t)n >= out_cap - off) return -1;
         off += (size_t)n;
     }
-    if (off + 2 >= out_cap) return -1;
-    memcpy(out + off, "\r\n", 2);
-    off += 2;
     return (int)off;
 }
 
-static const char* ws_find_header_ci(const char* resp, const char* header_name) {
-    size_t nlen = strlen(header_name);
-    const char* p = resp;
-    while ((p = strstr(p, header_name)) != NULL) {
-        /* Ensure it starts at line start (or after \n) and is followed by ':' */
-        const char* line_start = p;
-        if (line_start != resp && *(line_start - 1) != '\n') { p++; continue; }
-        const char* colon = p + nlen;
-        if (*colon != ':') { p++; continue; }
-        return colon + 1; /* return after ':' */
+/* Case-insensitive match of the token [s, e) against lit */
+static int ws_token_is(const char* s, const char* e, const char* lit) {
+    size_t n = strlen(lit);
+    if ((size_t)(e - s) != n) return 0;
+    for (size_t i = 0; i < n; i++) {
+        if (tolower((unsigned char)s[i]) != lit[i]) return 0;
     }
-    return NULL;
+    return 1;
 }
 
-static void ws_trim_lws(const char** start, const char** end) {
-    const char* s = *start;
-    const char* e = *end;
-    while (s < e && (*s == ' ' || *s == '\t')) s++;
-    while (e > s && (e[-1] == ' ' || e[-1] == '\t' || e[-1] == '\r')) e--;
-    *start = s; *end = e;
+/* Window bits parameter value: 8..15, optionally quoted */
+static int ws_parse_window_bits(const char* s, const char* e) {
+    if (e - s >= 2 && *s == '"' && e[-1] == '"') { s++; e--; }
+    if (e - s < 1 || e - s > 2) return -1;
+    int v = 0;
+    for (; s < e; s++) {
+        if (*s < '0' || *s > '9') return -1;
+        v = v * 10 + (*s - '0');
+    }
+    return (v >= 8 && v <= 15) ? v : -1;
 }
 
-int ws_validate_handshake_response(const char* response, const char* expected_accept) {
-    if (!response || !expected_accept) return -1;
-    /* Check status line: HTTP/1.1 101 Switching Protocols */
-    const char* status = strstr(response, "HTTP/1.1 101");
-    if (!status || (status != response && *(status - 1) != '\n')) return -1;
-
-    /* Required headers: Upgrade: websocket, Connection: Upgrade, Sec-WebSocket-Accept: <val> */
-    const char* upv = ws_find_header_ci(response, "Upgrade");
-    const char* cov = ws_find_header_ci(response, "Connection");
-    const char* acv = ws_find_header_ci(response, "Sec-WebSocket-Accept");
-    if (!upv || !cov || !acv) return -1;
-
-    /* Extract header values until end-of-line */
-    const char* up_end = strchr(upv, '\n'); if (!up_end) return -1;
-    const char* co_end = strchr(cov, '\n'); if (!co_end) return -1;
-    const char* ac_end = strchr(acv, '\n'); if (!ac_end) return -1;
-
-    ws_trim_lws(&upv, &up_end);
-    ws_trim_lws(&cov, &co_end);
-    ws_trim_lws(&acv, &ac_end);
-
-    /* Case-insensitive contains checks for Upgrade/Connection */
-    /* Portable case-insensitive substring search */
-    auto const char* ws_strcasestr(const char* haystack, const char* needle) {
-        if (!*needle) return haystack;
-        size_t nlen = strlen(needle);
-        for (const char* p = haystack; *p; p++) {
-            size_t i = 0;
-            while (i < nlen) {
-                char a = p[i];
-                char b = needle[i];
-                if (a >= 'A' && a <= 'Z') a = (char)(a - 'A' + 'a');
-                if (b >= 'A' && b <= 'Z') b = (char)(b - 'A' + 'a');
-                if (a != b) break;
-                i++;
-            }
-            if (i == nlen) return p;
-        }
-        return NULL;
-    }
+int ws_negotiate_deflate(const char* response, const ws_deflate_params_t* offer,
+                         ws_deflate_params_t* agreed) {
+    if (!response || !agreed) return -1;
+    memset(agreed, 0, sizeof(*agreed));
+    ws_http_response_t r;
+    if (ws_http_parse_all(&r, response) != 0) return -1;
+    return ws_negotiate_deflate_value(ws_http_response_value(&r, WS_HTTP_EXTENSIONS), offer, agreed);
+}
 
-    const char* up_ws = ws_strcasestr(upv, "websocket");
-    const char* co_up = ws_strcasestr(cov, "upgrade");
-    if (!up_ws || !co_up) return -1;
+int ws_negotiate_deflate_value(const char* extensions, const ws_deflate_params_t* offer,
+                               ws_deflate_params_t* agreed) {
+    if (!agreed) return -1;
+    memset(agreed, 0, sizeof(*agreed));
+    if (!extensions) return 0;
+    if (!offer || !offer->enabled) return -1;
+    const char* v = extensions;
+    const char* end = v + strlen(v);
+    ws_trim_lws(&v, &end);
 
-    /* Accept must match exactly */
-    size_t ac_len = (size_t)(ac_end - acv);
-    if (strlen(expected_accept) != ac_len) return -1;
-    if (strncmp(acv, expected_accept, ac_len) != 0) return -1;
+    /* Exactly one extension (the one offered), then ;-separated parameters */
+    const char* p = v;
+    const char* tok = memchr(p, ';', (size_t)(end - p));
+    if (memchr(p, ',', (size_t)(end - p))) return -1;
+    const char* name_end = tok ? tok : end;
+    const char* ns = p;
+    ws_trim_lws(&ns, &name_end);
+    if (!ws_token_is(ns, name_end, "permessage-deflate")) return -1;
 
+    agreed->enabled = 1;
+    agreed->client_max_window_bits = 15;
+    agreed->server_max_window_bits = 15;
+    int seen = 0;
+    while (tok) {
+        p = tok + 1;
+        tok = memchr(p, ';', (size_t)(end - p));
+        const char* pe = tok ? tok : end;
+        const char* eq = memchr(p, '=', (size_t)(pe - p));
+        const char* ks = p;
+        const char* ke = eq ? eq : pe;
+        ws_trim_lws(&ks, &ke);
+        const char* vs = eq ? eq + 1 : pe;
+        const char* ve = pe;
+        ws_trim_lws(&vs, &ve);
+        int bit;
+        if (ws_token_is(ks, ke, "server_no_context_takeover")) {
+            if (eq) return -1;
+            bit = 1;
+            agreed->server_no_context_takeover = 1;
+        } else if (ws_token_is(ks, ke, "client_no_context_takeover")) {
+            if (eq) return -1;
+            bit = 2;
+            agreed->client_no_context_takeover = 1;
+        } else if (ws_token_is(ks, ke, "server_max_window_bits")) {
+            int w = eq ? ws_parse_window_bits(vs, ve) : -1;
+            if (w < 0) return -1;
+            if (offer->server_max_window_bits > 0 && w > offer->server_max_window_bits) return -1;
+            bit = 4;
+            agreed->server_max_window_bits = w;
+        } else if (ws_token_is(ks, ke, "client_max_window_bits")) {
+            /* zlib cannot honour 8 (see deflate.c): fail rather than send what the server can't read */
+            int w = eq ? ws_parse_window_bits(vs, ve) : -1;
+            if (w < 9) return -1;
+            bit = 8;
+            agreed->client_max_window_bits = w;
+        } else {
+            return -1;
+        }
+        if (seen & bit) return -1; /* each parameter at most once */
+        seen |= bit;
+    }
+    /* Our own side of the offer holds whatever the server said: a smaller window or dropping
+     * our context is always readable by the server */
+    if (offer->client_no_context_takeover) agreed->client_no_context_takeover = 1;
+    if (offer->client_max_window_bits > 0 && offer->client_max_window_bits < agreed->client_max_window_bits) {
+        agreed->client_max_window_bits = offer->client_max_window_bits;
+    }
     return 0;
 }
-
-
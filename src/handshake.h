@@ -4,6 +4,8 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "internal/deflate.h"
+
 /* RFC 6455 GUID */
 #define WS_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
 
@@ -15,16 +17,109 @@ void ws_compute_accept(const char* base64_key, char out_accept[29]);
  * out_key must have space for 24+1 bytes (Base64 of 16 bytes). Returns 0 on success. */
 int ws_generate_client_key(char out_key[25]);
 
-/* Build a minimal HTTP/1.1 WebSocket Upgrade request into out (size out_cap).
+/* Build a minimal HTTP/1.1 WebSocket Upgrade request into out (size out_cap). extensions,
+ * if non-empty, is sent as the Sec-WebSocket-Extensions value.
  * Returns length written on success or -1 if insufficient capacity. */
 int ws_build_handshake_request(const char* host, int port, const char* path,
                                const char* sec_websocket_key,
                                const char* user_agent,
                                const char* origin,
                                const char* protocol,
+                               const char* extensions,
                                char* out, size_t out_cap);
 
-/* Validate a server handshake HTTP response against expected accept value.
+/* The same request with the 24-character Sec-WebSocket-Key left blank at *key_off: built once
+ * per endpoint, each connection copies it and drops its own key in with ws_handshake_set_key.
+ * Plain copies, no formatting. Returns the length or -1 if insufficient capacity. */
+int ws_build_handshake_template(const char* host, int port, const char* path,
+                                const char* user_agent, const char* origin,
+                                const char* protocol, const char* extensions,
+                                char* out, size_t out_cap, size_t* key_off);
+void ws_handshake_set_key(char* request, size_t key_off, const char key[25]);
+
+/* Incremental parser for the server's handshake response. Feed it bytes as they arrive; each
+ * byte is looked at once. The status code and the headers the client checks are captured on
+ * the way (values trimmed, NUL-terminated), so nothing is rescanned once the blank line is in.
+ * Initialised with ws_http_request_init, the same parser reads a client's upgrade request. */
+enum {
+    WS_HTTP_UPGRADE = 0,
+    WS_HTTP_CONNECTION,
+    WS_HTTP_ACCEPT,
+    WS_HTTP_PROTOCOL,
+    WS_HTTP_EXTENSIONS,
+    WS_HTTP_KEY,
+    WS_HTTP_VERSION,
+    WS_HTTP_NHEADERS
+};
+
+typedef enum {
+    WS_HTTP_ERROR = -1,     /* malformed, or over WS_HTTP_MAX_HEADER / a value over its room */
+    WS_HTTP_NEED_MORE = 0,
+    WS_HTTP_DONE = 1        /* the blank line ending the headers was consumed */
+} ws_http_status_t;
+
+#define WS_HTTP_MAX_HEADER 16384
+#define WS_HTTP_NAME_MAX 24   /* longest header name of interest */
+#define WS_HTTP_VALUES 512    /* room for the captured values */
+
+typedef struct {
+    uint8_t  state;
+    uint8_t  request;         /* reading a request line rather than a status line */
+    uint8_t  header;          /* header whose value is being read, WS_HTTP_NHEADERS = other */
+    uint8_t  name_len;
+    uint8_t  upgrade_ok;      /* an Upgrade value names websocket */
+    uint8_t  connection_ok;   /* a Connection value lists upgrade */
+    uint16_t status;
+    uint16_t seen;            /* bit per WS_HTTP_* header present */
+    uint16_t pos;             /* bytes into the status or request line */
+    size_t   total;
+    uint16_t value_start;     /* of the value being read, in values */
+    uint16_t values_len;
+    uint16_t value_off[WS_HTTP_NHEADERS];
+    char     name[WS_HTTP_NAME_MAX]; /* also the request line's last bytes */
+    char     values[WS_HTTP_VALUES];
+} ws_http_response_t;
+
+void ws_http_response_init(ws_http_response_t* r);
+/* Consumes up to len bytes; *used is how many (through the blank line once DONE). */
+ws_http_status_t ws_http_response_feed(ws_http_response_t* r, const char* data, size_t len, size_t* used);
+/* A captured header value, NULL if the header was absent */
+const char* ws_http_response_value(const ws_http_response_t* r, int header);
+/* After DONE: 0 for a 101 with the upgrade headers and the expected accept value. A
+ * Sec-WebSocket-Protocol must be one of the comma-separated requested ones (protocol NULL or
+ * empty: none may come back). Negative on failure. */
+int ws_http_response_check(const ws_http_response_t* r, const char* expected_accept, const char* protocol);
+
+/* Server side: expect "GET <target> HTTP/1.1" first */
+void ws_http_request_init(ws_http_response_t* r);
+/* After DONE: 0 for an upgrade request with a 24-character key and version 13, with
+ * accept_out set to its Sec-WebSocket-Accept value. Negative on failure. */
+int ws_http_request_check(const ws_http_response_t* r, char accept_out[29]);
+/* The first protocol the client offered (comma-separated) that supported also lists, as a
+ * pointer into offered and its length; NULL if none or either is NULL */
+const char* ws_select_protocol(const char* offered, const char* supported, size_t* len);
+/* The 101 reply, with a Sec-WebSocket-Protocol when protocol_len > 0. NUL-terminated.
+ * Returns the length or -1 if insufficient capacity. */
+int ws_build_handshake_reply(const char* accept, const char* protocol, size_t protocol_len,
+                             char* out, size_t out_cap);
+/* Sent, best effort, to a request that is not a usable upgrade */
+#define WS_HANDSHAKE_REJECT \
+    "HTTP/1.1 400 Bad Request\r\nSec-WebSocket-Version: 13\r\nContent-Length: 0\r\nConnection: close\r\n\r\n"
+
+/* Format a permessage-deflate offer as a Sec-WebSocket-Extensions value.
+ * Returns length written or -1 if insufficient capacity. */
+int ws_format_deflate_offer(const ws_deflate_params_t* offer, char* out, size_t out_cap);
+
+/* Read the server's Sec-WebSocket-Extensions value (NULL: header absent) against what was
+ * offered (offer NULL or disabled: nothing was). Fills agreed (enabled 0 when the server
+ * declined) and returns 0, or -1 if it accepts an extension or parameter that was not offered. */
+int ws_negotiate_deflate_value(const char* extensions, const ws_deflate_params_t* offer,
+                               ws_deflate_params_t* agreed);
+/* The same, reading the header out of a whole response */
+int ws_negotiate_deflate(const char* response, const ws_deflate_params_t* offer,
+                         ws_deflate_params_t* agreed);
+
+/* Validate a whole server handshake HTTP response against expected accept value.
  * Returns 0 on success, negative on failure. */
 int ws_validate_handshake_response(const char* response, const char* expected_accept);
 
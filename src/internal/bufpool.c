@@ -0,0 +1,92 @@
+#include "bufpool.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define WS_BUFPOOL_MIN_SHIFT 12  /* 4 KiB */
+#define WS_BUFPOOL_MAX_SHIFT 30  /* 1 GiB; larger requests bypass the pool */
+#define WS_BUFPOOL_CLASSES   (WS_BUFPOOL_MAX_SHIFT - WS_BUFPOOL_MIN_SHIFT + 1)
+#define WS_BUFPOOL_KEEP      4   /* free buffers retained per class */
+#define WS_BUFPOOL_TLS_SHIFT 22  /* classes up to 4 MiB also get a per-thread slot */
+#define WS_BUFPOOL_TLS_CLASSES (WS_BUFPOOL_TLS_SHIFT - WS_BUFPOOL_MIN_SHIFT + 1)
+
+static struct {
+    pthread_mutex_t lock;
+    void*           free_list[WS_BUFPOOL_CLASSES][WS_BUFPOOL_KEEP];
+    int             nfree[WS_BUFPOOL_CLASSES];
+} g_pool = { PTHREAD_MUTEX_INITIALIZER, {{0}}, {0} };
+
+/* One buffer per small class cached per thread: a connection that keeps reusing the same
+ * size (the common case on a shard worker) never touches the shared lock */
+static _Thread_local void* t_cache[WS_BUFPOOL_TLS_CLASSES];
+static pthread_key_t  g_tls_key;
+static pthread_once_t g_tls_once = PTHREAD_ONCE_INIT;
+static int            g_tls_ok;
+
+static int size_class(size_t size) {
+    int shift = WS_BUFPOOL_MIN_SHIFT;
+    while (shift <= WS_BUFPOOL_MAX_SHIFT && ((size_t)1 << shift) < size) shift++;
+    return (shift <= WS_BUFPOOL_MAX_SHIFT) ? shift - WS_BUFPOOL_MIN_SHIFT : -1;
+}
+
+static void put_shared(void* buf, int cls) {
+    pthread_mutex_lock(&g_pool.lock);
+    if (g_pool.nfree[cls] < WS_BUFPOOL_KEEP) {
+        g_pool.free_list[cls][g_pool.nfree[cls]++] = buf;
+        buf = NULL;
+    }
+    pthread_mutex_unlock(&g_pool.lock);
+    free(buf);
+}
+
+static void tls_destructor(void* unused) {
+    (void)unused;
+    ws_bufpool_thread_flush();
+}
+
+static void tls_init(void) {
+    g_tls_ok = pthread_key_create(&g_tls_key, tls_destructor) == 0;
+}
+
+void* ws_bufpool_get(size_t size, size_t* out_cap) {
+    int cls = size_class(size);
+    if (cls < 0) { *out_cap = size; return malloc(size); }
+    size_t cap = (size_t)1 << (cls + WS_BUFPOOL_MIN_SHIFT);
+    void* buf = NULL;
+    if (cls < WS_BUFPOOL_TLS_CLASSES && t_cache[cls]) {
+        buf = t_cache[cls];
+        t_cache[cls] = NULL;
+    } else {
+        pthread_mutex_lock(&g_pool.lock);
+        if (g_pool.nfree[cls] > 0) buf = g_pool.free_list[cls][--g_pool.nfree[cls]];
+        pthread_mutex_unlock(&g_pool.lock);
+        if (!buf) buf = malloc(cap);
+    }
+    *out_cap = buf ? cap : 0;
+    return buf;
+}
+
+void ws_bufpool_put(void* buf, size_t cap) {
+    if (!buf) return;
+    int cls = size_class(cap);
+    if (cls < 0 || ((size_t)1 << (cls + WS_BUFPOOL_MIN_SHIFT)) != cap) { free(buf); return; }
+    if (cls < WS_BUFPOOL_TLS_CLASSES && !t_cache[cls]) {
+        pthread_once(&g_tls_once, tls_init);
+        if (g_tls_ok) {
+            /* Any non-NULL value arms the destructor that hands the slots back on exit */
+            (void)pthread_setspecific(g_tls_key, (void*)1);
+            t_cache[cls] = buf;
+            return;
+        }
+    }
+    put_shared(buf, cls);
+}
+
+void ws_bufpool_thread_flush(void) {
+    for (int cls = 0; cls < WS_BUFPOOL_TLS_CLASSES; cls++) {
+        if (!t_cache[cls]) continue;
+        put_shared(t_cache[cls], cls);
+        t_cache[cls] = NULL;
+    }
+}
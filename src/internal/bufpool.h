@@ -0,0 +1,15 @@
+#ifndef WIBESOCKET_INTERNAL_BUFPOOL_H
+#define WIBESOCKET_INTERNAL_BUFPOOL_H
+
+#include <stddef.h>
+
+/* Process-wide pool of large heap buffers in power-of-two size classes. Buffers put back are
+ * kept (a few per class) and handed out again, so big transient buffers are not allocated
+ * per message or kept per connection. Thread-safe; each thread also keeps one buffer per
+ * class up to 4 MiB in front of the shared lists. */
+void* ws_bufpool_get(size_t size, size_t* out_cap);
+void  ws_bufpool_put(void* buf, size_t cap);
+/* Return this thread's cached buffers to the shared lists (also done at thread exit). */
+void  ws_bufpool_thread_flush(void);
+
+#endif /* WIBESOCKET_INTERNAL_BUFPOOL_H */
@@ -0,0 +1,199 @@
+#include "deflate.h"
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#define WS_ZPOOL_KEEP 8 /* idle streams retained per direction */
+#define WS_DEFLATE_MEM_LEVEL 8
+
+/* Initialising a deflate stream allocates and clears its window and hash chains (~256 KiB at
+ * 15 bits); a reset only rewinds them, so streams are recycled across connections and, without
+ * context takeover, across messages. Shared under one lock: taken at most once per message,
+ * which is small next to the compression itself. */
+static struct {
+    pthread_mutex_t lock;
+    z_stream*       def[WS_ZPOOL_KEEP];
+    int             def_bits[WS_ZPOOL_KEEP];
+    int             ndef;
+    z_stream*       inf[WS_ZPOOL_KEEP];
+    int             ninf;
+} g_zpool = { PTHREAD_MUTEX_INITIALIZER, {0}, {0}, 0, {0}, 0 };
+
+static const uint8_t k_flush_tail[4] = { 0x00, 0x00, 0xff, 0xff };
+
+struct ws_deflate {
+    int       def_bits;
+    int       inf_bits;
+    int       def_keep; /* context takeover: def lives as long as the connection */
+    int       inf_keep;
+    z_stream* def;
+    z_stream* inf;      /* held across a fragmented message even without takeover */
+    int       inf_fin;  /* frame being inflated ends its message */
+    int       inf_tail; /* flush tail still to be fed after the payload */
+};
+
+static z_stream* zpool_take_deflate(int bits) {
+    z_stream* s = NULL;
+    pthread_mutex_lock(&g_zpool.lock);
+    for (int i = g_zpool.ndef - 1; i >= 0; i--) {
+        if (g_zpool.def_bits[i] != bits) continue;
+        s = g_zpool.def[i];
+        g_zpool.ndef--;
+        g_zpool.def[i] = g_zpool.def[g_zpool.ndef];
+        g_zpool.def_bits[i] = g_zpool.def_bits[g_zpool.ndef];
+        break;
+    }
+    pthread_mutex_unlock(&g_zpool.lock);
+    if (s) return s;
+    s = (z_stream*)calloc(1, sizeof(*s));
+    if (!s) return NULL;
+    /* Negative window bits: raw deflate, no zlib header or checksum */
+    if (deflateInit2(s, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -bits, WS_DEFLATE_MEM_LEVEL,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+        free(s);
+        return NULL;
+    }
+    return s;
+}
+
+static void zpool_put_deflate(z_stream* s, int bits) {
+    if (!s) return;
+    (void)deflateReset(s);
+    pthread_mutex_lock(&g_zpool.lock);
+    if (g_zpool.ndef < WS_ZPOOL_KEEP) {
+        g_zpool.def[g_zpool.ndef] = s;
+        g_zpool.def_bits[g_zpool.ndef++] = bits;
+        s = NULL;
+    }
+    pthread_mutex_unlock(&g_zpool.lock);
+    if (s) { (void)deflateEnd(s); free(s); }
+}
+
+static z_stream* zpool_take_inflate(int bits) {
+    z_stream* s = NULL;
+    pthread_mutex_lock(&g_zpool.lock);
+    if (g_zpool.ninf > 0) s = g_zpool.inf[--g_zpool.ninf];
+    pthread_mutex_unlock(&g_zpool.lock);
+    /* Any pooled inflater serves: reset2 switches it to this window size */
+    if (s && inflateReset2(s, -bits) == Z_OK) return s;
+    if (s) { (void)inflateEnd(s); free(s); }
+    s = (z_stream*)calloc(1, sizeof(*s));
+    if (!s) return NULL;
+    if (inflateInit2(s, -bits) != Z_OK) { free(s); return NULL; }
+    return s;
+}
+
+static void zpool_put_inflate(z_stream* s) {
+    if (!s) return;
+    pthread_mutex_lock(&g_zpool.lock);
+    if (g_zpool.ninf < WS_ZPOOL_KEEP) {
+        g_zpool.inf[g_zpool.ninf++] = s;
+        s = NULL;
+    }
+    pthread_mutex_unlock(&g_zpool.lock);
+    if (s) { (void)inflateEnd(s); free(s); }
+}
+
+/* zlib cannot produce a 256-byte window (8 becomes 9), and a larger inflate window reads any
+ * smaller stream, so both directions run with at least 9 bits */
+static int clamp_bits(int bits) {
+    if (bits <= 0 || bits > 15) return 15;
+    return bits < 9 ? 9 : bits;
+}
+
+ws_deflate_t* ws_deflate_create(const ws_deflate_params_t* agreed) {
+    ws_deflate_t* d = (ws_deflate_t*)calloc(1, sizeof(*d));
+    if (!d) return NULL;
+    d->def_bits = clamp_bits(agreed->client_max_window_bits);
+    d->inf_bits = clamp_bits(agreed->server_max_window_bits);
+    d->def_keep = !agreed->client_no_context_takeover;
+    d->inf_keep = !agreed->server_no_context_takeover;
+    return d;
+}
+
+void ws_deflate_destroy(ws_deflate_t* d) {
+    if (!d) return;
+    zpool_put_deflate(d->def, d->def_bits);
+    zpool_put_inflate(d->inf); /* reset when taken again */
+    free(d);
+}
+
+int ws_deflate_message(ws_deflate_t* d, const uint8_t* in, size_t len,
+                       uint8_t* out, size_t cap, size_t* out_len) {
+    if (len > UINT_MAX || cap > UINT_MAX) return -1;
+    z_stream* s = d->def;
+    if (!s) {
+        s = zpool_take_deflate(d->def_bits);
+        if (!s) return -1;
+        if (d->def_keep) d->def = s;
+    }
+    s->next_in = (Bytef*)(uintptr_t)in;
+    s->avail_in = (uInt)len;
+    s->next_out = out;
+    s->avail_out = (uInt)cap;
+    /* A sync flush ends the message on a byte boundary with an empty stored block, whose
+     * 00 00 ff ff the receiver puts back (RFC 7692 section 7.2.1) */
+    int rc = deflate(s, Z_SYNC_FLUSH);
+    size_t produced = cap - s->avail_out;
+    int ok = rc == Z_OK && s->avail_in == 0 && s->avail_out > 0 &&
+             produced >= sizeof(k_flush_tail) && produced - sizeof(k_flush_tail) < len &&
+             memcmp(out + produced - sizeof(k_flush_tail), k_flush_tail, sizeof(k_flush_tail)) == 0;
+    if (!d->def_keep) {
+        zpool_put_deflate(s, d->def_bits);
+    } else if (!ok) {
+        /* The peer will not see this message: forget it so later ones don't refer back to it */
+        (void)deflateReset(s);
+    }
+    if (!ok) return -1;
+    *out_len = produced - sizeof(k_flush_tail);
+    return 0;
+}
+
+int ws_inflate_begin(ws_deflate_t* d, const uint8_t* in, size_t len, int fin) {
+    if (len > UINT_MAX) return -1;
+    if (!d->inf) {
+        d->inf = zpool_take_inflate(d->inf_bits);
+        if (!d->inf) return -1;
+    }
+    d->inf->next_in = (Bytef*)(uintptr_t)in;
+    d->inf->avail_in = (uInt)len;
+    d->inf_fin = fin;
+    d->inf_tail = fin;
+    return 0;
+}
+
+int ws_inflate_more(ws_deflate_t* d, uint8_t* out, size_t cap, size_t* produced) {
+    z_stream* s = d->inf;
+    if (cap > UINT_MAX) cap = UINT_MAX;
+    s->next_out = out;
+    s->avail_out = (uInt)cap;
+    *produced = 0;
+    for (;;) {
+        if (s->avail_in == 0 && d->inf_tail) {
+            s->next_in = (Bytef*)(uintptr_t)k_flush_tail;
+            s->avail_in = sizeof(k_flush_tail);
+            d->inf_tail = 0;
+        }
+        int rc = inflate(s, Z_SYNC_FLUSH);
+        *produced = cap - s->avail_out;
+        if (rc == Z_STREAM_END) {
+            /* A final block ends the stream; the sender starts a fresh one next message */
+            (void)inflateReset(s);
+            s->avail_in = 0;
+            d->inf_tail = 0;
+            break;
+        }
+        if (rc != Z_OK && rc != Z_BUF_ERROR) return -1;
+        if (s->avail_out == 0) return 0;
+        if (s->avail_in == 0 && !d->inf_tail) break;
+        if (rc == Z_BUF_ERROR) return -1; /* input and room left, yet no progress */
+    }
+    if (d->inf_fin && !d->inf_keep) {
+        zpool_put_inflate(d->inf);
+        d->inf = NULL;
+    }
+    return 1;
+}
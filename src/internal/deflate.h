@@ -0,0 +1,42 @@
+#ifndef WIBESOCKET_INTERNAL_DEFLATE_H
+#define WIBESOCKET_INTERNAL_DEFLATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* permessage-deflate parameters (RFC 7692 section 7.1), either as offered or as agreed.
+ * Window bits are 8..15; in an offer, server_max_window_bits 0 means not requested. */
+typedef struct {
+    int enabled;
+    int client_no_context_takeover;
+    int server_no_context_takeover;
+    int client_max_window_bits;
+    int server_max_window_bits;
+} ws_deflate_params_t;
+
+/* Room a compressed message may need beyond the plain frame: the 00 00 ff ff flush tail,
+ * written before it is stripped. */
+#define WS_DEFLATE_TAIL 4
+
+/* Client-side compressor and decompressor of one connection (needs a WS_HAVE_ZLIB build).
+ * zlib streams come from a process-wide pool: with context takeover the connection holds one
+ * per direction for its lifetime, without it a stream is borrowed for a single message, so
+ * idle connections hold no compression state at all. */
+typedef struct ws_deflate ws_deflate_t;
+
+ws_deflate_t* ws_deflate_create(const ws_deflate_params_t* agreed);
+void          ws_deflate_destroy(ws_deflate_t* d);
+
+/* Compress one whole message into [out, out + cap), the flush tail removed. Returns 0 with
+ * the length, or -1 when it should go out uncompressed instead: no smaller than len, or out
+ * of room. The compressor is reset then, so the peer's window stays in step. */
+int ws_deflate_message(ws_deflate_t* d, const uint8_t* in, size_t len,
+                       uint8_t* out, size_t cap, size_t* out_len);
+
+/* Decompress one frame of a compressed message: begin with its payload (fin appends the
+ * stripped tail), then call more until it returns 1 (frame done) rather than 0 (out filled;
+ * call again with fresh room). -1 on a corrupt stream. *produced gets the bytes written. */
+int ws_inflate_begin(ws_deflate_t* d, const uint8_t* in, size_t len, int fin);
+int ws_inflate_more(ws_deflate_t* d, uint8_t* out, size_t cap, size_t* produced);
+
+#endif /* WIBESOCKET_INTERNAL_DEFLATE_H */
@@ -5,6 +5,13 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "utf8.h"
+
+/* 2 base bytes + 8 extended length + 4 mask key */
+#define WS_MAX_HEADER_SIZE 14
+/* RSV1 as stored in ws_frame_header_t.rsv: permessage-deflate's "compressed" bit */
+#define WS_RSV1 0x4U
+
 typedef enum {
     WS_OPCODE_CONTINUATION = 0x0,
     WS_OPCODE_TEXT         = 0x1,
@@ -18,10 +25,18 @@ typedef enum {
     WS_PARSER_OK = 0,
     WS_PARSER_NEED_MORE = 1,
     WS_PARSER_FRAME = 2,
+    WS_PARSER_CHUNK = 3, /* payload bytes of a frame that is not complete yet */
     WS_PARSER_ERROR_PROTOCOL = -1,
     WS_PARSER_ERROR_TOO_LARGE = -2,
 } ws_parser_status_t;
 
+/* Masking the peer's frames must follow, by its role (RFC 6455 5.1) */
+typedef enum {
+    WS_MASK_ANY = 0,   /* not checked; payloads pass through as received */
+    WS_MASK_FORBIDDEN, /* the peer is a server: its frames must not be masked */
+    WS_MASK_REQUIRED   /* the peer is a client: its frames must be, and are unmasked in place */
+} ws_mask_rule_t;
+
 typedef struct {
     bool     fin;
     uint8_t  rsv;
@@ -34,17 +49,28 @@ typedef struct {
 typedef struct {
     /* Config */
     uint64_t max_frame_size;
+    bool     allow_rsv1; /* permessage-deflate negotiated: RSV1 marks a compressed message */
+    ws_mask_rule_t masking; /* REQUIRED writes through the fed bytes, which must be writable */
 
     /* Incremental state */
-    uint8_t  hdr_bytes[2 + 8 + 4];
+    uint8_t  hdr_bytes[WS_MAX_HEADER_SIZE];
     size_t   hdr_need;   /* number of header bytes needed next */
     size_t   hdr_have;   /* number of header bytes already read */
     ws_frame_header_t cur;
+    bool     hdr_done;     /* header of cur fully parsed and validated */
     uint64_t payload_read; /* bytes of payload read so far */
 
     /* Message fragmentation tracking */
     bool     in_fragmented_message;
     ws_opcode_t first_fragment_opcode;
+    bool     compressed; /* current data message had RSV1 on its first frame */
+
+    /* Text messages are validated chunk by chunk; state spans chunks and continuation frames.
+     * Compressed text is left to the caller, which validates it once inflated. */
+    ws_utf8_state_t utf8;
+
+    /* Control payloads split across feeds are gathered here so the frame is seen whole */
+    uint8_t  ctrl_buf[125];
 
     /* Output view (zero-copy pointer into the last fed chunk) */
     const uint8_t* out_payload;
@@ -53,21 +79,33 @@ typedef struct {
 
 typedef struct {
     ws_opcode_t type;
-    const void* payload;
+    const void* payload;     /* bytes of this frame consumed by the current feed */
     size_t      payload_len;
     bool        is_final;
+    uint64_t    offset;      /* position of payload within the frame payload */
+    uint64_t    frame_len;   /* total payload length of the frame */
+    bool        compressed;  /* payload is deflate data (RSV1 message); still to be inflated */
 } ws_parsed_frame_t;
 
 void ws_parser_init(ws_parser_t* p, uint64_t max_frame_size);
 
 /* Feed a chunk. On WS_PARSER_FRAME, fills out_frame and sets consumed to the number of bytes
  * consumed from input. The out_payload points into the input buffer.
+ * On WS_PARSER_CHUNK the frame is still incomplete: out_frame describes the payload bytes this
+ * feed consumed (at offset of frame_len), so large frames can be streamed. A data frame whose
+ * payload spans feeds reports only its last chunk with WS_PARSER_FRAME; control frames are
+ * always reported whole.
  */
 ws_parser_status_t ws_parser_feed(ws_parser_t* p,
                                   const uint8_t* data, size_t len,
                                   size_t* consumed,
                                   ws_parsed_frame_t* out_frame);
 
+/* Write a frame header (rsv in ws_frame_header_t.rsv form, e.g. WS_RSV1) for payload_len
+ * bytes into out, which needs WS_MAX_HEADER_SIZE bytes. Returns the header length. */
+size_t ws_build_frame_header(uint8_t* out, int fin, uint8_t rsv, ws_opcode_t opcode,
+                             const uint8_t mask_key[4], size_t payload_len);
+
 /* Build a single WebSocket frame into out buffer. Returns number of bytes written or 0 on error.
  * If mask_key is non-NULL, client masking is applied; otherwise unmasked.
  */
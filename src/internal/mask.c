@@ -0,0 +1,123 @@
+#include "mask.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define WS_MASK_X86 1
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define WS_MASK_NEON 1
+#endif
+
+typedef void (*ws_mask_fn)(uint8_t*, const uint8_t*, size_t, const uint8_t[4], size_t);
+
+/* Key repeated from phase; the period (4) divides every block width below, so the pattern
+ * stays aligned with the payload after each full block. */
+static void fill_pattern(uint8_t* pat, size_t n, const uint8_t key[4], size_t phase) {
+    for (size_t i = 0; i < n; i++) pat[i] = key[(phase + i) & 3];
+}
+
+static void mask_tail(uint8_t* dst, const uint8_t* src, size_t len, const uint8_t key[4], size_t phase) {
+    for (size_t i = 0; i < len; i++) dst[i] = (uint8_t)(src[i] ^ key[(phase + i) & 3]);
+}
+
+static void mask_scalar64(uint8_t* dst, const uint8_t* src, size_t len, const uint8_t key[4], size_t phase) {
+    uint8_t pat[8]; fill_pattern(pat, 8, key, phase);
+    uint64_t k; memcpy(&k, pat, 8);
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t v; memcpy(&v, src + i, 8);
+        v ^= k;
+        memcpy(dst + i, &v, 8);
+    }
+    mask_tail(dst + i, src + i, len - i, key, phase + i);
+}
+
+#if defined(WS_MASK_X86)
+__attribute__((target("sse2")))
+static void mask_sse2(uint8_t* dst, const uint8_t* src, size_t len, const uint8_t key[4], size_t phase) {
+    uint8_t pat[16]; fill_pattern(pat, 16, key, phase);
+    __m128i k = _mm_loadu_si128((const __m128i*)pat);
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i + 16));
+        __m128i c = _mm_loadu_si128((const __m128i*)(src + i + 32));
+        __m128i d = _mm_loadu_si128((const __m128i*)(src + i + 48));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(a, k));
+        _mm_storeu_si128((__m128i*)(dst + i + 16), _mm_xor_si128(b, k));
+        _mm_storeu_si128((__m128i*)(dst + i + 32), _mm_xor_si128(c, k));
+        _mm_storeu_si128((__m128i*)(dst + i + 48), _mm_xor_si128(d, k));
+    }
+    for (; i + 16 <= len; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(a, k));
+    }
+    mask_scalar64(dst + i, src + i, len - i, key, phase + i);
+}
+
+__attribute__((target("avx2")))
+static void mask_avx2(uint8_t* dst, const uint8_t* src, size_t len, const uint8_t key[4], size_t phase) {
+    uint8_t pat[32]; fill_pattern(pat, 32, key, phase);
+    __m256i k = _mm256_loadu_si256((const __m256i*)pat);
+    size_t i = 0;
+    for (; i + 128 <= len; i += 128) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(src + i + 32));
+        __m256i c = _mm256_loadu_si256((const __m256i*)(src + i + 64));
+        __m256i d = _mm256_loadu_si256((const __m256i*)(src + i + 96));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_xor_si256(a, k));
+        _mm256_storeu_si256((__m256i*)(dst + i + 32), _mm256_xor_si256(b, k));
+        _mm256_storeu_si256((__m256i*)(dst + i + 64), _mm256_xor_si256(c, k));
+        _mm256_storeu_si256((__m256i*)(dst + i + 96), _mm256_xor_si256(d, k));
+    }
+    for (; i + 32 <= len; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(src + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_xor_si256(a, k));
+    }
+    mask_sse2(dst + i, src + i, len - i, key, phase + i);
+}
+#endif
+
+#if defined(WS_MASK_NEON)
+static void mask_neon(uint8_t* dst, const uint8_t* src, size_t len, const uint8_t key[4], size_t phase) {
+    uint8_t pat[16]; fill_pattern(pat, 16, key, phase);
+    uint8x16_t k = vld1q_u8(pat);
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        uint8x16_t a = vld1q_u8(src + i), b = vld1q_u8(src + i + 16);
+        uint8x16_t c = vld1q_u8(src + i + 32), d = vld1q_u8(src + i + 48);
+        vst1q_u8(dst + i, veorq_u8(a, k));
+        vst1q_u8(dst + i + 16, veorq_u8(b, k));
+        vst1q_u8(dst + i + 32, veorq_u8(c, k));
+        vst1q_u8(dst + i + 48, veorq_u8(d, k));
+    }
+    for (; i + 16 <= len; i += 16) vst1q_u8(dst + i, veorq_u8(vld1q_u8(src + i), k));
+    mask_scalar64(dst + i, src + i, len - i, key, phase + i);
+}
+#endif
+
+static void mask_resolve(uint8_t* dst, const uint8_t* src, size_t len, const uint8_t key[4], size_t phase);
+
+static ws_mask_fn g_mask_impl = mask_resolve;
+
+static void mask_resolve(uint8_t* dst, const uint8_t* src, size_t len, const uint8_t key[4], size_t phase) {
+    ws_mask_fn fn = mask_scalar64;
+#if defined(WS_MASK_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) fn = mask_avx2;
+    else if (__builtin_cpu_supports("sse2")) fn = mask_sse2;
+#elif defined(WS_MASK_NEON)
+    fn = mask_neon;
+#endif
+    __atomic_store_n(&g_mask_impl, fn, __ATOMIC_RELAXED);
+    fn(dst, src, len, key, phase);
+}
+
+void ws_mask_copy(uint8_t* dst, const uint8_t* src, size_t len, const uint8_t key[4], size_t phase) {
+    /* Short payloads (typical control/small frames) skip the indirect call */
+    if (len < 16) { mask_tail(dst, src, len, key, phase); return; }
+    ws_mask_fn fn = __atomic_load_n(&g_mask_impl, __ATOMIC_RELAXED);
+    fn(dst, src, len, key, phase);
+}
@@ -0,0 +1,12 @@
+#ifndef WIBESOCKET_INTERNAL_MASK_H
+#define WIBESOCKET_INTERNAL_MASK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* XOR len bytes of src with the RFC 6455 masking key into dst (dst may equal src).
+ * phase is the index of src[0] within the 4-byte key cycle, so masking can resume mid-payload.
+ * Dispatches once at runtime to the widest kernel available (AVX2/SSE2/NEON, 64-bit scalar). */
+void ws_mask_copy(uint8_t* dst, const uint8_t* src, size_t len, const uint8_t key[4], size_t phase);
+
+#endif /* WIBESOCKET_INTERNAL_MASK_H */
@@ -0,0 +1,33 @@
+#include "mpsc.h"
+
+#include <stddef.h>
+
+void ws_mpsc_init(ws_mpsc_t* q) {
+    atomic_store_explicit(&q->stub.next, NULL, memory_order_relaxed);
+    atomic_store_explicit(&q->head, &q->stub, memory_order_relaxed);
+    q->tail = &q->stub;
+}
+
+void ws_mpsc_push(ws_mpsc_t* q, ws_mpsc_node_t* n) {
+    atomic_store_explicit(&n->next, NULL, memory_order_relaxed);
+    ws_mpsc_node_t* prev = atomic_exchange_explicit(&q->head, n, memory_order_acq_rel);
+    atomic_store_explicit(&prev->next, n, memory_order_release);
+}
+
+ws_mpsc_node_t* ws_mpsc_pop(ws_mpsc_t* q) {
+    ws_mpsc_node_t* tail = q->tail;
+    ws_mpsc_node_t* next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (tail == &q->stub) {
+        if (!next) return NULL;
+        q->tail = next;
+        tail = next;
+        next = atomic_load_explicit(&next->next, memory_order_acquire);
+    }
+    if (next) { q->tail = next; return tail; }
+    /* tail is the last linked node: unless a push is half done, recycle the stub behind it */
+    if (tail != atomic_load_explicit(&q->head, memory_order_acquire)) return NULL;
+    ws_mpsc_push(q, &q->stub);
+    next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (next) { q->tail = next; return tail; }
+    return NULL;
+}
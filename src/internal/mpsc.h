@@ -0,0 +1,29 @@
+#ifndef WIBESOCKET_INTERNAL_MPSC_H
+#define WIBESOCKET_INTERNAL_MPSC_H
+
+#include <stdatomic.h>
+
+/* Intrusive multi-producer single-consumer queue (Vyukov). Push is one exchange and one
+ * store, never blocks and never fails; only the owning thread pops. Nodes are embedded in
+ * the caller's structs and must stay alive until popped. */
+typedef struct ws_mpsc_node {
+    _Atomic(struct ws_mpsc_node*) next;
+} ws_mpsc_node_t;
+
+/* head and tail sit on separate cache lines (padding rather than _Alignas, so the queue can
+ * live inside malloc'd structs) */
+typedef struct {
+    _Atomic(ws_mpsc_node_t*) head; /* producers */
+    char                     pad[64 - sizeof(void*)];
+    ws_mpsc_node_t*          tail; /* consumer */
+    ws_mpsc_node_t           stub;
+} ws_mpsc_t;
+
+void ws_mpsc_init(ws_mpsc_t* q);
+/* Any thread */
+void ws_mpsc_push(ws_mpsc_t* q, ws_mpsc_node_t* n);
+/* Owner only. NULL when empty, or while a producer is between its two steps: that producer's
+ * push completes shortly, so callers pair the queue with a wakeup it raises afterwards. */
+ws_mpsc_node_t* ws_mpsc_pop(ws_mpsc_t* q);
+
+#endif /* WIBESOCKET_INTERNAL_MPSC_H */
@@ -0,0 +1,130 @@
+#include "random.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/random.h>
+#endif
+
+#define WS_RNG_BLOCKS 8                  /* ChaCha20 blocks per refill */
+#define WS_RNG_BUF    (WS_RNG_BLOCKS * 64)
+#define WS_RNG_KEY    32
+
+typedef struct {
+    uint8_t  key[WS_RNG_KEY];
+    uint8_t  buf[WS_RNG_BUF];
+    size_t   avail;   /* unused bytes at the end of buf */
+    unsigned gen;     /* fork generation it was seeded in, 0 = never */
+} ws_rng_t;
+
+static _Thread_local ws_rng_t t_rng;
+static atomic_uint g_fork_gen = 1;
+static pthread_once_t g_atfork_once = PTHREAD_ONCE_INIT;
+
+#define ROTL32(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+#define QR(a, b, c, d) do { \
+    a += b; d ^= a; d = ROTL32(d, 16); \
+    c += d; b ^= c; b = ROTL32(b, 12); \
+    a += b; d ^= a; d = ROTL32(d, 8);  \
+    c += d; b ^= c; b = ROTL32(b, 7);  \
+} while (0)
+
+static uint32_t load32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void store32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+}
+
+void ws_chacha20_block(const uint8_t key[32], uint32_t counter, const uint8_t nonce[12], uint8_t out[64]) {
+    uint32_t s[16], x[16];
+    s[0] = 0x61707865; s[1] = 0x3320646e; s[2] = 0x79622d32; s[3] = 0x6b206574; /* "expand 32-byte k" */
+    for (int i = 0; i < 8; i++) s[4 + i] = load32(key + 4 * i);
+    s[12] = counter;
+    for (int i = 0; i < 3; i++) s[13 + i] = load32(nonce + 4 * i);
+    memcpy(x, s, sizeof(x));
+    for (int i = 0; i < 10; i++) {
+        QR(x[0], x[4], x[8], x[12]); QR(x[1], x[5], x[9], x[13]);
+        QR(x[2], x[6], x[10], x[14]); QR(x[3], x[7], x[11], x[15]);
+        QR(x[0], x[5], x[10], x[15]); QR(x[1], x[6], x[11], x[12]);
+        QR(x[2], x[7], x[8], x[13]); QR(x[3], x[4], x[9], x[14]);
+    }
+    for (int i = 0; i < 16; i++) store32(out + 4 * i, x[i] + s[i]);
+}
+
+static void on_fork_child(void) {
+    atomic_fetch_add_explicit(&g_fork_gen, 1, memory_order_relaxed);
+}
+
+static void register_atfork(void) {
+    (void)pthread_atfork(NULL, NULL, on_fork_child);
+}
+
+/* Kernel entropy; only a kernel without getrandom or /dev/urandom falls back to clocks */
+static void seed_key(uint8_t key[WS_RNG_KEY]) {
+    size_t got = 0;
+#if defined(__linux__)
+    while (got < WS_RNG_KEY) {
+        ssize_t r = getrandom(key + got, WS_RNG_KEY - got, 0);
+        if (r > 0) got += (size_t)r;
+        else if (r < 0 && errno == EINTR) continue;
+        else break;
+    }
+#endif
+    if (got < WS_RNG_KEY) {
+        int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            while (got < WS_RNG_KEY) {
+                ssize_t r = read(fd, key + got, WS_RNG_KEY - got);
+                if (r > 0) got += (size_t)r;
+                else if (r < 0 && errno == EINTR) continue;
+                else break;
+            }
+            close(fd);
+        }
+    }
+    if (got < WS_RNG_KEY) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        uint64_t mix[4] = { (uint64_t)ts.tv_sec, (uint64_t)ts.tv_nsec, (uint64_t)getpid(), (uint64_t)(uintptr_t)&t_rng };
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        mix[0] ^= (uint64_t)ts.tv_nsec << 32;
+        memcpy(key, mix, WS_RNG_KEY);
+    }
+}
+
+static void refill(ws_rng_t* r) {
+    static const uint8_t zero_nonce[12] = {0};
+    for (uint32_t i = 0; i < WS_RNG_BLOCKS; i++) ws_chacha20_block(r->key, i, zero_nonce, r->buf + 64 * i);
+    /* Fast key erasure: the next key comes out of this stream and is never handed out */
+    memcpy(r->key, r->buf, WS_RNG_KEY);
+    memset(r->buf, 0, WS_RNG_KEY);
+    r->avail = WS_RNG_BUF - WS_RNG_KEY;
+}
+
+void ws_random_bytes(void* out, size_t len) {
+    ws_rng_t* r = &t_rng;
+    unsigned gen = atomic_load_explicit(&g_fork_gen, memory_order_relaxed);
+    if (r->gen != gen) {
+        pthread_once(&g_atfork_once, register_atfork);
+        seed_key(r->key);
+        r->avail = 0;
+        r->gen = atomic_load_explicit(&g_fork_gen, memory_order_relaxed);
+    }
+    uint8_t* p = (uint8_t*)out;
+    while (len > 0) {
+        if (r->avail == 0) refill(r);
+        size_t n = len < r->avail ? len : r->avail;
+        uint8_t* src = r->buf + WS_RNG_BUF - r->avail;
+        memcpy(p, src, n);
+        memset(src, 0, n);
+        r->avail -= n;
+        p += n; len -= n;
+    }
+}
@@ -0,0 +1,17 @@
+#ifndef WIBESOCKET_INTERNAL_RANDOM_H
+#define WIBESOCKET_INTERNAL_RANDOM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Per-thread ChaCha20 generator for masking keys and handshake nonces (RFC 6455 requires
+ * both to be unpredictable). Seeded from getrandom once per thread, then refilled 512 bytes
+ * at a time with fast key erasure: the first 32 bytes of each refill become the next key,
+ * so earlier output cannot be recovered from the state, and bytes are wiped as they are
+ * handed out. A fork reseeds the child so the two never share a stream. */
+void ws_random_bytes(void* out, size_t len);
+
+/* The RFC 8439 block function, exposed for its test vectors */
+void ws_chacha20_block(const uint8_t key[32], uint32_t counter, const uint8_t nonce[12], uint8_t out[64]);
+
+#endif /* WIBESOCKET_INTERNAL_RANDOM_H */
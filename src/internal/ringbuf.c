@@ -1,6 +1,91 @@
+#if defined(__linux__)
+#define _GNU_SOURCE
+#endif
 #include "ringbuf.h"
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#define WS_RING_POOL_KEEP 64 /* idle mirrored mappings kept for reuse */
+#define WS_RING_HOT_MAX (64U * 1024U) /* largest ring a thread keeps with its pages */
+
+/* Setting up a mirrored ring is a memfd, a truncate and three mmaps; a freed one goes back
+ * here instead, with its pages handed back to the kernel so a pooled ring costs only address
+ * space. Reused by exact capacity. */
+static struct {
+    pthread_mutex_t lock;
+    uint8_t*        base[WS_RING_POOL_KEEP];
+    size_t          cap[WS_RING_POOL_KEEP];
+    int             n;
+} g_ring_pool = { PTHREAD_MUTEX_INITIALIZER, {0}, {0}, 0 };
+
+/* One small ring per thread parked with its pages intact: a connection that hands its ring
+ * back between reads (buffer lending) and takes it again on the next one, on the same loop
+ * thread, costs neither a syscall nor a lock */
+static _Thread_local uint8_t* t_hot_base;
+static _Thread_local size_t   t_hot_cap;
+static pthread_key_t  g_hot_key;
+static pthread_once_t g_hot_once = PTHREAD_ONCE_INIT;
+static int            g_hot_ok;
+
+#if defined(__linux__)
+static void ring_pool_put(uint8_t* base, size_t cap) {
+#if defined(MADV_REMOVE)
+    /* Punch out the memfd pages (both halves are the same pages) and keep the mapping */
+    if (madvise(base, cap, MADV_REMOVE) == 0) {
+        pthread_mutex_lock(&g_ring_pool.lock);
+        if (g_ring_pool.n < WS_RING_POOL_KEEP) {
+            g_ring_pool.base[g_ring_pool.n] = base;
+            g_ring_pool.cap[g_ring_pool.n++] = cap;
+            base = NULL;
+        }
+        pthread_mutex_unlock(&g_ring_pool.lock);
+    }
+#endif
+    if (base) munmap(base, 2 * cap);
+}
+#endif
+
+void ws_ringbuf_thread_flush(void) {
+#if defined(__linux__)
+    if (t_hot_base) ring_pool_put(t_hot_base, t_hot_cap);
+#endif
+    t_hot_base = NULL;
+    t_hot_cap = 0;
+}
+
+static void hot_destructor(void* unused) {
+    (void)unused;
+    ws_ringbuf_thread_flush();
+}
+
+static void hot_init(void) {
+    g_hot_ok = pthread_key_create(&g_hot_key, hot_destructor) == 0;
+}
+
+static uint8_t* ring_pool_take(size_t cap) {
+    uint8_t* base = NULL;
+    if (t_hot_base && t_hot_cap == cap) {
+        base = t_hot_base;
+        t_hot_base = NULL;
+        return base;
+    }
+    pthread_mutex_lock(&g_ring_pool.lock);
+    for (int i = g_ring_pool.n - 1; i >= 0; i--) {
+        if (g_ring_pool.cap[i] != cap) continue;
+        base = g_ring_pool.base[i];
+        g_ring_pool.n--;
+        g_ring_pool.base[i] = g_ring_pool.base[g_ring_pool.n];
+        g_ring_pool.cap[i] = g_ring_pool.cap[g_ring_pool.n];
+        break;
+    }
+    pthread_mutex_unlock(&g_ring_pool.lock);
+    return base;
+}
 
 int ws_ringbuf_init(ws_ringbuf_t* rb, size_t capacity) {
     memset(rb, 0, sizeof(*rb));
@@ -12,9 +97,75 @@ int ws_ringbuf_init(ws_ringbuf_t* rb, size_t capacity) {
     return 0;
 }
 
+int ws_ringbuf_init_mirrored(ws_ringbuf_t* rb, size_t capacity) {
+    memset(rb, 0, sizeof(*rb));
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+    long page = sysconf(_SC_PAGESIZE);
+    if (page <= 0 || capacity == 0) return -1;
+    size_t cap = (capacity + (size_t)page - 1) & ~((size_t)page - 1);
+    uint8_t* pooled = ring_pool_take(cap);
+    if (pooled) {
+        rb->buffer = pooled;
+        rb->capacity = cap;
+        rb->mirrored = true;
+        return 0;
+    }
+    int fd = memfd_create("wibesocket-ring", MFD_CLOEXEC);
+    if (fd < 0) return -1;
+    if (ftruncate(fd, (off_t)cap) != 0) { close(fd); return -1; }
+    /* Reserve 2*cap of address space, then map the same pages into both halves */
+    uint8_t* base = (uint8_t*)mmap(NULL, 2 * cap, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) { close(fd); return -1; }
+    if (mmap(base, cap, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+        mmap(base + cap, cap, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, 2 * cap); close(fd); return -1;
+    }
+    close(fd);
+    rb->buffer = base;
+    rb->capacity = cap;
+    rb->mirrored = true;
+    return 0;
+#else
+    (void)capacity;
+    return -1;
+#endif
+}
+
 void ws_ringbuf_free(ws_ringbuf_t* rb) {
-    if (rb && rb->buffer) free(rb->buffer);
-    if (rb) memset(rb, 0, sizeof(*rb));
+    if (!rb) return;
+#if defined(__linux__)
+    if (rb->buffer && rb->mirrored) {
+        if (!t_hot_base && rb->capacity <= WS_RING_HOT_MAX) {
+            pthread_once(&g_hot_once, hot_init);
+            if (g_hot_ok) {
+                /* Any non-NULL value arms the destructor that hands the slot back on exit */
+                (void)pthread_setspecific(g_hot_key, (void*)1);
+                t_hot_base = rb->buffer;
+                t_hot_cap = rb->capacity;
+                rb->buffer = NULL;
+            }
+        }
+        if (rb->buffer) ring_pool_put(rb->buffer, rb->capacity);
+        rb->buffer = NULL;
+    }
+#endif
+    if (rb->buffer) free(rb->buffer);
+    memset(rb, 0, sizeof(*rb));
+}
+
+int ws_ringbuf_grow(ws_ringbuf_t* rb, size_t capacity) {
+    if (capacity <= rb->capacity) return 0;
+    ws_ringbuf_t nr;
+    if (rb->mirrored) {
+        if (ws_ringbuf_init_mirrored(&nr, capacity) != 0) return -1;
+    } else if (ws_ringbuf_init(&nr, capacity) != 0) {
+        return -1;
+    }
+    size_t moved = ws_ringbuf_read_copy(rb, nr.buffer, rb->count);
+    ws_ringbuf_commit(&nr, moved);
+    ws_ringbuf_free(rb);
+    *rb = nr;
+    return 0;
 }
 
 static size_t advance_index(size_t idx, size_t n, size_t cap) {
@@ -32,6 +183,7 @@ bool ws_ringbuf_is_full(const ws_ringbuf_t* rb) { return rb->count == rb->capaci
 size_t ws_ringbuf_peek_read(const ws_ringbuf_t* rb, const uint8_t** out_ptr) {
     size_t readable = ws_ringbuf_size(rb);
     if (readable == 0) { *out_ptr = NULL; return 0; }
+    if (rb->mirrored) { *out_ptr = rb->buffer + rb->tail; return readable; }
     size_t tail_to_end;
     if (rb->tail < rb->head) {
         /* contiguous region from tail up to head */
@@ -51,11 +203,14 @@ void ws_ringbuf_consume(ws_ringbuf_t* rb, size_t nbytes) {
     if (nbytes > readable) nbytes = readable;
     rb->tail = advance_index(rb->tail, nbytes, rb->capacity);
     rb->count -= nbytes;
+    /* Empty: rewind so the next write starts at offset 0 */
+    if (rb->count == 0) rb->head = rb->tail = 0;
 }
 
 size_t ws_ringbuf_peek_write(const ws_ringbuf_t* rb, uint8_t** out_ptr) {
     if (rb->count == rb->capacity) { *out_ptr = NULL; return 0; }
     size_t avail = ws_ringbuf_available(rb);
+    if (rb->mirrored) { *out_ptr = rb->buffer + rb->head; return avail; }
     size_t head_to_end;
     if (rb->head < rb->tail) {
         /* contiguous free region before tail */
@@ -77,6 +232,25 @@ void ws_ringbuf_commit(ws_ringbuf_t* rb, size_t nbytes) {
     rb->count += nbytes;
 }
 
+static void reverse_bytes(uint8_t* p, size_t n) {
+    for (size_t i = 0, j = n; i + 1 < j; i++, j--) { uint8_t t = p[i]; p[i] = p[j - 1]; p[j - 1] = t; }
+}
+
+void ws_ringbuf_linearize(ws_ringbuf_t* rb) {
+    if (rb->mirrored || rb->tail == 0) return;
+    if (rb->count == 0) { rb->head = rb->tail = 0; return; }
+    if (rb->capacity - rb->tail >= rb->count) {
+        memmove(rb->buffer, rb->buffer + rb->tail, rb->count);
+    } else {
+        /* Wrapped: rotate the whole buffer left by tail (three in-place reversals) */
+        reverse_bytes(rb->buffer, rb->tail);
+        reverse_bytes(rb->buffer + rb->tail, rb->capacity - rb->tail);
+        reverse_bytes(rb->buffer, rb->capacity);
+    }
+    rb->tail = 0;
+    rb->head = (rb->count == rb->capacity) ? 0 : rb->count;
+}
+
 size_t ws_ringbuf_write_copy(ws_ringbuf_t* rb, const uint8_t* data, size_t len) {
     size_t written = 0;
     while (len) {
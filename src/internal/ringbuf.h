@@ -11,10 +11,22 @@ typedef struct {
     size_t   head;  /* write index */
     size_t   tail;  /* read index */
     size_t   count; /* bytes stored */
+    bool     mirrored; /* buffer is mapped twice back-to-back: every region is contiguous */
 } ws_ringbuf_t;
 
 int  ws_ringbuf_init(ws_ringbuf_t* rb, size_t capacity);
+/* Mirrored ring: capacity is rounded up to the page size and the pages are mapped twice in a
+ * row, so peek_read/peek_write always return the full readable/writable span even when it
+ * wraps. Returns -1 where unsupported; callers fall back to ws_ringbuf_init. */
+int  ws_ringbuf_init_mirrored(ws_ringbuf_t* rb, size_t capacity);
+/* Mirrored rings are recycled: one small ring per thread keeps its pages, others go to a
+ * process-wide pool with their pages released, so a pooled ring costs only address space */
 void ws_ringbuf_free(ws_ringbuf_t* rb);
+/* Hand this thread's parked ring to the shared pool (also done at thread exit). */
+void ws_ringbuf_thread_flush(void);
+/* Move to a larger buffer of the same kind; the readable bytes end up at offset 0.
+ * Invalidates pointers into the old buffer. Returns -1 (ring unchanged) on failure. */
+int  ws_ringbuf_grow(ws_ringbuf_t* rb, size_t capacity);
 
 size_t ws_ringbuf_size(const ws_ringbuf_t* rb);
 size_t ws_ringbuf_available(const ws_ringbuf_t* rb);
@@ -29,6 +41,10 @@ void   ws_ringbuf_consume(ws_ringbuf_t* rb, size_t nbytes);
 size_t ws_ringbuf_peek_write(const ws_ringbuf_t* rb, uint8_t** out_ptr);
 void   ws_ringbuf_commit(ws_ringbuf_t* rb, size_t nbytes);
 
+/* Move readable bytes to the start of a non-mirrored buffer so they no longer wrap.
+ * Invalidates pointers previously returned by peek_read. */
+void   ws_ringbuf_linearize(ws_ringbuf_t* rb);
+
 /* Fallback convenience copy API */
 size_t ws_ringbuf_write_copy(ws_ringbuf_t* rb, const uint8_t* data, size_t len);
 size_t ws_ringbuf_read_copy(ws_ringbuf_t* rb, uint8_t* out, size_t len);
@@ -0,0 +1,42 @@
+#include "slab.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WS_SLAB_LINE  64
+#define WS_SLAB_CHUNK 64 /* objects per chunk */
+
+static size_t slot_size(const ws_slab_t* s) {
+    size_t n = s->size < sizeof(void*) ? sizeof(void*) : s->size;
+    return (n + WS_SLAB_LINE - 1) & ~(size_t)(WS_SLAB_LINE - 1);
+}
+
+void* ws_slab_alloc(ws_slab_t* s) {
+    size_t slot = slot_size(s);
+    pthread_mutex_lock(&s->lock);
+    void* obj = s->free_list;
+    if (!obj) {
+        uint8_t* chunk = (uint8_t*)aligned_alloc(WS_SLAB_LINE, slot * WS_SLAB_CHUNK);
+        if (!chunk) { pthread_mutex_unlock(&s->lock); return NULL; }
+        /* Slot 0 is handed out, the rest go on the free list */
+        for (size_t i = WS_SLAB_CHUNK - 1; i > 0; i--) {
+            *(void**)(chunk + i * slot) = s->free_list;
+            s->free_list = chunk + i * slot;
+        }
+        obj = chunk;
+    } else {
+        s->free_list = *(void**)obj;
+    }
+    pthread_mutex_unlock(&s->lock);
+    memset(obj, 0, s->size);
+    return obj;
+}
+
+void ws_slab_free(ws_slab_t* s, void* obj) {
+    if (!obj) return;
+    pthread_mutex_lock(&s->lock);
+    *(void**)obj = s->free_list;
+    s->free_list = obj;
+    pthread_mutex_unlock(&s->lock);
+}
@@ -0,0 +1,22 @@
+#ifndef WIBESOCKET_INTERNAL_SLAB_H
+#define WIBESOCKET_INTERNAL_SLAB_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+/* Fixed-size object cache. Objects are carved from 64-object chunks on cache-line boundaries
+ * and go back on a free list, never to the heap, so a process that churns connections reuses
+ * the same few chunks instead of asking malloc for a large struct each time. Thread-safe. */
+typedef struct {
+    pthread_mutex_t lock;
+    size_t          size; /* object size as given; rounded up to a cache line per slot */
+    void*           free_list;
+} ws_slab_t;
+
+#define WS_SLAB_INIT(object_size) { PTHREAD_MUTEX_INITIALIZER, (object_size), NULL }
+
+/* Zeroed object, or NULL out of memory */
+void* ws_slab_alloc(ws_slab_t* s);
+void  ws_slab_free(ws_slab_t* s, void* obj);
+
+#endif /* WIBESOCKET_INTERNAL_SLAB_H */
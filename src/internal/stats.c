@@ -0,0 +1,105 @@
+#include "stats.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WS_HIST_SUB 4 /* linear buckets per power of two */
+
+/* Live blocks, and the totals of those already destroyed */
+static pthread_mutex_t g_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static ws_stats_t*     g_stats_live;
+static wibesocket_stats_t g_stats_closed;
+
+static size_t hist_bucket(uint64_t v) {
+    if (v < WS_HIST_SUB) return (size_t)v;
+    int msb = 63 - __builtin_clzll(v);
+    size_t i = (size_t)(msb - 1) * WS_HIST_SUB + (size_t)((v >> (msb - 2)) & (WS_HIST_SUB - 1));
+    return i < WIBESOCKET_HIST_BUCKETS ? i : WIBESOCKET_HIST_BUCKETS - 1;
+}
+
+/* Largest value that lands in bucket i */
+static uint64_t hist_upper(size_t i) {
+    if (i < WS_HIST_SUB) return i;
+    int msb = (int)(i / WS_HIST_SUB) + 1;
+    uint64_t sub = i % WS_HIST_SUB;
+    return ((WS_HIST_SUB + sub + 1) << (msb - 2)) - 1;
+}
+
+/* Peaks combine as a maximum, everything else adds up */
+static int is_max_slot(size_t slot) {
+    return slot == WS_STAT_SLOT(send_queue_peak) || slot == WS_STAT_SLOT(send_delay.max_ns);
+}
+
+static void fold(uint64_t* acc, const uint64_t* v) {
+    for (size_t i = 0; i < WS_STATS_WORDS; i++) {
+        if (is_max_slot(i)) { if (v[i] > acc[i]) acc[i] = v[i]; }
+        else acc[i] += v[i];
+    }
+}
+
+ws_stats_t* ws_stats_create(void) {
+    ws_stats_t* s = (ws_stats_t*)calloc(1, sizeof(*s));
+    if (!s) return NULL;
+    pthread_mutex_lock(&g_stats_lock);
+    s->next = g_stats_live;
+    if (g_stats_live) g_stats_live->prev = s;
+    g_stats_live = s;
+    pthread_mutex_unlock(&g_stats_lock);
+    return s;
+}
+
+void ws_stats_destroy(ws_stats_t* s) {
+    if (!s) return;
+    wibesocket_stats_t snap;
+    ws_stats_read(s, &snap);
+    pthread_mutex_lock(&g_stats_lock);
+    fold((uint64_t*)&g_stats_closed, (const uint64_t*)&snap);
+    if (s->prev) s->prev->next = s->next; else g_stats_live = s->next;
+    if (s->next) s->next->prev = s->prev;
+    pthread_mutex_unlock(&g_stats_lock);
+    free(s);
+}
+
+void ws_stats_read(const ws_stats_t* s, wibesocket_stats_t* out) {
+    uint64_t* w = (uint64_t*)out;
+    for (size_t i = 0; i < WS_STATS_WORDS; i++) {
+        w[i] = atomic_load_explicit(&s->w[i], memory_order_relaxed);
+    }
+}
+
+void ws_stats_record_delay(ws_stats_t* s, uint64_t ns) {
+    ws_stat_add(s, WS_STAT_SLOT(send_delay.count), 1);
+    ws_stat_add(s, WS_STAT_SLOT(send_delay.sum_ns), ns);
+    ws_stat_max(s, WS_STAT_SLOT(send_delay.max_ns), ns);
+    ws_stat_add(s, WS_STAT_SLOT(send_delay.buckets) + hist_bucket(ns), 1);
+}
+
+void wibesocket_get_global_stats(wibesocket_stats_t* out) {
+    if (!out) return;
+    pthread_mutex_lock(&g_stats_lock);
+    *out = g_stats_closed;
+    for (ws_stats_t* s = g_stats_live; s; s = s->next) {
+        wibesocket_stats_t snap;
+        ws_stats_read(s, &snap);
+        fold((uint64_t*)out, (const uint64_t*)&snap);
+    }
+    pthread_mutex_unlock(&g_stats_lock);
+}
+
+uint64_t wibesocket_histogram_percentile(const wibesocket_histogram_t* hist, double pct) {
+    if (!hist || hist->count == 0) return 0;
+    if (pct < 0) pct = 0;
+    if (pct > 100) pct = 100;
+    uint64_t rank = (uint64_t)((double)hist->count * pct / 100.0 + 0.5);
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < WIBESOCKET_HIST_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= rank) {
+            uint64_t up = hist_upper(i);
+            return up < hist->max_ns ? up : hist->max_ns;
+        }
+    }
+    return hist->max_ns;
+}
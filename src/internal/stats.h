@@ -0,0 +1,43 @@
+#ifndef WIBESOCKET_INTERNAL_STATS_H
+#define WIBESOCKET_INTERNAL_STATS_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wibesocket/wibesocket.h"
+
+/* Counters of one connection, laid out word for word like wibesocket_stats_t so reading and
+ * summing are plain loops. Only the owning thread writes, so an update is a relaxed load and
+ * store (no locked instruction); other threads may read at any time. Live blocks sit on a
+ * global list, taken only at create, destroy and global reads. */
+#define WS_STATS_WORDS (sizeof(wibesocket_stats_t) / sizeof(uint64_t))
+#define WS_STAT_SLOT(field) (offsetof(wibesocket_stats_t, field) / sizeof(uint64_t))
+
+typedef struct ws_stats {
+    _Atomic uint64_t w[WS_STATS_WORDS];
+    struct ws_stats* prev;
+    struct ws_stats* next;
+} ws_stats_t;
+
+ws_stats_t* ws_stats_create(void);
+/* Folds the counters into the global totals of closed connections */
+void        ws_stats_destroy(ws_stats_t* s);
+void        ws_stats_read(const ws_stats_t* s, wibesocket_stats_t* out);
+void        ws_stats_record_delay(ws_stats_t* s, uint64_t ns);
+
+static inline void ws_stat_add(ws_stats_t* s, size_t slot, uint64_t n) {
+    uint64_t v = atomic_load_explicit(&s->w[slot], memory_order_relaxed);
+    atomic_store_explicit(&s->w[slot], v + n, memory_order_relaxed);
+}
+
+static inline void ws_stat_max(ws_stats_t* s, size_t slot, uint64_t v) {
+    if (v > atomic_load_explicit(&s->w[slot], memory_order_relaxed)) {
+        atomic_store_explicit(&s->w[slot], v, memory_order_relaxed);
+    }
+}
+
+/* Counting sites: s is NULL when stats are off */
+#define WS_STAT_ADD(s, field, n) do { if (s) ws_stat_add((s), WS_STAT_SLOT(field), (n)); } while (0)
+
+#endif /* WIBESOCKET_INTERNAL_STATS_H */
@@ -0,0 +1,146 @@
+#include "timerwheel.h"
+
+#include <string.h>
+
+#define WS_WHEEL_MASK  ((uint64_t)WS_WHEEL_SLOTS - 1)
+#define WS_WHEEL_SPAN  ((uint64_t)1 << (WS_WHEEL_BITS * WS_WHEEL_LEVELS))
+
+void ws_timerwheel_init(ws_timerwheel_t* w, uint64_t now_ms) {
+    memset(w, 0, sizeof(*w));
+    w->base_ms = now_ms;
+}
+
+void ws_timer_init(ws_timer_t* t, ws_timer_fn fn) {
+    memset(t, 0, sizeof(*t));
+    t->fn = fn;
+}
+
+static void timer_link(ws_timer_t** head, ws_timer_t* t) {
+    t->next = *head;
+    if (t->next) t->next->pprev = &t->next;
+    t->pprev = head;
+    *head = t;
+}
+
+static void timer_unlink(ws_timerwheel_t* w, ws_timer_t* t) {
+    *t->pprev = t->next;
+    if (t->next) t->next->pprev = t->pprev;
+    if (t->slot < WS_WHEEL_SLOTS && !w->slots[t->level][t->slot]) {
+        w->occupied[t->level] &= ~((uint64_t)1 << t->slot);
+    }
+    t->next = NULL;
+    t->pprev = NULL;
+}
+
+/* Level by distance from base: level L holds deadlines less than 64^(L+1) ticks away, in
+ * the slot of their 64^L-tick block. A slot is cascaded when base enters its block. */
+static void wheel_place(ws_timerwheel_t* w, ws_timer_t* t) {
+    uint64_t exp = t->expires_ms < w->base_ms ? w->base_ms : t->expires_ms;
+    uint64_t delta = exp - w->base_ms;
+    if (delta >= WS_WHEEL_SPAN) exp = w->base_ms + WS_WHEEL_SPAN - 1;
+    int lvl = 0;
+    while (lvl < WS_WHEEL_LEVELS - 1 && delta >= ((uint64_t)1 << (WS_WHEEL_BITS * (lvl + 1)))) lvl++;
+    unsigned slot = (unsigned)((exp >> (WS_WHEEL_BITS * lvl)) & WS_WHEEL_MASK);
+    t->level = (uint8_t)lvl;
+    t->slot = (uint8_t)slot;
+    timer_link(&w->slots[lvl][slot], t);
+    w->occupied[lvl] |= (uint64_t)1 << slot;
+}
+
+void ws_timer_schedule(ws_timerwheel_t* w, ws_timer_t* t, uint64_t expires_ms) {
+    if (ws_timer_active(t)) timer_unlink(w, t);
+    else w->count++;
+    t->expires_ms = expires_ms;
+    wheel_place(w, t);
+}
+
+void ws_timer_cancel(ws_timerwheel_t* w, ws_timer_t* t) {
+    if (!ws_timer_active(t)) return;
+    timer_unlink(w, t);
+    w->count--;
+}
+
+/* base just entered a new 64-tick block: re-place the matching slot of each level above,
+ * going up while the lower level wrapped too */
+static void wheel_cascade(ws_timerwheel_t* w) {
+    for (int lvl = 1; lvl < WS_WHEEL_LEVELS; lvl++) {
+        unsigned idx = (unsigned)((w->base_ms >> (WS_WHEEL_BITS * lvl)) & WS_WHEEL_MASK);
+        ws_timer_t* list = w->slots[lvl][idx];
+        w->slots[lvl][idx] = NULL;
+        w->occupied[lvl] &= ~((uint64_t)1 << idx);
+        while (list) {
+            ws_timer_t* t = list;
+            list = t->next;
+            wheel_place(w, t);
+        }
+        if (idx != 0) break;
+    }
+}
+
+size_t ws_timerwheel_advance(ws_timerwheel_t* w, uint64_t now_ms) {
+    if (w->count == 0) {
+        if (w->base_ms <= now_ms) w->base_ms = now_ms + 1;
+        return 0;
+    }
+    while (w->base_ms <= now_ms) {
+        unsigned idx = (unsigned)(w->base_ms & WS_WHEEL_MASK);
+        if (idx == 0) wheel_cascade(w);
+        uint64_t occ = w->occupied[0] >> idx;
+        if (!occ) {
+            /* Nothing left in this lap: jump to the next block (and its cascade) */
+            uint64_t next = (w->base_ms | WS_WHEEL_MASK) + 1;
+            w->base_ms = next <= now_ms + 1 ? next : now_ms + 1;
+            continue;
+        }
+        uint64_t at = w->base_ms + (uint64_t)__builtin_ctzll(occ);
+        if (at > now_ms) { w->base_ms = now_ms + 1; break; }
+        unsigned slot = (unsigned)(at & WS_WHEEL_MASK);
+        while (w->slots[0][slot]) {
+            ws_timer_t* t = w->slots[0][slot];
+            timer_unlink(w, t);
+            t->slot = WS_WHEEL_SLOTS;
+            timer_link(&w->expired, t);
+        }
+        w->base_ms = at + 1;
+    }
+    /* Taken one at a time from the head, so a callback may cancel any timer still waiting */
+    size_t fired = 0;
+    while (w->expired) {
+        ws_timer_t* t = w->expired;
+        timer_unlink(w, t);
+        w->count--;
+        t->fn(t, now_ms);
+        fired++;
+    }
+    return fired;
+}
+
+static uint64_t rotr64(uint64_t x, unsigned r) {
+    return r ? (x >> r) | (x << (64 - r)) : x;
+}
+
+int ws_timerwheel_next_ms(const ws_timerwheel_t* w, uint64_t now_ms, int max_ms) {
+    if (w->count == 0) return -1;
+    uint64_t base = w->base_ms;
+    uint64_t occ = w->occupied[0];
+    unsigned idx = (unsigned)(base & WS_WHEEL_MASK);
+    uint64_t first = UINT64_MAX;
+    if (occ >> idx) {
+        first = base + (uint64_t)__builtin_ctzll(occ >> idx);
+    } else if (occ) {
+        first = (base | WS_WHEEL_MASK) + 1 + (uint64_t)__builtin_ctzll(occ); /* next lap */
+    }
+    /* Upper levels: when base next enters the block of an occupied slot */
+    for (int lvl = 1; lvl < WS_WHEEL_LEVELS; lvl++) {
+        if (!w->occupied[lvl]) continue;
+        unsigned shift = (unsigned)(WS_WHEEL_BITS * lvl);
+        uint64_t start = (base + ((uint64_t)1 << shift) - 1) >> shift;
+        uint64_t rot = rotr64(w->occupied[lvl], (unsigned)(start & WS_WHEEL_MASK));
+        uint64_t at = (start + (uint64_t)__builtin_ctzll(rot)) << shift;
+        if (at < first) first = at;
+    }
+    if (first <= now_ms) return 0;
+    uint64_t wait = first - now_ms;
+    if (max_ms >= 0 && wait > (uint64_t)max_ms) return max_ms;
+    return wait > (uint64_t)INT32_MAX ? INT32_MAX : (int)wait;
+}
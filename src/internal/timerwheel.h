@@ -0,0 +1,51 @@
+#ifndef WIBESOCKET_INTERNAL_TIMERWHEEL_H
+#define WIBESOCKET_INTERNAL_TIMERWHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Hierarchical timer wheel with 1 ms ticks: 4 levels of 64 slots cover 2^24 ms (about 4.6
+ * hours); later deadlines wait in the last slot and are re-placed when it comes round.
+ * Timers are intrusive and doubly linked, so schedule and cancel are O(1); advancing
+ * cascades each timer down at most once per level. A bitmap per level lets advance and
+ * next_ms skip empty slots. Single-threaded: owned by one loop. */
+#define WS_WHEEL_BITS   6
+#define WS_WHEEL_SLOTS  (1 << WS_WHEEL_BITS)
+#define WS_WHEEL_LEVELS 4
+
+typedef struct ws_timer ws_timer_t;
+typedef void (*ws_timer_fn)(ws_timer_t* t, uint64_t now_ms);
+
+struct ws_timer {
+    ws_timer_t*  next;
+    ws_timer_t** pprev;      /* NULL while not scheduled */
+    uint64_t     expires_ms;
+    ws_timer_fn  fn;
+    uint8_t      level;
+    uint8_t      slot;       /* WS_WHEEL_SLOTS: on the expired list */
+};
+
+typedef struct {
+    uint64_t    base_ms;     /* next tick to process */
+    size_t      count;
+    uint64_t    occupied[WS_WHEEL_LEVELS];
+    ws_timer_t* slots[WS_WHEEL_LEVELS][WS_WHEEL_SLOTS];
+    ws_timer_t* expired;     /* collected by advance, run one at a time */
+} ws_timerwheel_t;
+
+void ws_timerwheel_init(ws_timerwheel_t* w, uint64_t now_ms);
+void ws_timer_init(ws_timer_t* t, ws_timer_fn fn);
+static inline int ws_timer_active(const ws_timer_t* t) { return t->pprev != NULL; }
+
+/* (Re)arm t for expires_ms. Deadlines up to the last advance's now_ms are due one tick later. */
+void ws_timer_schedule(ws_timerwheel_t* w, ws_timer_t* t, uint64_t expires_ms);
+void ws_timer_cancel(ws_timerwheel_t* w, ws_timer_t* t);
+
+/* Milliseconds until the wheel next needs advancing (an expiry or a cascade, never later
+ * than the earliest timer), clamped to max_ms; -1 when empty. */
+int  ws_timerwheel_next_ms(const ws_timerwheel_t* w, uint64_t now_ms, int max_ms);
+/* Fire every timer due by now_ms. Callbacks may schedule or cancel any timer, themselves
+ * included. Returns the number fired. */
+size_t ws_timerwheel_advance(ws_timerwheel_t* w, uint64_t now_ms);
+
+#endif /* WIBESOCKET_INTERNAL_TIMERWHEEL_H */
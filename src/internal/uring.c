@@ -0,0 +1,370 @@
+#include "uring.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+
+#define WS_URING_ENTRIES   64
+#define WS_URING_BUFS      8            /* provided receive buffers, power of two */
+#define WS_URING_BUF_SIZE  (16U * 1024U)
+#define WS_URING_SEND_MAX  (64U * 1024U) /* bytes per SEND SQE in a chain */
+#define WS_URING_CHAIN_MAX 32            /* SQEs per chain */
+#define WS_URING_BGID      0
+
+enum { UD_RECV = 1, UD_SEND = 2, UD_CANCEL = 3, UD_WATCH = 4 };
+
+typedef struct {
+    uint16_t bid;
+    uint32_t off;
+    uint32_t len;
+} ws_uring_held_t;
+
+struct ws_uring {
+    int      ring_fd;
+    int      sock_fd;
+
+    /* submission queue */
+    void*    sq_ptr;
+    size_t   sq_len;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    struct io_uring_sqe* sqes;
+    size_t   sqes_len;
+    unsigned to_submit;
+
+    /* completion queue */
+    void*    cq_ptr;
+    size_t   cq_len;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+
+    /* provided buffers for the multishot recv */
+    struct io_uring_buf_ring* br;
+    size_t   br_len;
+    uint8_t* bufs;
+    ws_uring_held_t held[WS_URING_BUFS]; /* filled buffers not yet copied out, in order */
+    unsigned held_head, held_count;
+    int      recv_armed;
+    int      recv_eof;
+    int      recv_err;
+
+    /* send chain */
+    unsigned chain_outstanding;
+    int      send_err;
+    int      send_done; /* chain finished, not yet observed through ws_uring_send_busy */
+
+    /* extra fd whose readability wakes the ring (multishot poll), -1 if none */
+    int      watch_fd;
+    int      watch_armed;
+    int      closing;   /* destroy in progress: re-arm nothing */
+};
+
+static int sys_setup(unsigned entries, struct io_uring_params* p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags, void* arg, size_t argsz) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static int sys_register(int fd, unsigned op, void* arg, unsigned nr) {
+    return (int)syscall(__NR_io_uring_register, fd, op, arg, nr);
+}
+
+static struct io_uring_sqe* get_sqe(ws_uring_t* u) {
+    unsigned head = __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+    unsigned tail = *u->sq_tail;
+    if (tail - head >= WS_URING_ENTRIES) return NULL;
+    unsigned idx = tail & *u->sq_mask;
+    struct io_uring_sqe* sqe = &u->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    u->sq_array[idx] = idx;
+    __atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    u->to_submit++;
+    return sqe;
+}
+
+static int submit(ws_uring_t* u) {
+    while (u->to_submit) {
+        int n = sys_enter(u->ring_fd, u->to_submit, 0, 0, NULL, 0);
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+            return -1;
+        }
+        u->to_submit -= (unsigned)n;
+    }
+    return 0;
+}
+
+static void buf_recycle(ws_uring_t* u, uint16_t bid) {
+    unsigned short tail = u->br->tail;
+    struct io_uring_buf* b = &u->br->bufs[tail & (WS_URING_BUFS - 1)];
+    b->addr = (uint64_t)(uintptr_t)(u->bufs + (size_t)bid * WS_URING_BUF_SIZE);
+    b->len = WS_URING_BUF_SIZE;
+    b->bid = bid;
+    __atomic_store_n(&u->br->tail, (unsigned short)(tail + 1), __ATOMIC_RELEASE);
+}
+
+static int arm_watch(ws_uring_t* u) {
+    struct io_uring_sqe* sqe = get_sqe(u);
+    if (!sqe) return -1;
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = u->watch_fd;
+    sqe->poll32_events = POLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = UD_WATCH;
+    u->watch_armed = 1;
+    return 0;
+}
+
+static int arm_recv(ws_uring_t* u) {
+    struct io_uring_sqe* sqe = get_sqe(u);
+    if (!sqe) return -1;
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = u->sock_fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = WS_URING_BGID;
+    sqe->user_data = UD_RECV;
+    u->recv_armed = 1;
+    return 0;
+}
+
+/* Drain the completion queue without entering the kernel; returns completions seen. */
+static unsigned reap(ws_uring_t* u) {
+    unsigned head = *u->cq_head;
+    unsigned tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+    unsigned seen = tail - head;
+    for (; head != tail; head++) {
+        struct io_uring_cqe* cqe = &u->cqes[head & *u->cq_mask];
+        switch (cqe->user_data) {
+        case UD_RECV:
+            if (!(cqe->flags & IORING_CQE_F_MORE)) u->recv_armed = 0;
+            if (cqe->res > 0 && (cqe->flags & IORING_CQE_F_BUFFER)) {
+                unsigned slot = (u->held_head + u->held_count) % WS_URING_BUFS;
+                u->held[slot].bid = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+                u->held[slot].off = 0;
+                u->held[slot].len = (uint32_t)cqe->res;
+                u->held_count++;
+            } else if (cqe->res == 0) {
+                u->recv_eof = 1;
+            } else if (cqe->res != -ENOBUFS && cqe->res != -ECANCELED) {
+                u->recv_err = 1;
+            }
+            break;
+        case UD_WATCH:
+            if (!(cqe->flags & IORING_CQE_F_MORE)) u->watch_armed = 0;
+            break;
+        case UD_SEND:
+            if (cqe->res < 0) u->send_err = 1;
+            if (u->chain_outstanding && --u->chain_outstanding == 0) u->send_done = 1;
+            break;
+        default:
+            break;
+        }
+    }
+    __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+    return seen;
+}
+
+ws_uring_t* ws_uring_create(int sock_fd) {
+    ws_uring_t* u = (ws_uring_t*)calloc(1, sizeof(*u));
+    if (!u) return NULL;
+    u->sock_fd = sock_fd;
+    u->watch_fd = -1;
+    struct io_uring_params p; memset(&p, 0, sizeof(p));
+    u->ring_fd = sys_setup(WS_URING_ENTRIES, &p);
+    if (u->ring_fd < 0) { free(u); return NULL; }
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP)) goto fail;
+
+    u->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    u->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (u->cq_len > u->sq_len) u->sq_len = u->cq_len;
+    u->sq_ptr = mmap(NULL, u->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_SQ_RING);
+    if (u->sq_ptr == MAP_FAILED) { u->sq_ptr = NULL; goto fail; }
+    u->cq_ptr = u->sq_ptr; /* single mmap */
+    u->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = (struct io_uring_sqe*)mmap(NULL, u->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                         u->ring_fd, IORING_OFF_SQES);
+    if (u->sqes == MAP_FAILED) { u->sqes = NULL; goto fail; }
+    uint8_t* sq = (uint8_t*)u->sq_ptr;
+    u->sq_head = (unsigned*)(sq + p.sq_off.head);
+    u->sq_tail = (unsigned*)(sq + p.sq_off.tail);
+    u->sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+    u->sq_array = (unsigned*)(sq + p.sq_off.array);
+    u->cq_head = (unsigned*)(sq + p.cq_off.head);
+    u->cq_tail = (unsigned*)(sq + p.cq_off.tail);
+    u->cq_mask = (unsigned*)(sq + p.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe*)(sq + p.cq_off.cqes);
+
+    /* Provided buffer ring (kernel 5.19+) */
+    u->br_len = WS_URING_BUFS * sizeof(struct io_uring_buf);
+    u->br = (struct io_uring_buf_ring*)mmap(NULL, u->br_len, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (u->br == MAP_FAILED) { u->br = NULL; goto fail; }
+    u->bufs = (uint8_t*)malloc((size_t)WS_URING_BUFS * WS_URING_BUF_SIZE);
+    if (!u->bufs) goto fail;
+    struct io_uring_buf_reg reg; memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)u->br;
+    reg.ring_entries = WS_URING_BUFS;
+    reg.bgid = WS_URING_BGID;
+    if (sys_register(u->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) goto fail;
+    u->br->tail = 0;
+    for (uint16_t i = 0; i < WS_URING_BUFS; i++) buf_recycle(u, i);
+
+    if (arm_recv(u) < 0 || submit(u) < 0) goto fail;
+    return u;
+fail:
+    ws_uring_destroy(u);
+    return NULL;
+}
+
+int ws_uring_fd(const ws_uring_t* u) {
+    return u->ring_fd;
+}
+
+int ws_uring_watch(ws_uring_t* u, int fd) {
+    u->watch_fd = fd;
+    return (arm_watch(u) < 0 || submit(u) < 0) ? -1 : 0;
+}
+
+/* Enter until at least one completion or timeout_ms (-1 infinite); io_uring_enter's result. */
+static int enter_wait(ws_uring_t* u, int timeout_ms) {
+    int rc;
+    if (timeout_ms < 0) {
+        rc = sys_enter(u->ring_fd, u->to_submit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+    } else {
+        struct __kernel_timespec ts;
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000LL;
+        struct io_uring_getevents_arg arg; memset(&arg, 0, sizeof(arg));
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+        rc = sys_enter(u->ring_fd, u->to_submit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                       &arg, sizeof(arg));
+    }
+    if (rc >= 0) u->to_submit -= (unsigned)rc < u->to_submit ? (unsigned)rc : u->to_submit;
+    return rc;
+}
+
+void ws_uring_destroy(ws_uring_t* u) {
+    if (!u) return;
+    u->closing = 1;
+    if (u->sq_ptr && u->sqes && (u->recv_armed || u->chain_outstanding || u->watch_armed)) {
+        /* Nothing may still be writing into bufs once they are freed */
+        struct io_uring_sqe* sqe = get_sqe(u);
+        if (sqe) {
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = -1;
+            sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+            sqe->user_data = UD_CANCEL;
+        }
+        (void)submit(u);
+        for (int spins = 0; spins < 1000; spins++) {
+            reap(u);
+            if (!u->recv_armed && !u->chain_outstanding && !u->watch_armed) break;
+            (void)enter_wait(u, 10);
+        }
+    }
+    if (u->ring_fd >= 0) close(u->ring_fd);
+    if (u->sqes) munmap(u->sqes, u->sqes_len);
+    if (u->sq_ptr) munmap(u->sq_ptr, u->sq_len);
+    if (u->br) munmap(u->br, u->br_len);
+    free(u->bufs);
+    free(u);
+}
+
+/* The multishot stops on ENOBUFS (or after errors the kernel treats as terminal); re-arm
+ * once buffers are back, unless the stream has ended */
+static void rearm_recv(ws_uring_t* u) {
+    if (u->closing) return;
+    if (u->watch_fd >= 0 && !u->watch_armed && (arm_watch(u) < 0 || submit(u) < 0)) u->recv_err = 1;
+    if (u->recv_armed || u->recv_eof || u->recv_err || u->held_count >= WS_URING_BUFS) return;
+    if (arm_recv(u) < 0 || submit(u) < 0) u->recv_err = 1;
+}
+
+ssize_t ws_uring_recv(ws_uring_t* u, uint8_t* dst, size_t cap) {
+    reap(u);
+    size_t n = 0;
+    while (u->held_count && n < cap) {
+        ws_uring_held_t* h = &u->held[u->held_head];
+        size_t take = h->len - h->off;
+        if (take > cap - n) take = cap - n;
+        memcpy(dst + n, u->bufs + (size_t)h->bid * WS_URING_BUF_SIZE + h->off, take);
+        n += take;
+        h->off += (uint32_t)take;
+        if (h->off == h->len) {
+            buf_recycle(u, h->bid);
+            u->held_head = (u->held_head + 1) % WS_URING_BUFS;
+            u->held_count--;
+        }
+    }
+    rearm_recv(u);
+    if (n) return (ssize_t)n;
+    if (u->held_count) return 0;
+    if (u->recv_err) return -1;
+    if (u->recv_eof) return WS_URING_EOF;
+    return 0;
+}
+
+int ws_uring_wait(ws_uring_t* u, int timeout_ms) {
+    /* A completion reaped here (say, the end of a send chain) is news the caller has not
+     * acted on yet: report it rather than sleeping on top of it */
+    unsigned seen = reap(u);
+    /* The stop may only show up now: without a recv armed, nothing would ever complete */
+    rearm_recv(u);
+    if (seen || u->send_done || u->held_count || u->recv_eof || u->recv_err) return 1;
+    if (enter_wait(u, timeout_ms) < 0) {
+        if (errno == ETIME) return 0;
+        if (errno != EINTR) return -1;
+        /* interrupted: let the caller re-check its state */
+    }
+    /* Any completion counts, including one that only finished a send chain */
+    return 1;
+}
+
+ssize_t ws_uring_send(ws_uring_t* u, const uint8_t* p, size_t len) {
+    reap(u);
+    if (u->send_err) return -1;
+    if (u->chain_outstanding || len == 0) return 0;
+    size_t off = 0;
+    unsigned k = 0;
+    struct io_uring_sqe* prev = NULL;
+    while (off < len && k < WS_URING_CHAIN_MAX) {
+        struct io_uring_sqe* sqe = get_sqe(u);
+        if (!sqe) break;
+        size_t n = len - off;
+        if (n > WS_URING_SEND_MAX) n = WS_URING_SEND_MAX;
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = u->sock_fd;
+        sqe->addr = (uint64_t)(uintptr_t)(p + off);
+        sqe->len = (uint32_t)n;
+        /* WAITALL: a short send would break ordering with the next link, so finish or fail */
+        sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+        sqe->user_data = UD_SEND;
+        if (prev) prev->flags |= IOSQE_IO_LINK;
+        prev = sqe;
+        off += n; k++;
+    }
+    u->chain_outstanding = k;
+    if (submit(u) < 0) { u->send_err = 1; return -1; }
+    reap(u);
+    return (ssize_t)off;
+}
+
+int ws_uring_send_busy(ws_uring_t* u) {
+    reap(u);
+    if (u->send_err) return -1;
+    if (u->chain_outstanding) return 1;
+    u->send_done = 0;
+    return 0;
+}
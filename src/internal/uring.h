@@ -0,0 +1,39 @@
+#ifndef WIBESOCKET_INTERNAL_URING_H
+#define WIBESOCKET_INTERNAL_URING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/* Per-connection io_uring engine (raw syscalls, no liburing). Receive is one multishot RECV
+ * landing in a ring of provided buffers, drained into the caller's receive ring; sends go out
+ * as a chain of linked SEND SQEs so ordering holds without waiting between them. Readiness
+ * and the read are a single completion, so a wait plus read costs one io_uring_enter. */
+typedef struct ws_uring ws_uring_t;
+
+#define WS_URING_EOF (-2)
+
+/* NULL where io_uring or provided buffer rings are unavailable; callers keep using epoll. */
+ws_uring_t* ws_uring_create(int sock_fd);
+/* Cancels outstanding operations and waits for them before releasing the buffers. */
+void        ws_uring_destroy(ws_uring_t* u);
+/* Pollable: readable while completions are queued, so a shared loop can watch it. */
+int         ws_uring_fd(const ws_uring_t* u);
+/* Also complete (and so wake waiters and the ring fd) whenever fd turns readable. */
+int         ws_uring_watch(ws_uring_t* u, int fd);
+
+/* Copy received bytes into dst. Returns bytes copied, 0 if nothing has arrived, WS_URING_EOF
+ * once the peer closed and everything was handed out, or -1 on a socket error. Never blocks. */
+ssize_t     ws_uring_recv(ws_uring_t* u, uint8_t* dst, size_t cap);
+/* Block until a completion arrives or timeout_ms passes (-1 infinite). Returns 1 without
+ * sleeping if one was already reaped but not yet acted on (data held, chain finished), 0 on
+ * timeout, -1 on error. */
+int         ws_uring_wait(ws_uring_t* u, int timeout_ms);
+
+/* Submit [p, p + len) as linked SENDs. One chain at a time: the memory must stay untouched
+ * until ws_uring_send_busy() reports 0. Returns bytes submitted (may be less than len) or -1. */
+ssize_t     ws_uring_send(ws_uring_t* u, const uint8_t* p, size_t len);
+/* Reap completions; returns 1 while a chain is in flight, 0 when idle, -1 if a send failed. */
+int         ws_uring_send_busy(ws_uring_t* u);
+
+#endif /* WIBESOCKET_INTERNAL_URING_H */
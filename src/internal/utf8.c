@@ -1,36 +1,270 @@
 #include "utf8.h"
 
-bool ws_utf8_is_valid(const uint8_t* s, size_t len) {
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define WS_UTF8_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define WS_UTF8_NEON 1
+#endif
+
+/* Below this the scalar path wins: no setup, and short strings are mostly ASCII anyway */
+#define WS_UTF8_SIMD_MIN 32
+
+void ws_utf8_init(ws_utf8_state_t* st) {
+    st->need = 0; st->lo = 0x80; st->hi = 0xBF;
+}
+
+/* Scalar DFA with an 8-byte ASCII skip. The second byte range encodes the
+ * overlong/surrogate/max-codepoint rules of RFC 3629. */
+static bool feed_scalar(ws_utf8_state_t* st, const uint8_t* s, size_t len) {
+    uint8_t need = st->need, lo = st->lo, hi = st->hi;
     size_t i = 0;
     while (i < len) {
+        if (!need) {
+            while (i + 8 <= len) {
+                uint64_t w; memcpy(&w, s + i, 8);
+                if (w & 0x8080808080808080ULL) break;
+                i += 8;
+            }
+            if (i == len) break;
+        }
         uint8_t c = s[i++];
+        if (need) {
+            if (c < lo || c > hi) return false;
+            need--; lo = 0x80; hi = 0xBF;
+            continue;
+        }
         if (c < 0x80) continue; /* ASCII */
-        if ((c >> 5) == 0x6) {
-            if (i >= len) return false; /* need 1 cont */
-            uint8_t c1 = s[i++];
-            if ((c1 & 0xC0) != 0x80) return false;
-            uint32_t cp = ((uint32_t)(c & 0x1F) << 6) | (uint32_t)(c1 & 0x3F);
-            if (cp < 0x80) return false; /* overlong */
-        } else if ((c >> 4) == 0xE) {
-            if (i + 1 >= len) return false; /* need 2 cont */
-            uint8_t c1 = s[i++]; uint8_t c2 = s[i++];
-            if ((c1 & 0xC0) != 0x80 || (c2 & 0xC0) != 0x80) return false;
-            uint32_t cp = ((uint32_t)(c & 0x0F) << 12) | ((uint32_t)(c1 & 0x3F) << 6) | (uint32_t)(c2 & 0x3F);
-            if (cp < 0x800) return false; /* overlong */
-            if (cp >= 0xD800 && cp <= 0xDFFF) return false; /* surrogates */
-        } else if ((c >> 3) == 0x1E) {
-            if (i + 2 >= len) return false; /* need 3 cont */
-            uint8_t c1 = s[i++], c2 = s[i++], c3 = s[i++];
-            if ((c1 & 0xC0) != 0x80 || (c2 & 0xC0) != 0x80 || (c3 & 0xC0) != 0x80) return false;
-            uint32_t cp = ((uint32_t)(c & 0x07) << 18) | ((uint32_t)(c1 & 0x3F) << 12) |
-                          ((uint32_t)(c2 & 0x3F) << 6) | (uint32_t)(c3 & 0x3F);
-            if (cp < 0x10000) return false; /* overlong */
-            if (cp > 0x10FFFF) return false;
+        if (c >= 0xC2 && c <= 0xDF) { need = 1; }
+        else if (c == 0xE0)          { need = 2; lo = 0xA0; }
+        else if (c == 0xED)          { need = 2; hi = 0x9F; }
+        else if (c >= 0xE1 && c <= 0xEF) { need = 2; }
+        else if (c == 0xF0)          { need = 3; lo = 0x90; }
+        else if (c >= 0xF1 && c <= 0xF3) { need = 3; }
+        else if (c == 0xF4)          { need = 3; hi = 0x8F; }
+        else return false;
+    }
+    st->need = need; st->lo = lo; st->hi = hi;
+    return true;
+}
+
+static bool validate_scalar(const uint8_t* s, size_t len) {
+    ws_utf8_state_t st; ws_utf8_init(&st);
+    return feed_scalar(&st, s, len) && ws_utf8_complete(&st);
+}
+
+/* Lookup-table validation (Keiser & Lemire, "Validating UTF-8 In Less Than One Instruction
+ * Per Byte"): each byte pair is classified by three 16-entry nibble tables whose AND is
+ * non-zero exactly for invalid pairs; 3rd/4th-byte continuations are checked separately. */
+#define TOO_SHORT   (1 << 0)
+#define TOO_LONG    (1 << 1)
+#define OVERLONG_3  (1 << 2)
+#define TOO_LARGE   (1 << 3)
+#define SURROGATE   (1 << 4)
+#define OVERLONG_2  (1 << 5)
+#define TOO_LARGE_1000 (1 << 6)
+#define OVERLONG_4  (1 << 6)
+#define TWO_CONTS   (1 << 7)
+#define CARRY       (TOO_SHORT | TOO_LONG | TWO_CONTS)
+
+static const uint8_t k_byte1_high[16] = {
+    /* 0_______ ASCII */
+    TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+    /* 10______ continuation */
+    TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+    /* 1100____ */ TOO_SHORT | OVERLONG_2,
+    /* 1101____ */ TOO_SHORT,
+    /* 1110____ */ TOO_SHORT | OVERLONG_3 | SURROGATE,
+    /* 1111____ */ TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4,
+};
+static const uint8_t k_byte1_low[16] = {
+    /* ____0000 */ CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+    /* ____0001 */ CARRY | OVERLONG_2,
+    /* ____001_ */ CARRY, CARRY,
+    /* ____0100 */ CARRY | TOO_LARGE,
+    /* ____0101 */ CARRY | TOO_LARGE | TOO_LARGE_1000,
+    /* ____011_ */ CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+    /* ____1___ */ CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+                   CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+                   CARRY | TOO_LARGE | TOO_LARGE_1000,
+    /* ____1101 */ CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+                   CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+};
+static const uint8_t k_byte2_high[16] = {
+    /* 0_______ */ TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+    /* 1000____ */ TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+    /* 1001____ */ TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+    /* 101_____ */ TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+                   TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+    /* 11______ */ TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+};
+/* A block whose last bytes exceed these ends inside a multi-byte sequence */
+static const uint8_t k_max_tail[16] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1,
+};
+
+#if defined(WS_UTF8_X86)
+__attribute__((target("ssse3")))
+static __m128i ssse3_block_errors(__m128i in, __m128i prev) {
+    const __m128i nib = _mm_set1_epi8(0x0F);
+    const __m128i t1 = _mm_loadu_si128((const __m128i*)k_byte1_high);
+    const __m128i t2 = _mm_loadu_si128((const __m128i*)k_byte1_low);
+    const __m128i t3 = _mm_loadu_si128((const __m128i*)k_byte2_high);
+    __m128i prev1 = _mm_alignr_epi8(in, prev, 15);
+    __m128i b1h = _mm_shuffle_epi8(t1, _mm_and_si128(_mm_srli_epi16(prev1, 4), nib));
+    __m128i b1l = _mm_shuffle_epi8(t2, _mm_and_si128(prev1, nib));
+    __m128i b2h = _mm_shuffle_epi8(t3, _mm_and_si128(_mm_srli_epi16(in, 4), nib));
+    __m128i sc = _mm_and_si128(_mm_and_si128(b1h, b1l), b2h);
+    /* Bytes 2/3 back being >= 0xE0 / >= 0xF0 demand a continuation here (high bit after subs) */
+    __m128i third = _mm_subs_epu8(_mm_alignr_epi8(in, prev, 14), _mm_set1_epi8((char)(0xE0 - 0x80)));
+    __m128i fourth = _mm_subs_epu8(_mm_alignr_epi8(in, prev, 13), _mm_set1_epi8((char)(0xF0 - 0x80)));
+    __m128i must23 = _mm_and_si128(_mm_or_si128(third, fourth), _mm_set1_epi8((char)0x80));
+    return _mm_xor_si128(must23, sc);
+}
+
+__attribute__((target("ssse3")))
+static bool validate_ssse3(const uint8_t* s, size_t len) {
+    const __m128i max_tail = _mm_loadu_si128((const __m128i*)k_max_tail);
+    __m128i prev = _mm_setzero_si128(), err = _mm_setzero_si128(), incomplete = _mm_setzero_si128();
+    size_t i = 0;
+    /* ASCII fast path: 32 bytes per check */
+    for (;;) {
+        while (i + 32 <= len) {
+            __m128i a = _mm_loadu_si128((const __m128i*)(s + i));
+            __m128i b = _mm_loadu_si128((const __m128i*)(s + i + 16));
+            if (_mm_movemask_epi8(_mm_or_si128(a, b)) != 0) break;
+            err = _mm_or_si128(err, incomplete);
+            incomplete = _mm_setzero_si128();
+            i += 32;
+        }
+        if (i + 16 > len) break;
+        __m128i in = _mm_loadu_si128((const __m128i*)(s + i));
+        if (_mm_movemask_epi8(in) == 0) {
+            err = _mm_or_si128(err, incomplete);
+            incomplete = _mm_setzero_si128();
         } else {
-            return false;
+            err = _mm_or_si128(err, ssse3_block_errors(in, prev));
+            incomplete = _mm_subs_epu8(in, max_tail);
+            prev = in;
         }
+        i += 16;
     }
-    return true;
+    if (i < len) {
+        /* Zero padding is ASCII, so a sequence cut by the end still shows up as TOO_SHORT */
+        uint8_t tail[16] = {0};
+        memcpy(tail, s + i, len - i);
+        __m128i in = _mm_loadu_si128((const __m128i*)tail);
+        err = _mm_or_si128(err, ssse3_block_errors(in, prev));
+        incomplete = _mm_setzero_si128();
+    }
+    err = _mm_or_si128(err, incomplete);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(err, _mm_setzero_si128())) == 0xFFFF;
 }
+#endif
 
+#if defined(WS_UTF8_NEON)
+static uint8x16_t neon_block_errors(uint8x16_t in, uint8x16_t prev) {
+    const uint8x16_t nib = vdupq_n_u8(0x0F);
+    uint8x16_t prev1 = vextq_u8(prev, in, 15);
+    uint8x16_t b1h = vqtbl1q_u8(vld1q_u8(k_byte1_high), vshrq_n_u8(prev1, 4));
+    uint8x16_t b1l = vqtbl1q_u8(vld1q_u8(k_byte1_low), vandq_u8(prev1, nib));
+    uint8x16_t b2h = vqtbl1q_u8(vld1q_u8(k_byte2_high), vshrq_n_u8(in, 4));
+    uint8x16_t sc = vandq_u8(vandq_u8(b1h, b1l), b2h);
+    uint8x16_t third = vqsubq_u8(vextq_u8(prev, in, 14), vdupq_n_u8(0xE0 - 0x80));
+    uint8x16_t fourth = vqsubq_u8(vextq_u8(prev, in, 13), vdupq_n_u8(0xF0 - 0x80));
+    uint8x16_t must23 = vandq_u8(vorrq_u8(third, fourth), vdupq_n_u8(0x80));
+    return veorq_u8(must23, sc);
+}
 
+static bool validate_neon(const uint8_t* s, size_t len) {
+    const uint8x16_t max_tail = vld1q_u8(k_max_tail);
+    uint8x16_t prev = vdupq_n_u8(0), err = vdupq_n_u8(0), incomplete = vdupq_n_u8(0);
+    size_t i = 0;
+    for (;;) {
+        while (i + 32 <= len) {
+            uint8x16_t a = vld1q_u8(s + i), b = vld1q_u8(s + i + 16);
+            if (vmaxvq_u8(vorrq_u8(a, b)) >= 0x80) break;
+            err = vorrq_u8(err, incomplete);
+            incomplete = vdupq_n_u8(0);
+            i += 32;
+        }
+        if (i + 16 > len) break;
+        uint8x16_t in = vld1q_u8(s + i);
+        if (vmaxvq_u8(in) < 0x80) {
+            err = vorrq_u8(err, incomplete);
+            incomplete = vdupq_n_u8(0);
+        } else {
+            err = vorrq_u8(err, neon_block_errors(in, prev));
+            incomplete = vqsubq_u8(in, max_tail);
+            prev = in;
+        }
+        i += 16;
+    }
+    if (i < len) {
+        uint8_t tail[16] = {0};
+        memcpy(tail, s + i, len - i);
+        err = vorrq_u8(err, neon_block_errors(vld1q_u8(tail), prev));
+        incomplete = vdupq_n_u8(0);
+    }
+    err = vorrq_u8(err, incomplete);
+    return vmaxvq_u8(err) == 0;
+}
+#endif
+
+typedef bool (*ws_utf8_fn)(const uint8_t*, size_t);
+
+static bool validate_resolve(const uint8_t* s, size_t len);
+
+static ws_utf8_fn g_validate = validate_resolve;
+
+static bool validate_resolve(const uint8_t* s, size_t len) {
+    ws_utf8_fn fn = validate_scalar;
+#if defined(WS_UTF8_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3")) fn = validate_ssse3;
+#elif defined(WS_UTF8_NEON)
+    fn = validate_neon;
+#endif
+    __atomic_store_n(&g_validate, fn, __ATOMIC_RELAXED);
+    return fn(s, len);
+}
+
+/* Length of the prefix that ends on a codepoint boundary (drops a trailing partial sequence). */
+static size_t complete_prefix(const uint8_t* s, size_t len) {
+    for (size_t k = 1; k <= 3 && k <= len; k++) {
+        uint8_t b = s[len - k];
+        if (b < 0x80) return len;
+        if (b >= 0xC0) {
+            size_t seq = (b >= 0xF0) ? 4 : (b >= 0xE0) ? 3 : 2;
+            return (k < seq) ? len - k : len;
+        }
+    }
+    return len;
+}
+
+bool ws_utf8_feed(ws_utf8_state_t* st, const uint8_t* s, size_t len) {
+    size_t i = 0;
+    /* Finish a codepoint carried over from the previous chunk */
+    if (st->need) {
+        size_t n = (st->need < len) ? st->need : len;
+        if (!feed_scalar(st, s, n)) return false;
+        i = n;
+    }
+    if (len - i >= WS_UTF8_SIMD_MIN) {
+        /* Vector kernel on whole codepoints; a split sequence at the end goes to the DFA */
+        size_t cut = complete_prefix(s + i, len - i);
+        ws_utf8_fn fn = __atomic_load_n(&g_validate, __ATOMIC_RELAXED);
+        if (!fn(s + i, cut)) return false;
+        i += cut;
+    }
+    return feed_scalar(st, s + i, len - i);
+}
+
+bool ws_utf8_is_valid(const uint8_t* s, size_t len) {
+    ws_utf8_state_t st; ws_utf8_init(&st);
+    return ws_utf8_feed(&st, s, len) && ws_utf8_complete(&st);
+}
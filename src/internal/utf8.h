@@ -5,9 +5,22 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+/* Incremental validator state: a codepoint may be split across chunks/fragments. */
+typedef struct {
+    uint8_t need; /* continuation bytes still expected */
+    uint8_t lo;   /* allowed range of the next continuation byte */
+    uint8_t hi;
+} ws_utf8_state_t;
+
+void ws_utf8_init(ws_utf8_state_t* st);
+
+/* Validate the next chunk of a UTF-8 stream. Returns false as soon as the stream is invalid. */
+bool ws_utf8_feed(ws_utf8_state_t* st, const uint8_t* data, size_t len);
+
+/* True if the stream validated so far ends on a codepoint boundary. */
+static inline bool ws_utf8_complete(const ws_utf8_state_t* st) { return st->need == 0; }
+
 /* Validate UTF-8 per RFC 3629 (no surrogates, max U+10FFFF). */
 bool ws_utf8_is_valid(const uint8_t* data, size_t len);
 
 #endif /* WIBESOCKET_INTERNAL_UTF8_H */
-
-
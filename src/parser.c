@@ -1,13 +1,10 @@
-/* Incremental WebSocket frame parser per RFC 6455 (no extensions) */
+/* Incremental WebSocket frame parser per RFC 6455 (RSV1 for permessage-deflate, RFC 7692) */
 #include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include "internal/frame.h"
 #include "internal/utf8.h"
-
-static void ws_apply_mask(uint8_t* dst, const uint8_t* src, size_t len, const uint8_t mask[4]) {
-    for (size_t i = 0; i < len; i++) dst[i] = (uint8_t)(src[i] ^ mask[i & 3]);
-}
+#include "internal/mask.h"
 
 static bool ws_is_valid_close_code(uint16_t code) {
     if (code == 1000 || code == 1001 || code == 1002 || code == 1003 ||
@@ -23,44 +20,65 @@ void ws_parser_init(ws_parser_t* p, uint64_t max_frame_size) {
     p->hdr_need = 2; /* first 2 header bytes */
 }
 
-static int ws_parse_header(ws_parser_t* p) {
-    if (p->hdr_have < p->hdr_need) return 0; /* need more */
-    const uint8_t* h = p->hdr_bytes;
+static uint64_t ws_load_be64(const uint8_t* s) {
+    uint64_t v; memcpy(&v, s, 8);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+/* Header length implied by the second byte: 2, plus 2 or 8 extended length, plus 4 mask */
+static size_t ws_header_size(uint8_t b1) {
+    uint8_t plen7 = b1 & 0x7FU;
+    size_t ext = plen7 < 126 ? 0 : (plen7 == 126 ? 2 : 8);
+    return 2 + ext + ((b1 & 0x80U) ? 4 : 0);
+}
+
+/* Rules that only need the first byte, so a bad frame is refused before its length arrives */
+static int ws_check_first_byte(const ws_parser_t* p, uint8_t b0) {
+    uint8_t rsv = (uint8_t)((b0 >> 4) & 0x07U);
+    uint8_t opcode = b0 & 0x0FU;
+    /* RSV1 only on the first frame of a data message, and only once deflate was negotiated */
+    if (rsv != 0) {
+        bool first_data = opcode == WS_OPCODE_TEXT || opcode == WS_OPCODE_BINARY;
+        if (rsv != WS_RSV1 || !p->allow_rsv1 || !first_data) return WS_PARSER_ERROR_PROTOCOL;
+    }
+    if (opcode >= 0x3 && opcode <= 0x7) return WS_PARSER_ERROR_PROTOCOL; /* reserved */
+    if (opcode >= 0xB) return WS_PARSER_ERROR_PROTOCOL; /* reserved */
+    return 0;
+}
+
+/* Decode a whole header of ws_header_size(h[1]) bytes in place. Returns 1 or an error. */
+static int ws_decode_header(ws_parser_t* p, const uint8_t* h) {
     uint8_t b0 = h[0];
     uint8_t b1 = h[1];
+    int rc = ws_check_first_byte(p, b0);
+    if (rc < 0) return rc;
     p->cur.fin = (b0 & 0x80U) != 0;
     p->cur.rsv = (uint8_t)((b0 >> 4) & 0x07U);
     p->cur.opcode = (ws_opcode_t)(b0 & 0x0FU);
     p->cur.masked = (b1 & 0x80U) != 0;
-    uint64_t plen7 = (uint64_t)(b1 & 0x7FU);
 
-    if (p->cur.rsv != 0) return WS_PARSER_ERROR_PROTOCOL;
-    if (p->cur.opcode >= 0x3 && p->cur.opcode <= 0x7) return WS_PARSER_ERROR_PROTOCOL; /* reserved */
-    if (p->cur.opcode >= 0xB) return WS_PARSER_ERROR_PROTOCOL; /* reserved */
-
-    size_t need = 2;
-    if (plen7 <= 125) {
-        p->cur.payload_len = plen7;
-    } else if (plen7 == 126) {
-        need += 2;
-        if (p->hdr_have < need) { p->hdr_need = need; return 0; }
+    size_t pos = 2;
+    switch (b1 & 0x7FU) {
+    case 126:
         p->cur.payload_len = ((uint64_t)h[2] << 8) | (uint64_t)h[3];
-    } else { /* 127 */
-        need += 8;
-        if (p->hdr_have < need) { p->hdr_need = need; return 0; }
-        uint64_t v = 0;
-        for (int i = 0; i < 8; i++) v = (v << 8) | h[2 + i];
-        p->cur.payload_len = v;
+        pos = 4;
+        break;
+    case 127:
+        p->cur.payload_len = ws_load_be64(h + 2);
+        pos = 10;
         /* Disallow lengths with MSB set per RFC (must not be negative when interpreted as signed) */
-        if (h[2] & 0x80U) return WS_PARSER_ERROR_PROTOCOL;
-    }
-
-    size_t after_len = (size_t)(need);
-    if (p->cur.masked) {
-        need += 4;
-        if (p->hdr_have < need) { p->hdr_need = need; return 0; }
-        memcpy(p->cur.mask_key, h + after_len, 4);
+        if (p->cur.payload_len >> 63) return WS_PARSER_ERROR_PROTOCOL;
+        break;
+    default:
+        p->cur.payload_len = b1 & 0x7FU;
+        break;
     }
+    if (p->cur.masked) memcpy(p->cur.mask_key, h + pos, 4);
+    if ((p->masking == WS_MASK_REQUIRED && !p->cur.masked) ||
+        (p->masking == WS_MASK_FORBIDDEN && p->cur.masked)) return WS_PARSER_ERROR_PROTOCOL;
 
     /* Control frame rules */
     bool is_control = (p->cur.opcode & 0x08U) != 0;
@@ -71,9 +89,23 @@ static int ws_parse_header(ws_parser_t* p) {
 
     if (p->cur.payload_len > p->max_frame_size) return WS_PARSER_ERROR_TOO_LARGE;
 
+    /* Fragmentation rules are checked up front so chunks can be classified as they stream */
+    if (!is_control) {
+        if (p->cur.opcode == WS_OPCODE_CONTINUATION) {
+            if (!p->in_fragmented_message) return WS_PARSER_ERROR_PROTOCOL;
+        } else if (p->in_fragmented_message) {
+            return WS_PARSER_ERROR_PROTOCOL; /* new data while mid-frag */
+        }
+    }
+
     return 1; /* header complete */
 }
 
+static bool ws_parser_is_text(const ws_parser_t* p) {
+    return p->cur.opcode == WS_OPCODE_TEXT ||
+           (p->cur.opcode == WS_OPCODE_CONTINUATION && p->first_fragment_opcode == WS_OPCODE_TEXT);
+}
+
 ws_parser_status_t ws_parser_feed(ws_parser_t* p,
                                   const uint8_t* data, size_t len,
                                   size_t* consumed,
@@ -82,21 +114,39 @@ ws_parser_status_t ws_parser_feed(ws_parser_t* p,
     p->out_payload = NULL;
     p->out_payload_len = 0;
 
-    /* Accumulate header first; ws_parse_header may request more bytes progressively */
-    for (;;) {
-        while (p->hdr_have < p->hdr_need && *consumed < len) {
-            p->hdr_bytes[p->hdr_have++] = data[*consumed];
-            (*consumed)++;
-        }
-        int hdr_status = ws_parse_header(p);
-        if (hdr_status < 0) return (ws_parser_status_t)hdr_status;
-        if (hdr_status == 0) {
-            if (*consumed == len) return WS_PARSER_NEED_MORE;
-            /* Otherwise loop to pull more header bytes now that hdr_need may have increased */
-            continue;
+    while (!p->hdr_done) {
+        const uint8_t* in = data + *consumed;
+        size_t avail = len - *consumed;
+        int hdr_status;
+        size_t hlen;
+        if (p->hdr_have == 0 && avail >= 2 && (hlen = ws_header_size(in[1])) <= avail) {
+            /* Whole header contiguous in the input (the usual case): decode it where it lies */
+            hdr_status = ws_decode_header(p, in);
+            if (hdr_status < 0) return (ws_parser_status_t)hdr_status;
+            *consumed += hlen;
+        } else {
+            /* Header split at a buffer boundary: gather it, sized once the second byte is in */
+            size_t n = p->hdr_need - p->hdr_have;
+            if (n > avail) n = avail;
+            memcpy(p->hdr_bytes + p->hdr_have, in, n);
+            p->hdr_have += n;
+            *consumed += n;
+            if (p->hdr_have < p->hdr_need) return WS_PARSER_NEED_MORE;
+            if (p->hdr_need == 2) {
+                hdr_status = ws_check_first_byte(p, p->hdr_bytes[0]);
+                if (hdr_status < 0) return (ws_parser_status_t)hdr_status;
+                p->hdr_need = ws_header_size(p->hdr_bytes[1]);
+                if (p->hdr_need > 2) continue;
+            }
+            hdr_status = ws_decode_header(p, p->hdr_bytes);
+            if (hdr_status < 0) return (ws_parser_status_t)hdr_status;
         }
         /* Header complete */
-        break;
+        p->hdr_done = true;
+        if (p->cur.opcode == WS_OPCODE_TEXT || p->cur.opcode == WS_OPCODE_BINARY) {
+            p->compressed = (p->cur.rsv & WS_RSV1) != 0;
+        }
+        if (p->cur.opcode == WS_OPCODE_TEXT) ws_utf8_init(&p->utf8);
     }
 
     /* Header complete; now expect payload_len bytes */
@@ -104,49 +154,64 @@ ws_parser_status_t ws_parser_feed(ws_parser_t* p,
     size_t avail = len - *consumed;
     size_t take = (size_t)((need < (uint64_t)avail) ? need : (uint64_t)avail);
     const uint8_t* payload_start = data + *consumed;
+    uint64_t offset = p->payload_read;
     *consumed += take;
     p->payload_read += take;
+    if (p->masking == WS_MASK_REQUIRED && take > 0) {
+        /* Each payload byte is fed once, so unmasking where it lies is safe */
+        ws_mask_copy((uint8_t*)(uintptr_t)payload_start, payload_start, take, p->cur.mask_key, (size_t)(offset & 3));
+    }
 
     /* Expose zero-copy payload view of the chunk we just consumed */
     p->out_payload = payload_start;
     p->out_payload_len = take;
 
-    if (p->payload_read < p->cur.payload_len) {
-        /* Need more data for this frame */
-        if (take == 0) return WS_PARSER_NEED_MORE;
-        /* Provide partial data frames (caller can accumulate); no frame signal yet */
-        return WS_PARSER_NEED_MORE;
+    bool is_control = ((p->cur.opcode & 0x08U) != 0);
+    bool compressed = !is_control && p->compressed;
+    bool is_text = !is_control && !compressed && ws_parser_is_text(p);
+    if (is_text && take > 0 && !ws_utf8_feed(&p->utf8, payload_start, take)) {
+        return WS_PARSER_ERROR_PROTOCOL; /* fail fast on the first bad chunk */
+    }
+    if (is_control && take < p->cur.payload_len) {
+        memcpy(p->ctrl_buf + offset, payload_start, take);
     }
 
-    /* Entire payload read; construct frame */
     ws_parsed_frame_t f;
     f.type = (ws_opcode_t)p->cur.opcode;
     f.payload = p->out_payload;
-    f.payload_len = (size_t)p->out_payload_len; /* could be less than total if spread across feeds */
+    f.payload_len = (size_t)p->out_payload_len;
     f.is_final = p->cur.fin;
+    f.offset = offset;
+    f.frame_len = p->cur.payload_len;
+    f.compressed = compressed;
+
+    if (p->payload_read < p->cur.payload_len) {
+        /* Need more data for this frame */
+        if (take == 0 || is_control) return WS_PARSER_NEED_MORE;
+        /* Provide partial data so the caller can stream or accumulate it */
+        if (out_frame) *out_frame = f;
+        return WS_PARSER_CHUNK;
+    }
+
+    /* Entire payload read */
+    if (is_control && take < p->cur.payload_len) {
+        f.payload = p->ctrl_buf;
+        f.payload_len = (size_t)p->cur.payload_len;
+        f.offset = 0;
+    }
 
     /* Fragmentation tracking */
-    bool is_control = ((p->cur.opcode & 0x08U) != 0);
     if (!is_control) {
         if (p->cur.opcode == WS_OPCODE_CONTINUATION) {
-            if (!p->in_fragmented_message) return WS_PARSER_ERROR_PROTOCOL;
             if (p->cur.fin) p->in_fragmented_message = false;
-        } else { /* data opcode */
-            if (p->in_fragmented_message) return WS_PARSER_ERROR_PROTOCOL; /* new data while mid-frag */
-            if (!p->cur.fin) {
-                p->in_fragmented_message = true;
-                p->first_fragment_opcode = p->cur.opcode;
-            }
+        } else if (!p->cur.fin) { /* data opcode */
+            p->in_fragmented_message = true;
+            p->first_fragment_opcode = p->cur.opcode;
         }
     }
 
-    /* Validate UTF-8 for text frames and close reason if present */
-    if ((p->cur.opcode == WS_OPCODE_TEXT || (p->cur.opcode == WS_OPCODE_CONTINUATION && p->first_fragment_opcode == WS_OPCODE_TEXT)) &&
-        f.payload_len > 0) {
-        if (!ws_utf8_is_valid((const uint8_t*)f.payload, f.payload_len)) {
-            return WS_PARSER_ERROR_PROTOCOL;
-        }
-    }
+    /* A text message must end on a codepoint boundary */
+    if (is_text && p->cur.fin && !ws_utf8_complete(&p->utf8)) return WS_PARSER_ERROR_PROTOCOL;
 
     if (p->cur.opcode == WS_OPCODE_CLOSE) {
         /* Payload must be 0 or >= 2. If >=2, first 2 bytes are code, rest is UTF-8 reason */
@@ -163,23 +228,16 @@ ws_parser_status_t ws_parser_feed(ws_parser_t* p,
     /* Reset for next frame */
     p->hdr_need = 2;
     p->hdr_have = 0;
+    p->hdr_done = false;
     p->payload_read = 0;
 
     if (out_frame) *out_frame = f;
     return WS_PARSER_FRAME;
 }
 
-size_t ws_build_frame(uint8_t* out, size_t out_cap,
-                      int fin, ws_opcode_t opcode,
-                      const uint8_t mask_key[4],
-                      const uint8_t* payload, size_t payload_len) {
-    size_t need = 2;
-    if (payload_len <= 125) need += 0; else if (payload_len <= 0xFFFF) need += 2; else need += 8;
-    if (mask_key) need += 4;
-    need += payload_len;
-    if (need > out_cap) return 0;
-
-    out[0] = (uint8_t)((fin ? 0x80 : 0) | (opcode & 0x0F));
+size_t ws_build_frame_header(uint8_t* out, int fin, uint8_t rsv, ws_opcode_t opcode,
+                             const uint8_t mask_key[4], size_t payload_len) {
+    out[0] = (uint8_t)((fin ? 0x80 : 0) | ((rsv & 0x07U) << 4) | (opcode & 0x0F));
     size_t pos = 2;
     if (payload_len <= 125) {
         out[1] = (uint8_t)payload_len;
@@ -198,9 +256,24 @@ size_t ws_build_frame(uint8_t* out, size_t out_cap,
         memcpy(out + pos, mask_key, 4);
         pos += 4;
     }
+    return pos;
+}
+
+size_t ws_build_frame(uint8_t* out, size_t out_cap,
+                      int fin, ws_opcode_t opcode,
+                      const uint8_t mask_key[4],
+                      const uint8_t* payload, size_t payload_len) {
+    size_t need = 2;
+    if (payload_len <= 125) need += 0; else if (payload_len <= 0xFFFF) need += 2; else need += 8;
+    if (mask_key) need += 4;
+    need += payload_len;
+    if (need > out_cap) return 0;
+
+    size_t pos = ws_build_frame_header(out, fin, 0, opcode, mask_key, payload_len);
     if (payload_len) {
         if (mask_key) {
-            for (size_t i = 0; i < payload_len; i++) out[pos + i] = (uint8_t)(payload[i] ^ mask_key[i & 3]);
+            /* Fused copy + mask: the payload is read once and written once */
+            ws_mask_copy(out + pos, payload, payload_len, mask_key, 0);
         } else if (payload) {
             memcpy(out + pos, payload, payload_len);
         }
@@ -0,0 +1,253 @@
+#define _POSIX_C_SOURCE 200809L /* struct addrinfo, strdup */
+#include "event_loop.h"
+
+#include <netdb.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define WS_POOL_BUCKETS        64
+#define WS_POOL_DEFAULT_WARM   4
+#define WS_POOL_DEFAULT_DNS_MS 30000
+
+struct ws_pool_host {
+    wibesocket_pool_t*  pool;
+    ws_pool_host_t*     next;       /* hash chain */
+    char*               uri;
+    uint64_t            hash;
+    /* Connections the pool holds: [0, nidle) open and ready, [nidle, nowned) connecting.
+     * Never more than warm, so owned has warm slots. */
+    wibesocket_conn_t** owned;
+    size_t              nidle;
+    size_t              nowned;
+    /* One lookup at a time: while it runs, refills wait for its result instead of starting
+     * lookups of their own */
+    int                 resolving;
+    wibesocket_conn_t*  resolver;
+    struct addrinfo*    addrs;      /* ws_addrinfo_dup of the last lookup, NULL when none */
+    uint64_t            addrs_expire_ms;
+};
+
+struct wibesocket_pool {
+    wibesocket_loop_t*  loop;
+    wibesocket_config_t cfg;
+    size_t              warm;
+    uint32_t            dns_ttl_ms;
+    ws_pool_host_t*     buckets[WS_POOL_BUCKETS];
+};
+
+static uint64_t ws_pool_now_ms(void) {
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)(ts.tv_nsec / 1000000ULL);
+}
+
+/* FNV-1a */
+static uint64_t ws_pool_hash(const char* s) {
+    uint64_t h = 1469598103934665603ULL;
+    for (; *s; s++) { h ^= (uint8_t)*s; h *= 1099511628211ULL; }
+    return h;
+}
+
+struct addrinfo* ws_addrinfo_dup(const struct addrinfo* ai) {
+    size_t n = 0, addr_bytes = 0;
+    for (const struct addrinfo* p = ai; p; p = p->ai_next) {
+        n++;
+        addr_bytes += (p->ai_addrlen + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+    }
+    if (n == 0) return NULL;
+    struct addrinfo* out = (struct addrinfo*)malloc(n * sizeof(*out) + addr_bytes);
+    if (!out) return NULL;
+    char* addr = (char*)(out + n);
+    size_t i = 0;
+    for (const struct addrinfo* p = ai; p; p = p->ai_next, i++) {
+        out[i] = *p;
+        out[i].ai_canonname = NULL;
+        out[i].ai_addr = (struct sockaddr*)(void*)addr;
+        memcpy(addr, p->ai_addr, p->ai_addrlen);
+        addr += (p->ai_addrlen + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+        out[i].ai_next = i + 1 < n ? &out[i + 1] : NULL;
+    }
+    return out;
+}
+
+static void ws_pool_forget_addrs(ws_pool_host_t* h) {
+    free(h->addrs);
+    h->addrs = NULL;
+}
+
+void ws_pool_host_resolved(ws_pool_host_t* h, const struct addrinfo* addrs) {
+    struct addrinfo* copy = ws_addrinfo_dup(addrs);
+    h->resolving = 0;
+    h->resolver = NULL;
+    if (!copy) return;
+    ws_pool_forget_addrs(h);
+    h->addrs = copy;
+    h->addrs_expire_ms = ws_pool_now_ms() + h->pool->dns_ttl_ms;
+}
+
+static const struct addrinfo* ws_pool_fresh_addrs(const ws_pool_host_t* h) {
+    return h->addrs && ws_pool_now_ms() < h->addrs_expire_ms ? h->addrs : NULL;
+}
+
+/* Remove owned[i], keeping idle ones in front */
+static wibesocket_conn_t* ws_pool_take(ws_pool_host_t* h, size_t i) {
+    wibesocket_conn_t* c = h->owned[i];
+    if (i < h->nidle) {
+        h->owned[i] = h->owned[--h->nidle];
+        i = h->nidle;
+    }
+    h->owned[i] = h->owned[--h->nowned];
+    return c;
+}
+
+static size_t ws_pool_index(const ws_pool_host_t* h, const wibesocket_conn_t* c) {
+    size_t i = 0;
+    while (i < h->nowned && h->owned[i] != c) i++;
+    return i;
+}
+
+static void ws_pool_on_event(wibesocket_loop_t* loop, wibesocket_conn_t* conn, uint32_t events, void* ud);
+
+/* Start connections until warm are open or on their way. A failed start waits for the next
+ * acquire rather than retrying here, so an unreachable host does not spin the loop. */
+static void ws_pool_refill(ws_pool_host_t* h) {
+    wibesocket_pool_t* p = h->pool;
+    while (h->nowned < p->warm) {
+        const struct addrinfo* addrs = ws_pool_fresh_addrs(h);
+        if (!addrs) {
+            if (h->resolving) return;
+            h->resolving = 1;
+        }
+        wibesocket_conn_t* c = ws_conn_start_pooled(h->uri, &p->cfg, addrs ? NULL : h, addrs);
+        if (!c || wibesocket_get_state(c) == WIBESOCKET_STATE_ERROR ||
+            wibesocket_loop_add(p->loop, c, ws_pool_on_event, h) != WIBESOCKET_OK) {
+            if (c) (void)wibesocket_close(c);
+            if (!addrs) h->resolving = 0;
+            return;
+        }
+        /* Numeric hosts resolve on the spot, and then resolving is already clear */
+        if (!addrs && h->resolving) h->resolver = c;
+        h->owned[h->nowned++] = c;
+    }
+}
+
+static void ws_pool_on_event(wibesocket_loop_t* loop, wibesocket_conn_t* conn, uint32_t events, void* ud) {
+    ws_pool_host_t* h = (ws_pool_host_t*)ud;
+    (void)loop;
+    size_t i = ws_pool_index(h, conn);
+    if (i == h->nowned) return;
+    if (conn == h->resolver && (events & WIBESOCKET_EVENT_ERROR)) {
+        h->resolving = 0;
+        h->resolver = NULL;
+    }
+    if (i >= h->nidle) {
+        if (events & WIBESOCKET_EVENT_ERROR) {
+            /* The cached addresses may be what failed: look the host up again next time */
+            ws_pool_forget_addrs(h);
+            (void)wibesocket_close(ws_pool_take(h, i));
+        } else if (events & WIBESOCKET_EVENT_CONNECTED) {
+            h->owned[i] = h->owned[h->nidle];
+            h->owned[h->nidle++] = conn;
+            /* The rest of a refill may have been waiting for this one's lookup */
+            ws_pool_refill(h);
+        }
+        return;
+    }
+    /* Idle: recv answers pings; a message, a close or an error retires the connection */
+    int retire = (events & WIBESOCKET_EVENT_ERROR) != 0;
+    if (!retire && (events & WIBESOCKET_EVENT_READABLE)) {
+        wibesocket_message_t m;
+        wibesocket_error_t e = wibesocket_recv(conn, &m, 0);
+        if (e == WIBESOCKET_OK) wibesocket_release_message(conn, &m);
+        retire = e != WIBESOCKET_ERROR_TIMEOUT;
+    }
+    if (!retire) return;
+    (void)wibesocket_close(ws_pool_take(h, i));
+    ws_pool_refill(h);
+}
+
+static ws_pool_host_t* ws_pool_find(const wibesocket_pool_t* p, const char* uri, uint64_t hash) {
+    ws_pool_host_t* h = p->buckets[hash % WS_POOL_BUCKETS];
+    while (h && (h->hash != hash || strcmp(h->uri, uri) != 0)) h = h->next;
+    return h;
+}
+
+static ws_pool_host_t* ws_pool_host(wibesocket_pool_t* p, const char* uri) {
+    uint64_t hash = ws_pool_hash(uri);
+    ws_pool_host_t* h = ws_pool_find(p, uri, hash);
+    if (h) return h;
+    h = (ws_pool_host_t*)calloc(1, sizeof(*h));
+    if (!h) return NULL;
+    h->uri = strdup(uri);
+    h->owned = (wibesocket_conn_t**)calloc(p->warm, sizeof(*h->owned));
+    if (!h->uri || !h->owned) { free(h->uri); free(h->owned); free(h); return NULL; }
+    h->pool = p;
+    h->hash = hash;
+    h->next = p->buckets[hash % WS_POOL_BUCKETS];
+    p->buckets[hash % WS_POOL_BUCKETS] = h;
+    return h;
+}
+
+wibesocket_pool_t* wibesocket_pool_create(wibesocket_loop_t* loop, const wibesocket_pool_config_t* config) {
+    if (!loop) return NULL;
+    wibesocket_pool_t* p = (wibesocket_pool_t*)calloc(1, sizeof(*p));
+    if (!p) return NULL;
+    p->loop = loop;
+    if (config && config->config) p->cfg = *config->config;
+    p->warm = config && config->warm ? config->warm : WS_POOL_DEFAULT_WARM;
+    p->dns_ttl_ms = config && config->dns_ttl_ms ? config->dns_ttl_ms : WS_POOL_DEFAULT_DNS_MS;
+    return p;
+}
+
+void wibesocket_pool_destroy(wibesocket_pool_t* pool) {
+    if (!pool) return;
+    for (size_t b = 0; b < WS_POOL_BUCKETS; b++) {
+        for (ws_pool_host_t* h = pool->buckets[b], *next; h; h = next) {
+            next = h->next;
+            while (h->nowned > 0) (void)wibesocket_close(ws_pool_take(h, h->nowned - 1));
+            ws_pool_forget_addrs(h);
+            free(h->owned);
+            free(h->uri);
+            free(h);
+        }
+    }
+    free(pool);
+}
+
+wibesocket_error_t wibesocket_pool_prewarm(wibesocket_pool_t* pool, const char* uri) {
+    if (!pool || !uri) return WIBESOCKET_ERROR_INVALID_ARGS;
+    ws_pool_host_t* h = ws_pool_host(pool, uri);
+    if (!h) return WIBESOCKET_ERROR_MEMORY;
+    ws_pool_refill(h);
+    return WIBESOCKET_OK;
+}
+
+wibesocket_conn_t* wibesocket_pool_acquire(wibesocket_pool_t* pool, const char* uri, int timeout_ms) {
+    if (!pool || !uri) return NULL;
+    ws_pool_host_t* h = ws_pool_host(pool, uri);
+    if (!h) return NULL;
+    wibesocket_conn_t* c = NULL;
+    while (!c && h->nidle > 0) {
+        c = ws_pool_take(h, h->nidle - 1);
+        /* Dropped since the loop last looked: close it while the loop still owns it, so
+         * the close does not block here */
+        if (wibesocket_get_state(c) != WIBESOCKET_STATE_OPEN) {
+            (void)wibesocket_close(c);
+            c = NULL;
+        } else if (wibesocket_loop_remove(pool->loop, c) != WIBESOCKET_OK) {
+            (void)wibesocket_close(c);
+            c = NULL;
+        }
+    }
+    ws_pool_refill(h);
+    if (!c && timeout_ms != 0) {
+        c = ws_conn_connect_pooled(uri, &pool->cfg, h->resolving ? NULL : h, ws_pool_fresh_addrs(h), timeout_ms);
+    }
+    return c;
+}
+
+size_t wibesocket_pool_ready(const wibesocket_pool_t* pool, const char* uri) {
+    if (!pool || !uri) return 0;
+    const ws_pool_host_t* h = ws_pool_find(pool, uri, ws_pool_hash(uri));
+    return h ? h->nidle : 0;
+}
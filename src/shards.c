@@ -0,0 +1,133 @@
+#if defined(__linux__)
+#define _GNU_SOURCE /* pthread_setaffinity_np */
+#endif
+#include "event_loop.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+#include "internal/bufpool.h"
+
+typedef struct {
+    wibesocket_shards_t* owner;
+    wibesocket_loop_t*   loop;
+    pthread_t            thread;
+    int                  started;
+    int                  cpu;    /* -1 = not pinned */
+} ws_shard_t;
+
+struct wibesocket_shards {
+    ws_shard_t*  shards;
+    size_t       count;
+    atomic_size_t next;     /* round-robin cursor */
+    atomic_int   stopping;
+};
+
+typedef struct {
+    wibesocket_conn_t* conn;
+    wibesocket_loop_cb cb;
+    void*              user_data;
+} ws_shard_add_t;
+
+static void* shard_main(void* arg) {
+    ws_shard_t* s = (ws_shard_t*)arg;
+#if defined(__linux__)
+    if (s->cpu >= 0) {
+        cpu_set_t set; CPU_ZERO(&set); CPU_SET(s->cpu, &set);
+        (void)pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+#endif
+    /* wibesocket_loop_stop from destroy may land before the first run: check our own flag */
+    while (!atomic_load(&s->owner->stopping)) {
+        if (wibesocket_loop_run_once(s->loop, -1) < 0) break;
+    }
+    ws_bufpool_thread_flush();
+    return NULL;
+}
+
+wibesocket_shards_t* wibesocket_shards_create(size_t n_threads, int pin_to_cpus) {
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpu < 1) ncpu = 1;
+    if (n_threads == 0) n_threads = (size_t)ncpu;
+    wibesocket_shards_t* g = (wibesocket_shards_t*)calloc(1, sizeof(*g));
+    if (!g) return NULL;
+    g->shards = (ws_shard_t*)calloc(n_threads, sizeof(ws_shard_t));
+    if (!g->shards) { free(g); return NULL; }
+    g->count = n_threads;
+    for (size_t i = 0; i < n_threads; i++) {
+        ws_shard_t* s = &g->shards[i];
+        s->owner = g;
+        s->cpu = pin_to_cpus ? (int)(i % (size_t)ncpu) : -1;
+        s->loop = wibesocket_loop_create();
+        if (!s->loop || pthread_create(&s->thread, NULL, shard_main, s) != 0) {
+            wibesocket_shards_destroy(g);
+            return NULL;
+        }
+        s->started = 1;
+    }
+    return g;
+}
+
+void wibesocket_shards_destroy(wibesocket_shards_t* g) {
+    if (!g) return;
+    atomic_store(&g->stopping, 1);
+    for (size_t i = 0; i < g->count; i++) {
+        if (g->shards[i].loop) wibesocket_loop_stop(g->shards[i].loop);
+    }
+    for (size_t i = 0; i < g->count; i++) {
+        ws_shard_t* s = &g->shards[i];
+        if (s->started) pthread_join(s->thread, NULL);
+        /* Runs tasks posted after the worker's last round, on this thread */
+        wibesocket_loop_destroy(s->loop);
+    }
+    free(g->shards);
+    free(g);
+}
+
+size_t wibesocket_shards_count(const wibesocket_shards_t* g) {
+    return g ? g->count : 0;
+}
+
+static void shard_add_task(wibesocket_loop_t* loop, void* arg) {
+    ws_shard_add_t* a = (ws_shard_add_t*)arg;
+    if (wibesocket_loop_add(loop, a->conn, a->cb, a->user_data) != WIBESOCKET_OK) {
+        a->cb(loop, a->conn, WIBESOCKET_EVENT_ERROR, a->user_data);
+    }
+    free(a);
+}
+
+wibesocket_error_t wibesocket_shards_add(wibesocket_shards_t* g, wibesocket_conn_t* conn,
+                                         int shard, wibesocket_loop_cb cb, void* user_data,
+                                         size_t* out_shard) {
+    if (!g || !conn || !cb || ws_conn_shard(conn) >= 0) return WIBESOCKET_ERROR_INVALID_ARGS;
+    size_t idx = (shard < 0) ? atomic_fetch_add(&g->next, 1) % g->count : (size_t)shard % g->count;
+    ws_shard_add_t* a = (ws_shard_add_t*)malloc(sizeof(*a));
+    if (!a) return WIBESOCKET_ERROR_MEMORY;
+    a->conn = conn; a->cb = cb; a->user_data = user_data;
+    /* Set before the handoff so any thread that later learns of conn sees its owner */
+    ws_conn_set_shard(conn, (int)idx);
+    wibesocket_error_t e = wibesocket_loop_post(g->shards[idx].loop, shard_add_task, a);
+    if (e != WIBESOCKET_OK) { ws_conn_set_shard(conn, -1); free(a); return e; }
+    if (out_shard) *out_shard = idx;
+    return WIBESOCKET_OK;
+}
+
+wibesocket_error_t wibesocket_shards_post(wibesocket_shards_t* g, size_t shard,
+                                          wibesocket_loop_task_fn fn, void* arg) {
+    if (!g || shard >= g->count) return WIBESOCKET_ERROR_INVALID_ARGS;
+    return wibesocket_loop_post(g->shards[shard].loop, fn, arg);
+}
+
+wibesocket_error_t wibesocket_shards_send(wibesocket_shards_t* g, wibesocket_conn_t* conn,
+                                          wibesocket_frame_type_t type, const void* data, size_t len) {
+    if (!g || !conn) return WIBESOCKET_ERROR_INVALID_ARGS;
+    int idx = ws_conn_shard(conn);
+    if (idx < 0 || (size_t)idx >= g->count) return WIBESOCKET_ERROR_INVALID_ARGS;
+    /* Straight onto the connection's own queue: the owning shard's loop watches its wakeup */
+    return wibesocket_post_send(conn, type, data, len);
+}
@@ -1,4 +1,8 @@
+#if defined(__linux__)
+#define _GNU_SOURCE /* getaddrinfo_a */
+#else
 #define _POSIX_C_SOURCE 200809L
+#endif
 #include "wibesocket/wibesocket.h"
 
 #include <stdlib.h>
@@ -9,16 +13,115 @@
 #include <sys/epoll.h>
 #include <sys/socket.h>
 #include <netinet/tcp.h>
-#if defined(__linux__)
-#include <sys/random.h>
-#endif
 #include <netdb.h>
 #include <time.h>
 #include <stdio.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <sys/eventfd.h>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+#if defined(__linux__) && defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY)
+#define WS_HAVE_ZEROCOPY 1
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+#endif
 
 #include "internal/frame.h"
 #include "internal/ringbuf.h"
+#include "internal/bufpool.h"
+#include "internal/slab.h"
+#include "internal/mpsc.h"
+#include "internal/mask.h"
+#include "internal/random.h"
+#include "internal/stats.h"
 #include "handshake.h"
+#include "event_loop.h"
+#if defined(WS_HAVE_IO_URING)
+#include "internal/uring.h"
+#endif
+
+/* Default receive ring; larger frames stream through it into a pooled reassembly buffer */
+#define WS_DEFAULT_RECV_BUFFER (256U * 1024U)
+/* Rings start this small and double while reads fill them, up to the configured size */
+#define WS_RECV_INITIAL 4096U
+/* Send queue: first buffer, and the largest kept once the queue has fully drained */
+#define WS_SEND_INITIAL 4096U
+#define WS_SEND_KEEP (64U * 1024U)
+/* Below this, buffers come straight from malloc rather than a pool size class */
+#define WS_MEM_POOL_MIN 4096U
+/* Send-queue watermarks when the config leaves them 0 */
+#define WS_DEFAULT_SEND_HIGH_WATERMARK (64U * 1024U * 1024U)
+#define WS_DEFAULT_COALESCE_BYTES (16U * 1024U)
+/* Messages shorter than this go uncompressed when the config leaves the threshold 0 */
+#define WS_DEFAULT_COMPRESSION_THRESHOLD 64U
+/* Inflated payloads of a batch: first buffer size, room asked of each inflate call, and how
+ * many full buffers a batch may set aside (each doubles the size of the next) */
+#define WS_ZOUT_MIN (64U * 1024U)
+#define WS_ZOUT_ROOM 4096U
+#define WS_ZOUT_SPENT 16
+/* How often a loop re-checks an async DNS lookup, which has no fd to wait on */
+#define WS_RESOLVE_POLL_MS 5
+/* Wait for the server's CLOSE reply when the config leaves close_timeout_ms 0 */
+#define WS_DEFAULT_CLOSE_TIMEOUT_MS 500U
+/* recv calls whose payloads may be outstanding at once; beyond that recv is NOT_READY */
+#define WS_PIN_MAX 256U
+/* Donated payloads (and remainders) shorter than this are left to the kernel to copy when the
+ * config has no zerocopy_threshold: pinning pages costs more than copying a few of them */
+#define WS_ZEROCOPY_MIN (16U * 1024U)
+
+typedef enum {
+    WS_CONNECT_IDLE = 0, /* not connecting: open, closed or failed */
+    WS_CONNECT_RESOLVE,  /* async DNS in flight, no socket yet */
+    WS_CONNECT_TCP,      /* non-blocking connect() in progress */
+    WS_CONNECT_SEND,     /* upgrade request queued (server: the 101 reply) */
+    WS_CONNECT_RECV      /* reading the 101 response into the receive ring (server: the request,
+                          * which comes before SEND) */
+} ws_connect_phase_t;
+
+/* A ring set aside while payloads still point into it, freed with its last pin */
+typedef struct {
+    ws_ringbuf_t rb;
+    size_t       pins;
+} ws_rx_seg_t;
+
+/* Everything the messages of one recv/recv_batch call point into */
+typedef struct {
+    uint32_t     id;
+    int          refcnt;
+    uint64_t     start;    /* stream position of its first ring byte */
+    int          in_ring;  /* some payload points into a ring, not only into the buffers below */
+    ws_rx_seg_t* seg;      /* retired ring it points into; NULL = the current one */
+    uint8_t*     asm_buf;  /* reassembled frame */
+    size_t       asm_cap;
+#if defined(WS_HAVE_ZLIB)
+    uint8_t*     zout;     /* inflated payloads */
+    size_t       zout_cap;
+    struct ws_zbuf { uint8_t* buf; size_t cap; }* zspent;
+    size_t       zspent_n;
+#endif
+} ws_pin_t;
+
+/* A large payload written from its own buffer instead of the send queue (zerocopy_threshold,
+ * wibesocket_send_donated). Its header is in the queue; the payload follows once the queue has
+ * been written up to at. */
+typedef struct ws_zc_buf {
+    struct ws_zc_buf* next;
+    size_t   node_cap;
+    uint8_t* buf;
+    size_t   len;
+    size_t   off;       /* bytes written */
+    size_t   cap;       /* pooled buffer; 0 = donated, given back through release */
+    uint64_t at;        /* queue stream position (send_written) of the end of its header */
+    uint64_t first_id;  /* MSG_ZEROCOPY sends that carried it: ids first_id .. first_id + ids - 1 */
+    uint64_t ids;
+    uint64_t done;      /* of those, how many the kernel has reported complete */
+    wibesocket_release_fn release;
+    void*    ctx;
+} ws_zc_buf_t;
 
 typedef struct wibesocket_conn {
     int                fd;
@@ -26,32 +129,137 @@ typedef struct wibesocket_conn {
     wibesocket_state_t state;
     wibesocket_error_t last_error;
     wibesocket_config_t cfg;
+    wibesocket_allocator_t alloc; /* cfg.allocator's hooks; zeroed = built-in pools */
 
     /* handshake */
+    int  server;          /* accepted (wibesocket_accept): sends unmasked, the peer must mask */
     char client_key[25];
     char expected_accept[29];
+    char*  protocol;      /* subprotocol the server chose (or, serving, we did), NULL if none */
+    size_t protocol_cap;
 
-    /* recv */
-    uint8_t* recv_buf;
-    size_t   recv_size;
-    size_t   recv_cap;
-    size_t   pending_consume;
+    /* recv: ring starting at the oldest unreleased byte; mirrored so frames stay contiguous */
+    ws_ringbuf_t rx;
+    size_t   recv_parsed;     /* bytes at the front already fed to the parser */
+    size_t   pending_consume; /* bytes of fully handled frames, reclaimed up to the oldest pin */
+    uint64_t rx_front;        /* stream position of the ring's first byte */
+    int      rx_drained;      /* last recv() hit EAGAIN or a short read: wait for an edge first */
+    size_t   rx_max;          /* the ring doubles up to this */
+    int      rx_grow;         /* a read filled the whole window: grow at the next safe point */
     ws_parser_t parser;
 
-    /* FFI payload lifetime pinning */
-    const uint8_t* pinned_payload;
-    size_t         pinned_len;
-    int            pinned_refcnt;
+    /* Frames too large for the ring are reassembled into pooled buffers */
+    uint8_t* asm_buf;         /* frame currently streaming in */
+    size_t   asm_cap;
+    uint8_t* asm_pinned;      /* reassembled frame of this recv call, handed to its pin */
+    size_t   asm_pinned_cap;
+
+    /* Payload pins, oldest first: one per recv call that handed out messages */
+    ws_pin_t* pins;
+    size_t    npins;
+    size_t    pins_cap;
+    size_t    rx_pins;  /* pins into the current ring, which keep its bytes in place */
+    uint32_t  pin_seq;
 
     /* Send queue (non-blocking partial writes) */
     uint8_t* send_buf;
     size_t   send_size; /* total bytes in buffer */
     size_t   send_off;  /* bytes already sent */
     size_t   send_cap;  /* capacity */
+    int      corked;    /* between send_begin and send_commit: queue frames, don't flush */
+    /* coalesce_delay_us: data frames wait in the queue until it holds coalesce_bytes or
+     * flush_due_us passes (0 = nothing held back) */
+    size_t   coalesce_bytes;
+    uint64_t flush_due_us;
+    uint64_t send_written; /* queue bytes written since open: positions for the payloads below */
+
+    /* Payloads written from their own buffers, in queue order; zc_next is the first not fully
+     * written, those ahead of it wait for the kernel's completion before being freed */
+    ws_zc_buf_t* zc_head;
+    ws_zc_buf_t* zc_tail;
+    ws_zc_buf_t* zc_next;
+    size_t       zc_unsent; /* their bytes not yet written */
+    int          zc_state;  /* SO_ZEROCOPY on the socket: 0 untried, 1 on, -1 unavailable */
+    uint64_t     zc_seq;    /* MSG_ZEROCOPY sends so far; the kernel numbers them from 0 */
+    uint64_t     zc_acked;  /* ...and completions reported for them */
 
     /* Close handshake */
     int      close_sent;
     uint64_t close_sent_ms;
+    int      lingering;    /* closed by the user inside a loop, waiting for the server's CLOSE */
+
+    /* Keepalive and idle detection (see ws_conn_timer_deadline) */
+    int      track_rx;     /* either is on: stamp last_rx_ms on every read */
+    uint64_t last_rx_ms;
+    uint64_t last_ping_ms;
+    uint64_t ping_out_us;  /* when the oldest unanswered PING went out, 0 = none */
+    uint64_t rtt_us;       /* its round trip, once a PONG came back */
+
+    /* enable_stats counters (NULL = off) */
+    ws_stats_t* stats;
+    uint64_t    send_stamp_ns; /* when the oldest unsent frame was queued */
+    uint64_t    cn_start_us;
+
+    /* Shared event loop registration; epfd is closed while attached */
+    ws_loop_entry_t* loop_entry;
+    int              shard; /* owning wibesocket_shards worker, -1 if none */
+
+    /* Frames built on other threads (wibesocket_post_send), spliced into the queue on flush.
+     * A producer raises post_fd only when it moves post_signalled from 0 to 1. */
+    ws_mpsc_t        posted;
+    atomic_int       post_signalled;
+    int              post_fd;
+    atomic_size_t    post_bytes; /* posted but not yet spliced, counted against the high mark */
+    ws_mpsc_node_t*  post_held;  /* popped but did not fit the queue: spliced first next time */
+
+    /* Backpressure: sends are refused while queue + posted bytes exceed send_high; once a
+     * refusal happened, dropping to send_low raises a one-shot drained notification */
+    size_t           send_high;
+    size_t           send_low;
+    int              send_blocked;
+    int              drained_pending;
+
+    /* Non-blocking connect state machine (see ws_connect_step) */
+    ws_connect_phase_t cn_phase;
+    uint64_t         cn_deadline_ms;
+    char*            cn_host;      /* one allocation holding host, port and path */
+    char*            cn_port;
+    char*            cn_path;
+    size_t           cn_cap;
+    struct addrinfo* cn_addrs;
+    struct addrinfo* cn_next;      /* next address to try if the current one fails */
+    int              cn_addrs_dup; /* cn_addrs is a ws_addrinfo_dup copy, not getaddrinfo's */
+    ws_pool_host_t*  cn_pool_host; /* pool to hand the lookup to, until it completes */
+    size_t           cn_scanned;   /* response bytes already fed to cn_resp */
+    ws_http_response_t* cn_resp;   /* upgrade response parse state, kept across reads */
+    size_t           cn_resp_cap;
+#if defined(WS_HAVE_GETADDRINFO_A)
+    struct gaicb     cn_gai;
+    struct addrinfo  cn_hints;
+    int              cn_gai_active;
+#endif
+
+#if defined(WS_HAVE_IO_URING)
+    /* io_uring engine once open (NULL = epoll + recv/send) */
+    ws_uring_t* uring;
+    size_t   send_inflight; /* queued bytes from send_off handed to the kernel */
+    uint8_t* send_retired;  /* previous queue buffer the in-flight chain still reads */
+    size_t   send_retired_cap;
+#endif
+
+#if defined(WS_HAVE_ZLIB)
+    /* permessage-deflate once negotiated (NULL = off) */
+    ws_deflate_t*   deflate;
+    size_t          deflate_threshold;
+    int             ztext;  /* compressed message in progress is text: validated once inflated */
+    ws_utf8_state_t zutf8;
+    /* Inflated payloads of this recv call, handed to its pin */
+    uint8_t*        zout;
+    size_t          zout_cap;
+    size_t          zout_len;
+    struct ws_zbuf* zspent; /* WS_ZOUT_SPENT slots, filled earlier in the batch */
+    size_t          zspent_n;
+#endif
 } wibesocket_conn;
 
 static int set_nonblocking(int fd) {
@@ -61,7 +269,44 @@ static int set_nonblocking(int fd) {
     return 0;
 }
 
-static int parse_ws_uri(const char* uri, char** out_host, char** out_port, char** out_path) {
+/* Connection buffers: the config's allocator if it has one, else malloc for small sizes and
+ * the shared size-class pool above. cap is what the buffer really holds; pass it back to put. */
+static void* ws_mem_get(const wibesocket_conn* c, size_t size, size_t* cap) {
+    void* p;
+    if (c->alloc.alloc) p = c->alloc.alloc(c->alloc.ctx, size);
+    else if (size < WS_MEM_POOL_MIN) p = malloc(size);
+    else return ws_bufpool_get(size, cap);
+    *cap = p ? size : 0;
+    return p;
+}
+
+static void ws_mem_put(const wibesocket_conn* c, void* p, size_t cap) {
+    if (!p) return;
+    if (c->alloc.free) c->alloc.free(c->alloc.ctx, p, cap);
+    else ws_bufpool_put(p, cap); /* frees anything that is not a class size */
+}
+
+static ws_slab_t g_conn_slab = WS_SLAB_INIT(sizeof(wibesocket_conn));
+
+static wibesocket_conn* ws_conn_alloc(const wibesocket_config_t* config) {
+    const wibesocket_allocator_t* a = config ? config->allocator : NULL;
+    if (a && (!a->alloc || !a->free)) return NULL;
+    if (!a) return (wibesocket_conn*)ws_slab_alloc(&g_conn_slab);
+    wibesocket_conn* c = (wibesocket_conn*)a->alloc(a->ctx, sizeof(*c));
+    if (!c) return NULL;
+    memset(c, 0, sizeof(*c));
+    c->alloc = *a;
+    return c;
+}
+
+static void ws_conn_free(wibesocket_conn* c) {
+    ws_stats_destroy(c->stats);
+    if (!c->alloc.free) { ws_slab_free(&g_conn_slab, c); return; }
+    wibesocket_allocator_t a = c->alloc;
+    a.free(a.ctx, c, sizeof(*c));
+}
+
+static int parse_ws_uri(wibesocket_conn* c, const char* uri) {
     /* Very small parser for ws://host[:port]/path */
     const char* p = strstr(uri, "://");
     if (!p) return -1;
@@ -72,392 +317,2327 @@ static int parse_ws_uri(const char* uri, char** out_host, char** out_port, char*
     const char* slash = strchr(p, '/');
     const char* host_end = slash ? slash : uri + strlen(uri);
     const char* colon = memchr(host_start, ':', (size_t)(host_end - host_start));
-    if (colon) {
-        *out_host = strndup(host_start, (size_t)(colon - host_start));
-        *out_port = strndup(colon + 1, (size_t)(host_end - (colon + 1)));
-    } else {
-        *out_host = strndup(host_start, (size_t)(host_end - host_start));
-        *out_port = strdup("80");
-    }
-    *out_path = slash ? strdup(slash) : strdup("/");
-    return (*out_host && *out_port && *out_path) ? 0 : -1;
-}
-
-static int ep_add_out(int epfd, int fd) {
-    struct epoll_event ev; memset(&ev, 0, sizeof(ev));
-    ev.events = EPOLLOUT | EPOLLET; ev.data.fd = fd;
-    return epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+    const char* port = colon ? colon + 1 : "80";
+    size_t host_len = (size_t)((colon ? colon : host_end) - host_start);
+    size_t port_len = colon ? (size_t)(host_end - port) : 2;
+    const char* path = slash ? slash : "/";
+    size_t path_len = strlen(path);
+    char* b = (char*)ws_mem_get(c, host_len + port_len + path_len + 3, &c->cn_cap);
+    if (!b) return -1;
+    c->cn_host = b;
+    c->cn_port = b + host_len + 1;
+    c->cn_path = c->cn_port + port_len + 1;
+    memcpy(c->cn_host, host_start, host_len); c->cn_host[host_len] = 0;
+    memcpy(c->cn_port, port, port_len); c->cn_port[port_len] = 0;
+    memcpy(c->cn_path, path, path_len + 1);
+    return 0;
 }
 
-static int ep_mod_in(int epfd, int fd) {
+static int ep_add_in(int epfd, int fd) {
     struct epoll_event ev; memset(&ev, 0, sizeof(ev));
     ev.events = EPOLLIN | EPOLLET; ev.data.fd = fd;
-    return epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+    return epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
 }
 
 static int wait_epoll(int epfd, int timeout_ms) {
     struct epoll_event ev; return epoll_wait(epfd, &ev, 1, timeout_ms);
 }
 
-static int socket_connect_nb(const char* host, const char* port) {
-    struct addrinfo hints; memset(&hints, 0, sizeof(hints));
-    hints.ai_family = AF_UNSPEC; hints.ai_socktype = SOCK_STREAM;
-    struct addrinfo* res = NULL;
-    int rc = getaddrinfo(host, port, &hints, &res);
-    if (rc != 0) return -1;
-    int fd = -1;
-    for (struct addrinfo* ai = res; ai; ai = ai->ai_next) {
-        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK, ai->ai_protocol);
-        if (fd < 0) continue;
-        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
-        if (errno == EINPROGRESS) break;
-        close(fd); fd = -1;
-    }
-    freeaddrinfo(res);
-    return fd;
+/* Blocking wait for input: the private epoll set, or poll() while a shared loop owns the fd */
+static int wait_readable(wibesocket_conn* c, int timeout_ms) {
+    WS_STAT_ADD(c->stats, syscalls, 1);
+#if defined(WS_HAVE_IO_URING)
+    if (c->uring) return ws_uring_wait(c->uring, timeout_ms);
+#endif
+    if (c->epfd >= 0) return wait_epoll(c->epfd, timeout_ms);
+    struct pollfd pfd[2] = { { c->fd, POLLIN, 0 }, { c->post_fd, POLLIN, 0 } };
+    return poll(pfd, 2, timeout_ms);
 }
 
-static wibesocket_error_t do_handshake(wibesocket_conn* c, const char* host, int port, const char* path) {
-    if (ws_generate_client_key(c->client_key) != 0) return WIBESOCKET_ERROR_HANDSHAKE;
-    ws_compute_accept(c->client_key, c->expected_accept);
-    char req[1024];
-    int n = ws_build_handshake_request(host, port, path, c->client_key,
-                                       c->cfg.user_agent, c->cfg.origin, c->cfg.protocol,
-                                       req, sizeof(req));
-    if (n <= 0) return WIBESOCKET_ERROR_HANDSHAKE;
-    ssize_t wr = send(c->fd, req, (size_t)n, 0);
-    if (wr < 0 && errno != EAGAIN && errno != EWOULDBLOCK) return WIBESOCKET_ERROR_NETWORK;
+static uint64_t ws_now_ms(void) {
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)(ts.tv_nsec / 1000000ULL);
+}
 
-    /* wait for response */
-    int timeout = (int)c->cfg.handshake_timeout_ms;
-    if (timeout <= 0) timeout = 5000;
-    char resp[4096]; size_t resp_len = 0;
-    for (;;) {
-        int w = wait_epoll(c->epfd, timeout);
-        if (w <= 0) return WIBESOCKET_ERROR_TIMEOUT;
-        ssize_t rd = recv(c->fd, resp + resp_len, sizeof(resp) - 1 - resp_len, 0);
-        if (rd < 0) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) continue;
-            return WIBESOCKET_ERROR_NETWORK;
-        }
-        if (rd == 0) return WIBESOCKET_ERROR_NETWORK;
-        resp_len += (size_t)rd; resp[resp_len] = '\0';
-        if (strstr(resp, "\r\n\r\n")) break;
-        if (resp_len >= sizeof(resp) - 1) return WIBESOCKET_ERROR_HANDSHAKE;
-    }
-    if (ws_validate_handshake_response(resp, c->expected_accept) != 0) return WIBESOCKET_ERROR_HANDSHAKE;
-    return WIBESOCKET_OK;
+static uint64_t ws_now_us(void) {
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)(ts.tv_nsec / 1000ULL);
 }
 
-static uint64_t ws_now_ms(void) {
+static uint64_t ws_now_ns(void) {
     struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
-    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)(ts.tv_nsec / 1000000ULL);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* A frame of wire size n joins the send queue (stats on) */
+static void ws_stat_frame_out(wibesocket_conn* c, unsigned opcode, size_t n, int was_empty) {
+    ws_stat_add(c->stats, WS_STAT_SLOT(frames_out) + (opcode & 0xF), 1);
+    ws_stat_add(c->stats, WS_STAT_SLOT(bytes_out) + (opcode & 0xF), n);
+    ws_stat_max(c->stats, WS_STAT_SLOT(send_queue_peak), c->send_size - c->send_off + c->zc_unsent);
+    if (was_empty) c->send_stamp_ns = ws_now_ns();
 }
 
+/* The queue drained: one send delay sample for its oldest frame */
+static void ws_stat_drained(wibesocket_conn* c) {
+    if (!c->stats || !c->send_stamp_ns) return;
+    ws_stats_record_delay(c->stats, ws_now_ns() - c->send_stamp_ns);
+    c->send_stamp_ns = 0;
+}
+
+/* The queue buffer is taken on the first send, so a connection that only listens holds none */
 static void ws_queue_init(wibesocket_conn* c) {
-    c->send_cap = 16384; /* initial */
-    c->send_buf = (uint8_t*)malloc(c->send_cap);
-    c->send_size = c->send_off = 0;
+    c->send_buf = NULL;
+    c->send_cap = c->send_size = c->send_off = 0;
 }
 
 static void ws_queue_free(wibesocket_conn* c) {
-    free(c->send_buf); c->send_buf = NULL; c->send_cap = c->send_size = c->send_off = 0;
-}
-
-static int ws_queue_append(wibesocket_conn* c, const uint8_t* data, size_t len) {
-    if (!len) return 0;
-    size_t needed = (c->send_size - c->send_off) + len;
-    if (needed > c->send_cap) {
-        size_t new_cap = c->send_cap ? c->send_cap : 16384;
-        while (new_cap < needed) new_cap *= 2;
-        uint8_t* nb = (uint8_t*)realloc(c->send_buf, new_cap);
-        if (!nb) return -1;
-        /* compact existing data to start */
-        size_t remain = c->send_size - c->send_off;
-        memmove(nb, nb + c->send_off, remain);
-        c->send_buf = nb; c->send_off = 0; c->send_size = remain; c->send_cap = new_cap;
-    } else if (c->send_off > 0) {
-        size_t remain = c->send_size - c->send_off;
+    ws_mem_put(c, c->send_buf, c->send_cap);
+    c->send_buf = NULL; c->send_cap = c->send_size = c->send_off = 0;
+}
+
+/* Once everything has gone out: hand back a buffer a burst grew, keep a small one for reuse
+ * (none when lending buffers) */
+static void ws_queue_trim(wibesocket_conn* c) {
+    if (c->send_off != c->send_size) return;
+    if (c->send_cap > WS_SEND_KEEP || (c->cfg.recv_buffer_lending && c->state == WIBESOCKET_STATE_OPEN)) {
+        ws_queue_free(c);
+    }
+}
+
+/* Make room for len more bytes at the end of the send queue and return where they go.
+ * The caller writes in place and advances send_size; steady-state sends reuse the same
+ * buffer so nothing is allocated once it has grown to the largest frame. */
+static uint8_t* ws_queue_reserve(wibesocket_conn* c, size_t len) {
+    size_t remain = c->send_size - c->send_off;
+    if (c->send_cap - c->send_size >= len) return c->send_buf + c->send_size;
+#if defined(WS_HAVE_IO_URING)
+    if (c->send_inflight && !c->send_retired) {
+        /* The kernel is still reading the front of this buffer: move only the unsubmitted
+         * tail to a new one and keep the old alive until the chain completes */
+        size_t from = c->send_off + c->send_inflight;
+        size_t rest = c->send_size - from;
+        size_t cap = c->send_cap;
+        while (cap < rest + len) cap *= 2;
+        uint8_t* nb = (uint8_t*)ws_mem_get(c, cap, &cap);
+        if (!nb) return NULL;
+        memcpy(nb, c->send_buf + from, rest);
+        c->send_retired = c->send_buf; c->send_retired_cap = c->send_cap;
+        c->send_buf = nb; c->send_cap = cap; c->send_off = 0; c->send_size = rest;
+        return c->send_buf + c->send_size;
+    }
+#endif
+    if (c->send_off > 0) {
         memmove(c->send_buf, c->send_buf + c->send_off, remain);
         c->send_off = 0; c->send_size = remain;
+        if (c->send_cap - c->send_size >= len) return c->send_buf + c->send_size;
     }
-    memcpy(c->send_buf + c->send_size, data, len);
-    c->send_size += len;
-    return 0;
+    size_t new_cap = c->send_cap ? c->send_cap : WS_SEND_INITIAL;
+    while (new_cap < remain + len) new_cap *= 2;
+    uint8_t* nb = (uint8_t*)ws_mem_get(c, new_cap, &new_cap);
+    if (!nb) return NULL;
+    if (c->send_size) memcpy(nb, c->send_buf, c->send_size);
+    ws_mem_put(c, c->send_buf, c->send_cap);
+    c->send_buf = nb; c->send_cap = new_cap;
+    return c->send_buf + c->send_size;
 }
 
-static void ws_flush_send(wibesocket_conn* c) {
-    while (c->send_off < c->send_size) {
-        #ifdef MSG_NOSIGNAL
-        const int send_flags = MSG_NOSIGNAL;
-        #else
-        const int send_flags = 0;
-        #endif
-        ssize_t wr = send(c->fd, c->send_buf + c->send_off, c->send_size - c->send_off, send_flags);
-        if (wr > 0) {
-            c->send_off += (size_t)wr;
-        } else {
-            if (wr < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
-            /* on other errors, drop queue */
-            c->send_off = c->send_size = 0; return;
-        }
-    }
-    /* all sent */
-    c->send_off = c->send_size = 0;
+/* Queue bytes or large payloads still to be written */
+static int ws_send_pending(const wibesocket_conn* c) {
+    return c->send_off < c->send_size || c->zc_next;
 }
 
-wibesocket_conn_t* wibesocket_connect(const char* uri, const wibesocket_config_t* config) {
-    if (!uri) return NULL;
-    char *host = NULL, *port = NULL, *path = NULL;
-    if (parse_ws_uri(uri, &host, &port, &path) != 0) return NULL;
+/* A loop only watches for writability while bytes are queued */
+static void ws_sync_write_interest(wibesocket_conn* c) {
+    if (c->loop_entry) ws_loop_entry_want_write(c->loop_entry, ws_send_pending(c));
+}
 
-    wibesocket_conn* c = (wibesocket_conn*)calloc(1, sizeof(*c));
-    if (!c) { free(host); free(port); free(path); return NULL; }
-    if (config) c->cfg = *config;
-    c->state = WIBESOCKET_STATE_CONNECTING;
-    c->last_error = WIBESOCKET_OK;
-    c->recv_cap = (c->cfg.max_frame_size ? c->cfg.max_frame_size : (1U << 20)) + 16;
-    c->recv_buf = (uint8_t*)malloc(c->recv_cap);
-    if (!c->recv_buf) { free(c); free(host); free(port); free(path); return NULL; }
-    ws_parser_init(&c->parser, c->cfg.max_frame_size ? c->cfg.max_frame_size : (1U << 20));
-    ws_queue_init(c);
+static void ws_zc_free(wibesocket_conn* c, ws_zc_buf_t* z) {
+    if (z->cap) ws_mem_put(c, z->buf, z->cap);
+    else if (z->release) z->release(z->ctx, z->buf, z->len);
+    ws_mem_put(c, z, z->node_cap);
+}
 
-    c->fd = socket_connect_nb(host, port);
-    if (c->fd < 0) { c->last_error = WIBESOCKET_ERROR_NETWORK; goto fail; }
-    /* Low-latency TCP settings */
-    {
-        int one = 1; (void)setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
-        int buf = 1 << 20; (void)setsockopt(c->fd, SOL_SOCKET, SO_SNDBUF, &buf, sizeof(buf));
-        (void)setsockopt(c->fd, SOL_SOCKET, SO_RCVBUF, &buf, sizeof(buf));
+/* Free the written payloads the kernel no longer reads from; completions come in any order */
+static void ws_zc_collect(wibesocket_conn* c) {
+    ws_zc_buf_t** pp = &c->zc_head;
+    ws_zc_buf_t* prev = NULL;
+    while (*pp && *pp != c->zc_next) {
+        ws_zc_buf_t* z = *pp;
+        if (z->done < z->ids) { prev = z; pp = &z->next; continue; }
+        *pp = z->next;
+        if (c->zc_tail == z) c->zc_tail = prev;
+        ws_zc_free(c, z);
     }
-    c->epfd = epoll_create1(EPOLL_CLOEXEC);
-    if (c->epfd < 0) { c->last_error = WIBESOCKET_ERROR_NETWORK; goto fail; }
-    if (ep_add_out(c->epfd, c->fd) < 0) { c->last_error = WIBESOCKET_ERROR_NETWORK; goto fail; }
+}
 
-    int timeout = (int)c->cfg.handshake_timeout_ms; if (timeout <= 0) timeout = 5000;
-    int w = wait_epoll(c->epfd, timeout);
-    if (w <= 0) { c->last_error = WIBESOCKET_ERROR_TIMEOUT; goto fail; }
-    /* switch to read */
-    if (ep_mod_in(c->epfd, c->fd) < 0) { c->last_error = WIBESOCKET_ERROR_NETWORK; goto fail; }
+/* The connection failed or is going away: nothing more will be written from these. Ones the
+ * kernel may still be sending from stay queued until their completions are reaped. */
+static void ws_zc_drop_all(wibesocket_conn* c) {
+    c->zc_next = NULL;
+    c->zc_unsent = 0;
+    ws_zc_collect(c);
+}
 
-    wibesocket_error_t hs = do_handshake(c, host, atoi(port), path);
-    if (hs != WIBESOCKET_OK) { c->last_error = hs; goto fail; }
+/* The socket is closed with payloads still in the kernel's hands, which may read them after
+ * close(): they are neither reused nor released, only counted */
+static void ws_zc_abandon(wibesocket_conn* c) {
+    while (c->zc_head) {
+        ws_zc_buf_t* z = c->zc_head;
+        c->zc_head = z->next;
+        WS_STAT_ADD(c->stats, zerocopy_abandoned, 1);
+        ws_mem_put(c, z, z->node_cap);
+    }
+    c->zc_tail = NULL;
+}
 
-    c->state = WIBESOCKET_STATE_OPEN;
-    free(host); free(port); free(path);
-    return c;
-fail:
-    free(host); free(port); free(path);
-    (void)wibesocket_close((wibesocket_conn_t*)c);
-    return NULL;
+#if defined(WS_HAVE_ZEROCOPY)
+/* SO_ZEROCOPY is set on the socket the first time it is wanted */
+static int ws_zc_enabled(wibesocket_conn* c) {
+    if (c->zc_state == 0 && c->fd >= 0) {
+        int one = 1;
+        c->zc_state = setsockopt(c->fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0 ? 1 : -1;
+    }
+    return c->zc_state > 0;
 }
 
-static void gen_mask(uint8_t m[4]) {
-#if defined(__linux__)
-    ssize_t r = getrandom(m, 4, 0);
-    if (r == 4) return;
+/* The kernel finished the MSG_ZEROCOPY sends lo..hi (32-bit ids, widened against zc_seq) */
+static void ws_zc_complete(wibesocket_conn* c, uint32_t lo, uint32_t hi) {
+    uint64_t from = c->zc_seq - (uint32_t)((uint32_t)c->zc_seq - lo);
+    uint64_t to = from + (uint32_t)(hi - lo) + 1;
+    c->zc_acked += to - from;
+    for (ws_zc_buf_t* z = c->zc_head; z; z = z->next) {
+        uint64_t a = z->first_id > from ? z->first_id : from;
+        uint64_t b = z->first_id + z->ids < to ? z->first_id + z->ids : to;
+        if (z->ids && a < b) z->done += b - a;
+    }
+}
+
+/* Read completion notifications off the socket's error queue, then free what they cover */
+static void ws_zc_reap(wibesocket_conn* c) {
+    while (c->zc_acked < c->zc_seq && c->fd >= 0) {
+        char control[CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in6))];
+        struct msghdr msg; memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        ssize_t r = recvmsg(c->fd, &msg, MSG_ERRQUEUE);
+        WS_STAT_ADD(c->stats, syscalls, 1);
+        if (r < 0) break; /* EAGAIN: nothing reported yet */
+        for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+                  (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))) continue;
+            struct sock_extended_err ee;
+            memcpy(&ee, CMSG_DATA(cm), sizeof(ee));
+            if (ee.ee_origin == SO_EE_ORIGIN_ZEROCOPY && ee.ee_errno == 0) ws_zc_complete(c, ee.ee_info, ee.ee_data);
+        }
+    }
+    ws_zc_collect(c);
+}
+#else
+static void ws_zc_reap(wibesocket_conn* c) {
+    ws_zc_collect(c);
+}
 #endif
-    unsigned x = (unsigned)time(NULL);
-    for (int i = 0; i < 4; i++) { x = x * 1103515245u + 12345u; m[i] = (uint8_t)(x >> 24); }
+
+/* Append z (node_cap from ws_mem_get): buf goes out once the queue is written up to its end */
+static void ws_zc_link(wibesocket_conn* c, ws_zc_buf_t* z, size_t node_cap, uint8_t* buf, size_t len,
+                       size_t cap, wibesocket_release_fn release, void* ctx) {
+    memset(z, 0, sizeof(*z));
+    z->node_cap = node_cap;
+    z->buf = buf; z->len = len; z->cap = cap;
+    z->release = release; z->ctx = ctx;
+    z->at = c->send_written + (c->send_size - c->send_off);
+    if (c->zc_tail) c->zc_tail->next = z; else c->zc_head = z;
+    c->zc_tail = z;
+    if (!c->zc_next) c->zc_next = z;
+    c->zc_unsent += len;
 }
 
-static wibesocket_error_t send_frame(wibesocket_conn* c, ws_opcode_t opcode, const void* data, size_t len) {
-    if (!c || c->state != WIBESOCKET_STATE_OPEN) return WIBESOCKET_ERROR_NOT_READY;
-    uint8_t mask[4]; gen_mask(mask);
-    size_t hdr = 2 + ((len <= 125) ? 0 : (len <= 0xFFFF ? 2 : 8)) + 4;
-    size_t need = hdr + len;
-    uint8_t* buf = (uint8_t*)malloc(need);
-    if (!buf) return WIBESOCKET_ERROR_MEMORY;
-    size_t n = ws_build_frame(buf, need, 1, opcode, mask, (const uint8_t*)data, len);
-    if (n == 0) { free(buf); return WIBESOCKET_ERROR_BUFFER_FULL; }
-    /* Try immediate send */
-    #ifdef MSG_NOSIGNAL
-    const int send_flags = MSG_NOSIGNAL;
-    #else
-    const int send_flags = 0;
-    #endif
-    ssize_t wr = send(c->fd, buf, n, send_flags);
-    if (wr == (ssize_t)n) { free(buf); return WIBESOCKET_OK; }
-    if (wr < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-        /* queue entire frame */
-        int rc = ws_queue_append(c, buf, n);
-        free(buf);
-        if (rc < 0) return WIBESOCKET_ERROR_MEMORY;
-        return WIBESOCKET_OK;
+/* Queue the header of a payload that is written from buf (masked with mask by then). The
+ * node comes off *spare when there is one (allocated ahead by a batch), else it is allocated. */
+static wibesocket_error_t ws_queue_zc(wibesocket_conn* c, ws_opcode_t opcode, const uint8_t mask[4],
+                                      uint8_t* buf, size_t len, size_t cap,
+                                      wibesocket_release_fn release, void* ctx, ws_zc_buf_t** spare) {
+    size_t node_cap = 0;
+    ws_zc_buf_t* z;
+    if (spare && *spare) {
+        z = *spare;
+        *spare = z->next;
+        node_cap = z->node_cap;
+    } else {
+        z = (ws_zc_buf_t*)ws_mem_get(c, sizeof(*z), &node_cap);
+        if (!z) return WIBESOCKET_ERROR_MEMORY;
     }
-    if (wr >= 0 && (size_t)wr < n) {
-        int rc = ws_queue_append(c, buf + wr, n - (size_t)wr);
-        free(buf);
-        if (rc < 0) return WIBESOCKET_ERROR_MEMORY;
-        return WIBESOCKET_OK;
+    int was_empty = !ws_send_pending(c);
+    uint8_t* out = ws_queue_reserve(c, WS_MAX_HEADER_SIZE);
+    if (!out) { ws_mem_put(c, z, node_cap); return WIBESOCKET_ERROR_MEMORY; }
+    size_t hl = ws_build_frame_header(out, 1, 0, opcode, mask, len);
+    c->send_size += hl;
+    ws_zc_link(c, z, node_cap, buf, len, cap, release, ctx);
+    if (c->stats) ws_stat_frame_out(c, (unsigned)opcode, hl + len, was_empty);
+    return WIBESOCKET_OK;
+}
+
+#if defined(WS_HAVE_IO_URING)
+/* Account a finished chain and hand the next stretch of the queue to the kernel. */
+static int ws_flush_uring(wibesocket_conn* c) {
+    int busy = ws_uring_send_busy(c->uring);
+    if (busy < 0) {
+        ws_mem_put(c, c->send_retired, c->send_retired_cap); c->send_retired = NULL;
+        c->send_inflight = 0; c->send_off = c->send_size = 0;
+        return -1;
     }
-    free(buf);
-    return WIBESOCKET_ERROR_NETWORK;
+    if (!busy && c->send_inflight) {
+        if (c->send_retired) { ws_mem_put(c, c->send_retired, c->send_retired_cap); c->send_retired = NULL; }
+        else c->send_off += c->send_inflight;
+        c->send_inflight = 0;
+        if (c->send_off == c->send_size) { c->send_off = c->send_size = 0; ws_stat_drained(c); ws_queue_trim(c); }
+    }
+    if (!c->send_inflight && c->send_off < c->send_size) {
+        ssize_t n = ws_uring_send(c->uring, c->send_buf + c->send_off, c->send_size - c->send_off);
+        if (n < 0) { c->send_off = c->send_size = 0; return -1; }
+        c->send_inflight = (size_t)n;
+    }
+    return 0;
 }
+#endif
 
-wibesocket_error_t wibesocket_send_text(wibesocket_conn_t* conn, const char* text, size_t len) {
-    return send_frame((wibesocket_conn*)conn, WS_OPCODE_TEXT, text, len);
+typedef struct {
+    ws_mpsc_node_t node;
+    size_t         cap; /* allocation size, for ws_mem_put */
+    size_t         len;
+    uint8_t        bytes[]; /* complete masked frame */
+} ws_posted_frame_t;
+
+/* Bytes accepted but not yet written: queued, in zerocopy buffers, or posted by other threads */
+static size_t ws_send_backlog(const wibesocket_conn* c) {
+    return (c->send_size - c->send_off) + c->zc_unsent + atomic_load_explicit(&c->post_bytes, memory_order_relaxed);
 }
 
-wibesocket_error_t wibesocket_send_binary(wibesocket_conn_t* conn, const void* data, size_t len) {
-    return send_frame((wibesocket_conn*)conn, WS_OPCODE_BINARY, data, len);
+/* Admission for a new outgoing frame of need bytes: one frame always fits an empty queue, so
+ * a single message larger than the high mark is still possible. */
+static int ws_send_admit(wibesocket_conn* c, size_t need) {
+    size_t backlog = ws_send_backlog(c);
+    if (backlog == 0 || backlog + need <= c->send_high) return 1;
+    c->send_blocked = 1;
+    return 0;
 }
 
-wibesocket_error_t wibesocket_send_ping(wibesocket_conn_t* conn, const void* data, size_t len) {
-    return send_frame((wibesocket_conn*)conn, WS_OPCODE_PING, data, len);
+/* After a flush: report the drop below the low mark once per refusal */
+static void ws_check_drained(wibesocket_conn* c) {
+    if (c->send_blocked && ws_send_backlog(c) <= c->send_low) {
+        c->send_blocked = 0;
+        c->drained_pending = 1;
+        if (c->loop_entry) ws_loop_entry_mark_pending(c->loop_entry);
+    }
 }
 
-wibesocket_error_t wibesocket_send_close(wibesocket_conn_t* conn, uint16_t code, const char* reason) {
-    uint8_t payload[2 + 125]; size_t n = 0;
-    payload[n++] = (uint8_t)((code >> 8) & 0xFF); payload[n++] = (uint8_t)(code & 0xFF);
-    if (reason) {
-        size_t rlen = strlen(reason); if (rlen > 125) rlen = 125;
-        memcpy(payload + n, reason, rlen); n += rlen;
+/* A send failed hard: the peer will never see the queue, so drop it and say why */
+static int ws_send_failed(wibesocket_conn* c, wibesocket_error_t why) {
+    c->send_off = c->send_size = 0;
+    ws_zc_drop_all(c);
+    if (c->post_held) {
+        ws_posted_frame_t* f = (ws_posted_frame_t*)c->post_held;
+        c->post_held = NULL;
+        atomic_fetch_sub_explicit(&c->post_bytes, f->len, memory_order_relaxed);
+        ws_mem_put(c, f, f->cap);
     }
-    wibesocket_conn* c = (wibesocket_conn*)conn;
-    wibesocket_error_t e = send_frame(c, WS_OPCODE_CLOSE, payload, n);
-    if (e == WIBESOCKET_OK) { c->state = WIBESOCKET_STATE_CLOSING; c->close_sent = 1; c->close_sent_ms = ws_now_ms(); }
-    return e;
+    if (c->state == WIBESOCKET_STATE_OPEN || c->state == WIBESOCKET_STATE_CLOSING) {
+        c->state = WIBESOCKET_STATE_ERROR;
+        c->last_error = why;
+    }
+    return -1;
 }
 
-wibesocket_error_t wibesocket_recv(wibesocket_conn_t* conn, wibesocket_message_t* msg, int timeout_ms) {
-    wibesocket_conn* c = (wibesocket_conn*)conn;
-    if (!c || c->state != WIBESOCKET_STATE_OPEN) return WIBESOCKET_ERROR_NOT_READY;
-    if (c->pinned_refcnt > 0) return WIBESOCKET_ERROR_NOT_READY;
-    /* Flush any pending sends */
-    ws_flush_send(c);
-    int w = wait_epoll(c->epfd, timeout_ms);
-    if (w <= 0) return WIBESOCKET_ERROR_TIMEOUT;
-    ssize_t rd = recv(c->fd, c->recv_buf + c->recv_size, c->recv_cap - c->recv_size, 0);
-    if (rd < 0) return (errno == EAGAIN || errno == EWOULDBLOCK) ? WIBESOCKET_ERROR_TIMEOUT : WIBESOCKET_ERROR_NETWORK;
-    if (rd == 0) { c->state = WIBESOCKET_STATE_CLOSED; return WIBESOCKET_ERROR_CLOSED; }
-    c->recv_size += (size_t)rd;
-
-    size_t consumed = 0; ws_parsed_frame_t fr;
-    ws_parser_status_t st = ws_parser_feed(&c->parser, c->recv_buf, c->recv_size, &consumed, &fr);
-    if (st == WS_PARSER_NEED_MORE) return WIBESOCKET_ERROR_NOT_READY;
-    if (st < 0) { c->last_error = WIBESOCKET_ERROR_PROTOCOL; return c->last_error; }
-    /* Defer sliding until payload released to keep zero-copy pointer valid */
-    c->pending_consume = consumed;
-
-    /* Handle control frames */
-    if (fr.type == WS_OPCODE_PING) {
-        /* Respond with PONG carrying same payload */
-        (void)send_frame(c, WS_OPCODE_PONG, fr.payload, fr.payload_len);
-        return WIBESOCKET_ERROR_NOT_READY;
+/* Owner side of wibesocket_post_send. The wakeup is consumed and the flag cleared before the
+ * queue is drained, so a producer that finds the flag set knows its frame will be seen. */
+static int ws_drain_posted(wibesocket_conn* c) {
+    if (atomic_load_explicit(&c->post_signalled, memory_order_acquire)) {
+        uint64_t cnt;
+        ssize_t r = read(c->post_fd, &cnt, sizeof(cnt));
+        (void)r;
+        WS_STAT_ADD(c->stats, syscalls, 1);
+        atomic_store(&c->post_signalled, 0);
+    }
+    ws_mpsc_node_t* n;
+    while ((n = c->post_held ? c->post_held : ws_mpsc_pop(&c->posted)) != NULL) {
+        ws_posted_frame_t* f = (ws_posted_frame_t*)n;
+        int was_empty = !ws_send_pending(c);
+        uint8_t* out = ws_queue_reserve(c, f->len);
+        /* No room: keep it at the head so nothing behind it overtakes it */
+        if (!out) { c->post_held = n; return -1; }
+        c->post_held = NULL;
+        memcpy(out, f->bytes, f->len); c->send_size += f->len;
+        if (c->stats) ws_stat_frame_out(c, f->bytes[0], f->len, was_empty);
+        atomic_fetch_sub_explicit(&c->post_bytes, f->len, memory_order_relaxed);
+        ws_mem_put(c, f, f->cap);
+    }
+    return 0;
+}
+
+/* Push queued bytes until the socket would block. Returns -1 on a hard socket error. */
+static int ws_flush_send(wibesocket_conn* c) {
+    c->flush_due_us = 0;
+    if (c->state == WIBESOCKET_STATE_OPEN) ws_drain_posted(c);
+#if defined(WS_HAVE_IO_URING)
+    if (c->uring) {
+        if (ws_flush_uring(c) < 0) return ws_send_failed(c, WIBESOCKET_ERROR_NETWORK);
+        /* A held frame is retried once the queue has emptied; if it still does not fit,
+         * nothing later will make room for it */
+        if (c->post_held && !c->send_inflight && c->send_off == c->send_size) {
+            if (ws_drain_posted(c) < 0) return ws_send_failed(c, WIBESOCKET_ERROR_MEMORY);
+            if (ws_flush_uring(c) < 0) return ws_send_failed(c, WIBESOCKET_ERROR_NETWORK);
+        }
+        ws_check_drained(c);
+        return 0;
     }
-    if (fr.type == WS_OPCODE_CLOSE) {
-        /* Parse close code if present */
-        uint16_t code = WIBESOCKET_CLOSE_NORMAL;
-        if (fr.payload_len >= 2) {
-            const uint8_t* b = (const uint8_t*)fr.payload;
-            code = (uint16_t)((b[0] << 8) | b[1]);
+#endif
+    if (c->zc_head) ws_zc_reap(c);
+    while (ws_send_pending(c)) {
+        #ifdef MSG_NOSIGNAL
+        const int send_flags = MSG_NOSIGNAL;
+        #else
+        const int send_flags = 0;
+        #endif
+        /* Queue bytes up to the next payload with a buffer of its own, then that payload */
+        ws_zc_buf_t* z = c->zc_next;
+        size_t run = c->send_size - c->send_off;
+        if (z && z->at - c->send_written < run) run = (size_t)(z->at - c->send_written);
+        if (run == 0 && z->off == z->len) { c->zc_next = z->next; continue; }
+        ssize_t wr;
+        int zc = 0;
+        if (run > 0) {
+            wr = send(c->fd, c->send_buf + c->send_off, run, send_flags);
+        } else {
+#if defined(WS_HAVE_ZEROCOPY)
+            size_t zc_min = c->cfg.zerocopy_threshold ? c->cfg.zerocopy_threshold : WS_ZEROCOPY_MIN;
+            zc = z->len - z->off >= zc_min && ws_zc_enabled(c);
+            wr = send(c->fd, z->buf + z->off, z->len - z->off, send_flags | (zc ? MSG_ZEROCOPY : 0));
+            /* Out of option memory for pinned pages: this stretch goes out copied */
+            if (wr < 0 && zc && errno == ENOBUFS) {
+                zc = 0;
+                wr = send(c->fd, z->buf + z->off, z->len - z->off, send_flags);
+            }
+#else
+            wr = send(c->fd, z->buf + z->off, z->len - z->off, send_flags);
+#endif
         }
-        if (c->state != WIBESOCKET_STATE_CLOSING) {
-            (void)wibesocket_send_close(conn, code, NULL);
+        WS_STAT_ADD(c->stats, syscalls, 1);
+        if (wr > 0 && run > 0) {
+            c->send_off += (size_t)wr;
+            c->send_written += (size_t)wr;
+        } else if (wr > 0) {
+            if (zc) {
+                if (!z->ids) z->first_id = c->zc_seq;
+                z->ids++;
+                c->zc_seq++;
+            }
+            z->off += (size_t)wr;
+            c->zc_unsent -= (size_t)wr;
+            if (z->off == z->len) c->zc_next = z->next;
+        } else {
+            if (wr < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                WS_STAT_ADD(c->stats, eagain, 1);
+                ws_sync_write_interest(c);
+                ws_check_drained(c);
+                return 0;
+            }
+            if (wr < 0 && errno == EINTR) continue;
+            ws_send_failed(c, WIBESOCKET_ERROR_NETWORK);
+            ws_sync_write_interest(c);
+            return -1;
         }
-        c->state = WIBESOCKET_STATE_CLOSED;
-        if (c->fd >= 0) { close(c->fd); c->fd = -1; }
-        return WIBESOCKET_ERROR_CLOSED;
-    }
-
-    /* Fill out message; zero-copy view into recv buffer */
-    msg->type = (fr.type == WS_OPCODE_TEXT) ? WIBESOCKET_FRAME_TEXT :
-                (fr.type == WS_OPCODE_BINARY) ? WIBESOCKET_FRAME_BINARY : WIBESOCKET_FRAME_CONTINUATION;
-    msg->payload = fr.payload;
-    msg->payload_len = fr.payload_len;
-    msg->is_final = fr.is_final;
-    /* Pin the payload region to avoid reuse/memmove until released by FFI */
-    c->pinned_payload = (const uint8_t*)fr.payload;
-    c->pinned_len = fr.payload_len;
-    c->pinned_refcnt = 1;
-    return WIBESOCKET_OK;
+    }
+    /* all sent */
+    c->send_off = c->send_size = 0;
+    if (c->post_held && c->state == WIBESOCKET_STATE_OPEN) {
+        /* Retried into the emptied queue; if it still does not fit, nothing later will make
+         * room for it */
+        if (ws_drain_posted(c) < 0) {
+            ws_send_failed(c, WIBESOCKET_ERROR_MEMORY);
+            ws_sync_write_interest(c);
+            return -1;
+        }
+        return ws_flush_send(c);
+    }
+    if (c->zc_head) ws_zc_collect(c);
+    ws_stat_drained(c);
+    ws_queue_trim(c);
+    ws_sync_write_interest(c);
+    ws_check_drained(c);
+    return 0;
 }
 
-wibesocket_state_t wibesocket_get_state(const wibesocket_conn_t* conn) {
-    const wibesocket_conn* c = (const wibesocket_conn*)conn;
-    return c ? c->state : WIBESOCKET_STATE_ERROR;
+/* Coalescing is holding queued frames back until flush_due_us */
+static int ws_send_held(const wibesocket_conn* c) {
+    return c->flush_due_us && ws_now_us() < c->flush_due_us;
 }
 
-wibesocket_error_t wibesocket_get_error(const wibesocket_conn_t* conn) {
-    const wibesocket_conn* c = (const wibesocket_conn*)conn;
-    return c ? c->last_error : WIBESOCKET_ERROR_INVALID_ARGS;
+/* After queuing: write now, unless corked or coalescing holds small data frames back. The
+ * first frame held starts the deadline; urgent (control) frames go at once with everything
+ * queued ahead of them. */
+static int ws_send_kick(wibesocket_conn* c, int urgent) {
+    if (c->corked) return 0;
+    if (c->cfg.coalesce_delay_us && !urgent && ws_send_backlog(c) < c->coalesce_bytes) {
+        if (!c->flush_due_us) {
+            c->flush_due_us = ws_now_us() + c->cfg.coalesce_delay_us;
+            if (c->loop_entry) ws_loop_entry_flush_at(c->loop_entry, c->flush_due_us);
+            return 0;
+        }
+        if (ws_send_held(c)) return 0;
+    }
+    return ws_flush_send(c);
 }
 
-static void safe_close(int* fd) { if (*fd >= 0) { close(*fd); *fd = -1; } }
+static wibesocket_error_t ws_read_socket(wibesocket_conn* c);
+static int ws_rx_grow(wibesocket_conn* c);
+static void ws_rx_lend_back(wibesocket_conn* c);
 
-wibesocket_error_t wibesocket_close(wibesocket_conn_t* conn) {
-    wibesocket_conn* c = (wibesocket_conn*)conn;
-    if (!c) return WIBESOCKET_ERROR_INVALID_ARGS;
-    if (c->state == WIBESOCKET_STATE_OPEN) {
-        (void)wibesocket_send_close(conn, WIBESOCKET_CLOSE_NORMAL, NULL);
+static void ws_connect_cleanup(wibesocket_conn* c) {
+#if defined(WS_HAVE_GETADDRINFO_A)
+    if (c->cn_gai_active) {
+        /* A lookup that already started cannot be cancelled; it writes into c, so wait it out */
+        if (gai_cancel(&c->cn_gai) == EAI_NOTCANCELED) {
+            const struct gaicb* list[1] = { &c->cn_gai };
+            while (gai_error(&c->cn_gai) == EAI_INPROGRESS) (void)gai_suspend(list, 1, NULL);
+        }
+        if (c->cn_gai.ar_result) freeaddrinfo(c->cn_gai.ar_result);
+        c->cn_gai_active = 0;
+    }
+#endif
+    if (c->cn_addrs && c->cn_addrs_dup) free(c->cn_addrs);
+    else if (c->cn_addrs) freeaddrinfo(c->cn_addrs);
+    c->cn_addrs = c->cn_next = NULL;
+    c->cn_pool_host = NULL;
+    ws_mem_put(c, c->cn_host, c->cn_cap);
+    c->cn_host = c->cn_port = c->cn_path = NULL;
+    ws_mem_put(c, c->cn_resp, c->cn_resp_cap);
+    c->cn_resp = NULL;
+    c->cn_phase = WS_CONNECT_IDLE;
+}
+
+static wibesocket_error_t ws_connect_fail(wibesocket_conn* c, wibesocket_error_t e) {
+    ws_connect_cleanup(c);
+    c->state = WIBESOCKET_STATE_ERROR;
+    c->last_error = e;
+    return e;
+}
+
+/* Numeric hosts resolve immediately; names go through getaddrinfo_a when async. */
+static wibesocket_error_t ws_connect_resolve(wibesocket_conn* c, int async) {
+    struct addrinfo hints; memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC; hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICHOST;
+    if (getaddrinfo(c->cn_host, c->cn_port, &hints, &c->cn_addrs) == 0) {
+        c->cn_next = c->cn_addrs;
+        return WIBESOCKET_OK;
+    }
+    c->cn_addrs = NULL;
+    hints.ai_flags = 0;
+#if defined(WS_HAVE_GETADDRINFO_A)
+    if (async) {
+        c->cn_hints = hints;
+        memset(&c->cn_gai, 0, sizeof(c->cn_gai));
+        c->cn_gai.ar_name = c->cn_host;
+        c->cn_gai.ar_service = c->cn_port;
+        c->cn_gai.ar_request = &c->cn_hints;
+        struct gaicb* list[1] = { &c->cn_gai };
+        struct sigevent sev; memset(&sev, 0, sizeof(sev));
+        sev.sigev_notify = SIGEV_NONE;
+        if (getaddrinfo_a(GAI_NOWAIT, list, 1, &sev) != 0) return WIBESOCKET_ERROR_NETWORK;
+        c->cn_gai_active = 1;
+        c->cn_phase = WS_CONNECT_RESOLVE;
+        return WIBESOCKET_ERROR_NOT_READY;
     }
-    /* Wait briefly for peer CLOSE */
-    uint64_t start = ws_now_ms();
-    while (ws_now_ms() - start < 500) {
-        wibesocket_message_t m; memset(&m,0,sizeof(m));
-        if (wibesocket_recv(conn, &m, 50) == WIBESOCKET_ERROR_CLOSED) break;
+#else
+    (void)async;
+#endif
+    if (getaddrinfo(c->cn_host, c->cn_port, &hints, &c->cn_addrs) != 0) {
+        c->cn_addrs = NULL;
+        return WIBESOCKET_ERROR_NETWORK;
     }
-    safe_close(&c->fd);
-    safe_close(&c->epfd);
-    free(c->recv_buf);
-    ws_queue_free(c);
-    free(c);
+    c->cn_next = c->cn_addrs;
     return WIBESOCKET_OK;
 }
 
-static const char* k_error_strings[] = {
-    "ok",
-    "invalid args",
-    "memory",
-    "network",
-    "handshake",
-    "protocol",
-    "timeout",
-    "closed",
-    "buffer full",
-    "not ready",
-};
+/* A pool's connection shares what it looked up with the pool's address cache */
+static void ws_connect_resolved(wibesocket_conn* c) {
+    if (c->cn_pool_host) ws_pool_host_resolved(c->cn_pool_host, c->cn_addrs);
+    c->cn_pool_host = NULL;
+}
 
-const char* wibesocket_error_string(wibesocket_error_t error) {
-    size_t n = sizeof(k_error_strings)/sizeof(k_error_strings[0]);
-    return ((unsigned)error < n) ? k_error_strings[error] : "unknown";
+static void ws_connect_set_fd(wibesocket_conn* c, int fd) {
+    if (c->fd >= 0) {
+        if (c->loop_entry) ws_loop_entry_set_fd(c->loop_entry, -1);
+        close(c->fd);
+    }
+    c->fd = fd;
+    if (fd >= 0 && c->loop_entry) ws_loop_entry_set_fd(c->loop_entry, fd);
 }
 
-void wibesocket_retain_payload(wibesocket_conn_t* conn) {
-    wibesocket_conn* c = (wibesocket_conn*)conn;
-    if (!c) return;
-    if (c->pinned_refcnt > 0) c->pinned_refcnt++;
+/* busy_poll_socket: let reads on fd poll the device queue; best effort */
+static void ws_set_busy_poll(int fd, uint32_t us) {
+#if defined(SO_BUSY_POLL)
+    int v = us > INT32_MAX ? INT32_MAX : (int)us;
+    (void)setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &v, sizeof(v));
+#if defined(SO_PREFER_BUSY_POLL)
+    int one = 1; (void)setsockopt(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &one, sizeof(one));
+#endif
+#else
+    (void)fd; (void)us;
+#endif
 }
 
-void wibesocket_release_payload(wibesocket_conn_t* conn) {
-    wibesocket_conn* c = (wibesocket_conn*)conn;
-    if (!c) return;
-    if (c->pinned_refcnt > 0) c->pinned_refcnt--;
-    if (c->pinned_refcnt == 0) {
-        /* After release, compact recv buffer by consuming the parsed frame bytes */
-        if (c->pending_consume > 0 && c->pending_consume <= c->recv_size) {
-            memmove(c->recv_buf, c->recv_buf + c->pending_consume, c->recv_size - c->pending_consume);
-            c->recv_size -= c->pending_consume;
-            c->pending_consume = 0;
-        }
-        c->pinned_payload = NULL;
-        c->pinned_len = 0;
+/* Start a non-blocking connect() to the next candidate address. */
+static wibesocket_error_t ws_connect_tcp(wibesocket_conn* c) {
+    while (c->cn_next) {
+        struct addrinfo* ai = c->cn_next;
+        c->cn_next = ai->ai_next;
+        int fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) continue;
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) != 0 && errno != EINPROGRESS) { close(fd); continue; }
+        /* Low-latency TCP settings */
+        int one = 1; (void)setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        int buf = 1 << 20; (void)setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buf, sizeof(buf));
+        (void)setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buf, sizeof(buf));
+        if (c->cfg.busy_poll_us && c->cfg.busy_poll_socket) ws_set_busy_poll(fd, c->cfg.busy_poll_us);
+        ws_connect_set_fd(c, fd);
+        c->cn_phase = WS_CONNECT_TCP;
+        return WIBESOCKET_OK;
     }
+    return WIBESOCKET_ERROR_NETWORK;
 }
 
-int wibesocket_fileno(const wibesocket_conn_t* conn) {
-    const wibesocket_conn* c = (const wibesocket_conn*)conn;
-    return c ? c->fd : -1;
+#if defined(WS_HAVE_ZLIB)
+/* Config window bits as offered: 0 = 15, and zlib needs at least 9 */
+static int ws_window_bits(uint8_t bits) {
+    if (bits == 0 || bits > 15) return 15;
+    return bits < 9 ? 9 : bits;
 }
+#endif
 
-wibesocket_error_t wibesocket_poll_events(wibesocket_conn_t* conn, int timeout_ms) {
-    wibesocket_conn* c = (wibesocket_conn*)conn;
-    if (!c || c->epfd < 0) return WIBESOCKET_ERROR_INVALID_ARGS;
-    int w = wait_epoll(c->epfd, timeout_ms);
-    if (w > 0) return WIBESOCKET_OK;
-    if (w == 0) return WIBESOCKET_ERROR_TIMEOUT;
-    return WIBESOCKET_ERROR_NETWORK;
+/* permessage-deflate offer for this connection; disabled (never offered) without zlib */
+static void ws_deflate_offer(const wibesocket_conn* c, ws_deflate_params_t* offer) {
+    memset(offer, 0, sizeof(*offer));
+#if defined(WS_HAVE_ZLIB)
+    if (!c->cfg.enable_compression) return;
+    offer->enabled = 1;
+    offer->client_max_window_bits = ws_window_bits(c->cfg.compression_client_max_window_bits);
+    if (c->cfg.compression_server_max_window_bits) {
+        offer->server_max_window_bits = ws_window_bits(c->cfg.compression_server_max_window_bits);
+    }
+    offer->client_no_context_takeover = c->cfg.compression_client_no_context_takeover;
+    offer->server_no_context_takeover = c->cfg.compression_server_no_context_takeover;
+#else
+    (void)c;
+#endif
+}
+
+/* Queue the upgrade request; it goes out through the normal send queue. */
+static wibesocket_error_t ws_connect_queue_request(wibesocket_conn* c) {
+    if (ws_generate_client_key(c->client_key) != 0) return WIBESOCKET_ERROR_HANDSHAKE;
+    ws_compute_accept(c->client_key, c->expected_accept);
+    ws_deflate_params_t offer;
+    ws_deflate_offer(c, &offer);
+    char ext[160] = "";
+    if (offer.enabled && ws_format_deflate_offer(&offer, ext, sizeof(ext)) < 0) return WIBESOCKET_ERROR_HANDSHAKE;
+    if (!c->cn_resp) {
+        c->cn_resp = (ws_http_response_t*)ws_mem_get(c, sizeof(*c->cn_resp), &c->cn_resp_cap);
+        if (!c->cn_resp) return WIBESOCKET_ERROR_MEMORY;
+    }
+    ws_http_response_init(c->cn_resp);
+    c->cn_scanned = 0;
+    uint8_t* out = ws_queue_reserve(c, 1024);
+    if (!out) return WIBESOCKET_ERROR_MEMORY;
+    size_t key_off = 0;
+    int n = ws_build_handshake_template(c->cn_host, atoi(c->cn_port), c->cn_path, c->cfg.user_agent,
+                                        c->cfg.origin, c->cfg.protocol, ext, (char*)out, 1024, &key_off);
+    if (n <= 0) return WIBESOCKET_ERROR_HANDSHAKE;
+    ws_handshake_set_key((char*)out, key_off, c->client_key);
+    c->send_size += (size_t)n;
+    c->cn_phase = WS_CONNECT_SEND;
+    return WIBESOCKET_OK;
 }
 
+/* Feed handshake bytes that arrived since the last read to the header parser. Bytes after the
+ * blank line are early frames and stay buffered for the first recv. */
+static ws_http_status_t ws_connect_feed(wibesocket_conn* c) {
+    const char* data = (const char*)c->rx.buffer + c->rx.tail;
+    size_t used = 0;
+    ws_http_status_t st = ws_http_response_feed(c->cn_resp, data + c->cn_scanned, c->rx.count - c->cn_scanned, &used);
+    c->cn_scanned += used;
+    /* Headers longer than the ring grow it (the parser caps them at WS_HTTP_MAX_HEADER) */
+    if (st == WS_HTTP_NEED_MORE && c->rx.count >= c->rx.capacity && ws_rx_grow(c) != 0) return WS_HTTP_ERROR;
+    return st;
+}
 
+/* Validate the response once the blank line is in */
+static wibesocket_error_t ws_connect_check_response(wibesocket_conn* c) {
+    ws_http_response_t* r = c->cn_resp;
+    ws_http_status_t st = ws_connect_feed(c);
+    if (st == WS_HTTP_ERROR) return WIBESOCKET_ERROR_HANDSHAKE;
+    if (st == WS_HTTP_NEED_MORE) return WIBESOCKET_ERROR_NOT_READY;
+    if (ws_http_response_check(r, c->expected_accept, c->cfg.protocol) != 0) return WIBESOCKET_ERROR_HANDSHAKE;
+    ws_deflate_params_t offer, agreed;
+    ws_deflate_offer(c, &offer);
+    if (ws_negotiate_deflate_value(ws_http_response_value(r, WS_HTTP_EXTENSIONS), &offer, &agreed) != 0)
+        return WIBESOCKET_ERROR_HANDSHAKE;
+    const char* chosen = ws_http_response_value(r, WS_HTTP_PROTOCOL);
+    if (chosen) {
+        size_t n = strlen(chosen) + 1;
+        c->protocol = (char*)ws_mem_get(c, n, &c->protocol_cap);
+        if (!c->protocol) return WIBESOCKET_ERROR_MEMORY;
+        memcpy(c->protocol, chosen, n);
+    }
+#if defined(WS_HAVE_ZLIB)
+    if (agreed.enabled) {
+        c->deflate = ws_deflate_create(&agreed);
+        if (!c->deflate) return WIBESOCKET_ERROR_MEMORY;
+        c->deflate_threshold = c->cfg.compression_threshold ? c->cfg.compression_threshold
+                                                            : WS_DEFAULT_COMPRESSION_THRESHOLD;
+        c->parser.allow_rsv1 = true;
+    }
+#endif
+    ws_ringbuf_consume(&c->rx, c->cn_scanned);
+    return WIBESOCKET_OK;
+}
+
+/* Server side: once the client's request is in, queue the 101 with the first subprotocol it
+ * offered that cfg.protocol lists, or write a 400 (best effort) and fail */
+static wibesocket_error_t ws_accept_check_request(wibesocket_conn* c) {
+    ws_http_response_t* r = c->cn_resp;
+    ws_http_status_t st = ws_connect_feed(c);
+    if (st == WS_HTTP_NEED_MORE) return WIBESOCKET_ERROR_NOT_READY;
+    char accept[29];
+    if (st == WS_HTTP_ERROR || ws_http_request_check(r, accept) != 0) {
+#ifdef MSG_NOSIGNAL
+        const int send_flags = MSG_NOSIGNAL;
+#else
+        const int send_flags = 0;
+#endif
+        ssize_t w = send(c->fd, WS_HANDSHAKE_REJECT, sizeof(WS_HANDSHAKE_REJECT) - 1, send_flags);
+        (void)w;
+        return WIBESOCKET_ERROR_HANDSHAKE;
+    }
+    size_t plen = 0;
+    const char* chosen = ws_select_protocol(ws_http_response_value(r, WS_HTTP_PROTOCOL), c->cfg.protocol, &plen);
+    if (chosen) {
+        c->protocol = (char*)ws_mem_get(c, plen + 1, &c->protocol_cap);
+        if (!c->protocol) return WIBESOCKET_ERROR_MEMORY;
+        memcpy(c->protocol, chosen, plen);
+        c->protocol[plen] = 0;
+    }
+    size_t need = 160 + plen;
+    uint8_t* out = ws_queue_reserve(c, need);
+    if (!out) return WIBESOCKET_ERROR_MEMORY;
+    int n = ws_build_handshake_reply(accept, chosen, plen, (char*)out, need);
+    if (n <= 0) return WIBESOCKET_ERROR_HANDSHAKE;
+    c->send_size += (size_t)n;
+    ws_ringbuf_consume(&c->rx, c->cn_scanned);
+    c->cn_phase = WS_CONNECT_SEND;
+    return WIBESOCKET_OK;
+}
+
+/* Handshake done on either side: switch to the open connection's engine */
+static wibesocket_error_t ws_connect_open(wibesocket_conn* c) {
+    ws_connect_cleanup(c);
+    if (c->epfd >= 0 && ep_add_in(c->epfd, c->fd) < 0) return ws_connect_fail(c, WIBESOCKET_ERROR_NETWORK);
+#if defined(WS_HAVE_IO_URING)
+    /* Falls back to epoll silently where io_uring is disabled or too old */
+    if (c->cfg.io_backend == WIBESOCKET_IO_URING) {
+        c->uring = ws_uring_create(c->fd);
+        if (c->uring && ws_uring_watch(c->uring, c->post_fd) < 0) { ws_uring_destroy(c->uring); c->uring = NULL; }
+        if (c->uring && c->loop_entry) ws_loop_entry_set_fd(c->loop_entry, ws_uring_fd(c->uring));
+    }
+#endif
+    /* Frames that arrived with the handshake are parsed by the first recv */
+    c->rx_drained = 0;
+    c->state = WIBESOCKET_STATE_OPEN;
+    c->last_rx_ms = ws_now_ms();
+    if (c->stats) {
+        ws_stat_add(c->stats, WS_STAT_SLOT(handshake_us), ws_now_us() - c->cn_start_us);
+        ws_stat_add(c->stats, WS_STAT_SLOT(connections), 1);
+    }
+    ws_rx_lend_back(c);
+    ws_queue_trim(c);
+    /* Frames posted while connecting go out now */
+    if (atomic_load(&c->post_signalled) && ws_flush_send(c) < 0) return ws_connect_fail(c, WIBESOCKET_ERROR_NETWORK);
+    return WIBESOCKET_OK;
+}
+
+/* One non-blocking pass of the connect state machine: resolve -> TCP connect -> send upgrade
+ * -> read 101 (accepted connections: read the request -> send the 101). Advances as far as
+ * readiness allows and returns NOT_READY, OK once open, or the failure (state ERROR). */
+static wibesocket_error_t ws_connect_step(wibesocket_conn* c) {
+    if (ws_now_ms() >= c->cn_deadline_ms) return ws_connect_fail(c, WIBESOCKET_ERROR_TIMEOUT);
+    for (;;) {
+        switch (c->cn_phase) {
+        case WS_CONNECT_RESOLVE: {
+#if defined(WS_HAVE_GETADDRINFO_A)
+            int rc = gai_error(&c->cn_gai);
+            if (rc == EAI_INPROGRESS) return WIBESOCKET_ERROR_NOT_READY;
+            c->cn_gai_active = 0;
+            if (rc != 0) return ws_connect_fail(c, WIBESOCKET_ERROR_NETWORK);
+            c->cn_addrs = c->cn_next = c->cn_gai.ar_result;
+            c->cn_gai.ar_result = NULL;
+#endif
+            ws_connect_resolved(c);
+            if (ws_connect_tcp(c) != WIBESOCKET_OK) return ws_connect_fail(c, WIBESOCKET_ERROR_NETWORK);
+            break;
+        }
+        case WS_CONNECT_TCP: {
+            struct pollfd pfd = { c->fd, POLLOUT, 0 };
+            int w = poll(&pfd, 1, 0);
+            if (w == 0 || (w < 0 && errno == EINTR)) return WIBESOCKET_ERROR_NOT_READY;
+            int err = 0; socklen_t el = sizeof(err);
+            if (w < 0 || getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &el) < 0) err = errno ? errno : EIO;
+            if (err != 0) {
+                /* Refused or unreachable: fall through to the next address */
+                if (ws_connect_tcp(c) != WIBESOCKET_OK) return ws_connect_fail(c, WIBESOCKET_ERROR_NETWORK);
+                break;
+            }
+            wibesocket_error_t e = ws_connect_queue_request(c);
+            if (e != WIBESOCKET_OK) return ws_connect_fail(c, e);
+            break;
+        }
+        case WS_CONNECT_SEND:
+            if (ws_flush_send(c) < 0) return ws_connect_fail(c, WIBESOCKET_ERROR_NETWORK);
+            if (c->send_off < c->send_size) return WIBESOCKET_ERROR_NOT_READY;
+            if (c->server) return ws_connect_open(c);
+            c->cn_phase = WS_CONNECT_RECV;
+            break;
+        case WS_CONNECT_RECV: {
+            wibesocket_error_t e = ws_read_socket(c);
+            if (e == WIBESOCKET_ERROR_BUFFER_FULL) return ws_connect_fail(c, WIBESOCKET_ERROR_HANDSHAKE);
+            if (e == WIBESOCKET_ERROR_CLOSED) return ws_connect_fail(c, WIBESOCKET_ERROR_NETWORK);
+            if (e != WIBESOCKET_OK && e != WIBESOCKET_ERROR_TIMEOUT) return ws_connect_fail(c, e);
+            wibesocket_error_t r = c->server ? ws_accept_check_request(c) : ws_connect_check_response(c);
+            if (r == WIBESOCKET_ERROR_NOT_READY) {
+                if (e == WIBESOCKET_ERROR_TIMEOUT) return WIBESOCKET_ERROR_NOT_READY;
+                break; /* more may be queued in the kernel */
+            }
+            if (r != WIBESOCKET_OK) return ws_connect_fail(c, r);
+            if (c->server) break; /* on to SEND */
+            return ws_connect_open(c);
+        }
+        default:
+            return (c->state == WIBESOCKET_STATE_OPEN) ? WIBESOCKET_OK :
+                   (c->last_error != WIBESOCKET_OK ? c->last_error : WIBESOCKET_ERROR_NOT_READY);
+        }
+    }
+}
+
+/* Everything but the socket, for either side. -1 if c was freed; on 0 the state may already be
+ * ERROR. async: driven by connect_step or a loop, so no private epoll set. */
+static int ws_conn_init(wibesocket_conn* c, const wibesocket_config_t* config, int async) {
+    if (config) c->cfg = *config;
+    c->fd = c->epfd = c->post_fd = -1;
+    c->send_high = c->cfg.send_high_watermark ? c->cfg.send_high_watermark : WS_DEFAULT_SEND_HIGH_WATERMARK;
+    c->send_low = c->cfg.send_low_watermark ? c->cfg.send_low_watermark : c->send_high / 4;
+    if (c->send_low > c->send_high) c->send_low = c->send_high;
+    c->coalesce_bytes = c->cfg.coalesce_bytes ? c->cfg.coalesce_bytes : WS_DEFAULT_COALESCE_BYTES;
+    c->shard = -1;
+    ws_mpsc_init(&c->posted);
+    c->state = WIBESOCKET_STATE_CONNECTING;
+    c->last_error = WIBESOCKET_OK;
+    int timeout = (int)c->cfg.handshake_timeout_ms; if (timeout <= 0) timeout = 5000;
+    c->cn_deadline_ms = ws_now_ms() + (uint64_t)timeout;
+    c->track_rx = c->cfg.ping_interval_ms > 0 || c->cfg.idle_timeout_ms > 0;
+    if (c->cfg.enable_stats) {
+        c->stats = ws_stats_create();
+        if (!c->stats) { ws_connect_cleanup(c); ws_conn_free(c); return -1; }
+        c->cn_start_us = ws_now_us();
+    }
+    size_t recv_cap = c->cfg.recv_buffer_size;
+    if (recv_cap == 0) {
+        recv_cap = (size_t)(c->cfg.max_frame_size ? c->cfg.max_frame_size : (1U << 20)) + 16;
+        if (recv_cap > WS_DEFAULT_RECV_BUFFER) recv_cap = WS_DEFAULT_RECV_BUFFER;
+    }
+    c->rx_max = recv_cap;
+    size_t first = recv_cap < WS_RECV_INITIAL ? recv_cap : WS_RECV_INITIAL;
+    if (ws_ringbuf_init_mirrored(&c->rx, first) != 0 && ws_ringbuf_init(&c->rx, first) != 0) {
+        ws_connect_cleanup(c); ws_conn_free(c); return -1;
+    }
+    ws_parser_init(&c->parser, c->cfg.max_frame_size ? c->cfg.max_frame_size : (1U << 20));
+    c->parser.masking = WS_MASK_FORBIDDEN;
+    ws_queue_init(c);
+    c->post_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (c->post_fd < 0) { (void)ws_connect_fail(c, WIBESOCKET_ERROR_NETWORK); return 0; }
+    if (!async) {
+        c->epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (c->epfd < 0 || ep_add_in(c->epfd, c->post_fd) < 0) { (void)ws_connect_fail(c, WIBESOCKET_ERROR_NETWORK); return 0; }
+    }
+    return 0;
+}
+
+/* addrs, when given, is connected to (a copy of it) without a lookup */
+static wibesocket_conn* ws_connect_begin(const char* uri, const wibesocket_config_t* config, int async,
+                                         ws_pool_host_t* pool_host, const struct addrinfo* addrs) {
+    if (!uri) return NULL;
+    wibesocket_conn* c = ws_conn_alloc(config);
+    if (!c) return NULL;
+    if (parse_ws_uri(c, uri) != 0) { ws_connect_cleanup(c); ws_conn_free(c); return NULL; }
+    if (ws_conn_init(c, config, async) != 0) return NULL;
+    if (c->state == WIBESOCKET_STATE_ERROR) return c;
+
+    wibesocket_error_t e;
+    if (addrs) {
+        c->cn_addrs = c->cn_next = ws_addrinfo_dup(addrs);
+        c->cn_addrs_dup = 1;
+        e = c->cn_addrs ? WIBESOCKET_OK : WIBESOCKET_ERROR_MEMORY;
+    } else {
+        c->cn_pool_host = pool_host;
+        e = ws_connect_resolve(c, async);
+        if (e == WIBESOCKET_OK) ws_connect_resolved(c);
+    }
+    if (e == WIBESOCKET_OK) {
+        if (ws_connect_tcp(c) != WIBESOCKET_OK) (void)ws_connect_fail(c, WIBESOCKET_ERROR_NETWORK);
+    } else if (e != WIBESOCKET_ERROR_NOT_READY) {
+        (void)ws_connect_fail(c, e);
+    }
+    return c;
+}
+
+/* Blocking form: the same state machine, waiting on the socket between steps */
+static wibesocket_conn_t* ws_connect_wait(wibesocket_conn* c) {
+    while (c->state == WIBESOCKET_STATE_CONNECTING) {
+        if (ws_connect_step(c) != WIBESOCKET_ERROR_NOT_READY) break;
+        uint64_t now = ws_now_ms();
+        int wait = (now < c->cn_deadline_ms) ? (int)(c->cn_deadline_ms - now) : 0;
+        struct pollfd pfd = { c->fd, (short)(c->cn_phase == WS_CONNECT_RECV ? POLLIN : POLLOUT), 0 };
+        (void)poll(&pfd, 1, wait);
+    }
+    if (c->state != WIBESOCKET_STATE_OPEN) {
+        (void)wibesocket_close((wibesocket_conn_t*)c);
+        return NULL;
+    }
+    return (wibesocket_conn_t*)c;
+}
+
+wibesocket_conn_t* wibesocket_connect(const char* uri, const wibesocket_config_t* config) {
+    wibesocket_conn* c = ws_connect_begin(uri, config, 0, NULL, NULL);
+    return c ? ws_connect_wait(c) : NULL;
+}
+
+wibesocket_conn_t* wibesocket_connect_start(const char* uri, const wibesocket_config_t* config) {
+    return (wibesocket_conn_t*)ws_connect_begin(uri, config, 1, NULL, NULL);
+}
+
+wibesocket_conn_t* ws_conn_start_pooled(const char* uri, const wibesocket_config_t* config,
+                                        ws_pool_host_t* host, const struct addrinfo* addrs) {
+    return (wibesocket_conn_t*)ws_connect_begin(uri, config, 1, host, addrs);
+}
+
+wibesocket_conn_t* ws_conn_connect_pooled(const char* uri, const wibesocket_config_t* config,
+                                          ws_pool_host_t* host, const struct addrinfo* addrs, int timeout_ms) {
+    wibesocket_conn* c = ws_connect_begin(uri, config, 0, host, addrs);
+    if (!c) return NULL;
+    uint64_t deadline = ws_now_ms() + (uint64_t)(timeout_ms > 0 ? timeout_ms : 0);
+    if (timeout_ms > 0 && deadline < c->cn_deadline_ms) c->cn_deadline_ms = deadline;
+    return ws_connect_wait(c);
+}
+
+/* Server side: c takes fd, connected and with the client's request on its way */
+static wibesocket_conn* ws_accept_begin(int fd, const wibesocket_config_t* config, int async) {
+    if (fd < 0) return NULL;
+    wibesocket_conn* c = ws_conn_alloc(config);
+    if (!c) { close(fd); return NULL; }
+    if (ws_conn_init(c, config, async) != 0) { close(fd); return NULL; }
+    c->fd = fd;
+    c->server = 1;
+    c->parser.masking = WS_MASK_REQUIRED;
+    if (c->state == WIBESOCKET_STATE_ERROR) return c;
+    if (set_nonblocking(fd) != 0) { (void)ws_connect_fail(c, WIBESOCKET_ERROR_NETWORK); return c; }
+    int one = 1; (void)setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (c->cfg.busy_poll_us && c->cfg.busy_poll_socket) ws_set_busy_poll(fd, c->cfg.busy_poll_us);
+    c->cn_resp = (ws_http_response_t*)ws_mem_get(c, sizeof(*c->cn_resp), &c->cn_resp_cap);
+    if (!c->cn_resp) { (void)ws_connect_fail(c, WIBESOCKET_ERROR_MEMORY); return c; }
+    ws_http_request_init(c->cn_resp);
+    c->cn_scanned = 0;
+    c->cn_phase = WS_CONNECT_RECV;
+    return c;
+}
+
+wibesocket_conn_t* wibesocket_accept(int fd, const wibesocket_config_t* config) {
+    wibesocket_conn* c = ws_accept_begin(fd, config, 0);
+    return c ? ws_connect_wait(c) : NULL;
+}
+
+wibesocket_conn_t* wibesocket_accept_start(int fd, const wibesocket_config_t* config) {
+    return (wibesocket_conn_t*)ws_accept_begin(fd, config, 1);
+}
+
+wibesocket_error_t wibesocket_connect_step(wibesocket_conn_t* conn) {
+    wibesocket_conn* c = (wibesocket_conn*)conn;
+    if (!c) return WIBESOCKET_ERROR_INVALID_ARGS;
+    if (c->state == WIBESOCKET_STATE_OPEN) return WIBESOCKET_OK;
+    if (c->state != WIBESOCKET_STATE_CONNECTING) return c->last_error != WIBESOCKET_OK ? c->last_error : WIBESOCKET_ERROR_CLOSED;
+    return ws_connect_step(c);
+}
+
+/* From the thread's ChaCha20 stream: no syscall per frame */
+static void gen_mask(uint8_t m[4]) {
+    ws_random_bytes(m, 4);
+}
+
+/* Masking key for an outgoing frame, in m; NULL on a server, whose frames go out unmasked */
+static const uint8_t* ws_tx_mask(const wibesocket_conn* c, uint8_t m[4]) {
+    if (c->server) return NULL;
+    gen_mask(m);
+    return m;
+}
+
+static size_t ws_frame_size(size_t len) {
+    return 2 + ((len <= 125) ? 0 : (len <= 0xFFFF ? 2 : 8)) + 4 + len;
+}
+
+/* Frame for one message into out (ws_frame_size(len) + WS_DEFLATE_TAIL bytes), masked unless
+ * mask is NULL. Data messages past the threshold are deflated behind room for the largest
+ * header, then slid down behind the real one and masked in place; anything else, or a message
+ * that would not shrink, goes out plain. */
+static size_t ws_build_message(wibesocket_conn* c, ws_opcode_t opcode, const uint8_t mask[4],
+                               const void* data, size_t len, uint8_t* out, size_t cap) {
+#if defined(WS_HAVE_ZLIB)
+    if (c->deflate && len >= c->deflate_threshold &&
+        (opcode == WS_OPCODE_TEXT || opcode == WS_OPCODE_BINARY)) {
+        size_t hmax = ws_frame_size(len) - len;
+        size_t clen = 0;
+        if (ws_deflate_message(c->deflate, (const uint8_t*)data, len, out + hmax, cap - hmax, &clen) == 0) {
+            size_t hl = ws_build_frame_header(out, 1, WS_RSV1, opcode, mask, clen);
+            if (hl < hmax) memmove(out + hl, out + hmax, clen);
+            if (mask) ws_mask_copy(out + hl, out + hl, clen, mask, 0);
+            return hl + clen;
+        }
+    }
+#else
+    (void)c;
+#endif
+    return ws_build_frame(out, cap, 1, opcode, mask, (const uint8_t*)data, len);
+}
+
+/* zerocopy_threshold: data messages that large (and not about to be compressed) are masked (or
+ * copied, on a server) into a buffer of their own and written from it with MSG_ZEROCOPY */
+static int ws_zc_wanted(wibesocket_conn* c, ws_opcode_t opcode, size_t len) {
+#if defined(WS_HAVE_ZEROCOPY)
+    if (!c->cfg.zerocopy_threshold || len < c->cfg.zerocopy_threshold) return 0;
+    if (opcode != WS_OPCODE_TEXT && opcode != WS_OPCODE_BINARY) return 0;
+#if defined(WS_HAVE_IO_URING)
+    if (c->uring) return 0;
+#endif
+#if defined(WS_HAVE_ZLIB)
+    if (c->deflate && len >= c->deflate_threshold) return 0;
+#endif
+    return ws_zc_enabled(c);
+#else
+    (void)c; (void)opcode; (void)len;
+    return 0;
+#endif
+}
+
+/* Build a frame straight into the queue tail, behind anything still unsent. */
+static wibesocket_error_t ws_queue_frame(wibesocket_conn* c, ws_opcode_t opcode, const void* data, size_t len,
+                                         ws_zc_buf_t** spare) {
+    uint8_t key[4];
+    const uint8_t* mask = ws_tx_mask(c, key);
+    if (ws_zc_wanted(c, opcode, len)) {
+        size_t cap = 0;
+        uint8_t* buf = (uint8_t*)ws_mem_get(c, len, &cap);
+        if (buf) {
+            if (mask) ws_mask_copy(buf, (const uint8_t*)data, len, mask, 0);
+            else memcpy(buf, data, len);
+            wibesocket_error_t e = ws_queue_zc(c, opcode, mask, buf, len, cap, NULL, NULL, spare);
+            if (e != WIBESOCKET_OK) ws_mem_put(c, buf, cap);
+            return e;
+        }
+        /* No buffer to spare: the queue copy below */
+    }
+    size_t need = ws_frame_size(len) + WS_DEFLATE_TAIL;
+    int was_empty = !ws_send_pending(c);
+    uint8_t* out = ws_queue_reserve(c, need);
+    if (!out) return WIBESOCKET_ERROR_MEMORY;
+    size_t n = ws_build_message(c, opcode, mask, data, len, out, need);
+    if (n == 0) return WIBESOCKET_ERROR_BUFFER_FULL;
+    c->send_size += n;
+    if (c->stats) ws_stat_frame_out(c, (unsigned)opcode, n, was_empty);
+    return WIBESOCKET_OK;
+}
+
+static wibesocket_error_t send_frame(wibesocket_conn* c, ws_opcode_t opcode, const void* data, size_t len) {
+    if (!c || c->state != WIBESOCKET_STATE_OPEN) return WIBESOCKET_ERROR_NOT_READY;
+    /* Close and pong are protocol obligations and bypass the watermark */
+    if (opcode != WS_OPCODE_CLOSE && opcode != WS_OPCODE_PONG && !ws_send_admit(c, ws_frame_size(len))) {
+        return WIBESOCKET_ERROR_BUFFER_FULL;
+    }
+    wibesocket_error_t e = ws_queue_frame(c, opcode, data, len, NULL);
+    if (e != WIBESOCKET_OK) return e;
+    int urgent = opcode != WS_OPCODE_TEXT && opcode != WS_OPCODE_BINARY;
+    if (ws_send_kick(c, urgent) < 0) return WIBESOCKET_ERROR_NETWORK;
+    return WIBESOCKET_OK;
+}
+
+wibesocket_error_t wibesocket_send_begin(wibesocket_conn_t* conn) {
+    wibesocket_conn* c = (wibesocket_conn*)conn;
+    if (!c) return WIBESOCKET_ERROR_INVALID_ARGS;
+    if (c->state != WIBESOCKET_STATE_OPEN) return WIBESOCKET_ERROR_NOT_READY;
+    c->corked = 1;
+    return WIBESOCKET_OK;
+}
+
+wibesocket_error_t wibesocket_send_commit(wibesocket_conn_t* conn) {
+    wibesocket_conn* c = (wibesocket_conn*)conn;
+    if (!c) return WIBESOCKET_ERROR_INVALID_ARGS;
+    c->corked = 0;
+    if (c->fd >= 0 && ws_flush_send(c) < 0) return WIBESOCKET_ERROR_NETWORK;
+    return WIBESOCKET_OK;
+}
+
+wibesocket_error_t wibesocket_flush(wibesocket_conn_t* conn) {
+    wibesocket_conn* c = (wibesocket_conn*)conn;
+    if (!c) return WIBESOCKET_ERROR_INVALID_ARGS;
+    if (c->fd >= 0 && ws_flush_send(c) < 0) return WIBESOCKET_ERROR_NETWORK;
+    return WIBESOCKET_OK;
+}
+
+wibesocket_error_t wibesocket_send_batch(wibesocket_conn_t* conn, wibesocket_frame_type_t type,
+                                         const struct iovec* iov, size_t count) {
+    wibesocket_conn* c = (wibesocket_conn*)conn;
+    if (!c || (count && !iov)) return WIBESOCKET_ERROR_INVALID_ARGS;
+    if (type != WIBESOCKET_FRAME_TEXT && type != WIBESOCKET_FRAME_BINARY) return WIBESOCKET_ERROR_INVALID_ARGS;
+    if (c->state != WIBESOCKET_STATE_OPEN) return WIBESOCKET_ERROR_NOT_READY;
+    /* Reserve the whole batch up front so it is queued entirely or not at all: queue room for
+     * every frame, and a node for each payload written from its own buffer (one that gets no
+     * buffer falls back to the queue room) */
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) total += ws_frame_size(iov[i].iov_len);
+    if (!ws_send_admit(c, total)) return WIBESOCKET_ERROR_BUFFER_FULL;
+    if (!ws_queue_reserve(c, total + WS_DEFLATE_TAIL)) return WIBESOCKET_ERROR_MEMORY;
+    ws_zc_buf_t* spare = NULL;
+    wibesocket_error_t e = WIBESOCKET_OK;
+    for (size_t i = 0; i < count && e == WIBESOCKET_OK; i++) {
+        if (!ws_zc_wanted(c, (ws_opcode_t)type, iov[i].iov_len)) continue;
+        size_t node_cap = 0;
+        ws_zc_buf_t* z = (ws_zc_buf_t*)ws_mem_get(c, sizeof(*z), &node_cap);
+        if (!z) { e = WIBESOCKET_ERROR_MEMORY; break; }
+        z->node_cap = node_cap;
+        z->next = spare;
+        spare = z;
+    }
+    for (size_t i = 0; i < count && e == WIBESOCKET_OK; i++) {
+        e = ws_queue_frame(c, (ws_opcode_t)type, iov[i].iov_base, iov[i].iov_len, &spare);
+    }
+    while (spare) {
+        ws_zc_buf_t* z = spare;
+        spare = z->next;
+        ws_mem_put(c, z, z->node_cap);
+    }
+    if (e != WIBESOCKET_OK) return e;
+    if (ws_send_kick(c, 0) < 0) return WIBESOCKET_ERROR_NETWORK;
+    return WIBESOCKET_OK;
+}
+
+wibesocket_error_t wibesocket_send_text(wibesocket_conn_t* conn, const char* text, size_t len) {
+    return send_frame((wibesocket_conn*)conn, WS_OPCODE_TEXT, text, len);
+}
+
+wibesocket_error_t wibesocket_send_binary(wibesocket_conn_t* conn, const void* data, size_t len) {
+    return send_frame((wibesocket_conn*)conn, WS_OPCODE_BINARY, data, len);
+}
+
+/* A PING whose PONG times the round trip, unless an earlier one is still unanswered */
+static wibesocket_error_t ws_send_ping(wibesocket_conn* c, const void* data, size_t len) {
+    wibesocket_error_t e = send_frame(c, WS_OPCODE_PING, data, len);
+    if (e == WIBESOCKET_OK && !c->ping_out_us) c->ping_out_us = ws_now_us();
+    return e;
+}
+
+wibesocket_error_t wibesocket_send_ping(wibesocket_conn_t* conn, const void* data, size_t len) {
+    return ws_send_ping((wibesocket_conn*)conn, data, len);
+}
+
+wibesocket_error_t wibesocket_post_send(wibesocket_conn_t* conn, wibesocket_frame_type_t type,
+                                        const void* data, size_t len) {
+    wibesocket_conn* c = (wibesocket_conn*)conn;
+    if (!c || (len && !data) || c->post_fd < 0) return WIBESOCKET_ERROR_INVALID_ARGS;
+    if (type != WIBESOCKET_FRAME_TEXT && type != WIBESOCKET_FRAME_BINARY && type != WIBESOCKET_FRAME_PING) {
+        return WIBESOCKET_ERROR_INVALID_ARGS;
+    }
+    size_t need = ws_frame_size(len);
+    /* Producers only see the posted bytes (the queue belongs to the owner) */
+    size_t before = atomic_fetch_add_explicit(&c->post_bytes, need, memory_order_relaxed);
+    if (before != 0 && before + need > c->send_high) {
+        atomic_fetch_sub_explicit(&c->post_bytes, need, memory_order_relaxed);
+        return WIBESOCKET_ERROR_BUFFER_FULL;
+    }
+    size_t cap = 0;
+    ws_posted_frame_t* f = (ws_posted_frame_t*)ws_mem_get(c, sizeof(*f) + need, &cap);
+    if (!f) { atomic_fetch_sub_explicit(&c->post_bytes, need, memory_order_relaxed); return WIBESOCKET_ERROR_MEMORY; }
+    f->cap = cap;
+    uint8_t key[4];
+    const uint8_t* mask = ws_tx_mask(c, key);
+    f->len = ws_build_frame(f->bytes, need, 1, (ws_opcode_t)type, mask, (const uint8_t*)data, len);
+    if (f->len == 0) {
+        ws_mem_put(c, f, f->cap);
+        atomic_fetch_sub_explicit(&c->post_bytes, need, memory_order_relaxed);
+        return WIBESOCKET_ERROR_INVALID_ARGS;
+    }
+    if (f->len != need) atomic_fetch_sub_explicit(&c->post_bytes, need - f->len, memory_order_relaxed);
+    ws_mpsc_push(&c->posted, &f->node);
+    if (!atomic_exchange(&c->post_signalled, 1)) {
+        uint64_t one = 1;
+        ssize_t w = write(c->post_fd, &one, sizeof(one));
+        (void)w;
+    }
+    return WIBESOCKET_OK;
+}
+
+wibesocket_error_t wibesocket_send_donated(wibesocket_conn_t* conn, wibesocket_frame_type_t type,
+                                           void* buf, size_t len, wibesocket_release_fn release, void* ctx) {
+    wibesocket_conn* c = (wibesocket_conn*)conn;
+    if (!c || (len && !buf)) return WIBESOCKET_ERROR_INVALID_ARGS;
+    if (type != WIBESOCKET_FRAME_TEXT && type != WIBESOCKET_FRAME_BINARY) return WIBESOCKET_ERROR_INVALID_ARGS;
+    if (c->state != WIBESOCKET_STATE_OPEN) return WIBESOCKET_ERROR_NOT_READY;
+    if (!ws_send_admit(c, ws_frame_size(len))) return WIBESOCKET_ERROR_BUFFER_FULL;
+    uint8_t key[4];
+    const uint8_t* mask = ws_tx_mask(c, key);
+#if defined(WS_HAVE_IO_URING)
+    if (c->uring) {
+        /* The send chain reads only from the queue: copy, and the buffer is free at once */
+        int was_empty = !ws_send_pending(c);
+        uint8_t* out = ws_queue_reserve(c, ws_frame_size(len));
+        if (!out) return WIBESOCKET_ERROR_MEMORY;
+        size_t n = ws_build_frame(out, ws_frame_size(len), 1, (ws_opcode_t)type, mask, (const uint8_t*)buf, len);
+        c->send_size += n;
+        if (c->stats) ws_stat_frame_out(c, (unsigned)type, n, was_empty);
+        if (release) release(ctx, buf, len);
+    } else
+#endif
+    {
+        wibesocket_error_t e = ws_queue_zc(c, (ws_opcode_t)type, mask, (uint8_t*)buf, len, 0, release, ctx, NULL);
+        if (e != WIBESOCKET_OK) return e;
+        /* Nothing reads the payload before the next flush */
+        if (mask) ws_mask_copy((uint8_t*)buf, (const uint8_t*)buf, len, mask, 0);
+    }
+    if (ws_send_kick(c, 0) < 0) return WIBESOCKET_ERROR_NETWORK;
+    return WIBESOCKET_OK;
+}
+
+/* One encoding of a server message; released with the last reference */
+struct wibesocket_broadcast {
+    atomic_size_t refs;
+    size_t        len;
+    uint8_t       frame[]; /* complete unmasked frame */
+};
+
+wibesocket_broadcast_t* wibesocket_broadcast_create(wibesocket_frame_type_t type, const void* data, size_t len) {
+    if (len && !data) return NULL;
+    if (type != WIBESOCKET_FRAME_TEXT && type != WIBESOCKET_FRAME_BINARY) return NULL;
+    size_t cap = ws_frame_size(len);
+    wibesocket_broadcast_t* m = (wibesocket_broadcast_t*)malloc(sizeof(*m) + cap);
+    if (!m) return NULL;
+    atomic_init(&m->refs, 1);
+    m->len = ws_build_frame(m->frame, cap, 1, (ws_opcode_t)type, NULL, (const uint8_t*)data, len);
+    if (m->len == 0) { free(m); return NULL; }
+    return m;
+}
+
+void wibesocket_broadcast_release(wibesocket_broadcast_t* msg) {
+    if (msg && atomic_fetch_sub_explicit(&msg->refs, 1, memory_order_acq_rel) == 1) free(msg);
+}
+
+static void ws_broadcast_unref(void* ctx, void* buf, size_t len) {
+    (void)buf; (void)len;
+    wibesocket_broadcast_release((wibesocket_broadcast_t*)ctx);
+}
+
+wibesocket_error_t wibesocket_broadcast_send(wibesocket_conn_t* conn, wibesocket_broadcast_t* msg) {
+    wibesocket_conn* c = (wibesocket_conn*)conn;
+    if (!c || !msg || !c->server) return WIBESOCKET_ERROR_INVALID_ARGS;
+    if (c->state != WIBESOCKET_STATE_OPEN) return WIBESOCKET_ERROR_NOT_READY;
+    if (!ws_send_admit(c, msg->len)) return WIBESOCKET_ERROR_BUFFER_FULL;
+    int was_empty = !ws_send_pending(c);
+#if defined(WS_HAVE_IO_URING)
+    if (c->uring) {
+        /* The send chain reads only from the queue */
+        uint8_t* out = ws_queue_reserve(c, msg->len);
+        if (!out) return WIBESOCKET_ERROR_MEMORY;
+        memcpy(out, msg->frame, msg->len);
+        c->send_size += msg->len;
+    } else
+#endif
+    {
+        /* Header and payload are one block here: the whole frame goes out from msg */
+        size_t node_cap = 0;
+        ws_zc_buf_t* z = (ws_zc_buf_t*)ws_mem_get(c, sizeof(*z), &node_cap);
+        if (!z) return WIBESOCKET_ERROR_MEMORY;
+        atomic_fetch_add_explicit(&msg->refs, 1, memory_order_relaxed);
+        ws_zc_link(c, z, node_cap, msg->frame, msg->len, 0, ws_broadcast_unref, msg);
+    }
+    if (c->stats) ws_stat_frame_out(c, msg->frame[0] & 0x0FU, msg->len, was_empty);
+    if (ws_send_kick(c, 0) < 0) return WIBESOCKET_ERROR_NETWORK;
+    return WIBESOCKET_OK;
+}
+
+size_t wibesocket_broadcast(wibesocket_conn_t* const* conns, size_t count, wibesocket_broadcast_t* msg) {
+    size_t sent = 0;
+    for (size_t i = 0; conns && i < count; i++) {
+        if (wibesocket_broadcast_send(conns[i], msg) == WIBESOCKET_OK) sent++;
+    }
+    return sent;
+}
+
+wibesocket_error_t wibesocket_send_close(wibesocket_conn_t* conn, uint16_t code, const char* reason) {
+    uint8_t payload[2 + 125]; size_t n = 0;
+    payload[n++] = (uint8_t)((code >> 8) & 0xFF); payload[n++] = (uint8_t)(code & 0xFF);
+    if (reason) {
+        size_t rlen = strlen(reason); if (rlen > 125) rlen = 125;
+        memcpy(payload + n, reason, rlen); n += rlen;
+    }
+    wibesocket_conn* c = (wibesocket_conn*)conn;
+    /* The close frame goes out with anything still corked ahead of it */
+    if (c) c->corked = 0;
+    wibesocket_error_t e = send_frame(c, WS_OPCODE_CLOSE, payload, n);
+    if (e == WIBESOCKET_OK) {
+        c->state = WIBESOCKET_STATE_CLOSING; c->close_sent = 1; c->close_sent_ms = ws_now_ms();
+        if (c->loop_entry) ws_loop_entry_rearm(c->loop_entry); /* arm the close timeout */
+    }
+    return e;
+}
+
+/* Start of unreleased receive data; everything up to rx.count is contiguous from here. */
+static uint8_t* ws_rx_data(wibesocket_conn* c) {
+    return c->rx.buffer + c->rx.tail;
+}
+
+/* Oldest pin into the current ring; its bytes and everything after them stay put */
+static const ws_pin_t* ws_rx_oldest_pin(const wibesocket_conn* c) {
+    if (c->rx_pins == 0) return NULL;
+    for (size_t i = 0; i < c->npins; i++) {
+        if (c->pins[i].in_ring && !c->pins[i].seg) return &c->pins[i];
+    }
+    return NULL;
+}
+
+/* Drop fully handled frames from the front of the ring, up to the oldest pinned payload. */
+static void ws_recv_compact(wibesocket_conn* c) {
+    size_t done = c->pending_consume;
+    const ws_pin_t* oldest = ws_rx_oldest_pin(c);
+    if (oldest && oldest->start - c->rx_front < done) done = (size_t)(oldest->start - c->rx_front);
+    if (done > 0) {
+        ws_ringbuf_consume(&c->rx, done);
+        c->recv_parsed -= done;
+        c->pending_consume -= done;
+        c->rx_front += done;
+    }
+    /* Plain (non-mirrored) fallback: slide data back once it drifts past half the buffer */
+    if (c->rx_pins == 0 && !c->rx.mirrored && c->rx.tail > c->rx.capacity / 2) {
+        WS_STAT_ADD(c->stats, recv_bytes_moved, c->rx.count);
+        ws_ringbuf_linearize(&c->rx);
+    }
+}
+
+/* Parse the next frame from bytes already buffered, without touching the socket. */
+static ws_parser_status_t ws_parse_buffered(wibesocket_conn* c, ws_parsed_frame_t* fr) {
+    if (!c->rx.buffer) return WS_PARSER_NEED_MORE; /* lent back: nothing buffered */
+    size_t consumed = 0;
+    ws_parser_status_t st = ws_parser_feed(&c->parser, ws_rx_data(c) + c->recv_parsed,
+                                           c->rx.count - c->recv_parsed, &consumed, fr);
+    c->recv_parsed += consumed;
+    if (st == WS_PARSER_CHUNK || (st == WS_PARSER_FRAME && c->asm_buf)) {
+        if (!c->asm_buf) {
+            /* Will fit the ring once complete: stay zero-copy and wait for the rest */
+            if (fr->frame_len + WS_MAX_HEADER_SIZE <= c->rx_max) return WS_PARSER_NEED_MORE;
+            c->asm_buf = (uint8_t*)ws_mem_get(c, (size_t)fr->frame_len, &c->asm_cap);
+            if (!c->asm_buf) return WS_PARSER_ERROR_TOO_LARGE;
+        }
+        memcpy(c->asm_buf + fr->offset, fr->payload, fr->payload_len);
+        /* Copied out: the ring bytes can be reclaimed while the frame keeps streaming */
+        c->pending_consume = c->recv_parsed;
+        if (st == WS_PARSER_CHUNK) return WS_PARSER_NEED_MORE;
+        fr->payload = c->asm_buf;
+        fr->payload_len = (size_t)fr->frame_len;
+        c->asm_pinned = c->asm_buf; c->asm_pinned_cap = c->asm_cap;
+        c->asm_buf = NULL; c->asm_cap = 0;
+        return st;
+    }
+    if (st == WS_PARSER_FRAME) {
+        /* The parser reports only the chunk of the last feed; the whole frame is contiguous here */
+        fr->payload_len = (size_t)fr->frame_len;
+        fr->payload = ws_rx_data(c) + c->recv_parsed - fr->payload_len;
+        /* Defer consuming until payload released to keep zero-copy pointer valid */
+        c->pending_consume = c->recv_parsed;
+    }
+    return st;
+}
+
+/* Contiguous free space after the buffered bytes. A plain buffer must not wrap, so only the
+ * span up to the end is offered there. */
+static size_t ws_rx_write_window(wibesocket_conn* c, uint8_t** out) {
+    if (c->rx.mirrored) return ws_ringbuf_peek_write(&c->rx, out);
+    size_t end = c->rx.tail + c->rx.count;
+    if (end >= c->rx.capacity) { *out = NULL; return 0; }
+    *out = c->rx.buffer + end;
+    return c->rx.capacity - end;
+}
+
+/* Buffer lending: a ring is taken for the first read after the last one went back */
+static int ws_rx_borrow(wibesocket_conn* c) {
+    if (c->rx.buffer) return 0;
+    size_t first = c->rx_max < WS_RECV_INITIAL ? c->rx_max : WS_RECV_INITIAL;
+    if (ws_ringbuf_init_mirrored(&c->rx, first) != 0 && ws_ringbuf_init(&c->rx, first) != 0) return -1;
+    return 0;
+}
+
+/* ...and handed back once empty and unpinned. Parser state lives outside the ring, and a
+ * frame streaming into a reassembly buffer has no bytes left in it. */
+static void ws_rx_lend_back(wibesocket_conn* c) {
+    if (!c->cfg.recv_buffer_lending || c->state != WIBESOCKET_STATE_OPEN) return;
+    if (!c->rx.buffer || c->rx.count > 0 || c->rx_pins > 0) return;
+    ws_ringbuf_free(&c->rx);
+    c->recv_parsed = c->pending_consume = 0;
+    c->rx_grow = 0;
+}
+
+/* Double the ring, up to rx_max. Only while nothing is pinned: buffered bytes move, but
+ * recv_parsed and pending_consume count from the front and stay valid. */
+static int ws_rx_grow(wibesocket_conn* c) {
+    c->rx_grow = 0;
+    if (c->rx.capacity >= c->rx_max) return -1;
+    size_t want = c->rx.capacity * 2;
+    return ws_ringbuf_grow(&c->rx, want < c->rx_max ? want : c->rx_max);
+}
+
+/* The ring is full but pinned payloads point into it: set it aside with its pins and carry
+ * the bytes not yet handed out over to a fresh ring (twice as large if they fill half). */
+static int ws_rx_retire(wibesocket_conn* c) {
+    size_t keep = c->rx.count - c->pending_consume;
+    size_t cap = c->rx.capacity;
+    if ((keep * 2 > cap || c->rx_grow) && cap < c->rx_max) cap = cap * 2 < c->rx_max ? cap * 2 : c->rx_max;
+    size_t seg_cap = 0;
+    ws_rx_seg_t* seg = (ws_rx_seg_t*)ws_mem_get(c, sizeof(*seg), &seg_cap);
+    if (!seg) return -1;
+    ws_ringbuf_t fresh;
+    if (ws_ringbuf_init_mirrored(&fresh, cap) != 0 && ws_ringbuf_init(&fresh, cap) != 0) {
+        ws_mem_put(c, seg, seg_cap);
+        return -1;
+    }
+    (void)ws_ringbuf_write_copy(&fresh, ws_rx_data(c) + c->pending_consume, keep);
+    WS_STAT_ADD(c->stats, recv_bytes_moved, keep);
+    seg->rb = c->rx;
+    seg->pins = c->rx_pins;
+    for (size_t i = 0; i < c->npins; i++) {
+        if (c->pins[i].in_ring && !c->pins[i].seg) c->pins[i].seg = seg;
+    }
+    c->rx = fresh;
+    c->rx_pins = 0;
+    c->rx_front += c->pending_consume;
+    c->recv_parsed -= c->pending_consume;
+    c->pending_consume = 0;
+    c->rx_grow = 0;
+    return 0;
+}
+
+/* One non-blocking recv() into the free space of the ring. TIMEOUT means EAGAIN. */
+static wibesocket_error_t ws_read_socket(wibesocket_conn* c) {
+#if defined(WS_HAVE_IO_URING)
+    if (c->uring) {
+        /* Completions of the send chain arrive on the same ring: keep the queue moving */
+        if (ws_flush_send(c) < 0) return WIBESOCKET_ERROR_NETWORK;
+        if (ws_rx_borrow(c) != 0) return WIBESOCKET_ERROR_MEMORY;
+        uint8_t* wptr;
+        size_t space = ws_rx_write_window(c, &wptr);
+        if (space == 0) return WIBESOCKET_ERROR_BUFFER_FULL;
+        ssize_t rd = ws_uring_recv(c->uring, wptr, space);
+        if (rd > 0) {
+            ws_ringbuf_commit(&c->rx, (size_t)rd);
+            if (c->track_rx) c->last_rx_ms = ws_now_ms();
+            c->rx_drained = 0;
+            if ((size_t)rd == space && c->rx.capacity < c->rx_max) c->rx_grow = 1;
+            return WIBESOCKET_OK;
+        }
+        if (rd == WS_URING_EOF) { c->state = WIBESOCKET_STATE_CLOSED; return WIBESOCKET_ERROR_CLOSED; }
+        if (rd < 0) return WIBESOCKET_ERROR_NETWORK;
+        c->rx_drained = 1;
+        return WIBESOCKET_ERROR_TIMEOUT;
+    }
+#endif
+    if (ws_rx_borrow(c) != 0) return WIBESOCKET_ERROR_MEMORY;
+    for (;;) {
+        uint8_t* wptr;
+        size_t space = ws_rx_write_window(c, &wptr);
+        if (space == 0) return WIBESOCKET_ERROR_BUFFER_FULL;
+        ssize_t rd = recv(c->fd, wptr, space, 0);
+        WS_STAT_ADD(c->stats, syscalls, 1);
+        if (rd > 0) {
+            ws_ringbuf_commit(&c->rx, (size_t)rd);
+            if (c->track_rx) c->last_rx_ms = ws_now_ms();
+            c->rx_drained = (size_t)rd < space;
+            if (!c->rx_drained && c->rx.capacity < c->rx_max) c->rx_grow = 1;
+            return WIBESOCKET_OK;
+        }
+        if (rd == 0) { c->state = WIBESOCKET_STATE_CLOSED; return WIBESOCKET_ERROR_CLOSED; }
+        if (errno == EINTR) continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK) return WIBESOCKET_ERROR_NETWORK;
+        WS_STAT_ADD(c->stats, eagain, 1);
+        c->rx_drained = 1;
+        return WIBESOCKET_ERROR_TIMEOUT;
+    }
+}
+
+/* Spinning is for an owner blocked in recv on the epoll engine; a loop does its own waiting */
+static int ws_busy_poll_on(const wibesocket_conn* c) {
+#if defined(WS_HAVE_IO_URING)
+    if (c->uring) return 0;
+#endif
+    return c->cfg.busy_poll_us && !c->loop_entry;
+}
+
+/* busy_poll_us: keep reading without sleeping until bytes come or the budget, capped by the
+ * caller's wait, runs out. TIMEOUT when the spin found nothing. */
+static wibesocket_error_t ws_busy_poll(wibesocket_conn* c, int wait_ms) {
+    uint64_t budget = c->cfg.busy_poll_us;
+    if (wait_ms >= 0 && (uint64_t)wait_ms * 1000ULL < budget) budget = (uint64_t)wait_ms * 1000ULL;
+    uint64_t end = ws_now_us() + budget;
+    do {
+        wibesocket_error_t e = ws_read_socket(c);
+        if (e != WIBESOCKET_ERROR_TIMEOUT) return e;
+    } while (ws_now_us() < end);
+    return WIBESOCKET_ERROR_TIMEOUT;
+}
+
+/* Pull more bytes from the socket. Edge-triggered: only wait in epoll once the kernel queue
+ * is known to be drained, otherwise go straight to recv(). */
+static wibesocket_error_t ws_fill_recv(wibesocket_conn* c, uint64_t deadline_ms, int infinite) {
+    for (;;) {
+        /* Posted frames wake the same wait; send them before sleeping again */
+        if (atomic_load_explicit(&c->post_signalled, memory_order_relaxed) && !c->corked &&
+            ws_flush_send(c) < 0) return WIBESOCKET_ERROR_NETWORK;
+        if (c->rx_drained) {
+            int wait = -1;
+            uint64_t now = ws_now_ms();
+            if (!infinite) wait = (now < deadline_ms) ? (int)(deadline_ms - now) : 0;
+            /* Outside a loop, the connection's own timers run while it waits here */
+            uint64_t due = c->loop_entry ? 0 : ws_conn_timer_deadline((wibesocket_conn_t*)c, now);
+            if (due) {
+                uint64_t left = due > now ? due - now : 0;
+                if (wait < 0 || left < (uint64_t)wait) wait = left > INT32_MAX ? INT32_MAX : (int)left;
+            }
+            if (wait != 0 && ws_busy_poll_on(c)) {
+                wibesocket_error_t e = ws_busy_poll(c, wait);
+                if (e != WIBESOCKET_ERROR_TIMEOUT) return e;
+            }
+            int w = wait_readable(c, wait);
+            if (w < 0 && errno == EINTR) continue;
+            if (w == 0 && due && (now = ws_now_ms()) >= due) {
+                (void)ws_conn_on_timer((wibesocket_conn_t*)c, now);
+                if (c->state != WIBESOCKET_STATE_OPEN && c->state != WIBESOCKET_STATE_CLOSING) {
+                    return c->last_error;
+                }
+                continue;
+            }
+            if (w <= 0) return WIBESOCKET_ERROR_TIMEOUT;
+            /* The wakeup may be zerocopy completions on the error queue */
+            if (c->zc_head) ws_zc_reap(c);
+        }
+        wibesocket_error_t e = ws_read_socket(c);
+        if (e != WIBESOCKET_ERROR_TIMEOUT) return e;
+    }
+}
+
+#if defined(WS_HAVE_ZLIB)
+/* Room for more inflated output. Payloads already handed out in this batch must not move, so
+ * a full buffer is set aside until release and only the current frame's bytes (from start)
+ * are carried over. */
+static int ws_zout_grow(wibesocket_conn* c, size_t start) {
+    if (start > 0 && c->zspent_n == WS_ZOUT_SPENT) return -1;
+    if (start > 0 && !c->zspent) {
+        size_t zcap = 0;
+        c->zspent = (struct ws_zbuf*)ws_mem_get(c, WS_ZOUT_SPENT * sizeof(*c->zspent), &zcap);
+        if (!c->zspent) return -1;
+    }
+    size_t keep = c->zout_len - start;
+    size_t cap = 0;
+    uint8_t* nb = (uint8_t*)ws_mem_get(c, c->zout_cap ? c->zout_cap * 2 : WS_ZOUT_MIN, &cap);
+    if (!nb) return -1;
+    if (keep) memcpy(nb, c->zout + start, keep);
+    if (start > 0) {
+        c->zspent[c->zspent_n].buf = c->zout;
+        c->zspent[c->zspent_n++].cap = c->zout_cap;
+    } else {
+        ws_mem_put(c, c->zout, c->zout_cap);
+    }
+    c->zout = nb; c->zout_cap = cap; c->zout_len = keep;
+    return 0;
+}
+
+static void ws_zbufs_put(const wibesocket_conn* c, uint8_t* zout, size_t zout_cap,
+                         struct ws_zbuf* spent, size_t spent_n) {
+    for (size_t i = 0; i < spent_n; i++) ws_mem_put(c, spent[i].buf, spent[i].cap);
+    ws_mem_put(c, spent, WS_ZOUT_SPENT * sizeof(*spent));
+    ws_mem_put(c, zout, zout_cap);
+}
+
+static void ws_zout_release(wibesocket_conn* c) {
+    ws_zbufs_put(c, c->zout, c->zout_cap, c->zspent, c->zspent_n);
+    c->zspent = NULL; c->zspent_n = 0;
+    c->zout = NULL; c->zout_cap = c->zout_len = 0;
+}
+
+/* Replace a compressed frame's payload by its inflated bytes. */
+static wibesocket_error_t ws_inflate_frame(wibesocket_conn* c, ws_parsed_frame_t* fr) {
+    if (ws_inflate_begin(c->deflate, (const uint8_t*)fr->payload, fr->payload_len, fr->is_final) != 0) {
+        return WIBESOCKET_ERROR_MEMORY;
+    }
+    size_t start = c->zout_len;
+    for (;;) {
+        if (c->zout_cap - c->zout_len < WS_ZOUT_ROOM) {
+            if (ws_zout_grow(c, start) != 0) return WIBESOCKET_ERROR_MEMORY;
+            start = 0;
+        }
+        size_t got = 0;
+        int r = ws_inflate_more(c->deflate, c->zout + c->zout_len, c->zout_cap - c->zout_len, &got);
+        c->zout_len += got;
+        if (r < 0) return WIBESOCKET_ERROR_PROTOCOL;
+        /* Inflated frames obey max_frame_size too, so a small bomb cannot balloon */
+        if (c->zout_len - start > c->parser.max_frame_size) return WIBESOCKET_ERROR_PROTOCOL;
+        if (r > 0) break;
+    }
+    size_t len = c->zout_len - start;
+    if (fr->type != WS_OPCODE_CONTINUATION) {
+        c->ztext = fr->type == WS_OPCODE_TEXT;
+        if (c->ztext) ws_utf8_init(&c->zutf8);
+    }
+    if (c->ztext && (!ws_utf8_feed(&c->zutf8, c->zout + start, len) ||
+                     (fr->is_final && !ws_utf8_complete(&c->zutf8)))) {
+        return WIBESOCKET_ERROR_PROTOCOL;
+    }
+    fr->payload = c->zout + start;
+    fr->payload_len = len;
+    return WIBESOCKET_OK;
+}
+#endif
+
+/* Room for one more pin; NOT_READY once WS_PIN_MAX recv calls are outstanding */
+static wibesocket_error_t ws_pin_reserve(wibesocket_conn* c) {
+    if (c->npins < c->pins_cap) return WIBESOCKET_OK;
+    if (c->npins >= WS_PIN_MAX) return WIBESOCKET_ERROR_NOT_READY;
+    size_t want = c->pins_cap ? c->pins_cap * 2 : 4;
+    size_t cap = 0;
+    ws_pin_t* np = (ws_pin_t*)ws_mem_get(c, want * sizeof(*np), &cap);
+    if (!np) return WIBESOCKET_ERROR_MEMORY;
+    if (c->npins) memcpy(np, c->pins, c->npins * sizeof(*np));
+    ws_mem_put(c, c->pins, c->pins_cap * sizeof(*np));
+    c->pins = np;
+    c->pins_cap = want;
+    return WIBESOCKET_OK;
+}
+
+/* Pin what the messages of this recv call point into: the ring from start onwards, and the
+ * reassembly and inflate buffers they were built in. Returns the pin's id (never 0). */
+static uint32_t ws_pin_new(wibesocket_conn* c, uint64_t start, const wibesocket_message_t* msgs, size_t n) {
+    ws_pin_t* p = &c->pins[c->npins++];
+    memset(p, 0, sizeof(*p));
+    if (++c->pin_seq == 0) c->pin_seq = 1;
+    p->id = c->pin_seq;
+    p->refcnt = 1;
+    p->start = start;
+    uintptr_t lo = (uintptr_t)c->rx.buffer;
+    uintptr_t hi = lo + c->rx.capacity * (c->rx.mirrored ? 2 : 1);
+    for (size_t i = 0; i < n && !p->in_ring; i++) {
+        uintptr_t at = (uintptr_t)msgs[i].payload;
+        p->in_ring = lo && at >= lo && at < hi;
+    }
+    if (p->in_ring) c->rx_pins++;
+    p->asm_buf = c->asm_pinned; p->asm_cap = c->asm_pinned_cap;
+    c->asm_pinned = NULL; c->asm_pinned_cap = 0;
+#if defined(WS_HAVE_ZLIB)
+    if (c->zout_len > 0) {
+        p->zout = c->zout; p->zout_cap = c->zout_cap;
+        p->zspent = c->zspent; p->zspent_n = c->zspent_n;
+        c->zout = NULL; c->zout_cap = c->zout_len = 0;
+        c->zspent = NULL; c->zspent_n = 0;
+    }
+#endif
+    return p->id;
+}
+
+static ws_pin_t* ws_pin_find(wibesocket_conn* c, uint32_t id) {
+    for (size_t i = c->npins; i-- > 0; ) {
+        if (c->pins[i].id == id) return &c->pins[i];
+    }
+    return NULL;
+}
+
+/* Last reference gone: give back its buffers, and its ring once that was retired */
+static void ws_pin_drop(wibesocket_conn* c, ws_pin_t* p) {
+    if (p->in_ring && !p->seg) {
+        c->rx_pins--;
+    } else if (p->seg && --p->seg->pins == 0) {
+        ws_ringbuf_free(&p->seg->rb);
+        ws_mem_put(c, p->seg, sizeof(*p->seg));
+    }
+    ws_mem_put(c, p->asm_buf, p->asm_cap);
+#if defined(WS_HAVE_ZLIB)
+    ws_zbufs_put(c, p->zout, p->zout_cap, p->zspent, p->zspent_n);
+#endif
+    size_t i = (size_t)(p - c->pins);
+    memmove(p, p + 1, (c->npins - i - 1) * sizeof(*p));
+    c->npins--;
+}
+
+static wibesocket_frame_type_t ws_msg_type(ws_opcode_t op) {
+    return (op == WS_OPCODE_TEXT) ? WIBESOCKET_FRAME_TEXT :
+           (op == WS_OPCODE_BINARY) ? WIBESOCKET_FRAME_BINARY : WIBESOCKET_FRAME_CONTINUATION;
+}
+
+/* Shared engine for recv/recv_batch: collects up to max complete data frames. Control frames
+ * never reach the caller: PINGs are answered through the send queue, flushed once per pass,
+ * and PONGs time the round trip. All collected payloads share one pin; pins of earlier calls
+ * may still be held, their bytes stay where they are and reading continues behind them. */
+static wibesocket_error_t ws_recv_collect(wibesocket_conn* c, wibesocket_message_t* msgs, size_t max,
+                                         size_t* out_n, int timeout_ms) {
+    *out_n = 0;
+    /* Data may still arrive after our CLOSE, up to the server's reply */
+    if (c->state != WIBESOCKET_STATE_OPEN && c->state != WIBESOCKET_STATE_CLOSING) return WIBESOCKET_ERROR_NOT_READY;
+    wibesocket_error_t pe = ws_pin_reserve(c);
+    if (pe != WIBESOCKET_OK) return pe;
+    if (c->asm_pinned) {
+        /* Reassembled by a call that failed before handing it out */
+        ws_mem_put(c, c->asm_pinned, c->asm_pinned_cap);
+        c->asm_pinned = NULL; c->asm_pinned_cap = 0;
+    }
+    /* Flush any pending sends, short of frames coalescing still holds back */
+    if (!c->corked && !ws_send_held(c)) (void)ws_flush_send(c);
+    ws_recv_compact(c);
+    /* Reads have been filling the ring: a larger one means fewer, larger recv() calls */
+    if (c->rx_grow && c->rx_pins == 0) (void)ws_rx_grow(c);
+
+    uint64_t deadline = (timeout_ms > 0) ? ws_now_ms() + (uint64_t)timeout_ms : 0;
+    size_t n = 0;
+    int pong_queued = 0;
+    uint64_t start = c->rx_front + c->pending_consume; /* first byte this call can hand out */
+    for (;;) {
+        /* Buffered-first: frames left over from an earlier read are served without a syscall.
+         * A reassembled frame ends the batch, its pin owns the buffer. */
+        while (n < max && !c->asm_pinned) {
+            size_t frame_start = c->pending_consume;
+            ws_parsed_frame_t fr;
+            ws_parser_status_t st = ws_parse_buffered(c, &fr);
+            if (st == WS_PARSER_NEED_MORE) break;
+            if (st < 0) {
+                c->last_error = WIBESOCKET_ERROR_PROTOCOL;
+                if (n > 0) break; /* hand out what we have; the error resurfaces on the next call */
+                return c->last_error;
+            }
+            if (fr.type == WS_OPCODE_CLOSE && n > 0) {
+                /* Deliver the batch first; re-parse the CLOSE (and count it) on the next call.
+                 * A server unmasked its payload in the ring, so mask it again for that. */
+                if (c->parser.masking == WS_MASK_REQUIRED) {
+                    uint8_t* pl = ws_rx_data(c) + c->recv_parsed - fr.frame_len;
+                    ws_mask_copy(pl, pl, (size_t)fr.frame_len, c->parser.cur.mask_key, 0);
+                }
+                c->recv_parsed = c->pending_consume = frame_start;
+                break;
+            }
+            if (c->stats) {
+                size_t hl = fr.payload_len > 65535 ? 10 : fr.payload_len > 125 ? 4 : 2;
+                if (c->parser.masking == WS_MASK_REQUIRED) hl += 4;
+                ws_stat_add(c->stats, WS_STAT_SLOT(frames_in) + ((unsigned)fr.type & 0xF), 1);
+                ws_stat_add(c->stats, WS_STAT_SLOT(bytes_in) + ((unsigned)fr.type & 0xF), hl + fr.payload_len);
+            }
+
+            /* Handle control frames */
+            if (fr.type == WS_OPCODE_PING) {
+                /* PONG with the same payload; none once our CLOSE is out */
+                if (c->state == WIBESOCKET_STATE_OPEN &&
+                    ws_queue_frame(c, WS_OPCODE_PONG, fr.payload, fr.payload_len, NULL) == WIBESOCKET_OK) {
+                    pong_queued = 1;
+                }
+                continue;
+            }
+            if (fr.type == WS_OPCODE_PONG) {
+                if (c->ping_out_us) {
+                    c->rtt_us = ws_now_us() - c->ping_out_us;
+                    c->ping_out_us = 0;
+                }
+                continue;
+            }
+            if (fr.type == WS_OPCODE_CLOSE) {
+                /* Parse close code if present */
+                uint16_t code = WIBESOCKET_CLOSE_NORMAL;
+                if (fr.payload_len >= 2) {
+                    const uint8_t* b = (const uint8_t*)fr.payload;
+                    code = (uint16_t)((b[0] << 8) | b[1]);
+                }
+                if (c->state != WIBESOCKET_STATE_CLOSING) {
+                    (void)wibesocket_send_close((wibesocket_conn_t*)c, code, NULL);
+                }
+                c->state = WIBESOCKET_STATE_CLOSED;
+                if (c->loop_entry) ws_loop_entry_set_fd(c->loop_entry, -1);
+                if (c->fd >= 0) { close(c->fd); c->fd = -1; }
+                return WIBESOCKET_ERROR_CLOSED;
+            }
+
+#if defined(WS_HAVE_ZLIB)
+            if (fr.compressed) {
+                wibesocket_error_t ze = ws_inflate_frame(c, &fr);
+                if (ze != WIBESOCKET_OK) {
+                    /* The inflater already consumed the frame: the stream cannot resume */
+                    c->state = WIBESOCKET_STATE_ERROR;
+                    c->last_error = ze;
+                    if (n > 0) break;
+                    return ze;
+                }
+            }
+#endif
+
+            /* Fill out message; zero-copy view into recv buffer (or the inflated copy) */
+            wibesocket_message_t* m = &msgs[n++];
+            m->type = ws_msg_type(fr.type);
+            m->payload = fr.payload;
+            m->payload_len = fr.payload_len;
+            m->is_final = fr.is_final;
+        }
+        if (pong_queued) {
+            pong_queued = 0;
+            if (!c->corked && ws_flush_send(c) < 0) {
+                c->last_error = WIBESOCKET_ERROR_NETWORK;
+                if (n == 0) return c->last_error;
+            }
+        }
+        if (n > 0) {
+            /* The kernel may still hold bytes from the same burst: one more read, no waiting */
+            if (n < max && !c->asm_pinned && !c->rx_drained && c->last_error != WIBESOCKET_ERROR_PROTOCOL &&
+                c->state == WIBESOCKET_STATE_OPEN &&
+                ws_read_socket(c) == WIBESOCKET_OK) continue;
+            break;
+        }
+        wibesocket_error_t e = ws_fill_recv(c, deadline, timeout_ms < 0);
+        if (e == WIBESOCKET_ERROR_BUFFER_FULL && c->rx_pins > 0) {
+            /* Payloads of earlier calls still point into the ring: carry on in a fresh one */
+            if (ws_rx_retire(c) != 0) return WIBESOCKET_ERROR_MEMORY;
+            continue;
+        }
+        if (e == WIBESOCKET_ERROR_BUFFER_FULL &&
+            (c->pending_consume > 0 || (!c->rx.mirrored && c->rx.tail > 0))) {
+            /* Nothing pinned in this ring: reclaim handled bytes and retry */
+            ws_recv_compact(c);
+            if (!c->rx.mirrored && c->rx.tail > 0) WS_STAT_ADD(c->stats, recv_bytes_moved, c->rx.count);
+            ws_ringbuf_linearize(&c->rx);
+            continue;
+        }
+        if (e == WIBESOCKET_ERROR_BUFFER_FULL && c->rx.capacity < c->rx_max) {
+            /* A frame that fits the largest ring but not this one */
+            if (ws_rx_grow(c) != 0) return WIBESOCKET_ERROR_MEMORY;
+            continue;
+        }
+        if (e != WIBESOCKET_OK) return e;
+    }
+
+    /* Keep the payloads in place until their pin is released */
+    uint32_t pin = ws_pin_new(c, start, msgs, n);
+    for (size_t i = 0; i < n; i++) msgs[i].pin = pin;
+    *out_n = n;
+    return WIBESOCKET_OK;
+}
+
+static wibesocket_error_t ws_recv_frames(wibesocket_conn* c, wibesocket_message_t* msgs, size_t max,
+                                         size_t* out_n, int timeout_ms) {
+    wibesocket_error_t e = ws_recv_collect(c, msgs, max, out_n, timeout_ms);
+    /* Nothing handed out: a lending connection gives its empty ring back right away */
+    if (e != WIBESOCKET_OK) ws_rx_lend_back(c);
+    return e;
+}
+
+wibesocket_error_t wibesocket_recv(wibesocket_conn_t* conn, wibesocket_message_t* msg, int timeout_ms) {
+    wibesocket_conn* c = (wibesocket_conn*)conn;
+    if (!c) return WIBESOCKET_ERROR_NOT_READY;
+    size_t n = 0;
+    return ws_recv_frames(c, msg, 1, &n, timeout_ms);
+}
+
+wibesocket_error_t wibesocket_recv_batch(wibesocket_conn_t* conn, wibesocket_message_t* msgs, size_t max_msgs,
+                                         size_t* out_count, int timeout_ms) {
+    wibesocket_conn* c = (wibesocket_conn*)conn;
+    if (out_count) *out_count = 0;
+    if (!c || !msgs || !max_msgs || !out_count) return WIBESOCKET_ERROR_INVALID_ARGS;
+    return ws_recv_frames(c, msgs, max_msgs, out_count, timeout_ms);
+}
+
+wibesocket_state_t wibesocket_get_state(const wibesocket_conn_t* conn) {
+    const wibesocket_conn* c = (const wibesocket_conn*)conn;
+    return c ? c->state : WIBESOCKET_STATE_ERROR;
+}
+
+wibesocket_error_t wibesocket_get_error(const wibesocket_conn_t* conn) {
+    const wibesocket_conn* c = (const wibesocket_conn*)conn;
+    return c ? c->last_error : WIBESOCKET_ERROR_INVALID_ARGS;
+}
+
+const char* wibesocket_get_protocol(const wibesocket_conn_t* conn) {
+    const wibesocket_conn* c = (const wibesocket_conn*)conn;
+    return c ? c->protocol : NULL;
+}
+
+static void safe_close(int* fd) { if (*fd >= 0) { close(*fd); *fd = -1; } }
+
+static uint64_t ws_close_deadline(const wibesocket_conn* c) {
+    return c->close_sent_ms + (c->cfg.close_timeout_ms ? c->cfg.close_timeout_ms : WS_DEFAULT_CLOSE_TIMEOUT_MS);
+}
+
+/* Read towards the server's CLOSE without waiting, dropping whatever data still arrives.
+ * 1 once the handshake is over (or the connection failed), 0 while the socket has nothing. */
+static int ws_close_drain(wibesocket_conn* c) {
+    for (;;) {
+        if (c->state != WIBESOCKET_STATE_CLOSING) return 1;
+        wibesocket_message_t m;
+        size_t n = 0;
+        wibesocket_error_t e = ws_recv_frames(c, &m, 1, &n, 0);
+        if (e == WIBESOCKET_OK) wibesocket_release_message((wibesocket_conn_t*)c, &m);
+        if (e == WIBESOCKET_ERROR_TIMEOUT) return 0;
+        if (e == WIBESOCKET_ERROR_NOT_READY) {
+            /* Every pin slot is held by messages the user never released: drop them */
+            if (c->npins < WS_PIN_MAX) return 1;
+            while (c->npins > 0) ws_pin_drop(c, &c->pins[0]);
+            continue;
+        }
+        if (e != WIBESOCKET_OK) return 1;
+    }
+}
+
+static void ws_conn_destroy(wibesocket_conn* c) {
+    if (c->loop_entry) ws_loop_entry_remove(c->loop_entry);
+    ws_connect_cleanup(c);
+#if defined(WS_HAVE_IO_URING)
+    ws_uring_destroy(c->uring); c->uring = NULL;
+    ws_mem_put(c, c->send_retired, c->send_retired_cap); c->send_retired = NULL;
+#endif
+#if defined(WS_HAVE_ZLIB)
+    ws_deflate_destroy(c->deflate); c->deflate = NULL;
+    ws_zout_release(c);
+#endif
+    /* Completions can only be read while the socket is open */
+    ws_zc_drop_all(c);
+    ws_zc_reap(c);
+    safe_close(&c->fd);
+    ws_zc_abandon(c);
+    safe_close(&c->epfd);
+    safe_close(&c->post_fd);
+    if (c->post_held) ws_mem_put(c, c->post_held, ((ws_posted_frame_t*)c->post_held)->cap);
+    for (ws_mpsc_node_t* n; (n = ws_mpsc_pop(&c->posted)) != NULL; ) {
+        ws_mem_put(c, n, ((ws_posted_frame_t*)n)->cap);
+    }
+    while (c->npins > 0) ws_pin_drop(c, &c->pins[c->npins - 1]);
+    ws_mem_put(c, c->pins, c->pins_cap * sizeof(*c->pins));
+    ws_ringbuf_free(&c->rx);
+    ws_mem_put(c, c->asm_buf, c->asm_cap);
+    ws_mem_put(c, c->protocol, c->protocol_cap); c->protocol = NULL;
+    ws_mem_put(c, c->asm_pinned, c->asm_pinned_cap);
+    ws_queue_free(c);
+    ws_conn_free(c);
+}
+
+wibesocket_error_t wibesocket_close(wibesocket_conn_t* conn) {
+    wibesocket_conn* c = (wibesocket_conn*)conn;
+    if (!c) return WIBESOCKET_ERROR_INVALID_ARGS;
+    if (c->state == WIBESOCKET_STATE_OPEN) {
+        (void)wibesocket_send_close(conn, WIBESOCKET_CLOSE_NORMAL, NULL);
+    }
+    if (c->state == WIBESOCKET_STATE_CLOSING && !ws_close_drain(c)) {
+        if (c->loop_entry) {
+            /* Don't block the loop: it finishes the handshake and frees the connection */
+            c->lingering = 1;
+            ws_loop_entry_rearm(c->loop_entry);
+            return WIBESOCKET_OK;
+        }
+        uint64_t deadline = ws_close_deadline(c);
+        for (;;) {
+            uint64_t now = ws_now_ms();
+            if (now >= deadline) break;
+            int w = wait_readable(c, (int)(deadline - now));
+            if (w < 0 && errno == EINTR) continue;
+            if (w <= 0) break;
+            c->rx_drained = 0; /* the wait took the edge: read before waiting again */
+            if (ws_close_drain(c)) break;
+        }
+    }
+    ws_conn_destroy(c);
+    return WIBESOCKET_OK;
+}
+
+static const char* k_error_strings[] = {
+    "ok",
+    "invalid args",
+    "memory",
+    "network",
+    "handshake",
+    "protocol",
+    "timeout",
+    "closed",
+    "buffer full",
+    "not ready",
+    "system",
+};
+
+const char* wibesocket_error_string(wibesocket_error_t error) {
+    size_t n = sizeof(k_error_strings)/sizeof(k_error_strings[0]);
+    return ((unsigned)error < n) ? k_error_strings[error] : "unknown";
+}
+
+static void ws_pin_release(wibesocket_conn* c, ws_pin_t* p) {
+    if (!p || --p->refcnt > 0) return;
+    int was_full = c->npins >= WS_PIN_MAX;
+    ws_pin_drop(c, p);
+    /* Reclaim the frames in front of the oldest remaining pin (no copying) */
+    ws_recv_compact(c);
+    ws_rx_lend_back(c);
+    /* recv refused while every pin was taken; frames left behind will not raise a new edge */
+    if (was_full && c->loop_entry && ws_conn_has_pending((wibesocket_conn_t*)c)) {
+        ws_loop_entry_mark_pending(c->loop_entry);
+    }
+}
+
+/* The most recent recv call's pin, for callers that hold one at a time */
+static ws_pin_t* ws_pin_newest(wibesocket_conn* c) {
+    return c->npins ? &c->pins[c->npins - 1] : NULL;
+}
+
+void wibesocket_retain_payload(wibesocket_conn_t* conn) {
+    wibesocket_conn* c = (wibesocket_conn*)conn;
+    if (!c) return;
+    ws_pin_t* p = ws_pin_newest(c);
+    if (p) p->refcnt++;
+}
+
+void wibesocket_release_payload(wibesocket_conn_t* conn) {
+    wibesocket_conn* c = (wibesocket_conn*)conn;
+    if (!c) return;
+    ws_pin_release(c, ws_pin_newest(c));
+}
+
+void wibesocket_retain_message(wibesocket_conn_t* conn, const wibesocket_message_t* msg) {
+    wibesocket_conn* c = (wibesocket_conn*)conn;
+    if (!c || !msg) return;
+    ws_pin_t* p = ws_pin_find(c, msg->pin);
+    if (p) p->refcnt++;
+}
+
+void wibesocket_release_message(wibesocket_conn_t* conn, const wibesocket_message_t* msg) {
+    wibesocket_conn* c = (wibesocket_conn*)conn;
+    if (!c || !msg) return;
+    ws_pin_release(c, ws_pin_find(c, msg->pin));
+}
+
+size_t wibesocket_get_buffered_amount(const wibesocket_conn_t* conn) {
+    const wibesocket_conn* c = (const wibesocket_conn*)conn;
+    return c ? ws_send_backlog(c) : 0;
+}
+
+wibesocket_error_t wibesocket_wait_writable(wibesocket_conn_t* conn, int timeout_ms) {
+    wibesocket_conn* c = (wibesocket_conn*)conn;
+    if (!c || c->fd < 0) return WIBESOCKET_ERROR_INVALID_ARGS;
+    uint64_t deadline = ws_now_ms() + (uint64_t)(timeout_ms > 0 ? timeout_ms : 0);
+    for (;;) {
+        if (c->state != WIBESOCKET_STATE_OPEN && c->state != WIBESOCKET_STATE_CLOSING) {
+            return c->last_error != WIBESOCKET_OK ? c->last_error : WIBESOCKET_ERROR_CLOSED;
+        }
+        if (ws_flush_send(c) < 0) return WIBESOCKET_ERROR_NETWORK;
+        if (ws_send_backlog(c) <= c->send_low) {
+            c->send_blocked = 0;
+            c->drained_pending = 0; /* the caller is being told right now */
+            return WIBESOCKET_OK;
+        }
+        int wait = -1;
+        if (timeout_ms >= 0) {
+            uint64_t now = ws_now_ms();
+            if (now >= deadline) return WIBESOCKET_ERROR_TIMEOUT;
+            wait = (int)(deadline - now);
+        }
+        int w;
+#if defined(WS_HAVE_IO_URING)
+        /* Completions of the send chain are what move things along here */
+        if (c->uring) w = ws_uring_wait(c->uring, wait);
+        else
+#endif
+        {
+            struct pollfd pfd = { c->fd, POLLOUT, 0 };
+            w = poll(&pfd, 1, wait);
+        }
+        if (w < 0 && errno != EINTR) return WIBESOCKET_ERROR_NETWORK;
+    }
+}
+
+wibesocket_error_t wibesocket_get_stats(const wibesocket_conn_t* conn, wibesocket_stats_t* out) {
+    const wibesocket_conn* c = (const wibesocket_conn*)conn;
+    if (!c || !out) return WIBESOCKET_ERROR_INVALID_ARGS;
+    if (!c->stats) return WIBESOCKET_ERROR_NOT_READY;
+    ws_stats_read(c->stats, out);
+    return WIBESOCKET_OK;
+}
+
+uint64_t wibesocket_get_rtt_us(const wibesocket_conn_t* conn) {
+    const wibesocket_conn* c = (const wibesocket_conn*)conn;
+    return c ? c->rtt_us : 0;
+}
+
+size_t wibesocket_get_memory_usage(const wibesocket_conn_t* conn) {
+    const wibesocket_conn* c = (const wibesocket_conn*)conn;
+    if (!c) return 0;
+    size_t n = c->rx.capacity + c->send_cap + c->asm_cap + c->asm_pinned_cap;
+    for (size_t i = 0; i < c->npins; i++) {
+        const ws_pin_t* p = &c->pins[i];
+        n += p->asm_cap;
+        /* A retired ring is counted once, with its oldest pin */
+        size_t j = 0;
+        while (p->seg && j < i && c->pins[j].seg != p->seg) j++;
+        if (p->seg && j == i) n += p->seg->rb.capacity;
+#if defined(WS_HAVE_ZLIB)
+        n += p->zout_cap;
+        for (size_t j = 0; j < p->zspent_n; j++) n += p->zspent[j].cap;
+#endif
+    }
+    for (const ws_zc_buf_t* z = c->zc_head; z; z = z->next) n += z->cap;
+#if defined(WS_HAVE_IO_URING)
+    if (c->send_retired) n += c->send_retired_cap;
+#endif
+#if defined(WS_HAVE_ZLIB)
+    n += c->zout_cap;
+    for (size_t i = 0; i < c->zspent_n; i++) n += c->zspent[i].cap;
+#endif
+    return n;
+}
+
+bool wibesocket_compression_negotiated(const wibesocket_conn_t* conn) {
+#if defined(WS_HAVE_ZLIB)
+    const wibesocket_conn* c = (const wibesocket_conn*)conn;
+    return c && c->deflate;
+#else
+    (void)conn;
+    return false;
+#endif
+}
+
+wibesocket_io_backend_t wibesocket_get_io_backend(const wibesocket_conn_t* conn) {
+#if defined(WS_HAVE_IO_URING)
+    const wibesocket_conn* c = (const wibesocket_conn*)conn;
+    if (c && c->uring) return WIBESOCKET_IO_URING;
+#else
+    (void)conn;
+#endif
+    return WIBESOCKET_IO_EPOLL;
+}
+
+wibesocket_error_t wibesocket_set_cpu_affinity(wibesocket_conn_t* conn, int cpu) {
+    wibesocket_conn* c = (wibesocket_conn*)conn;
+#if defined(__linux__)
+    if (cpu < 0 || cpu >= CPU_SETSIZE) return WIBESOCKET_ERROR_INVALID_ARGS;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) return WIBESOCKET_ERROR_SYSTEM;
+    /* A hint like busy_poll_socket: best effort */
+#if defined(SO_INCOMING_CPU)
+    if (c && c->fd >= 0) (void)setsockopt(c->fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu));
+#endif
+    (void)c;
+    return WIBESOCKET_OK;
+#else
+    (void)c; (void)cpu;
+    return WIBESOCKET_ERROR_NOT_READY;
+#endif
+}
+
+int wibesocket_fileno(const wibesocket_conn_t* conn) {
+    const wibesocket_conn* c = (const wibesocket_conn*)conn;
+#if defined(WS_HAVE_IO_URING)
+    if (c && c->uring) return ws_uring_fd(c->uring);
+#endif
+    return c ? c->fd : -1;
+}
+
+wibesocket_error_t wibesocket_poll_events(wibesocket_conn_t* conn, int timeout_ms) {
+    wibesocket_conn* c = (wibesocket_conn*)conn;
+    if (!c || c->fd < 0) return WIBESOCKET_ERROR_INVALID_ARGS;
+    int w = wait_readable(c, timeout_ms);
+    if (w > 0) return WIBESOCKET_OK;
+    if (w == 0) return WIBESOCKET_ERROR_TIMEOUT;
+    return WIBESOCKET_ERROR_NETWORK;
+}
+
+int ws_conn_loop_attach(wibesocket_conn_t* conn, ws_loop_entry_t* entry, int* out_fd) {
+    wibesocket_conn* c = (wibesocket_conn*)conn;
+    if (c->state != WIBESOCKET_STATE_OPEN && c->state != WIBESOCKET_STATE_CONNECTING) return -1;
+    c->loop_entry = entry;
+    /* The loop's set replaces the private one; blocking waits fall back to poll() */
+    safe_close(&c->epfd);
+    *out_fd = c->fd; /* -1 while an async connect is still resolving */
+#if defined(WS_HAVE_IO_URING)
+    if (c->uring) *out_fd = ws_uring_fd(c->uring); /* completions, not readiness */
+#endif
+    return 0;
+}
+
+void ws_conn_loop_detach(wibesocket_conn_t* conn) {
+    wibesocket_conn* c = (wibesocket_conn*)conn;
+    c->loop_entry = NULL;
+}
+
+ws_loop_entry_t* ws_conn_loop_entry(const wibesocket_conn_t* conn) {
+    return ((const wibesocket_conn*)conn)->loop_entry;
+}
+
+void ws_conn_on_readable(wibesocket_conn_t* conn) {
+    wibesocket_conn* c = (wibesocket_conn*)conn;
+    c->rx_drained = 0;
+#if defined(WS_HAVE_IO_URING)
+    /* A ring event may be a send completion that frees the queue for the next chain */
+    if (c->uring && !c->corked) (void)ws_flush_send(c);
+#endif
+}
+
+int ws_conn_on_writable(wibesocket_conn_t* conn) {
+    wibesocket_conn* c = (wibesocket_conn*)conn;
+    if (c->corked) return 0;
+    return ws_flush_send(c);
+}
+
+int ws_conn_flush_due(wibesocket_conn_t* conn) {
+    wibesocket_conn* c = (wibesocket_conn*)conn;
+    if (!c->flush_due_us || c->corked || c->state != WIBESOCKET_STATE_OPEN) return 0;
+    if (ws_send_held(c)) {
+        ws_loop_entry_flush_at(c->loop_entry, c->flush_due_us);
+        return 0;
+    }
+    return ws_flush_send(c);
+}
+
+int ws_conn_wants_write(const wibesocket_conn_t* conn) {
+    const wibesocket_conn* c = (const wibesocket_conn*)conn;
+#if defined(WS_HAVE_IO_URING)
+    if (c->uring) return 0; /* the kernel drives the send chain */
+#endif
+    return ws_send_pending(c);
+}
+
+int ws_conn_on_errqueue(wibesocket_conn_t* conn) {
+    wibesocket_conn* c = (wibesocket_conn*)conn;
+#if defined(WS_HAVE_ZEROCOPY)
+    if (c->zc_state <= 0 || c->fd < 0) return 0;
+    ws_zc_reap(c);
+    int err = 0; socklen_t el = sizeof(err);
+    if (getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &el) == 0 && err == 0) return 1;
+    if (c->state == WIBESOCKET_STATE_OPEN || c->state == WIBESOCKET_STATE_CLOSING) {
+        c->state = WIBESOCKET_STATE_ERROR;
+        c->last_error = WIBESOCKET_ERROR_NETWORK;
+    }
+#else
+    (void)c;
+#endif
+    return 0;
+}
+
+int ws_conn_connecting(const wibesocket_conn_t* conn) {
+    return ((const wibesocket_conn*)conn)->state == WIBESOCKET_STATE_CONNECTING;
+}
+
+uint64_t ws_conn_timer_deadline(const wibesocket_conn_t* conn, uint64_t now_ms) {
+    const wibesocket_conn* c = (const wibesocket_conn*)conn;
+    switch (c->state) {
+    case WIBESOCKET_STATE_CONNECTING:
+        /* A lookup in flight has no fd to wake us: check back shortly */
+        if (c->cn_phase == WS_CONNECT_RESOLVE && now_ms + WS_RESOLVE_POLL_MS < c->cn_deadline_ms) {
+            return now_ms + WS_RESOLVE_POLL_MS;
+        }
+        return c->cn_deadline_ms;
+    case WIBESOCKET_STATE_CLOSING:
+        return ws_close_deadline(c);
+    case WIBESOCKET_STATE_OPEN: {
+        /* A ping after each quiet interval; received bytes of any kind restart both clocks */
+        uint64_t due = 0;
+        if (c->cfg.ping_interval_ms) {
+            uint64_t last = c->last_rx_ms > c->last_ping_ms ? c->last_rx_ms : c->last_ping_ms;
+            due = last + c->cfg.ping_interval_ms;
+        }
+        if (c->cfg.idle_timeout_ms) {
+            uint64_t idle = c->last_rx_ms + c->cfg.idle_timeout_ms;
+            if (!due || idle < due) due = idle;
+        }
+        /* A loop keeps the coalescing deadline itself, to the microsecond */
+        if (c->flush_due_us && !c->loop_entry) {
+            uint64_t flush = (c->flush_due_us + 999) / 1000;
+            if (!due || flush < due) due = flush;
+        }
+        return due;
+    }
+    default:
+        return 0;
+    }
+}
+
+uint32_t ws_conn_on_timer(wibesocket_conn_t* conn, uint64_t now_ms) {
+    wibesocket_conn* c = (wibesocket_conn*)conn;
+    if (c->lingering) {
+        if (now_ms >= ws_close_deadline(c)) ws_conn_destroy(c);
+        return 0;
+    }
+    if (c->state == WIBESOCKET_STATE_CLOSING) {
+        if (now_ms < ws_close_deadline(c)) return 0;
+        c->state = WIBESOCKET_STATE_CLOSED;
+        c->last_error = WIBESOCKET_ERROR_TIMEOUT;
+        return WIBESOCKET_EVENT_ERROR;
+    }
+    if (c->state != WIBESOCKET_STATE_OPEN) return 0;
+    if (c->flush_due_us && now_ms * 1000 >= c->flush_due_us && !c->corked && ws_flush_send(c) < 0) {
+        return WIBESOCKET_EVENT_ERROR;
+    }
+    if (c->cfg.idle_timeout_ms && now_ms >= c->last_rx_ms + c->cfg.idle_timeout_ms) {
+        c->state = WIBESOCKET_STATE_ERROR;
+        c->last_error = WIBESOCKET_ERROR_TIMEOUT;
+        return WIBESOCKET_EVENT_ERROR;
+    }
+    if (c->cfg.ping_interval_ms) {
+        uint64_t last = c->last_rx_ms > c->last_ping_ms ? c->last_rx_ms : c->last_ping_ms;
+        if (now_ms >= last + c->cfg.ping_interval_ms) {
+            (void)ws_send_ping(c, NULL, 0);
+            c->last_ping_ms = now_ms;
+        }
+    }
+    return 0;
+}
+
+int ws_conn_lingering(const wibesocket_conn_t* conn) {
+    return ((const wibesocket_conn*)conn)->lingering;
+}
+
+void ws_conn_linger_step(wibesocket_conn_t* conn) {
+    wibesocket_conn* c = (wibesocket_conn*)conn;
+    if (ws_close_drain(c) || ws_now_ms() >= ws_close_deadline(c)) ws_conn_destroy(c);
+}
+
+void ws_conn_finish_close(wibesocket_conn_t* conn) {
+    ws_conn_destroy((wibesocket_conn*)conn);
+}
+
+void ws_conn_set_shard(wibesocket_conn_t* conn, int shard) {
+    ((wibesocket_conn*)conn)->shard = shard;
+}
+
+int ws_conn_shard(const wibesocket_conn_t* conn) {
+    return ((const wibesocket_conn*)conn)->shard;
+}
+
+int ws_conn_post_fd(const wibesocket_conn_t* conn) {
+    return ((const wibesocket_conn*)conn)->post_fd;
+}
+
+int ws_conn_take_drained(wibesocket_conn_t* conn) {
+    wibesocket_conn* c = (wibesocket_conn*)conn;
+    int d = c->drained_pending;
+    c->drained_pending = 0;
+    return d;
+}
+
+int ws_conn_has_pending(const wibesocket_conn_t* conn) {
+    const wibesocket_conn* c = (const wibesocket_conn*)conn;
+    if (c->drained_pending) return 1;
+    if (c->state != WIBESOCKET_STATE_OPEN || c->npins >= WS_PIN_MAX) return 0;
+    return !c->rx_drained || c->recv_parsed < c->rx.count;
+}
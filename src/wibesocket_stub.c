@@ -21,6 +21,7 @@ static const char* k_error_strings[] = {
     "closed",
     "buffer full",
     "not ready",
+    "system",
 };
 
 wibesocket_conn_t* wibesocket_connect(const char* uri, const wibesocket_config_t* config) {
@@ -0,0 +1,175 @@
+/* Local echo server for integration tests: accepts on 127.0.0.1 (ephemeral port), completes
+ * the upgrade and echoes every data frame back unmasked, one thread per client. Clients that
+ * connect to path /hold are not read from while echo_hold is set, so a test can fill the
+ * socket buffers deterministically. A client offering permessage-deflate on a path starting
+ * /deflate is accepted with the rest of the path as parameters ('&' for "; "); compressed
+ * frames are echoed as they are, which the client's inflater reads back in step. Path /mute
+ * reads and discards everything after the upgrade and never answers, not even a CLOSE; path
+ * /pinger sends a PING ahead of every echoed frame. */
+#ifndef WIBESOCKET_TESTS_ECHO_HELPER_H
+#define WIBESOCKET_TESTS_ECHO_HELPER_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "wibesocket/wibesocket.h"
+#include "../src/handshake.h"
+
+static atomic_int echo_hold;
+static atomic_int echo_rsv1_frames;    /* frames received with RSV1 set */
+static atomic_size_t echo_wire_bytes;  /* data frame payload bytes received */
+static atomic_int echo_pings;          /* PING frames received */
+static atomic_int echo_pongs;          /* PONG frames received */
+
+typedef struct {
+    int       listen_fd;
+    int       port;
+    pthread_t thread;
+    char      uri[64];
+} echo_server_t;
+
+static int echo_read_full(int fd, uint8_t* p, size_t n) {
+    while (n) {
+        ssize_t r = recv(fd, p, n, 0);
+        if (r <= 0) return -1;
+        p += r; n -= (size_t)r;
+    }
+    return 0;
+}
+
+static int echo_write_full(int fd, const uint8_t* p, size_t n) {
+    while (n) {
+        ssize_t w = send(fd, p, n, MSG_NOSIGNAL);
+        if (w <= 0) return -1;
+        p += w; n -= (size_t)w;
+    }
+    return 0;
+}
+
+static int echo_send_frame(int fd, uint8_t b0, const uint8_t* p, size_t n) {
+    uint8_t h[10]; size_t hl = 0;
+    h[hl++] = b0;
+    if (n <= 125) h[hl++] = (uint8_t)n;
+    else if (n <= 0xFFFF) { h[hl++] = 126; h[hl++] = (uint8_t)(n >> 8); h[hl++] = (uint8_t)n; }
+    else { h[hl++] = 127; for (int i = 7; i >= 0; i--) h[hl++] = (uint8_t)((uint64_t)n >> (8 * i)); }
+    if (echo_write_full(fd, h, hl) < 0) return -1;
+    return echo_write_full(fd, p, n);
+}
+
+static void* echo_client(void* arg) {
+    int fd = (int)(intptr_t)arg;
+    char req[4096]; size_t got = 0;
+    while (got < sizeof(req) - 1) {
+        ssize_t r = recv(fd, req + got, sizeof(req) - 1 - got, 0);
+        if (r <= 0) goto out;
+        got += (size_t)r; req[got] = 0;
+        if (strstr(req, "\r\n\r\n")) break;
+    }
+    {
+        const char* k = strstr(req, "Sec-WebSocket-Key: ");
+        if (!k) goto out;
+        char key[64]; size_t kl = 0; k += 19;
+        while (k[kl] && k[kl] != '\r' && kl < sizeof(key) - 1) { key[kl] = k[kl]; kl++; }
+        key[kl] = 0;
+        char accept[29]; ws_compute_accept(key, accept);
+        char ext[256] = "";
+        if (strncmp(req, "GET /deflate", 12) == 0 && strstr(req, "permessage-deflate")) {
+            size_t el = (size_t)snprintf(ext, sizeof(ext), "Sec-WebSocket-Extensions: permessage-deflate");
+            for (const char* q = req + 12; *q && *q != ' ' && el + 4 < sizeof(ext); q++) {
+                if (*q == '&') { ext[el++] = ';'; ext[el++] = ' '; }
+                else ext[el++] = *q;
+            }
+            memcpy(ext + el, "\r\n", 3);
+        }
+        char resp[512];
+        int n = snprintf(resp, sizeof(resp), "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n"
+                         "Connection: Upgrade\r\nSec-WebSocket-Accept: %s\r\n%s\r\n", accept, ext);
+        if (echo_write_full(fd, (const uint8_t*)resp, (size_t)n) < 0) goto out;
+    }
+    if (strncmp(req, "GET /hold", 9) == 0) {
+        while (atomic_load(&echo_hold)) usleep(1000);
+    }
+    if (strncmp(req, "GET /mute", 9) == 0) {
+        uint8_t sink[4096];
+        while (recv(fd, sink, sizeof(sink), 0) > 0) {}
+        goto out;
+    }
+    int pinger = strncmp(req, "GET /pinger", 11) == 0;
+    for (;;) {
+        uint8_t h[2];
+        if (echo_read_full(fd, h, 2) < 0) break;
+        uint64_t n = h[1] & 0x7F;
+        uint8_t ext[8];
+        if (n == 126) { if (echo_read_full(fd, ext, 2) < 0) break; n = ((uint64_t)ext[0] << 8) | ext[1]; }
+        else if (n == 127) { if (echo_read_full(fd, ext, 8) < 0) break; n = 0; for (int i = 0; i < 8; i++) n = (n << 8) | ext[i]; }
+        uint8_t mk[4] = {0, 0, 0, 0};
+        if ((h[1] & 0x80) && echo_read_full(fd, mk, 4) < 0) break;
+        uint8_t* p = (uint8_t*)malloc(n ? (size_t)n : 1);
+        if (!p || echo_read_full(fd, p, (size_t)n) < 0) { free(p); break; }
+        for (uint64_t i = 0; i < n; i++) p[i] ^= mk[i & 3];
+        uint8_t op = h[0] & 0x0F;
+        int rc = 0;
+        if (h[0] & 0x40) atomic_fetch_add(&echo_rsv1_frames, 1);
+        if (!(op & 0x8)) atomic_fetch_add(&echo_wire_bytes, (size_t)n);
+        if (op == 0x8) { (void)echo_send_frame(fd, 0x88, p, n < 2 ? (size_t)n : 2); free(p); break; }
+        if (op == 0x9) { atomic_fetch_add(&echo_pings, 1); rc = echo_send_frame(fd, 0x8A, p, (size_t)n); }
+        else if (op == 0xA) atomic_fetch_add(&echo_pongs, 1);
+        else {
+            if (pinger) rc = echo_send_frame(fd, 0x89, (const uint8_t*)"hb", 2);
+            if (rc == 0) rc = echo_send_frame(fd, h[0], p, (size_t)n);
+        }
+        free(p);
+        if (rc < 0) break;
+    }
+out:
+    close(fd);
+    return NULL;
+}
+
+static void* echo_accept_loop(void* arg) {
+    echo_server_t* s = (echo_server_t*)arg;
+    for (;;) {
+        int fd = accept(s->listen_fd, NULL, NULL);
+        if (fd < 0) return NULL;
+        int one = 1; (void)setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        pthread_t t;
+        if (pthread_create(&t, NULL, echo_client, (void*)(intptr_t)fd) != 0) { close(fd); continue; }
+        pthread_detach(t);
+    }
+}
+
+static int echo_server_start(echo_server_t* s) {
+    memset(s, 0, sizeof(*s));
+    s->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (s->listen_fd < 0) return -1;
+    struct sockaddr_in a; memset(&a, 0, sizeof(a));
+    a.sin_family = AF_INET; a.sin_addr.s_addr = htonl(INADDR_LOOPBACK); a.sin_port = 0;
+    socklen_t al = sizeof(a);
+    if (bind(s->listen_fd, (struct sockaddr*)&a, sizeof(a)) < 0 || listen(s->listen_fd, 128) < 0 ||
+        getsockname(s->listen_fd, (struct sockaddr*)&a, &al) < 0) {
+        close(s->listen_fd); return -1;
+    }
+    s->port = ntohs(a.sin_port);
+    snprintf(s->uri, sizeof(s->uri), "ws://127.0.0.1:%d/", s->port);
+    if (pthread_create(&s->thread, NULL, echo_accept_loop, s) != 0) { close(s->listen_fd); return -1; }
+    pthread_detach(s->thread);
+    return 0;
+}
+
+/* Connect to one of the server's paths ("/hold", "/deflate...") */
+static inline wibesocket_conn_t* echo_connect(const echo_server_t* s, const char* path, const wibesocket_config_t* cfg) {
+    char uri[256];
+    snprintf(uri, sizeof(uri), "ws://127.0.0.1:%d%s", s->port, path);
+    return wibesocket_connect(uri, cfg);
+}
+
+#endif /* WIBESOCKET_TESTS_ECHO_HELPER_H */
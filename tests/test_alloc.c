@@ -0,0 +1,227 @@
+/* Allocation: the slab behind connection structs, the allocator hook, which sees every heap
+ * buffer a connection takes (so it also shows when the receive ring is enough), and receive
+ * buffer lending */
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wibesocket/wibesocket.h"
+#include "../src/internal/slab.h"
+#include "echo_helper.h"
+
+static void test_slab(void) {
+    static ws_slab_t slab = WS_SLAB_INIT(100); /* slabs live as long as the process */
+    void* objs[200];
+    for (int i = 0; i < 200; i++) {
+        objs[i] = ws_slab_alloc(&slab);
+        assert(objs[i] && ((uintptr_t)objs[i] & 63) == 0);
+        for (int j = 0; j < i; j++) assert(objs[j] != objs[i]);
+        memset(objs[i], 0xab, 100);
+    }
+    void* last = objs[199];
+    ws_slab_free(&slab, last);
+    /* Recycled, and zeroed again */
+    uint8_t* again = (uint8_t*)ws_slab_alloc(&slab);
+    assert(again == last);
+    for (int k = 0; k < 100; k++) assert(again[k] == 0);
+    for (int i = 0; i < 200; i++) ws_slab_free(&slab, objs[i]);
+}
+
+static atomic_size_t g_allocs, g_frees, g_live_bytes;
+static atomic_size_t g_watch_size, g_watch_hits; /* requests of exactly this size */
+static atomic_size_t g_fail_from, g_fail_left;   /* refuse this many requests of at least this size */
+
+static void* count_alloc(void* ctx, size_t size) {
+    assert(ctx == &g_allocs);
+    if (atomic_load(&g_fail_from) && size >= atomic_load(&g_fail_from) && atomic_load(&g_fail_left) > 0) {
+        atomic_fetch_sub(&g_fail_left, 1);
+        return NULL;
+    }
+    atomic_fetch_add(&g_allocs, 1);
+    atomic_fetch_add(&g_live_bytes, size);
+    if (size == atomic_load(&g_watch_size)) atomic_fetch_add(&g_watch_hits, 1);
+    return malloc(size);
+}
+
+static void count_free(void* ctx, void* ptr, size_t size) {
+    assert(ctx == &g_allocs);
+    atomic_fetch_add(&g_frees, 1);
+    atomic_fetch_sub(&g_live_bytes, size);
+    free(ptr);
+}
+
+static const wibesocket_allocator_t k_counting = { count_alloc, count_free, &g_allocs };
+
+static void echo_one(wibesocket_conn_t* c, const char* data, size_t len) {
+    wibesocket_message_t m;
+    assert(wibesocket_send_binary(c, data, len) == WIBESOCKET_OK);
+    assert(wibesocket_recv(c, &m, 5000) == WIBESOCKET_OK);
+    assert(m.payload_len == len && memcmp(m.payload, data, len) == 0);
+    wibesocket_release_payload(c);
+}
+
+static void test_allocator_hook(const echo_server_t* srv) {
+    wibesocket_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.allocator = &k_counting;
+    size_t big = 200U * 1024U;
+    char* data = (char*)malloc(big);
+    for (size_t i = 0; i < big; i++) data[i] = (char)(i * 31);
+    atomic_store(&g_watch_size, big); /* a reassembly buffer for the big frame */
+
+    /* Default ring: it starts at a page and grows to take the 200 KiB frame in place */
+    wibesocket_conn_t* c = wibesocket_connect(srv->uri, &cfg);
+    assert(c);
+    assert(atomic_load(&g_allocs) > 0); /* the struct and the connect strings at least */
+    for (int i = 0; i < 10; i++) echo_one(c, data, 100);
+    assert(wibesocket_post_send(c, WIBESOCKET_FRAME_TEXT, "posted", 6) == WIBESOCKET_OK);
+    wibesocket_message_t m;
+    assert(wibesocket_recv(c, &m, 5000) == WIBESOCKET_OK && m.payload_len == 6);
+    wibesocket_release_payload(c);
+    echo_one(c, data, big);
+    echo_one(c, data, 100);
+    /* Only the send queue held the frame; nothing was reassembled on the way back */
+    assert(atomic_load(&g_watch_hits) == 0);
+    wibesocket_close(c);
+    assert(atomic_load(&g_allocs) == atomic_load(&g_frees));
+    assert(atomic_load(&g_live_bytes) == 0);
+
+    /* A ring capped below the frame: the frame is reassembled in a hooked buffer instead */
+    cfg.recv_buffer_size = 16384;
+    c = wibesocket_connect(srv->uri, &cfg);
+    assert(c);
+    echo_one(c, data, big);
+    echo_one(c, data, 100);
+    wibesocket_close(c);
+    assert(atomic_load(&g_watch_hits) == 1);
+    assert(atomic_load(&g_allocs) == atomic_load(&g_frees));
+    assert(atomic_load(&g_live_bytes) == 0);
+
+    /* A hook needs both halves */
+    wibesocket_allocator_t half = { count_alloc, NULL, &g_allocs };
+    cfg.allocator = &half;
+    assert(wibesocket_connect(srv->uri, &cfg) == NULL);
+    free(data);
+}
+
+/* A posted frame the send queue cannot grow for is retried, and failing that fails the
+ * connection instead of disappearing */
+static void test_posted_no_memory(const echo_server_t* srv) {
+    wibesocket_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.allocator = &k_counting;
+    size_t len = 64U * 1024U;
+    char* data = (char*)malloc(len);
+    memset(data, 'q', len);
+    wibesocket_conn_t* c = wibesocket_connect(srv->uri, &cfg);
+    assert(c);
+    /* The frame itself is allocated; the queue growing to take it is not, once */
+    atomic_store(&g_fail_from, 100000);
+    atomic_store(&g_fail_left, 1);
+    assert(wibesocket_post_send(c, WIBESOCKET_FRAME_BINARY, data, len) == WIBESOCKET_OK);
+    wibesocket_message_t m;
+    assert(wibesocket_recv(c, &m, 5000) == WIBESOCKET_OK);
+    assert(m.payload_len == len && memcmp(m.payload, data, len) == 0);
+    wibesocket_release_payload(c);
+    assert(atomic_load(&g_fail_left) == 0);
+    wibesocket_close(c);
+
+    /* Never: the connection fails and says why */
+    c = wibesocket_connect(srv->uri, &cfg);
+    assert(c);
+    atomic_store(&g_fail_left, 1000);
+    assert(wibesocket_post_send(c, WIBESOCKET_FRAME_BINARY, data, len) == WIBESOCKET_OK);
+    assert(wibesocket_recv(c, &m, 5000) != WIBESOCKET_OK);
+    assert(wibesocket_get_state(c) == WIBESOCKET_STATE_ERROR);
+    assert(wibesocket_get_error(c) == WIBESOCKET_ERROR_MEMORY);
+    atomic_store(&g_fail_from, 0);
+    wibesocket_close(c);
+    assert(atomic_load(&g_allocs) == atomic_load(&g_frees));
+    assert(atomic_load(&g_live_bytes) == 0);
+    free(data);
+}
+
+static void test_pooled_churn(const echo_server_t* srv) {
+    /* Built-in pools: connections come and go, and each still starts small and grows */
+    char msg[64 * 1024];
+    memset(msg, 'p', sizeof(msg));
+    for (int round = 0; round < 40; round++) {
+        wibesocket_conn_t* c = wibesocket_connect(srv->uri, NULL);
+        assert(c);
+        echo_one(c, msg, (size_t)(round * 1600 + 1));
+        wibesocket_close(c);
+    }
+}
+
+static void test_buffer_lending(const echo_server_t* srv, wibesocket_io_backend_t backend) {
+    wibesocket_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.recv_buffer_lending = true;
+    cfg.io_backend = backend;
+    wibesocket_conn_t* c = wibesocket_connect(srv->uri, &cfg);
+    assert(c);
+    /* Open and idle: no ring, no queue */
+    assert(wibesocket_get_memory_usage(c) == 0);
+
+    wibesocket_message_t m;
+    assert(wibesocket_send_text(c, "heartbeat", 9) == WIBESOCKET_OK);
+    assert(wibesocket_recv(c, &m, 5000) == WIBESOCKET_OK);
+    assert(m.payload_len == 9 && memcmp(m.payload, "heartbeat", 9) == 0);
+    assert(wibesocket_get_memory_usage(c) > 0); /* the payload points into the borrowed ring */
+    wibesocket_release_payload(c);
+    assert(wibesocket_get_memory_usage(c) == 0);
+    assert(wibesocket_recv(c, &m, 0) == WIBESOCKET_ERROR_TIMEOUT);
+    assert(wibesocket_get_memory_usage(c) == 0);
+
+    /* A pipelined burst, taken a batch at a time with a fresh ring behind each */
+    char msg[2048];
+    memset(msg, 'b', sizeof(msg));
+    assert(wibesocket_send_begin(c) == WIBESOCKET_OK);
+    for (int i = 0; i < 100; i++) {
+        msg[0] = (char)i;
+        assert(wibesocket_send_binary(c, msg, sizeof(msg)) == WIBESOCKET_OK);
+    }
+    assert(wibesocket_send_commit(c) == WIBESOCKET_OK);
+    int got = 0;
+    while (got < 100) {
+        wibesocket_message_t batch[16];
+        size_t k = 0;
+        assert(wibesocket_recv_batch(c, batch, 16, &k, 5000) == WIBESOCKET_OK);
+        for (size_t j = 0; j < k; j++, got++) {
+            assert(batch[j].payload_len == sizeof(msg));
+            assert(((const char*)batch[j].payload)[0] == (char)got);
+        }
+        wibesocket_release_payload(c);
+    }
+    /* Large frames still grow the borrowed ring, which goes back all the same */
+    size_t big = 200U * 1024U;
+    char* data = (char*)malloc(big);
+    for (size_t i = 0; i < big; i++) data[i] = (char)(i * 7);
+    echo_one(c, data, big);
+    free(data);
+    assert(wibesocket_get_memory_usage(c) == 0);
+    wibesocket_close(c);
+
+    /* Without lending the ring stays put */
+    cfg.recv_buffer_lending = false;
+    c = wibesocket_connect(srv->uri, &cfg);
+    assert(c);
+    echo_one(c, "x", 1);
+    assert(wibesocket_get_memory_usage(c) >= 4096);
+    wibesocket_close(c);
+}
+
+int main(void) {
+    test_slab();
+    echo_server_t srv;
+    assert(echo_server_start(&srv) == 0);
+    test_allocator_hook(&srv);
+    test_posted_no_memory(&srv);
+    test_pooled_churn(&srv);
+    test_buffer_lending(&srv, WIBESOCKET_IO_EPOLL);
+    test_buffer_lending(&srv, WIBESOCKET_IO_URING);
+    printf("test_alloc OK\n");
+    return 0;
+}
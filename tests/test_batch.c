@@ -0,0 +1,107 @@
+/* wibesocket_send_batch against the local echo server: every frame of a mixed-size batch comes
+ * back in order, and a batch over the high watermark is refused with nothing queued (the
+ * zerocopy-node case of all-or-nothing is in test_zerocopy) */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wibesocket/wibesocket.h"
+#include "echo_helper.h"
+
+static void fill(uint8_t* p, size_t n, unsigned seed) {
+    for (size_t i = 0; i < n; i++) p[i] = (uint8_t)(i * 31 + seed);
+}
+
+static int same(const wibesocket_message_t* m, size_t n, unsigned seed) {
+    if (m->payload_len != n) return 0;
+    const uint8_t* p = (const uint8_t*)m->payload;
+    for (size_t i = 0; i < n; i++) if (p[i] != (uint8_t)(i * 31 + seed)) return 0;
+    return 1;
+}
+
+/* Lengths either side of each header size boundary, plus an empty frame */
+static const size_t sizes[] = { 0, 1, 125, 126, 127, 65535, 65536, 300U << 10, 7 };
+#define NSIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+static void test_mixed_echo(const echo_server_t* srv) {
+    wibesocket_config_t cfg; memset(&cfg, 0, sizeof(cfg));
+    cfg.max_frame_size = 1U << 20;
+    wibesocket_conn_t* c = wibesocket_connect(srv->uri, &cfg);
+    assert(c);
+    uint8_t* bufs[NSIZES];
+    struct iovec iov[NSIZES];
+    for (size_t i = 0; i < NSIZES; i++) {
+        bufs[i] = (uint8_t*)malloc(sizes[i] ? sizes[i] : 1);
+        fill(bufs[i], sizes[i], (unsigned)i);
+        iov[i].iov_base = bufs[i];
+        iov[i].iov_len = sizes[i];
+    }
+    for (unsigned round = 0; round < 3; round++) {
+        assert(wibesocket_send_batch(c, WIBESOCKET_FRAME_BINARY, iov, NSIZES) == WIBESOCKET_OK);
+        for (size_t i = 0; i < NSIZES; i++) {
+            wibesocket_message_t m;
+            assert(wibesocket_recv(c, &m, 5000) == WIBESOCKET_OK);
+            assert(m.type == WIBESOCKET_FRAME_BINARY && same(&m, sizes[i], (unsigned)i));
+            wibesocket_release_payload(c);
+        }
+    }
+    assert(wibesocket_send_batch(c, WIBESOCKET_FRAME_BINARY, iov, 0) == WIBESOCKET_OK);
+    assert(wibesocket_get_buffered_amount(c) == 0);
+    for (size_t i = 0; i < NSIZES; i++) free(bufs[i]);
+    assert(wibesocket_close(c) == WIBESOCKET_OK);
+}
+
+/* With a backlog the peer is not reading, a batch that would cross the high watermark is
+ * refused whole; once the peer catches up the same batch goes out and echoes in order */
+static void test_over_watermark(const echo_server_t* srv) {
+    char uri[80]; snprintf(uri, sizeof(uri), "%shold", srv->uri);
+    wibesocket_config_t cfg; memset(&cfg, 0, sizeof(cfg));
+    cfg.max_frame_size = 16U << 20;
+    cfg.send_high_watermark = 256U << 10;
+    cfg.send_low_watermark = 64U << 10;
+    atomic_store(&echo_hold, 1);
+    wibesocket_conn_t* c = wibesocket_connect(uri, &cfg);
+    assert(c);
+    size_t n = 8U << 20;
+    uint8_t* first = (uint8_t*)malloc(n);
+    fill(first, n, 50);
+    assert(wibesocket_send_binary(c, first, n) == WIBESOCKET_OK);
+    size_t before = wibesocket_get_buffered_amount(c);
+    assert(before > 0);
+
+    uint8_t* bufs[3];
+    struct iovec iov[3];
+    for (size_t i = 0; i < 3; i++) {
+        bufs[i] = (uint8_t*)malloc(128U << 10);
+        fill(bufs[i], 128U << 10, (unsigned)(60 + i));
+        iov[i].iov_base = bufs[i];
+        iov[i].iov_len = 128U << 10;
+    }
+    assert(wibesocket_send_batch(c, WIBESOCKET_FRAME_BINARY, iov, 3) == WIBESOCKET_ERROR_BUFFER_FULL);
+    assert(wibesocket_get_buffered_amount(c) == before);
+
+    atomic_store(&echo_hold, 0);
+    assert(wibesocket_wait_writable(c, 5000) == WIBESOCKET_OK);
+    assert(wibesocket_get_buffered_amount(c) <= cfg.send_low_watermark);
+    assert(wibesocket_send_batch(c, WIBESOCKET_FRAME_BINARY, iov, 3) == WIBESOCKET_OK);
+    wibesocket_message_t m;
+    assert(wibesocket_recv(c, &m, 5000) == WIBESOCKET_OK && same(&m, n, 50));
+    wibesocket_release_payload(c);
+    for (size_t i = 0; i < 3; i++) {
+        assert(wibesocket_recv(c, &m, 5000) == WIBESOCKET_OK && same(&m, 128U << 10, (unsigned)(60 + i)));
+        wibesocket_release_payload(c);
+    }
+    for (size_t i = 0; i < 3; i++) free(bufs[i]);
+    free(first);
+    assert(wibesocket_close(c) == WIBESOCKET_OK);
+}
+
+int main(void) {
+    echo_server_t srv;
+    assert(echo_server_start(&srv) == 0);
+    test_mixed_echo(&srv);
+    test_over_watermark(&srv);
+    printf("test_batch OK\n");
+    return 0;
+}
@@ -0,0 +1,107 @@
+/* Busy-poll receive: echoes arrive through the spinning path, timeouts still hold, and the
+ * spin stays off for looped connections */
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "wibesocket/wibesocket.h"
+#include "wibesocket/event_loop.h"
+#include "echo_helper.h"
+
+static uint64_t now_ms(void) {
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)(ts.tv_nsec / 1000000ULL);
+}
+
+static void test_pingpong(const echo_server_t* srv, uint32_t busy_us, bool socket_opts) {
+    wibesocket_config_t cfg; memset(&cfg, 0, sizeof(cfg));
+    cfg.busy_poll_us = busy_us;
+    cfg.busy_poll_socket = socket_opts;
+    cfg.enable_stats = true;
+    wibesocket_conn_t* c = wibesocket_connect(srv->uri, &cfg);
+    assert(c);
+    for (int i = 0; i < 500; i++) {
+        assert(wibesocket_send_binary(c, &i, sizeof(i)) == WIBESOCKET_OK);
+        wibesocket_message_t m;
+        assert(wibesocket_recv(c, &m, 5000) == WIBESOCKET_OK);
+        assert(m.payload_len == sizeof(i) && memcmp(m.payload, &i, sizeof(i)) == 0);
+        wibesocket_release_message(c, &m);
+    }
+    /* Nothing coming: the spin gives up and the timeout is still honoured */
+    wibesocket_message_t m;
+    uint64_t t0 = now_ms();
+    assert(wibesocket_recv(c, &m, 30) == WIBESOCKET_ERROR_TIMEOUT);
+    uint64_t took = now_ms() - t0;
+    assert(took >= 25 && took < 1000);
+    /* A zero timeout never spins */
+    wibesocket_stats_t before, after;
+    assert(wibesocket_get_stats(c, &before) == WIBESOCKET_OK);
+    assert(wibesocket_recv(c, &m, 0) == WIBESOCKET_ERROR_TIMEOUT);
+    assert(wibesocket_get_stats(c, &after) == WIBESOCKET_OK);
+    assert(after.syscalls - before.syscalls <= 2);
+    assert(wibesocket_close(c) == WIBESOCKET_OK);
+}
+
+static void test_affinity(const echo_server_t* srv) {
+    assert(wibesocket_set_cpu_affinity(NULL, -1) == WIBESOCKET_ERROR_INVALID_ARGS);
+    wibesocket_conn_t* c = wibesocket_connect(srv->uri, NULL);
+    assert(c);
+    wibesocket_error_t e = wibesocket_set_cpu_affinity(c, 0);
+    assert(e == WIBESOCKET_OK || e == WIBESOCKET_ERROR_NOT_READY);
+    /* A CPU past the last configured one cannot take the thread: the system says no */
+    long ncpu = sysconf(_SC_NPROCESSORS_CONF);
+    if (e == WIBESOCKET_OK && ncpu > 0 && ncpu < 1024) {
+        assert(wibesocket_set_cpu_affinity(c, (int)ncpu) == WIBESOCKET_ERROR_SYSTEM);
+    }
+    assert(wibesocket_send_text(c, "pinned", 6) == WIBESOCKET_OK);
+    wibesocket_message_t m;
+    assert(wibesocket_recv(c, &m, 5000) == WIBESOCKET_OK && m.payload_len == 6);
+    wibesocket_release_message(c, &m);
+    assert(wibesocket_close(c) == WIBESOCKET_OK);
+}
+
+typedef struct { int got; } loop_state_t;
+
+static void on_event(wibesocket_loop_t* loop, wibesocket_conn_t* conn, uint32_t events, void* ud) {
+    loop_state_t* st = (loop_state_t*)ud;
+    (void)loop;
+    if (!(events & WIBESOCKET_EVENT_READABLE)) return;
+    wibesocket_message_t m;
+    while (wibesocket_recv(conn, &m, 0) == WIBESOCKET_OK) {
+        wibesocket_release_message(conn, &m);
+        st->got++;
+    }
+}
+
+/* In a loop the loop does the waiting: the setting is inert */
+static void test_looped(const echo_server_t* srv) {
+    wibesocket_config_t cfg; memset(&cfg, 0, sizeof(cfg));
+    cfg.busy_poll_us = 1000000;
+    wibesocket_loop_t* loop = wibesocket_loop_create();
+    wibesocket_conn_t* c = wibesocket_connect(srv->uri, &cfg);
+    assert(c);
+    loop_state_t st = { 0 };
+    assert(wibesocket_loop_add(loop, c, on_event, &st) == WIBESOCKET_OK);
+    for (int i = 0; i < 10; i++) assert(wibesocket_send_text(c, "x", 1) == WIBESOCKET_OK);
+    uint64_t deadline = now_ms() + 5000;
+    while (st.got < 10 && now_ms() < deadline) assert(wibesocket_loop_run_once(loop, 100) >= 0);
+    assert(st.got == 10);
+    uint64_t t0 = now_ms();
+    assert(wibesocket_loop_run_once(loop, 20) >= 0);
+    assert(now_ms() - t0 < 500);
+    assert(wibesocket_close(c) == WIBESOCKET_OK);
+    wibesocket_loop_destroy(loop);
+}
+
+int main(void) {
+    echo_server_t srv;
+    assert(echo_server_start(&srv) == 0);
+    test_pingpong(&srv, 0, false);
+    test_pingpong(&srv, 50, false);
+    test_pingpong(&srv, 200, true);
+    test_affinity(&srv);
+    test_looped(&srv);
+    printf("test_busy_poll OK\n");
+    return 0;
+}
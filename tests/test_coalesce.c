@@ -0,0 +1,124 @@
+/* Outbound coalescing: small data frames wait in the queue until the byte threshold, the
+ * deadline (standalone and in a loop) or an explicit flush; control frames never wait */
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "wibesocket/wibesocket.h"
+#include "wibesocket/event_loop.h"
+#include "echo_helper.h"
+
+static uint64_t now_us(void) {
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)(ts.tv_nsec / 1000ULL);
+}
+
+static wibesocket_conn_t* connect_coalescing(const echo_server_t* srv, uint32_t bytes, uint32_t delay_us) {
+    wibesocket_config_t cfg; memset(&cfg, 0, sizeof(cfg));
+    cfg.coalesce_bytes = bytes;
+    cfg.coalesce_delay_us = delay_us;
+    cfg.enable_stats = true;
+    wibesocket_conn_t* c = wibesocket_connect(srv->uri, &cfg);
+    assert(c);
+    return c;
+}
+
+static void expect_echoes(wibesocket_conn_t* c, int from, int to) {
+    for (int i = from; i < to; i++) {
+        wibesocket_message_t m;
+        assert(wibesocket_recv(c, &m, 5000) == WIBESOCKET_OK);
+        assert(m.payload_len == sizeof(i) && memcmp(m.payload, &i, sizeof(i)) == 0);
+        wibesocket_release_message(c, &m);
+    }
+}
+
+static void test_flush_and_threshold(const echo_server_t* srv) {
+    wibesocket_conn_t* c = connect_coalescing(srv, 1024, 10U * 1000U * 1000U);
+    wibesocket_stats_t st0, st1;
+    assert(wibesocket_get_stats(c, &st0) == WIBESOCKET_OK);
+    for (int i = 0; i < 50; i++) assert(wibesocket_send_binary(c, &i, sizeof(i)) == WIBESOCKET_OK);
+    assert(wibesocket_get_buffered_amount(c) == 50 * (2 + 4 + sizeof(int)));
+    assert(wibesocket_get_stats(c, &st1) == WIBESOCKET_OK);
+    assert(st1.syscalls == st0.syscalls); /* nothing written yet */
+    assert(wibesocket_flush(c) == WIBESOCKET_OK);
+    assert(wibesocket_get_buffered_amount(c) == 0);
+    expect_echoes(c, 0, 50);
+
+    /* 10-byte frames: the 103rd reaches 1024 bytes and takes the lot out */
+    for (int i = 0; i < 102; i++) assert(wibesocket_send_binary(c, &i, sizeof(i)) == WIBESOCKET_OK);
+    assert(wibesocket_get_buffered_amount(c) == 1020);
+    int last = 102;
+    assert(wibesocket_send_binary(c, &last, sizeof(last)) == WIBESOCKET_OK);
+    assert(wibesocket_get_buffered_amount(c) == 0);
+    expect_echoes(c, 0, 103);
+
+    /* A PING is not held, nor is the data queued before it */
+    int x = 7;
+    assert(wibesocket_send_binary(c, &x, sizeof(x)) == WIBESOCKET_OK);
+    assert(wibesocket_get_buffered_amount(c) > 0);
+    assert(wibesocket_send_ping(c, "p", 1) == WIBESOCKET_OK);
+    assert(wibesocket_get_buffered_amount(c) == 0);
+    expect_echoes(c, 7, 8);
+    assert(wibesocket_close(c) == WIBESOCKET_OK);
+}
+
+/* Standalone: a recv waiting for the echo flushes the held frame at its deadline */
+static void test_standalone_deadline(const echo_server_t* srv) {
+    wibesocket_conn_t* c = connect_coalescing(srv, 0, 30000);
+    int i = 0;
+    uint64_t t0 = now_us();
+    assert(wibesocket_send_binary(c, &i, sizeof(i)) == WIBESOCKET_OK);
+    assert(wibesocket_get_buffered_amount(c) > 0);
+    expect_echoes(c, 0, 1);
+    uint64_t took = now_us() - t0;
+    assert(took >= 25000 && took < 1000000);
+    assert(wibesocket_close(c) == WIBESOCKET_OK);
+}
+
+typedef struct { int got; } loop_state_t;
+
+static void on_event(wibesocket_loop_t* loop, wibesocket_conn_t* conn, uint32_t events, void* ud) {
+    loop_state_t* st = (loop_state_t*)ud;
+    (void)loop;
+    if (!(events & WIBESOCKET_EVENT_READABLE)) return;
+    wibesocket_message_t m;
+    while (wibesocket_recv(conn, &m, 0) == WIBESOCKET_OK) {
+        assert(m.payload_len == sizeof(int) && memcmp(m.payload, &st->got, sizeof(int)) == 0);
+        wibesocket_release_message(conn, &m);
+        st->got++;
+    }
+}
+
+/* In a loop the deadline wakes the loop long before the caller's timeout */
+static void test_loop_deadline(const echo_server_t* srv) {
+    wibesocket_conn_t* c = connect_coalescing(srv, 0, 2000);
+    wibesocket_loop_t* loop = wibesocket_loop_create();
+    loop_state_t st = { 0 };
+    assert(wibesocket_loop_add(loop, c, on_event, &st) == WIBESOCKET_OK);
+    for (int round = 0; round < 5; round++) {
+        uint64_t t0 = now_us();
+        for (int i = 0; i < 20; i++) {
+            int v = round * 20 + i;
+            assert(wibesocket_send_binary(c, &v, sizeof(v)) == WIBESOCKET_OK);
+        }
+        assert(wibesocket_get_buffered_amount(c) > 0);
+        while (st.got < (round + 1) * 20) assert(wibesocket_loop_run_once(loop, 1000) >= 0);
+        assert(now_us() - t0 < 500000);
+    }
+    /* Closing with frames held sends them before the CLOSE */
+    int v = 100;
+    assert(wibesocket_send_binary(c, &v, sizeof(v)) == WIBESOCKET_OK);
+    assert(wibesocket_close(c) == WIBESOCKET_OK);
+    wibesocket_loop_destroy(loop);
+}
+
+int main(void) {
+    echo_server_t srv;
+    assert(echo_server_start(&srv) == 0);
+    test_flush_and_threshold(&srv);
+    test_standalone_deadline(&srv);
+    test_loop_deadline(&srv);
+    printf("test_coalesce OK\n");
+    return 0;
+}
@@ -0,0 +1,233 @@
+/* permessage-deflate: the compressor/inflater pair, then negotiation and round trips through
+ * the echo server, which bounces compressed frames back as they are */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wibesocket/wibesocket.h"
+#include "../src/internal/deflate.h"
+#include "echo_helper.h"
+
+/* Order-book style JSON: the repetitive payload compression is meant for */
+static size_t make_book(char* out, size_t cap, int seq, int levels) {
+    size_t n = (size_t)snprintf(out, cap, "{\"type\":\"book\",\"seq\":%d,\"bids\":[", seq);
+    for (int i = 0; i < levels && n + 64 < cap; i++) {
+        n += (size_t)snprintf(out + n, cap - n, "%s[\"%d.%02d\",\"%d.5\"]", i ? "," : "",
+                              30000 - i, (seq + i) % 100, (i * 7 + seq) % 50);
+    }
+    n += (size_t)snprintf(out + n, cap - n, "]}");
+    return n;
+}
+
+/* Inflate a whole compressed message split into two frames, through a small output window */
+static size_t inflate_split(ws_deflate_t* rx, const uint8_t* c, size_t clen, uint8_t* out, size_t cap) {
+    size_t cut = clen / 2, total = 0;
+    for (int part = 0; part < 2; part++) {
+        const uint8_t* in = part ? c + cut : c;
+        size_t len = part ? clen - cut : cut;
+        assert(ws_inflate_begin(rx, in, len, part == 1) == 0);
+        for (;;) {
+            size_t room = cap - total < 100 ? cap - total : 100;
+            size_t got = 0;
+            int r = ws_inflate_more(rx, out + total, room, &got);
+            assert(r >= 0);
+            total += got;
+            if (r == 1) break;
+            assert(got == room);
+        }
+    }
+    return total;
+}
+
+static void roundtrip_unit(int no_takeover, int bits) {
+    ws_deflate_params_t p;
+    memset(&p, 0, sizeof(p));
+    p.enabled = 1;
+    p.client_max_window_bits = bits;
+    p.client_no_context_takeover = no_takeover;
+    ws_deflate_t* tx = ws_deflate_create(&p);
+    /* The receiving side reads our compressor's parameters as the "server" ones */
+    ws_deflate_params_t q;
+    memset(&q, 0, sizeof(q));
+    q.enabled = 1;
+    q.server_max_window_bits = bits;
+    q.server_no_context_takeover = no_takeover;
+    ws_deflate_t* rx = ws_deflate_create(&q);
+    assert(tx && rx);
+
+    char msg[8192];
+    uint8_t comp[sizeof(msg) + WS_DEFLATE_TAIL];
+    uint8_t back[sizeof(msg)];
+    size_t first = 0, later = 0;
+    for (int i = 0; i < 50; i++) {
+        size_t n = make_book(msg, sizeof(msg), i, 40);
+        size_t clen = 0;
+        assert(ws_deflate_message(tx, (const uint8_t*)msg, n, comp, n + WS_DEFLATE_TAIL, &clen) == 0);
+        assert(clen > 0 && clen < n);
+        if (i == 0) first = clen;
+        if (i == 49) later = clen;
+        assert(inflate_split(rx, comp, clen, back, sizeof(back)) == n);
+        assert(memcmp(back, msg, n) == 0);
+
+        if (i == 20) {
+            /* Incompressible: refused, and the stream stays in step for the next message */
+            uint8_t noise[2048];
+            unsigned x = 12345;
+            for (size_t k = 0; k < sizeof(noise); k++) { x = x * 1103515245u + 12345u; noise[k] = (uint8_t)(x >> 24); }
+            assert(ws_deflate_message(tx, noise, sizeof(noise), comp, sizeof(noise) + WS_DEFLATE_TAIL, &clen) < 0);
+        }
+    }
+    /* Context takeover: later books refer back to earlier ones (given a window that holds one) */
+    if (!no_takeover && bits == 15) assert(later * 4 < first * 3);
+
+    /* Garbage is reported, not inflated */
+    ws_deflate_t* bad = ws_deflate_create(&q);
+    const uint8_t junk[8] = { 0xff, 0xff, 0xff, 0xff, 0x00, 0x01, 0x02, 0x03 };
+    size_t got = 0;
+    assert(ws_inflate_begin(bad, junk, sizeof(junk), 1) == 0);
+    assert(ws_inflate_more(bad, back, sizeof(back), &got) < 0);
+    ws_deflate_destroy(bad);
+
+    ws_deflate_destroy(tx);
+    ws_deflate_destroy(rx);
+}
+
+static void test_deflate_unit(void) {
+    roundtrip_unit(0, 15);
+    roundtrip_unit(1, 15);
+    roundtrip_unit(0, 9);
+    roundtrip_unit(1, 10);
+}
+
+static void echo_books(wibesocket_conn_t* c, int count, size_t min_ratio) {
+    char msg[4096];
+    size_t sent = 0;
+    int rsv1_before = atomic_load(&echo_rsv1_frames);
+    size_t wire_before = atomic_load(&echo_wire_bytes);
+    /* One corked burst, read back as batches: inflated payloads of a batch must all stay put */
+    assert(wibesocket_send_begin(c) == WIBESOCKET_OK);
+    for (int i = 0; i < count; i++) {
+        size_t n = make_book(msg, sizeof(msg), i, 30);
+        sent += n;
+        assert(wibesocket_send_text(c, msg, n) == WIBESOCKET_OK);
+    }
+    assert(wibesocket_send_commit(c) == WIBESOCKET_OK);
+    int got = 0;
+    while (got < count) {
+        wibesocket_message_t m[256];
+        size_t k = 0;
+        assert(wibesocket_recv_batch(c, m, 256, &k, 5000) == WIBESOCKET_OK);
+        for (size_t j = 0; j < k; j++, got++) {
+            size_t n = make_book(msg, sizeof(msg), got, 30);
+            assert(m[j].type == WIBESOCKET_FRAME_TEXT && m[j].is_final);
+            assert(m[j].payload_len == n && memcmp(m[j].payload, msg, n) == 0);
+        }
+        wibesocket_release_payload(c);
+    }
+    assert(atomic_load(&echo_rsv1_frames) - rsv1_before == count);
+    /* Bandwidth is the point: the wire carries a fraction of the JSON */
+    assert((atomic_load(&echo_wire_bytes) - wire_before) * min_ratio < sent);
+}
+
+static void test_echo_compressed(const echo_server_t* srv, wibesocket_io_backend_t backend) {
+    wibesocket_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.enable_compression = true;
+    cfg.max_frame_size = 8U << 20;
+    cfg.io_backend = backend;
+    wibesocket_conn_t* c = echo_connect(srv, "/deflate", &cfg);
+    assert(c && wibesocket_compression_negotiated(c));
+    echo_books(c, 300, 4);
+
+    /* Below the threshold and incompressible data both go out plain */
+    int rsv1_before = atomic_load(&echo_rsv1_frames);
+    wibesocket_message_t m;
+    assert(wibesocket_send_text(c, "tiny", 4) == WIBESOCKET_OK);
+    assert(wibesocket_recv(c, &m, 5000) == WIBESOCKET_OK);
+    assert(m.payload_len == 4 && memcmp(m.payload, "tiny", 4) == 0);
+    wibesocket_release_payload(c);
+    uint8_t noise[4096];
+    unsigned x = 777;
+    for (size_t k = 0; k < sizeof(noise); k++) { x = x * 1103515245u + 12345u; noise[k] = (uint8_t)(x >> 24); }
+    assert(wibesocket_send_binary(c, noise, sizeof(noise)) == WIBESOCKET_OK);
+    assert(wibesocket_recv(c, &m, 5000) == WIBESOCKET_OK);
+    assert(m.type == WIBESOCKET_FRAME_BINARY && m.payload_len == sizeof(noise));
+    assert(memcmp(m.payload, noise, sizeof(noise)) == 0);
+    wibesocket_release_payload(c);
+    assert(atomic_load(&echo_rsv1_frames) == rsv1_before);
+
+    /* A message far larger than the receive ring and the first inflate buffer */
+    size_t big = 3U << 20;
+    char* text = (char*)malloc(big);
+    for (size_t i = 0; i < big; i++) text[i] = (char)('a' + (i * 7 / 13) % 26);
+    assert(wibesocket_send_text(c, text, big) == WIBESOCKET_OK);
+    assert(wibesocket_recv(c, &m, 10000) == WIBESOCKET_OK);
+    assert(m.payload_len == big && memcmp(m.payload, text, big) == 0);
+    wibesocket_release_payload(c);
+    assert(atomic_load(&echo_rsv1_frames) == rsv1_before + 1);
+    free(text);
+    wibesocket_close(c);
+}
+
+static void test_echo_tuned(const echo_server_t* srv) {
+    wibesocket_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.enable_compression = true;
+    cfg.compression_client_no_context_takeover = true;
+    cfg.compression_server_no_context_takeover = true;
+    cfg.compression_threshold = 16;
+    wibesocket_conn_t* c = echo_connect(srv, "/deflate&client_no_context_takeover&server_no_context_takeover", &cfg);
+    assert(c && wibesocket_compression_negotiated(c));
+    echo_books(c, 100, 2);
+    wibesocket_close(c);
+
+    /* The server shrinks both windows */
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.enable_compression = true;
+    cfg.compression_server_max_window_bits = 12;
+    c = echo_connect(srv, "/deflate&client_max_window_bits=10&server_max_window_bits=10", &cfg);
+    assert(c && wibesocket_compression_negotiated(c));
+    echo_books(c, 100, 2);
+    wibesocket_close(c);
+
+    /* A window above the one asked for is refused */
+    c = echo_connect(srv, "/deflate&server_max_window_bits=14", &cfg);
+    assert(c == NULL);
+}
+
+static void test_echo_declined(const echo_server_t* srv) {
+    wibesocket_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.enable_compression = true;
+    wibesocket_conn_t* c = echo_connect(srv, "/", &cfg);
+    assert(c && !wibesocket_compression_negotiated(c));
+    int rsv1_before = atomic_load(&echo_rsv1_frames);
+    char msg[4096];
+    size_t n = make_book(msg, sizeof(msg), 1, 30);
+    wibesocket_message_t m;
+    assert(wibesocket_send_text(c, msg, n) == WIBESOCKET_OK);
+    assert(wibesocket_recv(c, &m, 5000) == WIBESOCKET_OK);
+    assert(m.payload_len == n && memcmp(m.payload, msg, n) == 0);
+    wibesocket_release_payload(c);
+    assert(atomic_load(&echo_rsv1_frames) == rsv1_before);
+    wibesocket_close(c);
+
+    /* Compression off: nothing is offered, so even a willing server leaves it off */
+    cfg.enable_compression = false;
+    c = echo_connect(srv, "/deflate", &cfg);
+    assert(c && !wibesocket_compression_negotiated(c));
+    wibesocket_close(c);
+}
+
+int main(void) {
+    test_deflate_unit();
+    echo_server_t srv;
+    assert(echo_server_start(&srv) == 0);
+    test_echo_compressed(&srv, WIBESOCKET_IO_EPOLL);
+    test_echo_compressed(&srv, WIBESOCKET_IO_URING);
+    test_echo_tuned(&srv);
+    test_echo_declined(&srv);
+    printf("test_deflate OK\n");
+    return 0;
+}
@@ -0,0 +1,270 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "wibesocket/wibesocket.h"
+#include "wibesocket/event_loop.h"
+#include "echo_helper.h"
+
+#define N_CONNS 8
+#define N_MSGS  3
+
+typedef struct {
+    int    id;
+    int    received;
+    int    writable_events;
+    size_t big_len;  /* expected payload length if this connection sent the big message */
+    int    close_when_done;
+} conn_state_t;
+
+static int g_done;
+
+static uint64_t now_ms(void) {
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)(ts.tv_nsec / 1000000ULL);
+}
+
+/* Takes at most one message per callback, relying on the loop to call again for the rest */
+static void on_event(wibesocket_loop_t* loop, wibesocket_conn_t* conn, uint32_t events, void* ud) {
+    conn_state_t* st = (conn_state_t*)ud;
+    (void)loop;
+    if (events & WIBESOCKET_EVENT_WRITABLE) st->writable_events++;
+    if (!(events & WIBESOCKET_EVENT_READABLE)) return;
+    wibesocket_message_t m;
+    if (wibesocket_recv(conn, &m, 0) != WIBESOCKET_OK) return;
+    if (st->big_len) {
+        assert(m.payload_len == st->big_len);
+        for (size_t i = 0; i < m.payload_len; i++) assert(((const uint8_t*)m.payload)[i] == (uint8_t)(i * 7));
+    } else {
+        char want[32]; int n = snprintf(want, sizeof(want), "conn-%d-msg-%d", st->id, st->received);
+        assert(m.payload_len == (size_t)n && memcmp(m.payload, want, (size_t)n) == 0);
+    }
+    wibesocket_release_payload(conn);
+    st->received++;
+    int target = st->big_len ? 1 : N_MSGS;
+    if (st->received == target) {
+        g_done++;
+        if (st->close_when_done) (void)wibesocket_close(conn);
+    }
+}
+
+static void test_loop_args(void) {
+    wibesocket_loop_t* loop = wibesocket_loop_create();
+    assert(loop);
+    assert(wibesocket_loop_add(NULL, NULL, on_event, NULL) == WIBESOCKET_ERROR_INVALID_ARGS);
+    assert(wibesocket_loop_add(loop, NULL, on_event, NULL) == WIBESOCKET_ERROR_INVALID_ARGS);
+    assert(wibesocket_loop_remove(loop, NULL) == WIBESOCKET_ERROR_INVALID_ARGS);
+    assert(wibesocket_loop_run_once(loop, 0) == 0);
+    wibesocket_loop_destroy(loop);
+}
+
+static void test_loop_many_connections(const echo_server_t* srv) {
+    const char* uri = srv->uri;
+    char hold_uri[80]; snprintf(hold_uri, sizeof(hold_uri), "%shold", srv->uri);
+    wibesocket_loop_t* loop = wibesocket_loop_create();
+    wibesocket_conn_t* conns[N_CONNS];
+    conn_state_t st[N_CONNS];
+    wibesocket_config_t cfg; memset(&cfg, 0, sizeof(cfg));
+    cfg.max_frame_size = 8U << 20;
+    g_done = 0;
+    for (int i = 0; i < N_CONNS; i++) {
+        memset(&st[i], 0, sizeof(st[i]));
+        st[i].id = i;
+        st[i].close_when_done = (i == 0);
+        conns[i] = wibesocket_connect(i == N_CONNS - 1 ? hold_uri : uri, &cfg);
+        assert(conns[i]);
+        assert(wibesocket_loop_add(loop, conns[i], on_event, &st[i]) == WIBESOCKET_OK);
+        assert(wibesocket_loop_add(loop, conns[i], on_event, &st[i]) == WIBESOCKET_ERROR_INVALID_ARGS);
+    }
+    /* The last connection pushes a payload far larger than the socket buffers to a peer that
+     * is not reading yet, so its send queue is only drained by WRITABLE events */
+    atomic_store(&echo_hold, 1);
+    static uint8_t big[6U << 20];
+    for (size_t i = 0; i < sizeof(big); i++) big[i] = (uint8_t)(i * 7);
+    st[N_CONNS - 1].big_len = sizeof(big);
+    assert(wibesocket_send_binary(conns[N_CONNS - 1], big, sizeof(big)) == WIBESOCKET_OK);
+    assert(wibesocket_get_buffered_amount(conns[N_CONNS - 1]) > 0);
+    atomic_store(&echo_hold, 0);
+    for (int i = 0; i < N_CONNS - 1; i++) {
+        for (int k = 0; k < N_MSGS; k++) {
+            char msg[32]; int n = snprintf(msg, sizeof(msg), "conn-%d-msg-%d", i, k);
+            assert(wibesocket_send_text(conns[i], msg, (size_t)n) == WIBESOCKET_OK);
+        }
+    }
+    uint64_t deadline = now_ms() + 10000;
+    while (g_done < N_CONNS && now_ms() < deadline) assert(wibesocket_loop_run_once(loop, 100) >= 0);
+    assert(g_done == N_CONNS);
+    assert(st[N_CONNS - 1].writable_events > 0);
+
+    /* conns[0] closed itself inside its callback; detach one and keep using it standalone */
+    assert(wibesocket_loop_remove(loop, conns[0]) == WIBESOCKET_ERROR_INVALID_ARGS);
+    assert(wibesocket_loop_remove(loop, conns[1]) == WIBESOCKET_OK);
+    assert(wibesocket_send_text(conns[1], "after", 5) == WIBESOCKET_OK);
+    wibesocket_message_t m;
+    assert(wibesocket_recv(conns[1], &m, 2000) == WIBESOCKET_OK);
+    assert(m.payload_len == 5 && memcmp(m.payload, "after", 5) == 0);
+    wibesocket_release_payload(conns[1]);
+
+    /* Destroying the loop detaches the rest; closing them afterwards must still work */
+    wibesocket_loop_destroy(loop);
+    for (int i = 1; i < N_CONNS; i++) assert(wibesocket_close(conns[i]) == WIBESOCKET_OK);
+}
+
+typedef struct {
+    int connected;
+    int echoed;
+    int failed;
+    wibesocket_error_t error;
+} async_state_t;
+
+static void on_async(wibesocket_loop_t* loop, wibesocket_conn_t* conn, uint32_t events, void* ud) {
+    async_state_t* st = (async_state_t*)ud;
+    (void)loop;
+    if (events & WIBESOCKET_EVENT_CONNECTED) {
+        assert(wibesocket_get_state(conn) == WIBESOCKET_STATE_OPEN);
+        st->connected = 1;
+        assert(wibesocket_send_text(conn, "async", 5) == WIBESOCKET_OK);
+    }
+    if ((events & WIBESOCKET_EVENT_ERROR) && wibesocket_get_state(conn) == WIBESOCKET_STATE_ERROR) {
+        st->failed = 1;
+        st->error = wibesocket_get_error(conn);
+        g_done++;
+        return;
+    }
+    if (!(events & WIBESOCKET_EVENT_READABLE)) return;
+    wibesocket_message_t m;
+    while (wibesocket_recv(conn, &m, 0) == WIBESOCKET_OK) {
+        assert(m.payload_len == 5 && memcmp(m.payload, "async", 5) == 0);
+        wibesocket_release_payload(conn);
+        st->echoed++;
+        g_done++;
+    }
+}
+
+/* Many handshakes in flight on one thread, plus one that never gets an answer */
+static void test_loop_async_connect(const echo_server_t* srv) {
+    enum { N = 16 };
+    wibesocket_loop_t* loop = wibesocket_loop_create();
+    wibesocket_conn_t* conns[N + 1];
+    async_state_t st[N + 1];
+    memset(st, 0, sizeof(st));
+    g_done = 0;
+    for (int i = 0; i < N; i++) {
+        char uri[64];
+        /* half by name to take the resolver path */
+        snprintf(uri, sizeof(uri), "ws://%s:%d/", (i & 1) ? "localhost" : "127.0.0.1", srv->port);
+        conns[i] = wibesocket_connect_start(uri, NULL);
+        assert(conns[i]);
+        assert(wibesocket_get_state(conns[i]) == WIBESOCKET_STATE_CONNECTING);
+        assert(wibesocket_loop_add(loop, conns[i], on_async, &st[i]) == WIBESOCKET_OK);
+    }
+    /* A listener that is never accepted from: TCP completes, the 101 never comes */
+    int silent = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in a; memset(&a, 0, sizeof(a));
+    a.sin_family = AF_INET; a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t al = sizeof(a);
+    assert(bind(silent, (struct sockaddr*)&a, sizeof(a)) == 0 && listen(silent, 4) == 0);
+    assert(getsockname(silent, (struct sockaddr*)&a, &al) == 0);
+    char uri[64]; snprintf(uri, sizeof(uri), "ws://127.0.0.1:%d/", ntohs(a.sin_port));
+    wibesocket_config_t cfg; memset(&cfg, 0, sizeof(cfg));
+    cfg.handshake_timeout_ms = 200;
+    conns[N] = wibesocket_connect_start(uri, &cfg);
+    assert(conns[N] && wibesocket_loop_add(loop, conns[N], on_async, &st[N]) == WIBESOCKET_OK);
+
+    uint64_t start = now_ms();
+    while (g_done < N + 1 && now_ms() - start < 5000) assert(wibesocket_loop_run_once(loop, -1) >= 0);
+    assert(g_done == N + 1);
+    for (int i = 0; i < N; i++) assert(st[i].connected && st[i].echoed == 1 && !st[i].failed);
+    assert(st[N].failed && st[N].error == WIBESOCKET_ERROR_TIMEOUT);
+    assert(wibesocket_connect_step(conns[N]) == WIBESOCKET_ERROR_TIMEOUT);
+
+    for (int i = 0; i <= N; i++) assert(wibesocket_close(conns[i]) == WIBESOCKET_OK);
+    wibesocket_loop_destroy(loop);
+    close(silent);
+}
+
+typedef struct {
+    int    drained;
+    size_t got_bytes;
+    int    got_msgs;
+} bp_state_t;
+
+static void on_bp(wibesocket_loop_t* loop, wibesocket_conn_t* conn, uint32_t events, void* ud) {
+    bp_state_t* st = (bp_state_t*)ud;
+    (void)loop;
+    if (events & WIBESOCKET_EVENT_DRAINED) st->drained++;
+    wibesocket_message_t m;
+    while (wibesocket_recv(conn, &m, 0) == WIBESOCKET_OK) {
+        st->got_bytes += m.payload_len;
+        st->got_msgs++;
+        wibesocket_release_payload(conn);
+    }
+}
+
+/* A payload bigger than the socket buffers, to a peer that is not reading yet, leaves a
+ * backlog above the high mark */
+static void test_backpressure(const echo_server_t* srv) {
+    char uri[80]; snprintf(uri, sizeof(uri), "%shold", srv->uri);
+    static uint8_t big[8U << 20];
+    wibesocket_config_t cfg; memset(&cfg, 0, sizeof(cfg));
+    cfg.max_frame_size = 16U << 20;
+    cfg.send_high_watermark = 256U << 10;
+    cfg.send_low_watermark = 64U << 10;
+
+    /* Standalone: refuse, then wait for the low mark */
+    atomic_store(&echo_hold, 1);
+    wibesocket_conn_t* c = wibesocket_connect(uri, &cfg);
+    assert(c);
+    assert(wibesocket_get_buffered_amount(c) == 0);
+    assert(wibesocket_send_binary(c, big, sizeof(big)) == WIBESOCKET_OK);
+    assert(wibesocket_get_buffered_amount(c) > cfg.send_high_watermark);
+    assert(wibesocket_send_binary(c, big, 1024) == WIBESOCKET_ERROR_BUFFER_FULL);
+    assert(wibesocket_post_send(c, WIBESOCKET_FRAME_BINARY, big, 1024) == WIBESOCKET_OK); /* first posted frame */
+    assert(wibesocket_wait_writable(c, 50) == WIBESOCKET_ERROR_TIMEOUT);
+    atomic_store(&echo_hold, 0);
+    assert(wibesocket_wait_writable(c, 5000) == WIBESOCKET_OK);
+    assert(wibesocket_get_buffered_amount(c) <= cfg.send_low_watermark);
+    wibesocket_message_t m;
+    assert(wibesocket_recv(c, &m, 5000) == WIBESOCKET_OK && m.payload_len == sizeof(big));
+    wibesocket_release_payload(c);
+    assert(wibesocket_recv(c, &m, 5000) == WIBESOCKET_OK && m.payload_len == 1024);
+    wibesocket_release_payload(c);
+    assert(wibesocket_close(c) == WIBESOCKET_OK);
+
+    /* In a loop: the drop to the low mark arrives as DRAINED, once */
+    wibesocket_loop_t* loop = wibesocket_loop_create();
+    atomic_store(&echo_hold, 1);
+    c = wibesocket_connect(uri, &cfg);
+    assert(c);
+    bp_state_t st; memset(&st, 0, sizeof(st));
+    assert(wibesocket_loop_add(loop, c, on_bp, &st) == WIBESOCKET_OK);
+    assert(wibesocket_send_binary(c, big, sizeof(big)) == WIBESOCKET_OK);
+    assert(wibesocket_send_text(c, "x", 1) == WIBESOCKET_ERROR_BUFFER_FULL);
+    for (int i = 0; i < 5; i++) assert(wibesocket_loop_run_once(loop, 10) >= 0);
+    assert(st.drained == 0);
+    atomic_store(&echo_hold, 0);
+    uint64_t deadline = now_ms() + 5000;
+    while (!st.drained && now_ms() < deadline) assert(wibesocket_loop_run_once(loop, 100) >= 0);
+    assert(st.drained == 1);
+    assert(wibesocket_send_text(c, "x", 1) == WIBESOCKET_OK);
+    while (st.got_msgs < 2 && now_ms() < deadline) assert(wibesocket_loop_run_once(loop, 100) >= 0);
+    assert(st.got_msgs == 2 && st.got_bytes == sizeof(big) + 1);
+    assert(st.drained == 1);
+    assert(wibesocket_close(c) == WIBESOCKET_OK);
+    wibesocket_loop_destroy(loop);
+}
+
+int main(void) {
+    test_loop_args();
+    echo_server_t srv;
+    if (echo_server_start(&srv) == 0) {
+        test_loop_many_connections(&srv);
+        test_loop_async_connect(&srv);
+        test_backpressure(&srv);
+    } else {
+        fprintf(stderr, "[skip] cannot listen on loopback\n");
+    }
+    printf("test_event_loop OK\n");
+    return 0;
+}
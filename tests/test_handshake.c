@@ -17,7 +17,7 @@ static void test_accept_known_vector(void) {
 
 static void test_request_build_minimal(void) {
     char req[512];
-    int n = ws_build_handshake_request("example.com", 80, "/chat", "abcd", NULL, NULL, NULL, req, sizeof(req));
+    int n = ws_build_handshake_request("example.com", 80, "/chat", "abcd", NULL, NULL, NULL, NULL, req, sizeof(req));
     assert(n > 0);
     const char* must[] = {
         "GET /chat HTTP/1.1\r\n",
@@ -58,11 +58,262 @@ static void test_validate_response_fail(void) {
     assert(ws_validate_handshake_response(resp_bad, accept) != 0);
 }
 
+static void test_request_with_extensions(void) {
+    char req[512];
+    ws_deflate_params_t offer;
+    memset(&offer, 0, sizeof(offer));
+    offer.enabled = 1;
+    offer.client_max_window_bits = 15;
+    char ext[160];
+    assert(ws_format_deflate_offer(&offer, ext, sizeof(ext)) > 0);
+    assert(strcmp(ext, "permessage-deflate; client_max_window_bits") == 0);
+    offer.client_max_window_bits = 10;
+    offer.server_max_window_bits = 12;
+    offer.client_no_context_takeover = 1;
+    offer.server_no_context_takeover = 1;
+    assert(ws_format_deflate_offer(&offer, ext, 20) < 0);
+    assert(ws_format_deflate_offer(&offer, ext, sizeof(ext)) > 0);
+    assert(strcmp(ext, "permessage-deflate; client_max_window_bits=10; server_max_window_bits=12; "
+                       "client_no_context_takeover; server_no_context_takeover") == 0);
+    int n = ws_build_handshake_request("example.com", 80, "/", "abcd", NULL, NULL, NULL, ext, req, sizeof(req));
+    assert(n > 0);
+    assert(strstr(req, "Sec-WebSocket-Extensions: permessage-deflate; client_max_window_bits=10;"));
+}
+
+static const char* deflate_resp(char* buf, size_t cap, const char* ext) {
+    snprintf(buf, cap, "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n"
+             "Connection: Upgrade\r\n%s%s%s\r\n", ext ? "Sec-WebSocket-Extensions: " : "",
+             ext ? ext : "", ext ? "\r\n" : "");
+    return buf;
+}
+
+static void test_deflate_negotiation(void) {
+    char buf[512];
+    ws_deflate_params_t offer, agreed;
+    memset(&offer, 0, sizeof(offer));
+    offer.enabled = 1;
+    offer.client_max_window_bits = 15;
+
+    /* Declined: no header */
+    assert(ws_negotiate_deflate(deflate_resp(buf, sizeof(buf), NULL), &offer, &agreed) == 0);
+    assert(!agreed.enabled);
+    /* Accepted with defaults */
+    assert(ws_negotiate_deflate(deflate_resp(buf, sizeof(buf), "permessage-deflate"), &offer, &agreed) == 0);
+    assert(agreed.enabled && agreed.client_max_window_bits == 15 && agreed.server_max_window_bits == 15);
+    assert(!agreed.client_no_context_takeover && !agreed.server_no_context_takeover);
+    /* Parameters, any case, quoted value */
+    assert(ws_negotiate_deflate(deflate_resp(buf, sizeof(buf),
+           "Permessage-Deflate; Server_No_Context_Takeover; client_max_window_bits=\"10\"; "
+           "server_max_window_bits=11"), &offer, &agreed) == 0);
+    assert(agreed.server_no_context_takeover && agreed.client_max_window_bits == 10 &&
+           agreed.server_max_window_bits == 11);
+    /* Our own limits hold even when the server says nothing about them */
+    offer.client_max_window_bits = 12;
+    offer.client_no_context_takeover = 1;
+    assert(ws_negotiate_deflate(deflate_resp(buf, sizeof(buf), "permessage-deflate"), &offer, &agreed) == 0);
+    assert(agreed.client_max_window_bits == 12 && agreed.client_no_context_takeover);
+
+    /* Rejected responses */
+    const char* bad[] = {
+        "x-webkit-deflate-frame",
+        "permessage-deflate, permessage-deflate",
+        "permessage-deflate; server_max_window_bits",
+        "permessage-deflate; server_max_window_bits=16",
+        "permessage-deflate; client_max_window_bits=8",
+        "permessage-deflate; server_no_context_takeover; server_no_context_takeover",
+        "permessage-deflate; client_no_context_takeover=1",
+        "permessage-deflate; unknown_param",
+    };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        assert(ws_negotiate_deflate(deflate_resp(buf, sizeof(buf), bad[i]), &offer, &agreed) != 0);
+    }
+    /* A server window above what was asked for */
+    offer.server_max_window_bits = 10;
+    assert(ws_negotiate_deflate(deflate_resp(buf, sizeof(buf), "permessage-deflate; server_max_window_bits=12"),
+                                &offer, &agreed) != 0);
+    /* Nothing offered: any extension in the response fails the handshake */
+    assert(ws_negotiate_deflate(deflate_resp(buf, sizeof(buf), "permessage-deflate"), NULL, &agreed) != 0);
+    assert(ws_negotiate_deflate(deflate_resp(buf, sizeof(buf), NULL), NULL, &agreed) == 0);
+}
+
+/* The template plus its key is byte-for-byte the built request */
+static void test_request_template(void) {
+    const char* key = "dGhlIHNhbXBsZSBub25jZQ==";
+    char built[512], tmpl[512];
+    int n = ws_build_handshake_request("example.com", 9001, "/chat?x=1", key, "ua/1", "http://o",
+                                       "chat, superchat", "permessage-deflate", built, sizeof(built));
+    size_t key_off = 0;
+    int m = ws_build_handshake_template("example.com", 9001, "/chat?x=1", "ua/1", "http://o",
+                                        "chat, superchat", "permessage-deflate", tmpl, sizeof(tmpl), &key_off);
+    assert(n > 0 && m == n);
+    ws_handshake_set_key(tmpl, key_off, key);
+    assert(memcmp(built, tmpl, (size_t)n) == 0 && tmpl[n] == 0);
+    assert(strstr(built, "Host: example.com:9001\r\n") && strstr(built, "Sec-WebSocket-Protocol: chat, superchat\r\n"));
+    /* Capacity includes the terminating NUL */
+    assert(ws_build_handshake_template("example.com", 9001, "/chat?x=1", "ua/1", "http://o", "chat, superchat",
+                                       "permessage-deflate", tmpl, (size_t)n, &key_off) < 0);
+}
+
+static const char* full_resp =
+    "HTTP/1.1 101 Switching Protocols\r\n"
+    "upgrade: WebSocket\r\n"
+    "Connection: keep-alive, Upgrade\r\n"
+    "X-Other: ignored\r\n"
+    "SEC-WEBSOCKET-ACCEPT:s3pPLMBiTxaQ9kYGzzhZRbK+xOo=  \r\n"
+    "Sec-WebSocket-Protocol: superchat\r\n"
+    "Sec-WebSocket-Extensions: permessage-deflate\r\n"
+    "\r\n";
+
+/* Feeding a byte at a time, or in uneven reads, ends on the blank line with the same values;
+ * whatever follows it is left alone */
+static void test_response_incremental(void) {
+    const char* accept = "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=";
+    char buf[512];
+    size_t hdr = strlen(full_resp);
+    memcpy(buf, full_resp, hdr);
+    memcpy(buf + hdr, "\x81\x02hi", 4);
+    static const size_t steps[] = { 1, 7, 64 };
+    for (size_t s = 0; s < sizeof(steps) / sizeof(steps[0]); s++) {
+        ws_http_response_t r;
+        ws_http_response_init(&r);
+        size_t off = 0, used = 0;
+        ws_http_status_t st = WS_HTTP_NEED_MORE;
+        while (st == WS_HTTP_NEED_MORE) {
+            size_t n = hdr + 4 - off < steps[s] ? hdr + 4 - off : steps[s];
+            assert(n > 0);
+            st = ws_http_response_feed(&r, buf + off, n, &used);
+            off += used;
+        }
+        assert(st == WS_HTTP_DONE && off == hdr);
+        assert(ws_http_response_check(&r, accept, "chat, superchat") == 0);
+        assert(strcmp(ws_http_response_value(&r, WS_HTTP_ACCEPT), accept) == 0);
+        assert(strcmp(ws_http_response_value(&r, WS_HTTP_PROTOCOL), "superchat") == 0);
+        assert(strcmp(ws_http_response_value(&r, WS_HTTP_EXTENSIONS), "permessage-deflate") == 0);
+        assert(ws_http_response_value(&r, WS_HTTP_UPGRADE) == NULL);
+        /* Further input is not taken */
+        assert(ws_http_response_feed(&r, buf + hdr, 4, &used) == WS_HTTP_DONE && used == 0);
+        /* The subprotocol must be one that was asked for, with its exact spelling */
+        assert(ws_http_response_check(&r, accept, NULL) != 0);
+        assert(ws_http_response_check(&r, accept, "chat") != 0);
+        assert(ws_http_response_check(&r, accept, "SuperChat") != 0);
+    }
+}
+
+static void test_response_rejects(void) {
+    const char* accept = "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=";
+    const char* bad[] = {
+        "HTTP/1.0 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+        "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n\r\n",
+        "HTTP/1.1 200 OK\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+        "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n\r\n",
+        "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websockets\r\nConnection: Upgrade\r\n"
+        "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n\r\n",
+        "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n"
+        "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n\r\n",
+        /* Repeated accept, folded line, line without a colon */
+        "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+        "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n"
+        "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n\r\n",
+        "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection:\r\n Upgrade\r\n"
+        "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n\r\n",
+        "HTTP/1.1 101 Switching Protocols\r\nUpgrade websocket\r\nConnection: Upgrade\r\n"
+        "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n\r\n",
+    };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        assert(ws_validate_handshake_response(bad[i], accept) != 0);
+    }
+
+    /* Captured values are bounded; so is the header block as a whole */
+    static char big[WS_HTTP_MAX_HEADER + 64];
+    int n = snprintf(big, sizeof(big), "HTTP/1.1 101 Switching Protocols\r\nSec-WebSocket-Extensions: ");
+    memset(big + n, 'x', WS_HTTP_VALUES);
+    strcpy(big + n + WS_HTTP_VALUES, "\r\n\r\n");
+    ws_http_response_t r;
+    size_t used;
+    ws_http_response_init(&r);
+    assert(ws_http_response_feed(&r, big, strlen(big), &used) == WS_HTTP_ERROR);
+    n = snprintf(big, sizeof(big), "HTTP/1.1 101 Switching Protocols\r\nX-Pad: ");
+    memset(big + n, 'x', WS_HTTP_MAX_HEADER);
+    strcpy(big + n + WS_HTTP_MAX_HEADER, "\r\n\r\n");
+    ws_http_response_init(&r);
+    assert(ws_http_response_feed(&r, big, strlen(big), &used) == WS_HTTP_ERROR);
+    /* ... and an error sticks */
+    assert(ws_http_response_feed(&r, "\r\n", 2, &used) == WS_HTTP_ERROR);
+}
+
+/* Server side: the request read a byte at a time, protocol selection, and the reply */
+static void test_request_server_side(void) {
+    const char* req =
+        "GET /chat?room=1 HTTP/1.1\r\n"
+        "Host: example.com\r\n"
+        "Upgrade: WebSocket\r\n"
+        "Connection: keep-alive, Upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+        "Sec-WebSocket-Version: 13\r\n"
+        "Sec-WebSocket-Protocol: chat.v2, chat\r\n"
+        "\r\n";
+    ws_http_response_t r;
+    ws_http_request_init(&r);
+    size_t used = 0, n = strlen(req);
+    for (size_t i = 0; i + 1 < n; i++) {
+        assert(ws_http_response_feed(&r, req + i, 1, &used) == WS_HTTP_NEED_MORE && used == 1);
+    }
+    assert(ws_http_response_feed(&r, req + n - 1, 1, &used) == WS_HTTP_DONE);
+    char accept[29];
+    assert(ws_http_request_check(&r, accept) == 0);
+    assert(strcmp(accept, "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") == 0);
+
+    size_t plen = 0;
+    const char* offered = ws_http_response_value(&r, WS_HTTP_PROTOCOL);
+    const char* p = ws_select_protocol(offered, "chat, other", &plen);
+    assert(p && plen == 4 && memcmp(p, "chat", 4) == 0);
+    assert(ws_select_protocol(offered, "Chat", &plen) == NULL);
+    assert(ws_select_protocol(NULL, "chat", &plen) == NULL);
+
+    char out[256];
+    int len = ws_build_handshake_reply(accept, p, plen, out, sizeof(out));
+    assert(len > 0 && (size_t)len == strlen(out));
+    ws_http_response_t back;
+    ws_http_response_init(&back);
+    assert(ws_http_response_feed(&back, out, (size_t)len, &used) == WS_HTTP_DONE && used == (size_t)len);
+    assert(ws_http_response_check(&back, accept, offered) == 0);
+    assert(strcmp(ws_http_response_value(&back, WS_HTTP_PROTOCOL), "chat") == 0);
+    assert(ws_build_handshake_reply(accept, NULL, 0, out, 40) < 0);
+
+    /* Not an upgrade: other methods and versions, a missing or short key, another version */
+    const char* bad[] = {
+        "POST / HTTP/1.1\r\n\r\n",
+        "GET / HTTP/1.0\r\n\r\n",
+        "GET / HTTP/1.1\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Version: 13\r\n\r\n",
+        "GET / HTTP/1.1\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Key: abcd\r\n"
+        "Sec-WebSocket-Version: 13\r\n\r\n",
+        "GET / HTTP/1.1\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 8\r\n\r\n",
+        "GET / HTTP/1.1\r\nConnection: Upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n",
+    };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        ws_http_request_init(&r);
+        if (ws_http_response_feed(&r, bad[i], strlen(bad[i]), &used) == WS_HTTP_DONE) {
+            assert(ws_http_request_check(&r, accept) < 0);
+        }
+    }
+    /* A response is not a request */
+    ws_http_request_init(&r);
+    assert(ws_http_response_feed(&r, out, (size_t)len, &used) == WS_HTTP_ERROR);
+}
+
 int main(void) {
     test_accept_known_vector();
     test_request_build_minimal();
     test_validate_response_ok();
     test_validate_response_fail();
+    test_request_with_extensions();
+    test_deflate_negotiation();
+    test_request_template();
+    test_response_incremental();
+    test_response_rejects();
+    test_request_server_side();
     printf("test_handshake OK\n");
     return 0;
 }
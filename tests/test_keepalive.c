@@ -0,0 +1,198 @@
+/* Control frames and connection timers: pings answered inside recv, round trip timing,
+ * keepalive pings, the idle limit and the close handshake timeout, both inside a loop (driven
+ * by its timer wheel) and standalone (driven by wibesocket_recv). The echo server answers
+ * pings; its /pinger path pings us, its /mute path never answers anything. */
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "wibesocket/wibesocket.h"
+#include "wibesocket/event_loop.h"
+#include "echo_helper.h"
+
+static uint64_t now_ms(void) {
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)(ts.tv_nsec / 1000000ULL);
+}
+
+typedef struct {
+    int errors;
+    int messages;
+} timer_state_t;
+
+/* Drains whatever arrives and counts failures */
+static void on_event(wibesocket_loop_t* loop, wibesocket_conn_t* conn, uint32_t events, void* ud) {
+    timer_state_t* st = (timer_state_t*)ud;
+    (void)loop;
+    if (events & WIBESOCKET_EVENT_ERROR) st->errors++;
+    if (!(events & WIBESOCKET_EVENT_READABLE)) return;
+    wibesocket_message_t m;
+    while (wibesocket_recv(conn, &m, 0) == WIBESOCKET_OK) {
+        st->messages++;
+        wibesocket_release_payload(conn);
+    }
+}
+
+static void run_for(wibesocket_loop_t* loop, uint64_t ms, const timer_state_t* stop_on_error) {
+    uint64_t end = now_ms() + ms;
+    for (uint64_t now; (now = now_ms()) < end; ) {
+        if (stop_on_error && stop_on_error->errors) return;
+        assert(wibesocket_loop_run_once(loop, (int)(end - now)) >= 0);
+    }
+}
+
+static void test_control_frames(const echo_server_t* srv) {
+    /* Every echo comes behind a PING: recv answers it and goes on to the data, same call */
+    wibesocket_conn_t* c = echo_connect(srv, "/pinger", NULL);
+    assert(c);
+    int pongs = atomic_load(&echo_pongs);
+    for (int i = 0; i < 50; i++) {
+        char msg[32];
+        int n = snprintf(msg, sizeof(msg), "msg-%d", i);
+        wibesocket_message_t m;
+        assert(wibesocket_send_text(c, msg, (size_t)n) == WIBESOCKET_OK);
+        assert(wibesocket_recv(c, &m, 5000) == WIBESOCKET_OK);
+        assert(m.type == WIBESOCKET_FRAME_TEXT && m.payload_len == (size_t)n);
+        assert(memcmp(m.payload, msg, (size_t)n) == 0);
+        wibesocket_release_payload(c);
+    }
+    /* The server reads each PONG before the next message */
+    assert(atomic_load(&echo_pongs) - pongs >= 49);
+    wibesocket_close(c);
+
+    /* Our PING: its PONG never surfaces, it times the round trip */
+    c = wibesocket_connect(srv->uri, NULL);
+    assert(c);
+    assert(wibesocket_get_rtt_us(c) == 0);
+    assert(wibesocket_send_ping(c, "t", 1) == WIBESOCKET_OK);
+    wibesocket_message_t m;
+    assert(wibesocket_recv(c, &m, 100) == WIBESOCKET_ERROR_TIMEOUT);
+    uint64_t rtt = wibesocket_get_rtt_us(c);
+    assert(rtt > 0 && rtt < 100000);
+    wibesocket_close(c);
+}
+
+static void test_keepalive_loop(const echo_server_t* srv) {
+    wibesocket_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.ping_interval_ms = 30;
+    cfg.idle_timeout_ms = 100; /* the pongs keep it alive */
+    wibesocket_conn_t* c = wibesocket_connect(srv->uri, &cfg);
+    assert(c);
+    wibesocket_loop_t* loop = wibesocket_loop_create();
+    timer_state_t st = {0, 0};
+    assert(wibesocket_loop_add(loop, c, on_event, &st) == WIBESOCKET_OK);
+    int before = atomic_load(&echo_pings);
+    run_for(loop, 400, NULL);
+    assert(st.errors == 0);
+    assert(wibesocket_get_state(c) == WIBESOCKET_STATE_OPEN);
+    int pings = atomic_load(&echo_pings) - before;
+    assert(pings >= 5 && pings <= 20);
+
+    /* Without pings, the silent echo server trips the idle limit */
+    wibesocket_close(c);
+    cfg.ping_interval_ms = 0;
+    c = wibesocket_connect(srv->uri, &cfg);
+    assert(c);
+    assert(wibesocket_loop_add(loop, c, on_event, &st) == WIBESOCKET_OK);
+    uint64_t start = now_ms();
+    run_for(loop, 2000, &st);
+    assert(st.errors == 1);
+    assert(now_ms() - start >= 90);
+    assert(wibesocket_get_state(c) == WIBESOCKET_STATE_ERROR);
+    assert(wibesocket_get_error(c) == WIBESOCKET_ERROR_TIMEOUT);
+    wibesocket_close(c);
+    wibesocket_loop_destroy(loop);
+}
+
+static void test_keepalive_standalone(const echo_server_t* srv) {
+    wibesocket_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.ping_interval_ms = 30;
+    wibesocket_conn_t* c = wibesocket_connect(srv->uri, &cfg);
+    assert(c);
+    int before = atomic_load(&echo_pings);
+    uint64_t end = now_ms() + 300;
+    for (uint64_t now; (now = now_ms()) < end; ) {
+        wibesocket_message_t m;
+        wibesocket_error_t e = wibesocket_recv(c, &m, (int)(end - now));
+        if (e == WIBESOCKET_OK) wibesocket_release_payload(c);
+        else assert(e == WIBESOCKET_ERROR_TIMEOUT);
+    }
+    int pings = atomic_load(&echo_pings) - before;
+    assert(pings >= 4 && pings <= 15);
+    assert(wibesocket_get_rtt_us(c) > 0);
+    wibesocket_close(c);
+
+    /* A silent server: recv gives up at the idle limit, well before its own timeout */
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.idle_timeout_ms = 100;
+    c = echo_connect(srv, "/mute", &cfg);
+    assert(c);
+    wibesocket_message_t m;
+    uint64_t start = now_ms();
+    assert(wibesocket_recv(c, &m, 5000) == WIBESOCKET_ERROR_TIMEOUT);
+    uint64_t took = now_ms() - start;
+    assert(took >= 90 && took < 2000);
+    assert(wibesocket_get_state(c) == WIBESOCKET_STATE_ERROR);
+    wibesocket_close(c);
+}
+
+static void test_close_timeout(const echo_server_t* srv) {
+    /* Standalone: close waits for the CLOSE reply, but no longer than close_timeout_ms */
+    wibesocket_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.close_timeout_ms = 100;
+    wibesocket_conn_t* c = echo_connect(srv, "/mute", &cfg);
+    assert(c);
+    uint64_t start = now_ms();
+    assert(wibesocket_close(c) == WIBESOCKET_OK);
+    uint64_t took = now_ms() - start;
+    assert(took >= 90 && took < 1000);
+
+    /* A server that answers: no waiting at all */
+    c = wibesocket_connect(srv->uri, NULL);
+    assert(c);
+    start = now_ms();
+    assert(wibesocket_close(c) == WIBESOCKET_OK);
+    assert(now_ms() - start < 100);
+
+    /* In a loop close returns at once; the loop finishes the handshake (or gives up on it) */
+    wibesocket_loop_t* loop = wibesocket_loop_create();
+    timer_state_t st = {0, 0};
+    for (int i = 0; i < 16; i++) {
+        c = (i & 1) ? echo_connect(srv, "/mute", &cfg) : wibesocket_connect(srv->uri, &cfg);
+        assert(c);
+        assert(wibesocket_loop_add(loop, c, on_event, &st) == WIBESOCKET_OK);
+        start = now_ms();
+        assert(wibesocket_close(c) == WIBESOCKET_OK);
+        assert(now_ms() - start < 50);
+    }
+    run_for(loop, 300, NULL);
+    assert(st.errors == 0 && st.messages == 0); /* closed connections get no callbacks */
+    wibesocket_loop_destroy(loop);
+
+    /* A loop destroyed while connections still wait for their CLOSE frees them too */
+    loop = wibesocket_loop_create();
+    for (int i = 0; i < 8; i++) {
+        c = echo_connect(srv, "/mute", &cfg);
+        assert(c);
+        assert(wibesocket_loop_add(loop, c, on_event, &st) == WIBESOCKET_OK);
+        assert(wibesocket_close(c) == WIBESOCKET_OK);
+    }
+    start = now_ms();
+    wibesocket_loop_destroy(loop);
+    assert(now_ms() - start < 50);
+}
+
+int main(void) {
+    echo_server_t srv;
+    assert(echo_server_start(&srv) == 0);
+    test_control_frames(&srv);
+    test_keepalive_loop(&srv);
+    test_keepalive_standalone(&srv);
+    test_close_timeout(&srv);
+    printf("test_keepalive OK\n");
+    return 0;
+}
@@ -5,6 +5,8 @@
 
 #include "wibesocket/wibesocket.h"
 #include "../src/internal/frame.h"
+#include "../src/internal/mask.h"
+#include "../src/internal/utf8.h"
 
 static size_t make_frame(uint8_t* out, size_t cap, int fin, uint8_t opcode,
                          int masked, const uint8_t mask[4],
@@ -28,7 +30,7 @@ static size_t make_frame(uint8_t* out, size_t cap, int fin, uint8_t opcode,
     }
     if (masked) out[1] |= 0x80;
     size_t pos = 2;
-    if (out[1] == 126) pos = 4; else if (out[1] == 127) pos = 10;
+    if ((out[1] & 0x7F) == 126) pos = 4; else if ((out[1] & 0x7F) == 127) pos = 10;
     if (masked) {
         memcpy(out + pos, mask, 4); pos += 4;
     }
@@ -124,12 +126,277 @@ static void test_close_frame_validation(void) {
     assert(s == WS_PARSER_ERROR_PROTOCOL);
 }
 
+static void test_chunked_payload_stream(void) {
+    ws_parser_t p; ws_parser_init(&p, 1 << 20);
+    static uint8_t buf[70000];
+    static uint8_t payload[65536];
+    for (size_t i = 0; i < sizeof(payload); i++) payload[i] = (uint8_t)i;
+    size_t n = make_frame(buf, sizeof(buf), 1, 0x2, 0, NULL, payload, sizeof(payload));
+    static uint8_t out[65536];
+    size_t off = 0, got = 0; int chunks = 0;
+    while (off < n) {
+        size_t step = (n - off < 1000) ? n - off : 1000;
+        size_t c = 0; ws_parsed_frame_t f;
+        ws_parser_status_t s = ws_parser_feed(&p, buf + off, step, &c, &f);
+        assert(c == step);
+        off += c;
+        if (s == WS_PARSER_NEED_MORE) continue;
+        assert(s == WS_PARSER_CHUNK || s == WS_PARSER_FRAME);
+        assert(f.frame_len == sizeof(payload));
+        assert(f.offset == got);
+        memcpy(out + f.offset, f.payload, f.payload_len);
+        got += f.payload_len; chunks++;
+        if (s == WS_PARSER_FRAME) assert(off == n);
+    }
+    assert(got == sizeof(payload) && chunks > 1);
+    assert(memcmp(out, payload, sizeof(payload)) == 0);
+}
+
+static void test_utf8_split_across_fragments(void) {
+    ws_parser_t p; ws_parser_init(&p, 1 << 20);
+    uint8_t buf[64];
+    /* U+20AC (E2 82 AC) split between a TEXT fragment and its continuation */
+    const uint8_t a[] = {'x', 0xE2, 0x82};
+    const uint8_t b[] = {0xAC, 'y'};
+    size_t n = make_frame(buf, sizeof(buf), 0, 0x1, 0, NULL, a, sizeof(a));
+    size_t c = 0; ws_parsed_frame_t f;
+    assert(ws_parser_feed(&p, buf, n, &c, &f) == WS_PARSER_FRAME && !f.is_final);
+    n = make_frame(buf, sizeof(buf), 1, 0x0, 0, NULL, b, sizeof(b));
+    assert(ws_parser_feed(&p, buf, n, &c, &f) == WS_PARSER_FRAME && f.is_final);
+
+    /* Message ending mid-codepoint is rejected */
+    ws_parser_init(&p, 1 << 20);
+    n = make_frame(buf, sizeof(buf), 1, 0x1, 0, NULL, a, sizeof(a));
+    assert(ws_parser_feed(&p, buf, n, &c, &f) == WS_PARSER_ERROR_PROTOCOL);
+}
+
+static void test_control_split_across_feeds(void) {
+    ws_parser_t p; ws_parser_init(&p, 1 << 20);
+    uint8_t buf[64];
+    const uint8_t payload[] = {0x03, 0xE8, 'b', 'y', 'e'};
+    size_t n = make_frame(buf, sizeof(buf), 1, 0x8, 0, NULL, payload, sizeof(payload));
+    size_t c = 0; ws_parsed_frame_t f;
+    assert(ws_parser_feed(&p, buf, 3, &c, &f) == WS_PARSER_NEED_MORE && c == 3);
+    assert(ws_parser_feed(&p, buf + 3, n - 3, &c, &f) == WS_PARSER_FRAME);
+    assert(f.payload_len == sizeof(payload));
+    assert(memcmp(f.payload, payload, sizeof(payload)) == 0);
+}
+
+static void test_utf8_vector_paths(void) {
+    /* Sequences dropped at every offset of a long ASCII run exercise the vector kernel,
+     * its block boundaries and the split-feed carry. */
+    static const struct { uint8_t b[4]; size_t n; int ok; } seqs[] = {
+        {{0xC3, 0xA9}, 2, 1}, {{0xE2, 0x82, 0xAC}, 3, 1}, {{0xF0, 0x9F, 0x98, 0x80}, 4, 1},
+        {{0xF4, 0x8F, 0xBF, 0xBF}, 4, 1}, {{0xED, 0x9F, 0xBF}, 3, 1},
+        {{0xC0, 0x80}, 2, 0}, {{0xE0, 0x9F, 0xBF}, 3, 0}, {{0xED, 0xA0, 0x80}, 3, 0},
+        {{0xF0, 0x8F, 0xBF, 0xBF}, 4, 0}, {{0xF4, 0x90, 0x80, 0x80}, 4, 0}, {{0xF5, 0x80, 0x80, 0x80}, 4, 0},
+        {{0x80}, 1, 0}, {{0xE2, 0x82}, 2, 0}, {{0xC3, 0xA9, 0xA9}, 3, 0}, {{0xFF}, 1, 0},
+    };
+    uint8_t buf[96];
+    for (size_t k = 0; k < sizeof(seqs)/sizeof(seqs[0]); k++) {
+        for (size_t off = 0; off + seqs[k].n <= sizeof(buf); off++) {
+            memset(buf, 'x', sizeof(buf));
+            memcpy(buf + off, seqs[k].b, seqs[k].n);
+            assert(ws_utf8_is_valid(buf, sizeof(buf)) == (bool)seqs[k].ok);
+            for (size_t cut = 0; cut <= sizeof(buf); cut += 7) {
+                ws_utf8_state_t st; ws_utf8_init(&st);
+                bool ok = ws_utf8_feed(&st, buf, cut) && ws_utf8_feed(&st, buf + cut, sizeof(buf) - cut)
+                          && ws_utf8_complete(&st);
+                assert(ok == (bool)seqs[k].ok);
+            }
+        }
+    }
+    /* truncated at the very end */
+    memset(buf, 'x', sizeof(buf));
+    buf[sizeof(buf) - 2] = 0xE2; buf[sizeof(buf) - 1] = 0x82;
+    assert(!ws_utf8_is_valid(buf, sizeof(buf)));
+}
+
+static void test_mask_kernel(void) {
+    static uint8_t src[1100], dst[1100 + 1], ref[1100];
+    const uint8_t key[4] = {0x37, 0xFA, 0x21, 0x3D};
+    for (size_t i = 0; i < sizeof(src); i++) src[i] = (uint8_t)(i * 31 + 7);
+    const size_t lens[] = {0, 1, 3, 15, 16, 17, 63, 64, 65, 127, 128, 129, 1000, 1099};
+    for (size_t li = 0; li < sizeof(lens)/sizeof(lens[0]); li++) {
+        for (size_t phase = 0; phase < 4; phase++) {
+            for (size_t misalign = 0; misalign < 2; misalign++) {
+                size_t len = lens[li];
+                for (size_t i = 0; i < len; i++) ref[i] = (uint8_t)(src[i + misalign] ^ key[(phase + i) & 3]);
+                ws_mask_copy(dst + misalign, src + misalign, len, key, phase);
+                assert(memcmp(dst + misalign, ref, len) == 0);
+                /* in place */
+                uint8_t tmp[1100]; memcpy(tmp, src + misalign, len);
+                ws_mask_copy(tmp, tmp, len, key, phase);
+                assert(memcmp(tmp, ref, len) == 0);
+            }
+        }
+    }
+    /* builder applies the mask and sets the MASK bit */
+    uint8_t frame[1200];
+    size_t n = ws_build_frame(frame, sizeof(frame), 1, WS_OPCODE_BINARY, key, src, 1000);
+    assert(n == 4 + 4 + 1000);
+    assert((frame[1] & 0x80) && memcmp(frame + 4, key, 4) == 0);
+    for (size_t i = 0; i < 1000; i++) assert((uint8_t)(frame[8 + i] ^ key[i & 3]) == src[i]);
+}
+
+static void test_rsv1_permessage_deflate(void) {
+    ws_parser_t p; ws_parser_init(&p, 1 << 20);
+    uint8_t buf[64]; size_t consumed = 0; ws_parsed_frame_t f;
+    const uint8_t bad_utf8[2] = { 0xC3, 0x28 };
+
+    /* Not negotiated: RSV1 is a protocol error */
+    size_t n = make_frame(buf, sizeof(buf), 1, 0x1, 0, NULL, bad_utf8, sizeof(bad_utf8));
+    buf[0] |= 0x40;
+    assert(ws_parser_feed(&p, buf, n, &consumed, &f) == WS_PARSER_ERROR_PROTOCOL);
+
+    /* Negotiated: compressed text is flagged and not UTF-8 checked (that happens once inflated) */
+    ws_parser_init(&p, 1 << 20); p.allow_rsv1 = true;
+    assert(ws_parser_feed(&p, buf, n, &consumed, &f) == WS_PARSER_FRAME);
+    assert(f.compressed && f.type == WS_OPCODE_TEXT);
+
+    /* The flag carries over continuation frames, which must not set RSV1 themselves */
+    n = make_frame(buf, sizeof(buf), 0, 0x2, 0, NULL, bad_utf8, 1);
+    buf[0] |= 0x40;
+    assert(ws_parser_feed(&p, buf, n, &consumed, &f) == WS_PARSER_FRAME && f.compressed && !f.is_final);
+    n = make_frame(buf, sizeof(buf), 1, 0x0, 0, NULL, bad_utf8 + 1, 1);
+    assert(ws_parser_feed(&p, buf, n, &consumed, &f) == WS_PARSER_FRAME && f.compressed && f.is_final);
+    n = make_frame(buf, sizeof(buf), 1, 0x2, 0, NULL, bad_utf8, 1);
+    assert(ws_parser_feed(&p, buf, n, &consumed, &f) == WS_PARSER_FRAME && !f.compressed);
+
+    n = make_frame(buf, sizeof(buf), 0, 0x2, 0, NULL, bad_utf8, 1);
+    assert(ws_parser_feed(&p, buf, n, &consumed, &f) == WS_PARSER_FRAME);
+    n = make_frame(buf, sizeof(buf), 1, 0x0, 0, NULL, bad_utf8, 1);
+    buf[0] |= 0x40;
+    assert(ws_parser_feed(&p, buf, n, &consumed, &f) == WS_PARSER_ERROR_PROTOCOL);
+
+    /* Never on control frames; RSV2/RSV3 stay reserved */
+    ws_parser_init(&p, 1 << 20); p.allow_rsv1 = true;
+    n = make_frame(buf, sizeof(buf), 1, 0x9, 0, NULL, NULL, 0);
+    buf[0] |= 0x40;
+    assert(ws_parser_feed(&p, buf, n, &consumed, &f) == WS_PARSER_ERROR_PROTOCOL);
+    ws_parser_init(&p, 1 << 20); p.allow_rsv1 = true;
+    n = make_frame(buf, sizeof(buf), 1, 0x2, 0, NULL, NULL, 0);
+    buf[0] |= 0x60;
+    assert(ws_parser_feed(&p, buf, n, &consumed, &f) == WS_PARSER_ERROR_PROTOCOL);
+
+    /* The builder sets RSV1 where the parser looks for it */
+    uint8_t hdr[WS_MAX_HEADER_SIZE];
+    assert(ws_build_frame_header(hdr, 1, WS_RSV1, WS_OPCODE_BINARY, NULL, 300) == 4);
+    assert(hdr[0] == 0xC2 && hdr[1] == 126 && hdr[2] == 1 && hdr[3] == 44);
+}
+
+/* Feed stream in the segments [0, split) and [split, n), or byte by byte when split is 0.
+ * Returns the number of frames and folds their lengths, payloads and keys into sum. */
+static int parse_split(const uint8_t* buf, size_t n, size_t split, uint64_t* sum) {
+    ws_parser_t p; ws_parser_init(&p, 1 << 20);
+    int frames = 0;
+    *sum = 0;
+    size_t off = 0;
+    while (off < n) {
+        size_t end = split == 0 ? off + 1 : (off < split ? split : n);
+        while (off < end) {
+            size_t c = 0; ws_parsed_frame_t f;
+            ws_parser_status_t s = ws_parser_feed(&p, buf + off, end - off, &c, &f);
+            assert(s >= 0);
+            off += c;
+            if (s == WS_PARSER_NEED_MORE) { assert(off == end); continue; }
+            for (size_t i = 0; i < f.payload_len; i++) {
+                *sum = *sum * 31 + ((const uint8_t*)f.payload)[i];
+            }
+            if (s == WS_PARSER_FRAME) {
+                frames++;
+                *sum = *sum * 31 + f.frame_len + (uint64_t)f.type * 7 + f.is_final;
+                if (p.cur.masked) for (int k = 0; k < 4; k++) *sum = *sum * 31 + p.cur.mask_key[k];
+            }
+        }
+    }
+    return frames;
+}
+
+static void test_header_split_points(void) {
+    /* Every header shape, including a 64-bit length, back to back */
+    static uint8_t buf[2048];
+    uint8_t payload[300];
+    for (size_t i = 0; i < sizeof(payload); i++) payload[i] = (uint8_t)(i * 7);
+    const uint8_t mask[4] = {0x11, 0x22, 0x33, 0x44};
+    size_t n = 0;
+    n += make_frame(buf + n, sizeof(buf) - n, 1, 0x2, 0, NULL, payload, 0);
+    n += make_frame(buf + n, sizeof(buf) - n, 1, 0x2, 1, mask, payload, 5);
+    n += make_frame(buf + n, sizeof(buf) - n, 1, 0x2, 0, NULL, payload, 200);
+    n += make_frame(buf + n, sizeof(buf) - n, 1, 0x2, 1, mask, payload, 300);
+    n += make_frame(buf + n, sizeof(buf) - n, 1, 0x9, 1, mask, payload, 3);
+    const uint8_t long_hdr[] = {0x82, 0xFF, 0, 0, 0, 0, 0, 0, 0, 3, 9, 8, 7, 6};
+    memcpy(buf + n, long_hdr, sizeof(long_hdr)); n += sizeof(long_hdr);
+    memcpy(buf + n, payload, 3); n += 3;
+    n += make_frame(buf + n, sizeof(buf) - n, 1, 0x2, 0, NULL, payload, 1);
+
+    uint64_t want = 0, got = 0;
+    assert(parse_split(buf, n, n, &want) == 7);
+    assert(parse_split(buf, n, 0, &got) == 7 && got == want);
+    for (size_t split = 1; split < n; split++) {
+        assert(parse_split(buf, n, split, &got) == 7);
+        assert(got == want);
+    }
+
+    /* A 64-bit length with the top bit set is refused whether the header is whole or split */
+    uint8_t bad[16] = {0x82, 0x7F, 0x80, 0, 0, 0, 0, 0, 0, 1};
+    ws_parser_t p; size_t c = 0; ws_parsed_frame_t f;
+    ws_parser_init(&p, 1 << 20);
+    assert(ws_parser_feed(&p, bad, sizeof(bad), &c, &f) == WS_PARSER_ERROR_PROTOCOL);
+    ws_parser_init(&p, 1 << 20);
+    assert(ws_parser_feed(&p, bad, 5, &c, &f) == WS_PARSER_NEED_MORE && c == 5);
+    assert(ws_parser_feed(&p, bad + 5, 5, &c, &f) == WS_PARSER_ERROR_PROTOCOL);
+    /* Reserved opcodes fail on the first two bytes, before any length arrives */
+    const uint8_t reserved[2] = {0x83, 0x7F};
+    ws_parser_init(&p, 1 << 20);
+    assert(ws_parser_feed(&p, reserved, 2, &c, &f) == WS_PARSER_ERROR_PROTOCOL);
+}
+
+/* Role rule: a client refuses masked frames, a server refuses unmasked ones and gets the
+ * payload unmasked in place, however it is split */
+static void test_mask_rule(void) {
+    const uint8_t mask[4] = {0x11, 0x22, 0x33, 0x44};
+    const char* text = "masked by the client";
+    size_t len = strlen(text);
+    uint8_t masked[64], plain[64], buf[64];
+    uint8_t tmp[64];
+    ws_mask_copy(tmp, (const uint8_t*)text, len, mask, 0);
+    size_t mn = make_frame(masked, sizeof(masked), 1, 0x1, 1, mask, tmp, len);
+    size_t pn = make_frame(plain, sizeof(plain), 1, 0x1, 0, NULL, (const uint8_t*)text, len);
+
+    ws_parser_t p; size_t c = 0; ws_parsed_frame_t f;
+    ws_parser_init(&p, 1 << 20);
+    p.masking = WS_MASK_FORBIDDEN;
+    assert(ws_parser_feed(&p, masked, mn, &c, &f) == WS_PARSER_ERROR_PROTOCOL);
+    ws_parser_init(&p, 1 << 20);
+    p.masking = WS_MASK_REQUIRED;
+    assert(ws_parser_feed(&p, plain, pn, &c, &f) == WS_PARSER_ERROR_PROTOCOL);
+
+    for (size_t split = 6; split < mn; split++) {
+        memcpy(buf, masked, mn);
+        ws_parser_init(&p, 1 << 20);
+        p.masking = WS_MASK_REQUIRED;
+        size_t c1 = 0, c2 = 0;
+        assert(ws_parser_feed(&p, buf, split, &c1, &f) != WS_PARSER_ERROR_PROTOCOL);
+        assert(ws_parser_feed(&p, buf + c1, mn - c1, &c2, &f) == WS_PARSER_FRAME);
+        assert(memcmp(buf + mn - len, text, len) == 0);
+    }
+}
+
 int main(void) {
     test_short_payload_unmasked();
     test_extended_16_unmasked();
     test_control_frame_rules();
     test_utf8_validation();
     test_close_frame_validation();
+    test_chunked_payload_stream();
+    test_utf8_split_across_fragments();
+    test_control_split_across_feeds();
+    test_utf8_vector_paths();
+    test_mask_kernel();
+    test_rsv1_permessage_deflate();
+    test_header_split_points();
+    test_mask_rule();
     printf("test_parser OK\n");
     return 0;
 }
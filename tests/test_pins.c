@@ -0,0 +1,165 @@
+/* Payload pins: many received messages held at once while receiving goes on, released in any
+ * order, with their ring retired behind them when it fills */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wibesocket/wibesocket.h"
+#include "echo_helper.h"
+
+/* Message i: its index, then a pattern derived from it, at one of a few sizes */
+static size_t msg_len(int i) { return (size_t)(8 + (i * 397) % 3000); }
+
+static void fill_msg(char* buf, int i) {
+    size_t n = msg_len(i);
+    memcpy(buf, &i, sizeof(i));
+    for (size_t j = sizeof(i); j < n; j++) buf[j] = (char)(i + (int)j * 13);
+}
+
+static int msg_ok(const wibesocket_message_t* m, int i) {
+    char want[4096];
+    fill_msg(want, i);
+    return m->payload_len == msg_len(i) && memcmp(m->payload, want, m->payload_len) == 0;
+}
+
+/* Keep up to `window` messages outstanding, releasing a pseudo-random one each time it is full */
+static void run_window(wibesocket_conn_t* c, int total, int window) {
+    wibesocket_message_t* held = (wibesocket_message_t*)calloc((size_t)window, sizeof(*held));
+    int* idx = (int*)calloc((size_t)window, sizeof(*idx));
+    char buf[4096];
+    int sent = 0, got = 0, nheld = 0;
+    unsigned seed = 12345;
+    while (got < total) {
+        while (sent < total && sent - got < 32) {
+            fill_msg(buf, sent);
+            assert(wibesocket_send_binary(c, buf, msg_len(sent)) == WIBESOCKET_OK);
+            sent++;
+        }
+        if (nheld == window) {
+            seed = seed * 1103515245U + 12345U;
+            int k = (int)((seed >> 16) % (unsigned)nheld);
+            /* Everything received so far is still intact, retired ring or not */
+            for (int j = 0; j < nheld; j++) assert(msg_ok(&held[j], idx[j]));
+            wibesocket_release_message(c, &held[k]);
+            held[k] = held[nheld - 1];
+            idx[k] = idx[nheld - 1];
+            nheld--;
+        }
+        wibesocket_message_t m;
+        assert(wibesocket_recv(c, &m, 5000) == WIBESOCKET_OK);
+        assert(m.pin != 0);
+        assert(msg_ok(&m, got));
+        held[nheld] = m;
+        idx[nheld++] = got++;
+    }
+    for (int j = 0; j < nheld; j++) assert(msg_ok(&held[j], idx[j]));
+    while (nheld > 0) wibesocket_release_message(c, &held[--nheld]);
+    free(held);
+    free(idx);
+}
+
+static void test_many_outstanding(const echo_server_t* srv, wibesocket_io_backend_t backend) {
+    wibesocket_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.io_backend = backend;
+    cfg.recv_buffer_size = 16 * 1024; /* a small ring fills, and is retired, many times over */
+    wibesocket_conn_t* c = wibesocket_connect(srv->uri, &cfg);
+    assert(c);
+    run_window(c, 2000, 40);
+    /* Every retired ring went back with its last pin */
+    assert(wibesocket_get_memory_usage(c) <= 64 * 1024);
+    wibesocket_close(c);
+}
+
+static void test_pin_limit_and_refcounts(const echo_server_t* srv) {
+    wibesocket_conn_t* c = wibesocket_connect(srv->uri, NULL);
+    assert(c);
+    static wibesocket_message_t held[256];
+    assert(wibesocket_send_begin(c) == WIBESOCKET_OK);
+    for (int i = 0; i < 260; i++) assert(wibesocket_send_binary(c, &i, sizeof(i)) == WIBESOCKET_OK);
+    assert(wibesocket_send_commit(c) == WIBESOCKET_OK);
+    for (int i = 0; i < 256; i++) {
+        assert(wibesocket_recv(c, &held[i], 5000) == WIBESOCKET_OK);
+        assert(*(const int*)held[i].payload == i);
+    }
+    /* Every pin taken: refused until one is released */
+    wibesocket_message_t m;
+    assert(wibesocket_recv(c, &m, 0) == WIBESOCKET_ERROR_NOT_READY);
+    wibesocket_retain_message(c, &held[7]);
+    wibesocket_release_message(c, &held[7]);
+    assert(wibesocket_recv(c, &m, 0) == WIBESOCKET_ERROR_NOT_READY); /* still one reference */
+    assert(*(const int*)held[7].payload == 7);
+    wibesocket_release_message(c, &held[7]);
+    assert(wibesocket_recv(c, &m, 5000) == WIBESOCKET_OK && *(const int*)m.payload == 256);
+    wibesocket_release_message(c, &m);
+    for (int i = 0; i < 256; i++) {
+        if (i != 7) wibesocket_release_message(c, &held[i]);
+    }
+    /* Releasing twice, or a pin that is gone, is harmless */
+    wibesocket_release_message(c, &held[0]);
+
+    /* A batch shares one pin; the pin-less calls act on the latest one */
+    wibesocket_message_t batch[8];
+    size_t k = 0;
+    assert(wibesocket_recv_batch(c, batch, 8, &k, 5000) == WIBESOCKET_OK && k >= 1);
+    for (size_t j = 1; j < k; j++) assert(batch[j].pin == batch[0].pin);
+    wibesocket_retain_payload(c);
+    wibesocket_release_payload(c);
+    assert(*(const int*)batch[0].payload == 257);
+    wibesocket_release_payload(c);
+    wibesocket_close(c);
+}
+
+static void test_large_held(const echo_server_t* srv) {
+    /* A frame beyond the ring is reassembled into its own buffer, held by its pin */
+    wibesocket_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.recv_buffer_size = 8 * 1024;
+    wibesocket_conn_t* c = wibesocket_connect(srv->uri, &cfg);
+    assert(c);
+    size_t big = 100 * 1024;
+    char* data = (char*)malloc(big);
+    for (size_t i = 0; i < big; i++) data[i] = (char)(i * 7);
+    char small[16] = "after the large";
+    assert(wibesocket_send_binary(c, data, big) == WIBESOCKET_OK);
+    assert(wibesocket_send_binary(c, data, big) == WIBESOCKET_OK);
+    assert(wibesocket_send_binary(c, small, sizeof(small)) == WIBESOCKET_OK);
+    wibesocket_message_t a, b, s;
+    assert(wibesocket_recv(c, &a, 5000) == WIBESOCKET_OK && a.payload_len == big);
+    assert(wibesocket_recv(c, &b, 5000) == WIBESOCKET_OK && b.payload_len == big);
+    assert(wibesocket_recv(c, &s, 5000) == WIBESOCKET_OK && s.payload_len == sizeof(small));
+    assert(a.payload != b.payload);
+    assert(memcmp(a.payload, data, big) == 0 && memcmp(b.payload, data, big) == 0);
+    assert(wibesocket_get_memory_usage(c) >= 2 * big);
+    wibesocket_release_message(c, &a);
+    assert(memcmp(b.payload, data, big) == 0 && memcmp(s.payload, small, sizeof(small)) == 0);
+    wibesocket_release_message(c, &s);
+    wibesocket_release_message(c, &b);
+    assert(wibesocket_get_memory_usage(c) < big);
+    free(data);
+    wibesocket_close(c);
+}
+
+static void test_compressed_held(const echo_server_t* srv) {
+    wibesocket_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.enable_compression = true;
+    cfg.compression_threshold = 16;
+    wibesocket_conn_t* c = echo_connect(srv, "/deflate", &cfg);
+    assert(c);
+    if (wibesocket_compression_negotiated(c)) run_window(c, 300, 20); /* inflated copies held */
+    wibesocket_close(c);
+}
+
+int main(void) {
+    echo_server_t srv;
+    assert(echo_server_start(&srv) == 0);
+    test_many_outstanding(&srv, WIBESOCKET_IO_EPOLL);
+    test_many_outstanding(&srv, WIBESOCKET_IO_URING);
+    test_pin_limit_and_refcounts(&srv);
+    test_large_held(&srv);
+    test_compressed_held(&srv);
+    printf("test_pins OK\n");
+    return 0;
+}
@@ -0,0 +1,127 @@
+/* Connection pool: warm connections per URI handed out open and refilled on the loop, cold
+ * URIs connected on demand, unreachable hosts failing without spinning */
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "wibesocket/wibesocket.h"
+#include "wibesocket/event_loop.h"
+#include "echo_helper.h"
+
+static uint64_t now_ms(void) {
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)(ts.tv_nsec / 1000000ULL);
+}
+
+/* Run the loop until uri has want connections ready; 1 if it got there in time */
+static int wait_ready(wibesocket_loop_t* loop, wibesocket_pool_t* pool, const char* uri, size_t want) {
+    uint64_t deadline = now_ms() + 5000;
+    while (wibesocket_pool_ready(pool, uri) < want && now_ms() < deadline) {
+        assert(wibesocket_loop_run_once(loop, 20) >= 0);
+    }
+    return wibesocket_pool_ready(pool, uri) >= want;
+}
+
+static void echo_once(wibesocket_conn_t* c, const char* text) {
+    assert(wibesocket_send_text(c, text, strlen(text)) == WIBESOCKET_OK);
+    wibesocket_message_t m;
+    assert(wibesocket_recv(c, &m, 5000) == WIBESOCKET_OK);
+    assert(m.payload_len == strlen(text) && memcmp(m.payload, text, m.payload_len) == 0);
+    wibesocket_release_payload(c);
+}
+
+/* Prewarmed connections come out open and usable outside the loop, and are replaced */
+static void test_warm(const char* uri, uint32_t dns_ttl_ms) {
+    wibesocket_loop_t* loop = wibesocket_loop_create();
+    wibesocket_pool_config_t pc; memset(&pc, 0, sizeof(pc));
+    pc.warm = 3;
+    pc.dns_ttl_ms = dns_ttl_ms;
+    wibesocket_pool_t* pool = wibesocket_pool_create(loop, &pc);
+    assert(pool);
+    assert(wibesocket_pool_prewarm(pool, uri) == WIBESOCKET_OK);
+    assert(wait_ready(loop, pool, uri, 3));
+
+    wibesocket_conn_t* held[3];
+    for (int i = 0; i < 3; i++) {
+        held[i] = wibesocket_pool_acquire(pool, uri, 0);
+        assert(held[i] && wibesocket_get_state(held[i]) == WIBESOCKET_STATE_OPEN);
+    }
+    assert(wibesocket_pool_ready(pool, uri) == 0);
+    for (int i = 0; i < 3; i++) echo_once(held[i], "pooled");
+    for (int i = 0; i < 3; i++) assert(wibesocket_close(held[i]) == WIBESOCKET_OK);
+
+    /* Replacements were started by the acquires */
+    assert(wait_ready(loop, pool, uri, 3));
+    wibesocket_conn_t* c = wibesocket_pool_acquire(pool, uri, 0);
+    assert(c);
+    echo_once(c, "again");
+    assert(wibesocket_close(c) == WIBESOCKET_OK);
+
+    wibesocket_pool_destroy(pool);
+    wibesocket_loop_destroy(loop);
+}
+
+/* A URI the pool has not seen: timeout 0 only starts warming, a timeout connects now */
+static void test_cold(const echo_server_t* srv) {
+    wibesocket_loop_t* loop = wibesocket_loop_create();
+    wibesocket_pool_t* pool = wibesocket_pool_create(loop, NULL);
+    assert(pool);
+    assert(wibesocket_pool_acquire(pool, srv->uri, 0) == NULL);
+    wibesocket_conn_t* c = wibesocket_pool_acquire(pool, srv->uri, 5000);
+    assert(c && wibesocket_get_state(c) == WIBESOCKET_STATE_OPEN);
+    echo_once(c, "cold");
+    assert(wibesocket_close(c) == WIBESOCKET_OK);
+    assert(wait_ready(loop, pool, srv->uri, 4));
+    /* Destroying closes what is still pooled, connecting or not */
+    c = wibesocket_pool_acquire(pool, srv->uri, 0);
+    assert(c);
+    wibesocket_pool_destroy(pool);
+    echo_once(c, "survives");
+    assert(wibesocket_close(c) == WIBESOCKET_OK);
+    wibesocket_loop_destroy(loop);
+}
+
+/* Nothing listening: acquires fail, nothing is ready, and the loop stays idle */
+static void test_unreachable(void) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in a; memset(&a, 0, sizeof(a));
+    a.sin_family = AF_INET; a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t al = sizeof(a);
+    assert(bind(fd, (struct sockaddr*)&a, sizeof(a)) == 0 && getsockname(fd, (struct sockaddr*)&a, &al) == 0);
+    char uri[64]; snprintf(uri, sizeof(uri), "ws://127.0.0.1:%d/", ntohs(a.sin_port));
+    close(fd);
+
+    wibesocket_loop_t* loop = wibesocket_loop_create();
+    wibesocket_pool_t* pool = wibesocket_pool_create(loop, NULL);
+    assert(wibesocket_pool_acquire(pool, uri, 0) == NULL);
+    assert(wibesocket_pool_acquire(pool, uri, 500) == NULL);
+    int dispatched = 0;
+    for (int i = 0; i < 10; i++) {
+        int n = wibesocket_loop_run_once(loop, 10);
+        assert(n >= 0);
+        dispatched += n;
+    }
+    assert(wibesocket_pool_ready(pool, uri) == 0);
+    assert(dispatched <= 8); /* the failed warmers, then quiet */
+    wibesocket_pool_destroy(pool);
+    wibesocket_loop_destroy(loop);
+}
+
+int main(void) {
+    echo_server_t srv;
+    assert(echo_server_start(&srv) == 0);
+    assert(wibesocket_pool_create(NULL, NULL) == NULL);
+    assert(wibesocket_pool_acquire(NULL, srv.uri, 0) == NULL);
+    assert(wibesocket_pool_prewarm(NULL, srv.uri) == WIBESOCKET_ERROR_INVALID_ARGS);
+    test_warm(srv.uri, 0);
+    /* By name: looked up once, then connected from the cache; with a 1 ms TTL, looked up
+     * again for nearly every refill */
+    char named[64]; snprintf(named, sizeof(named), "ws://localhost:%d/", srv.port);
+    test_warm(named, 0);
+    test_warm(named, 1);
+    test_cold(&srv);
+    test_unreachable();
+    printf("test_pool OK\n");
+    return 0;
+}
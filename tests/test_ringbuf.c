@@ -44,9 +44,93 @@ static void test_wrap_and_zero_copy(void) {
     ws_ringbuf_free(&rb);
 }
 
+static void test_linearize_wrapped(void) {
+    ws_ringbuf_t rb; assert(ws_ringbuf_init(&rb, 8) == 0);
+    uint8_t a[6] = {0,1,2,3,4,5};
+    assert(ws_ringbuf_write_copy(&rb, a, 6) == 6);
+    ws_ringbuf_consume(&rb, 5);
+    uint8_t b[6] = {6,7,8,9,10,11};
+    assert(ws_ringbuf_write_copy(&rb, b, 6) == 6); /* wraps */
+    ws_ringbuf_linearize(&rb);
+    const uint8_t* rptr; size_t have = ws_ringbuf_peek_read(&rb, &rptr);
+    assert(have == 7);
+    const uint8_t want[7] = {5,6,7,8,9,10,11};
+    assert(memcmp(rptr, want, 7) == 0);
+    ws_ringbuf_free(&rb);
+}
+
+static void test_mirrored_contiguous(void) {
+    ws_ringbuf_t rb;
+    if (ws_ringbuf_init_mirrored(&rb, 100) != 0) { printf("[rb] mirrored unsupported, skip\n"); return; }
+    assert(rb.mirrored && rb.capacity >= 100);
+    size_t cap = rb.capacity;
+    uint8_t* wptr; size_t space = ws_ringbuf_peek_write(&rb, &wptr);
+    assert(space == cap);
+    memset(wptr, 'x', cap - 3);
+    ws_ringbuf_commit(&rb, cap - 3);
+    ws_ringbuf_consume(&rb, cap - 4); /* 1 byte left near the end */
+    space = ws_ringbuf_peek_write(&rb, &wptr);
+    assert(space == cap - 1); /* whole free span despite wrapping */
+    for (size_t i = 0; i < 10; i++) wptr[i] = (uint8_t)('0' + i);
+    ws_ringbuf_commit(&rb, 10);
+    const uint8_t* rptr; size_t have = ws_ringbuf_peek_read(&rb, &rptr);
+    assert(have == 11);
+    assert(rptr[0] == 'x' && memcmp(rptr + 1, "0123456789", 10) == 0);
+    /* first page of the mirror aliases the start of the buffer */
+    assert(rb.buffer[0] == '3' && rb.buffer[cap] == '3');
+    ws_ringbuf_free(&rb);
+}
+
+static void test_grow_keeps_data(void) {
+    ws_ringbuf_t rb;
+    assert(ws_ringbuf_init(&rb, 8) == 0);
+    ws_ringbuf_write_copy(&rb, (const uint8_t*)"abcdef", 6);
+    ws_ringbuf_consume(&rb, 4);
+    ws_ringbuf_write_copy(&rb, (const uint8_t*)"ghij", 4); /* wraps: "efghij" */
+    assert(ws_ringbuf_grow(&rb, 32) == 0);
+    assert(rb.capacity == 32 && rb.count == 6 && rb.tail == 0);
+    const uint8_t* rptr; size_t have = ws_ringbuf_peek_read(&rb, &rptr);
+    assert(have == 6 && memcmp(rptr, "efghij", 6) == 0);
+    ws_ringbuf_free(&rb);
+
+    if (ws_ringbuf_init_mirrored(&rb, 100) != 0) return;
+    size_t cap = rb.capacity;
+    memset(rb.buffer, 'm', cap);
+    ws_ringbuf_commit(&rb, cap);
+    ws_ringbuf_consume(&rb, cap - 2);
+    assert(ws_ringbuf_grow(&rb, cap * 2) == 0);
+    assert(rb.mirrored && rb.capacity == cap * 2 && rb.count == 2 && rb.buffer[0] == 'm');
+    ws_ringbuf_free(&rb);
+}
+
+static void test_mirrored_pool_reuse(void) {
+    ws_ringbuf_t a, b, c, d;
+    ws_ringbuf_thread_flush();
+    if (ws_ringbuf_init_mirrored(&a, 12288) != 0) return;
+    assert(ws_ringbuf_init_mirrored(&b, 12288) == 0);
+    uint8_t* base_a = a.buffer;
+    uint8_t* base_b = b.buffer;
+    memset(a.buffer, 'z', a.capacity);
+    memset(b.buffer, 'z', b.capacity);
+    ws_ringbuf_free(&a); /* parked on this thread, pages kept */
+    ws_ringbuf_free(&b); /* shared pool, pages released */
+    assert(ws_ringbuf_init_mirrored(&c, 12288) == 0);
+    assert(c.buffer == base_a && c.count == 0 && c.tail == 0 && c.buffer[0] == 'z');
+    assert(ws_ringbuf_init_mirrored(&d, 12288) == 0);
+    assert(d.buffer == base_b && d.buffer[0] == 0 && d.buffer[d.capacity] == 0);
+    d.buffer[1] = 'q';
+    assert(d.buffer[d.capacity + 1] == 'q');
+    ws_ringbuf_free(&c);
+    ws_ringbuf_free(&d);
+}
+
 int main(void) {
     test_basic_rw();
     test_wrap_and_zero_copy();
+    test_linearize_wrapped();
+    test_mirrored_contiguous();
+    test_grow_keeps_data();
+    test_mirrored_pool_reuse();
     printf("test_ringbuf OK\n");
     return 0;
 }
@@ -0,0 +1,276 @@
+/* Server mode: accepted connections talking to wibesocket clients and to a raw socket (unmasked
+ * frames out, masked frames required in), subprotocol selection, bad requests, and broadcast
+ * messages shared by many connections */
+#include <assert.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "wibesocket/wibesocket.h"
+#include "wibesocket/event_loop.h"
+#include "../src/handshake.h"
+
+static int listen_local(int* port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in a; memset(&a, 0, sizeof(a));
+    a.sin_family = AF_INET; a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t al = sizeof(a);
+    assert(fd >= 0 && bind(fd, (struct sockaddr*)&a, sizeof(a)) == 0 && listen(fd, 128) == 0);
+    assert(getsockname(fd, (struct sockaddr*)&a, &al) == 0);
+    *port = ntohs(a.sin_port);
+    return fd;
+}
+
+static int raw_connect(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in a; memset(&a, 0, sizeof(a));
+    a.sin_family = AF_INET; a.sin_addr.s_addr = htonl(INADDR_LOOPBACK); a.sin_port = htons((uint16_t)port);
+    assert(fd >= 0 && connect(fd, (struct sockaddr*)&a, sizeof(a)) == 0);
+    return fd;
+}
+
+static void raw_read(int fd, void* p, size_t n) {
+    uint8_t* b = (uint8_t*)p;
+    while (n) {
+        ssize_t r = recv(fd, b, n, 0);
+        assert(r > 0);
+        b += r; n -= (size_t)r;
+    }
+}
+
+/* A wibesocket client and the server side of its connection, both open */
+static void open_pair(int lfd, int port, const char* client_proto, const wibesocket_config_t* server_cfg,
+                      wibesocket_conn_t** client, wibesocket_conn_t** server) {
+    char uri[64]; snprintf(uri, sizeof(uri), "ws://127.0.0.1:%d/", port);
+    wibesocket_config_t cc; memset(&cc, 0, sizeof(cc));
+    cc.protocol = client_proto;
+    wibesocket_conn_t* c = wibesocket_connect_start(uri, &cc);
+    assert(c);
+    (void)wibesocket_connect_step(c);
+    int fd = accept(lfd, NULL, NULL);
+    assert(fd >= 0);
+    wibesocket_conn_t* s = wibesocket_accept_start(fd, server_cfg);
+    assert(s && wibesocket_get_state(s) == WIBESOCKET_STATE_CONNECTING);
+    wibesocket_error_t ec = WIBESOCKET_ERROR_NOT_READY, es = WIBESOCKET_ERROR_NOT_READY;
+    for (int i = 0; i < 5000 && (ec == WIBESOCKET_ERROR_NOT_READY || es == WIBESOCKET_ERROR_NOT_READY); i++) {
+        ec = wibesocket_connect_step(c);
+        es = wibesocket_connect_step(s);
+        if (ec == WIBESOCKET_ERROR_NOT_READY || es == WIBESOCKET_ERROR_NOT_READY) (void)poll(NULL, 0, 1);
+    }
+    assert(ec == WIBESOCKET_OK && es == WIBESOCKET_OK);
+    *client = c;
+    *server = s;
+}
+
+static void expect_msg(wibesocket_conn_t* c, wibesocket_frame_type_t type, const void* data, size_t len) {
+    wibesocket_message_t m;
+    assert(wibesocket_recv(c, &m, 5000) == WIBESOCKET_OK);
+    assert(m.type == type && m.payload_len == len && memcmp(m.payload, data, len) == 0);
+    wibesocket_release_message(c, &m);
+}
+
+/* Both directions through the library, the subprotocol agreed on both ends, and a clean close */
+static void test_pair(int lfd, int port) {
+    wibesocket_config_t sc; memset(&sc, 0, sizeof(sc));
+    sc.protocol = "relay.v2, relay";
+    wibesocket_conn_t *c, *s;
+    open_pair(lfd, port, "relay, relay.v2", &sc, &c, &s);
+    assert(strcmp(wibesocket_get_protocol(c), "relay") == 0);
+    assert(strcmp(wibesocket_get_protocol(s), "relay") == 0);
+
+    assert(wibesocket_send_text(c, "up", 2) == WIBESOCKET_OK);
+    expect_msg(s, WIBESOCKET_FRAME_TEXT, "up", 2);
+    assert(wibesocket_send_binary(s, "down", 4) == WIBESOCKET_OK);
+    expect_msg(c, WIBESOCKET_FRAME_BINARY, "down", 4);
+    /* Large enough to stream through several reads on each side */
+    size_t big = 300 * 1024;
+    uint8_t* data = (uint8_t*)malloc(big);
+    for (size_t i = 0; i < big; i++) data[i] = (uint8_t)(i * 7);
+    assert(wibesocket_send_binary(c, data, big) == WIBESOCKET_OK);
+    expect_msg(s, WIBESOCKET_FRAME_BINARY, data, big);
+    assert(wibesocket_send_binary(s, data, big) == WIBESOCKET_OK);
+    expect_msg(c, WIBESOCKET_FRAME_BINARY, data, big);
+    free(data);
+
+    /* Broadcasts are for the server side only */
+    wibesocket_broadcast_t* b = wibesocket_broadcast_create(WIBESOCKET_FRAME_TEXT, "x", 1);
+    assert(b);
+    assert(wibesocket_broadcast_send(c, b) == WIBESOCKET_ERROR_INVALID_ARGS);
+    wibesocket_broadcast_release(b);
+
+    assert(wibesocket_send_close(s, WIBESOCKET_CLOSE_NORMAL, "bye") == WIBESOCKET_OK);
+    wibesocket_message_t m;
+    assert(wibesocket_recv(c, &m, 5000) == WIBESOCKET_ERROR_CLOSED);
+    assert(wibesocket_close(c) == WIBESOCKET_OK);
+    assert(wibesocket_close(s) == WIBESOCKET_OK);
+
+    /* A CLOSE read in the same batch as data is parsed again by the next call: its payload,
+     * unmasked in place the first time, must read the same the second, and it is counted once */
+    wibesocket_config_t ss = sc;
+    ss.enable_stats = true;
+    open_pair(lfd, port, NULL, &ss, &c, &s);
+    assert(wibesocket_send_begin(c) == WIBESOCKET_OK);
+    assert(wibesocket_send_text(c, "last", 4) == WIBESOCKET_OK);
+    assert(wibesocket_send_close(c, WIBESOCKET_CLOSE_GOING_AWAY, "done") == WIBESOCKET_OK);
+    (void)poll(NULL, 0, 50);
+    wibesocket_message_t batch[4]; size_t got = 0;
+    assert(wibesocket_recv_batch(s, batch, 4, &got, 5000) == WIBESOCKET_OK && got == 1);
+    assert(batch[0].payload_len == 4 && memcmp(batch[0].payload, "last", 4) == 0);
+    wibesocket_release_message(s, &batch[0]);
+    assert(wibesocket_recv(s, &m, 5000) == WIBESOCKET_ERROR_CLOSED);
+    wibesocket_stats_t st;
+    assert(wibesocket_get_stats(s, &st) == WIBESOCKET_OK);
+    assert(st.frames_in[WIBESOCKET_FRAME_TEXT] == 1 && st.bytes_in[WIBESOCKET_FRAME_TEXT] == 4 + 6);
+    assert(st.frames_in[WIBESOCKET_FRAME_CLOSE] == 1 && st.bytes_in[WIBESOCKET_FRAME_CLOSE] == 6 + 6); /* masked header */
+    assert(wibesocket_close(s) == WIBESOCKET_OK);
+    assert(wibesocket_close(c) == WIBESOCKET_OK);
+
+    /* No protocol in common: none chosen, the upgrade still succeeds */
+    open_pair(lfd, port, "other", &sc, &c, &s);
+    assert(wibesocket_get_protocol(c) == NULL && wibesocket_get_protocol(s) == NULL);
+    assert(wibesocket_close(c) == WIBESOCKET_OK);
+    assert(wibesocket_close(s) == WIBESOCKET_OK);
+}
+
+/* On the wire: the server's frames carry no mask, an unmasked client frame is a protocol error */
+static void test_raw_client(int lfd, int port) {
+    int rfd = raw_connect(port);
+    char req[512];
+    int n = ws_build_handshake_request("127.0.0.1", port, "/", "dGhlIHNhbXBsZSBub25jZQ==", NULL, NULL, NULL, NULL,
+                                       req, sizeof(req));
+    assert(n > 0);
+    /* A masked TEXT frame right behind the request: it must survive the handshake */
+    uint8_t frame[2 + 4 + 5] = {0x81, 0x80 | 5, 1, 2, 3, 4};
+    for (int i = 0; i < 5; i++) frame[6 + i] = (uint8_t)("hello"[i] ^ frame[2 + (i & 3)]);
+    assert(send(rfd, req, (size_t)n, 0) == n);
+    assert(send(rfd, frame, sizeof(frame), 0) == (ssize_t)sizeof(frame));
+
+    int fd = accept(lfd, NULL, NULL);
+    wibesocket_conn_t* s = wibesocket_accept(fd, NULL);
+    assert(s && wibesocket_get_state(s) == WIBESOCKET_STATE_OPEN);
+    char resp[1024]; size_t got = 0;
+    while (got < 4 || memcmp(resp + got - 4, "\r\n\r\n", 4) != 0) { raw_read(rfd, resp + got, 1); got++; }
+    resp[got] = 0;
+    assert(ws_validate_handshake_response(resp, "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") == 0);
+    expect_msg(s, WIBESOCKET_FRAME_TEXT, "hello", 5);
+
+    assert(wibesocket_send_text(s, "plain", 5) == WIBESOCKET_OK);
+    uint8_t out[7];
+    raw_read(rfd, out, sizeof(out));
+    assert(out[0] == 0x81 && out[1] == 5 && memcmp(out + 2, "plain", 5) == 0);
+
+    /* The same from a broadcast */
+    wibesocket_broadcast_t* b = wibesocket_broadcast_create(WIBESOCKET_FRAME_BINARY, "fan", 3);
+    assert(wibesocket_broadcast_send(s, b) == WIBESOCKET_OK);
+    wibesocket_broadcast_release(b);
+    raw_read(rfd, out, 5);
+    assert(out[0] == 0x82 && out[1] == 3 && memcmp(out + 2, "fan", 3) == 0);
+
+    const uint8_t unmasked[3] = {0x81, 1, 'x'};
+    assert(send(rfd, unmasked, sizeof(unmasked), 0) == 3);
+    wibesocket_message_t m;
+    assert(wibesocket_recv(s, &m, 5000) == WIBESOCKET_ERROR_PROTOCOL);
+    assert(wibesocket_close(s) == WIBESOCKET_OK);
+    close(rfd);
+}
+
+/* Not an upgrade: a 400 back and no connection */
+static void test_bad_request(int lfd, int port) {
+    int rfd = raw_connect(port);
+    const char* req = "GET / HTTP/1.1\r\nHost: x\r\n\r\n";
+    assert(send(rfd, req, strlen(req), 0) == (ssize_t)strlen(req));
+    assert(wibesocket_accept(accept(lfd, NULL, NULL), NULL) == NULL);
+    char resp[128] = {0};
+    raw_read(rfd, resp, 12);
+    assert(memcmp(resp, "HTTP/1.1 400", 12) == 0);
+    close(rfd);
+    assert(wibesocket_accept(-1, NULL) == NULL);
+}
+
+/* One message framed once and sent to every connection, small and zerocopy-sized */
+static void test_broadcast(int lfd, int port) {
+    enum { N = 16 };
+    wibesocket_config_t sc; memset(&sc, 0, sizeof(sc));
+    sc.zerocopy_threshold = 64 * 1024;
+    wibesocket_config_t uc = sc;
+    uc.io_backend = WIBESOCKET_IO_URING; /* copies into its queue; epoll where unavailable */
+    wibesocket_conn_t *clients[N], *servers[N];
+    for (int i = 0; i < N; i++) open_pair(lfd, port, NULL, i == N - 1 ? &uc : &sc, &clients[i], &servers[i]);
+
+    assert(wibesocket_broadcast_create(WIBESOCKET_FRAME_PING, "p", 1) == NULL);
+    assert(wibesocket_broadcast_create(WIBESOCKET_FRAME_TEXT, NULL, 1) == NULL);
+    const char* tick = "tick 42";
+    wibesocket_broadcast_t* small = wibesocket_broadcast_create(WIBESOCKET_FRAME_TEXT, tick, strlen(tick));
+    size_t big_len = 256 * 1024;
+    uint8_t* big = (uint8_t*)malloc(big_len);
+    for (size_t i = 0; i < big_len; i++) big[i] = (uint8_t)(i ^ (i >> 8));
+    wibesocket_broadcast_t* large = wibesocket_broadcast_create(WIBESOCKET_FRAME_BINARY, big, big_len);
+    assert(small && large);
+
+    assert(wibesocket_broadcast(servers, N, small) == N);
+    /* Released by its creator while sends still hold it */
+    assert(wibesocket_broadcast(servers, N, large) == N);
+    wibesocket_broadcast_release(large);
+    assert(wibesocket_broadcast(servers, N, small) == N);
+    wibesocket_broadcast_release(small);
+    for (int i = 0; i < N; i++) {
+        expect_msg(clients[i], WIBESOCKET_FRAME_TEXT, tick, strlen(tick));
+        expect_msg(clients[i], WIBESOCKET_FRAME_BINARY, big, big_len);
+        expect_msg(clients[i], WIBESOCKET_FRAME_TEXT, tick, strlen(tick));
+    }
+    /* Queued to a connection that then closes: the close drops its reference */
+    wibesocket_broadcast_t* last = wibesocket_broadcast_create(WIBESOCKET_FRAME_BINARY, big, big_len);
+    assert(wibesocket_send_begin(servers[0]) == WIBESOCKET_OK);
+    assert(wibesocket_broadcast_send(servers[0], last) == WIBESOCKET_OK);
+    wibesocket_broadcast_release(last);
+    free(big);
+    for (int i = 0; i < N; i++) {
+        assert(wibesocket_send_close(servers[i], WIBESOCKET_CLOSE_GOING_AWAY, NULL) == WIBESOCKET_OK);
+        assert(wibesocket_close(clients[i]) == WIBESOCKET_OK);
+        assert(wibesocket_close(servers[i]) == WIBESOCKET_OK);
+    }
+}
+
+static void on_connected(wibesocket_loop_t* loop, wibesocket_conn_t* conn, uint32_t events, void* ud) {
+    (void)loop; (void)conn;
+    assert(!(events & WIBESOCKET_EVENT_ERROR));
+    if (events & WIBESOCKET_EVENT_CONNECTED) (*(int*)ud)++;
+}
+
+/* An accepted connection completes its handshake on a loop like a connecting one */
+static void test_loop(int lfd, int port) {
+    wibesocket_loop_t* loop = wibesocket_loop_create();
+    char uri[64]; snprintf(uri, sizeof(uri), "ws://127.0.0.1:%d/", port);
+    int connected = 0;
+    wibesocket_conn_t* c = wibesocket_connect_start(uri, NULL);
+    assert(c && wibesocket_loop_add(loop, c, on_connected, &connected) == WIBESOCKET_OK);
+    assert(wibesocket_loop_run_once(loop, 100) >= 0);
+    wibesocket_conn_t* s = wibesocket_accept_start(accept(lfd, NULL, NULL), NULL);
+    assert(s && wibesocket_loop_add(loop, s, on_connected, &connected) == WIBESOCKET_OK);
+    for (int i = 0; i < 500 && connected < 2; i++) assert(wibesocket_loop_run_once(loop, 10) >= 0);
+    assert(connected == 2);
+    assert(wibesocket_loop_remove(loop, c) == WIBESOCKET_OK && wibesocket_loop_remove(loop, s) == WIBESOCKET_OK);
+    assert(wibesocket_send_text(c, "looped", 6) == WIBESOCKET_OK);
+    expect_msg(s, WIBESOCKET_FRAME_TEXT, "looped", 6);
+    assert(wibesocket_close(c) == WIBESOCKET_OK);
+    assert(wibesocket_close(s) == WIBESOCKET_OK);
+    wibesocket_loop_destroy(loop);
+}
+
+int main(void) {
+    int port = 0;
+    int lfd = listen_local(&port);
+    test_pair(lfd, port);
+    test_raw_client(lfd, port);
+    test_bad_request(lfd, port);
+    test_broadcast(lfd, port);
+    test_loop(lfd, port);
+    close(lfd);
+    printf("test_server OK\n");
+    return 0;
+}
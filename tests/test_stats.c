@@ -0,0 +1,106 @@
+/* Stats: the delay histogram on its own, then per-connection and global counters over a few
+ * echo round trips */
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "wibesocket/wibesocket.h"
+#include "../src/internal/stats.h"
+#include "echo_helper.h"
+
+static void test_histogram(void) {
+    ws_stats_t* s = ws_stats_create();
+    assert(s);
+    for (uint64_t v = 1; v <= 10000; v++) ws_stats_record_delay(s, v);
+    ws_stats_record_delay(s, 0);
+    wibesocket_stats_t st;
+    ws_stats_read(s, &st);
+    const wibesocket_histogram_t* h = &st.send_delay;
+    assert(h->count == 10001 && h->max_ns == 10000);
+    assert(h->sum_ns == 10000ULL * 10001ULL / 2);
+    uint64_t total = 0;
+    for (int i = 0; i < WIBESOCKET_HIST_BUCKETS; i++) total += h->buckets[i];
+    assert(total == h->count);
+    /* Bucket bounds are within a quarter of the true value */
+    uint64_t p50 = wibesocket_histogram_percentile(h, 50);
+    assert(p50 >= 5000 && p50 <= 6250);
+    uint64_t p99 = wibesocket_histogram_percentile(h, 99);
+    assert(p99 >= 9900 && p99 <= 10000);
+    assert(wibesocket_histogram_percentile(h, 100) == 10000);
+    assert(wibesocket_histogram_percentile(h, 0) == 0);
+    /* Beyond the last bucket: clamped there, max still exact */
+    ws_stats_record_delay(s, UINT64_MAX / 2);
+    ws_stats_read(s, &st);
+    assert(st.send_delay.buckets[WIBESOCKET_HIST_BUCKETS - 1] == 1);
+    assert(st.send_delay.max_ns == UINT64_MAX / 2);
+    ws_stats_destroy(s);
+
+    wibesocket_histogram_t empty;
+    memset(&empty, 0, sizeof(empty));
+    assert(wibesocket_histogram_percentile(&empty, 50) == 0);
+}
+
+static void test_conn_stats(const echo_server_t* srv) {
+    wibesocket_stats_t before, st, global;
+    wibesocket_get_global_stats(&before);
+
+    /* Off by default */
+    wibesocket_conn_t* c = wibesocket_connect(srv->uri, NULL);
+    assert(c);
+    assert(wibesocket_get_stats(c, &st) == WIBESOCKET_ERROR_NOT_READY);
+    wibesocket_close(c);
+
+    wibesocket_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.enable_stats = true;
+    c = wibesocket_connect(srv->uri, &cfg);
+    assert(c);
+    assert(wibesocket_get_stats(c, &st) == WIBESOCKET_OK);
+    assert(st.connections == 1 && st.handshake_us > 0);
+
+    const int n = 100;
+    for (int i = 0; i < n; i++) {
+        wibesocket_message_t m;
+        assert(wibesocket_send_text(c, "0123456789", 10) == WIBESOCKET_OK);
+        assert(wibesocket_recv(c, &m, 5000) == WIBESOCKET_OK);
+        assert(m.payload_len == 10);
+        wibesocket_release_payload(c);
+    }
+    wibesocket_message_t m;
+    assert(wibesocket_send_ping(c, NULL, 0) == WIBESOCKET_OK);
+    assert(wibesocket_recv(c, &m, 50) == WIBESOCKET_ERROR_TIMEOUT);
+
+    assert(wibesocket_get_stats(c, &st) == WIBESOCKET_OK);
+    assert(st.frames_out[WIBESOCKET_FRAME_TEXT] == (uint64_t)n);
+    assert(st.bytes_out[WIBESOCKET_FRAME_TEXT] == (uint64_t)n * (10 + 6)); /* masked header */
+    assert(st.frames_in[WIBESOCKET_FRAME_TEXT] == (uint64_t)n);
+    assert(st.bytes_in[WIBESOCKET_FRAME_TEXT] == (uint64_t)n * (10 + 2));
+    assert(st.frames_out[WIBESOCKET_FRAME_PING] == 1 && st.frames_in[WIBESOCKET_FRAME_PONG] == 1);
+    assert(st.frames_in[WIBESOCKET_FRAME_BINARY] == 0);
+    /* A send and at least one recv per round trip; short reads skip the EAGAIN recv */
+    assert(st.syscalls >= 2ULL * n);
+    assert(st.eagain < (uint64_t)n);
+    assert(st.send_queue_peak >= 16);
+    assert(st.send_delay.count >= (uint64_t)n);
+
+    /* Live connections are part of the global view */
+    wibesocket_get_global_stats(&global);
+    assert(global.frames_out[WIBESOCKET_FRAME_TEXT] - before.frames_out[WIBESOCKET_FRAME_TEXT] == (uint64_t)n);
+    assert(global.connections - before.connections == 1);
+    wibesocket_close(c);
+
+    /* ... and stay in it once closed, the CLOSE frame included */
+    wibesocket_get_global_stats(&global);
+    assert(global.frames_out[WIBESOCKET_FRAME_TEXT] - before.frames_out[WIBESOCKET_FRAME_TEXT] == (uint64_t)n);
+    assert(global.frames_out[WIBESOCKET_FRAME_CLOSE] - before.frames_out[WIBESOCKET_FRAME_CLOSE] == 1);
+    assert(global.send_queue_peak >= st.send_queue_peak);
+}
+
+int main(void) {
+    test_histogram();
+    echo_server_t srv;
+    assert(echo_server_start(&srv) == 0);
+    test_conn_stats(&srv);
+    printf("test_stats OK\n");
+    return 0;
+}
@@ -0,0 +1,117 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "internal/timerwheel.h"
+
+#define N_TIMERS 2000
+
+typedef struct {
+    ws_timer_t timer;
+    uint64_t   due;       /* model: deadline while armed, 0 when not */
+    uint64_t   fired_at;
+    int        fired;
+} model_timer_t;
+
+static model_timer_t g_t[N_TIMERS];
+static ws_timerwheel_t g_wheel;
+
+static void on_fire(ws_timer_t* t, uint64_t now_ms) {
+    model_timer_t* m = (model_timer_t*)t; /* timer is the first member */
+    /* Never early; "not late" is checked after each advance */
+    assert(m->due != 0 && m->due <= now_ms);
+    m->fired_at = now_ms;
+    m->fired++;
+    m->due = 0;
+}
+
+static uint64_t rnd(uint64_t* s) {
+    *s ^= *s << 13; *s ^= *s >> 7; *s ^= *s << 17;
+    return *s;
+}
+
+static uint64_t earliest_due(void) {
+    uint64_t best = 0;
+    for (int i = 0; i < N_TIMERS; i++) if (g_t[i].due && (!best || g_t[i].due < best)) best = g_t[i].due;
+    return best;
+}
+
+static void test_against_model(void) {
+    uint64_t seed = 88172645463325252ULL;
+    uint64_t now = 1000000;
+    ws_timerwheel_init(&g_wheel, now);
+    for (int i = 0; i < N_TIMERS; i++) ws_timer_init(&g_t[i].timer, on_fire);
+    for (int round = 0; round < 20000; round++) {
+        /* A few schedule/cancel operations, with spans from 0 ms to past the wheel's range */
+        for (int k = 0; k < 4; k++) {
+            model_timer_t* m = &g_t[rnd(&seed) % N_TIMERS];
+            uint64_t r = rnd(&seed);
+            if (r % 5 == 0) {
+                ws_timer_cancel(&g_wheel, &m->timer);
+                m->due = 0;
+            } else {
+                static const uint64_t spans[] = { 1, 64, 4096, 262144, 40000000 };
+                uint64_t due = now + (r >> 8) % spans[(r >> 4) % 5];
+                ws_timer_schedule(&g_wheel, &m->timer, due);
+                m->due = due < g_wheel.base_ms ? g_wheel.base_ms : due;
+            }
+        }
+        uint64_t first = earliest_due();
+        int wait = ws_timerwheel_next_ms(&g_wheel, now, -1);
+        if (!first) { assert(wait == -1); }
+        else { assert(wait >= 0 && (first <= now || (uint64_t)wait <= first - now)); }
+        /* Step: sometimes straight to the wheel's own wake-up, sometimes a random stride */
+        uint64_t step = (round % 3 == 0 && wait >= 0) ? (uint64_t)wait : rnd(&seed) % 5000;
+        now += step;
+        ws_timerwheel_advance(&g_wheel, now);
+        for (int i = 0; i < N_TIMERS; i++) {
+            /* Everything due has fired; nothing not yet due has */
+            assert(!(g_t[i].due && g_t[i].due <= now));
+            assert(!g_t[i].due || ws_timer_active(&g_t[i].timer));
+        }
+    }
+    assert(g_wheel.count == 0 || earliest_due() != 0);
+}
+
+/* A callback that reschedules itself and cancels a neighbour */
+static ws_timer_t g_self, g_victim;
+static int g_self_runs, g_victim_runs;
+
+static void self_fire(ws_timer_t* t, uint64_t now_ms) {
+    g_self_runs++;
+    ws_timer_cancel(&g_wheel, &g_victim);
+    if (g_self_runs < 5) ws_timer_schedule(&g_wheel, t, now_ms + 100);
+}
+
+static void victim_fire(ws_timer_t* t, uint64_t now_ms) {
+    (void)t; (void)now_ms;
+    g_victim_runs++;
+}
+
+static void test_callbacks(void) {
+    ws_timerwheel_init(&g_wheel, 0);
+    ws_timer_init(&g_self, self_fire);
+    ws_timer_init(&g_victim, victim_fire);
+    ws_timer_schedule(&g_wheel, &g_self, 50);
+    ws_timer_schedule(&g_wheel, &g_victim, 50); /* same slot, fires after self */
+    assert(ws_timerwheel_next_ms(&g_wheel, 0, -1) == 50);
+    assert(ws_timerwheel_next_ms(&g_wheel, 0, 10) == 10);
+    assert(ws_timerwheel_advance(&g_wheel, 49) == 0);
+    assert(ws_timerwheel_advance(&g_wheel, 50) == 1);
+    assert(g_self_runs == 1 && g_victim_runs == 0 && !ws_timer_active(&g_victim));
+    for (uint64_t t = 60; t < 1000; t += 10) ws_timerwheel_advance(&g_wheel, t);
+    assert(g_self_runs == 5 && g_wheel.count == 0);
+    assert(ws_timerwheel_next_ms(&g_wheel, 1000, -1) == -1);
+    /* Overdue when scheduled: fires on the next advance */
+    ws_timer_schedule(&g_wheel, &g_victim, 10);
+    assert(ws_timerwheel_next_ms(&g_wheel, 1000, -1) == 0);
+    assert(ws_timerwheel_advance(&g_wheel, 1000) == 1 && g_victim_runs == 1);
+}
+
+int main(void) {
+    test_callbacks();
+    test_against_model();
+    printf("test_timerwheel OK\n");
+    return 0;
+}
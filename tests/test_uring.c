@@ -0,0 +1,111 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "wibesocket/wibesocket.h"
+#include "wibesocket/event_loop.h"
+#include "echo_helper.h"
+
+/* Runs against whichever engine the connection ends up on, so kernels or builds without
+ * io_uring still exercise the fallback */
+
+static uint64_t now_ms(void) {
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)(ts.tv_nsec / 1000000ULL);
+}
+
+static wibesocket_conn_t* connect_uring(const char* uri) {
+    wibesocket_config_t cfg; memset(&cfg, 0, sizeof(cfg));
+    cfg.max_frame_size = 8U << 20;
+    cfg.io_backend = WIBESOCKET_IO_URING;
+    wibesocket_conn_t* c = wibesocket_connect(uri, &cfg);
+    assert(c);
+    return c;
+}
+
+static void test_echo_sizes(const char* uri) {
+    static uint8_t buf[6U << 20];
+    static const size_t sizes[] = { 0, 1, 125, 126, 65535, 65536, 200000, sizeof(buf) };
+    wibesocket_conn_t* c = connect_uring(uri);
+    printf("io backend: %s\n", wibesocket_get_io_backend(c) == WIBESOCKET_IO_URING ? "io_uring" : "epoll");
+    for (size_t i = 0; i < sizeof(buf); i++) buf[i] = (uint8_t)(i * 13 + 5);
+    for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+        assert(wibesocket_send_binary(c, buf, sizes[k]) == WIBESOCKET_OK);
+        wibesocket_message_t m;
+        assert(wibesocket_recv(c, &m, 5000) == WIBESOCKET_OK);
+        assert(m.payload_len == sizes[k]);
+        assert(sizes[k] == 0 || memcmp(m.payload, buf, sizes[k]) == 0);
+        wibesocket_release_payload(c);
+    }
+    assert(wibesocket_close(c) == WIBESOCKET_OK);
+}
+
+/* Many small frames queued while earlier chains are still in flight must arrive in order */
+static void test_pipelined_batch(const char* uri) {
+    enum { N = 500 };
+    wibesocket_conn_t* c = connect_uring(uri);
+    for (int i = 0; i < N; i++) {
+        char msg[32]; int n = snprintf(msg, sizeof(msg), "msg-%d", i);
+        assert(wibesocket_send_text(c, msg, (size_t)n) == WIBESOCKET_OK);
+    }
+    int got = 0;
+    uint64_t deadline = now_ms() + 5000;
+    while (got < N && now_ms() < deadline) {
+        wibesocket_message_t msgs[64]; size_t n = 0;
+        wibesocket_error_t e = wibesocket_recv_batch(c, msgs, 64, &n, 1000);
+        if (e == WIBESOCKET_ERROR_TIMEOUT) continue;
+        assert(e == WIBESOCKET_OK);
+        for (size_t k = 0; k < n; k++, got++) {
+            char want[32]; int wn = snprintf(want, sizeof(want), "msg-%d", got);
+            assert(msgs[k].payload_len == (size_t)wn && memcmp(msgs[k].payload, want, (size_t)wn) == 0);
+        }
+        wibesocket_release_payload(c);
+    }
+    assert(got == N);
+    assert(wibesocket_close(c) == WIBESOCKET_OK);
+}
+
+static int g_received;
+
+static void on_event(wibesocket_loop_t* loop, wibesocket_conn_t* conn, uint32_t events, void* ud) {
+    (void)loop; (void)ud;
+    if (!(events & WIBESOCKET_EVENT_READABLE)) return;
+    wibesocket_message_t m;
+    while (wibesocket_recv(conn, &m, 0) == WIBESOCKET_OK) {
+        assert(m.payload_len == 4 && memcmp(m.payload, "loop", 4) == 0);
+        wibesocket_release_payload(conn);
+        g_received++;
+    }
+}
+
+/* The shared loop watches the ring fd instead of the socket */
+static void test_loop_integration(const char* uri) {
+    enum { N = 4 };
+    wibesocket_loop_t* loop = wibesocket_loop_create();
+    wibesocket_conn_t* conns[N];
+    g_received = 0;
+    for (int i = 0; i < N; i++) {
+        conns[i] = connect_uring(uri);
+        assert(wibesocket_loop_add(loop, conns[i], on_event, NULL) == WIBESOCKET_OK);
+        for (int k = 0; k < 3; k++) assert(wibesocket_send_text(conns[i], "loop", 4) == WIBESOCKET_OK);
+    }
+    uint64_t deadline = now_ms() + 5000;
+    while (g_received < N * 3 && now_ms() < deadline) assert(wibesocket_loop_run_once(loop, 100) >= 0);
+    assert(g_received == N * 3);
+    for (int i = 0; i < N; i++) assert(wibesocket_close(conns[i]) == WIBESOCKET_OK);
+    wibesocket_loop_destroy(loop);
+}
+
+int main(void) {
+    echo_server_t srv;
+    if (echo_server_start(&srv) == 0) {
+        test_echo_sizes(srv.uri);
+        test_pipelined_batch(srv.uri);
+        test_loop_integration(srv.uri);
+    } else {
+        fprintf(stderr, "[skip] cannot listen on loopback\n");
+    }
+    printf("test_uring OK\n");
+    return 0;
+}
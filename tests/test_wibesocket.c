@@ -10,6 +10,18 @@ int main(void) {
     assert(wibesocket_error_string(WIBESOCKET_OK) != NULL);
     assert(WIBESOCKET_FRAME_TEXT == 0x1);
     assert(WIBESOCKET_CLOSE_NORMAL == 1000);
+    {
+        wibesocket_message_t batch[4]; size_t got = 7;
+        assert(wibesocket_recv_batch(NULL, batch, 4, &got, 0) == WIBESOCKET_ERROR_INVALID_ARGS);
+        assert(got == 0);
+        struct iovec iov = { (void*)"x", 1 };
+        assert(wibesocket_send_batch(NULL, WIBESOCKET_FRAME_TEXT, &iov, 1) == WIBESOCKET_ERROR_INVALID_ARGS);
+        assert(wibesocket_send_begin(NULL) == WIBESOCKET_ERROR_INVALID_ARGS);
+        assert(wibesocket_send_commit(NULL) == WIBESOCKET_ERROR_INVALID_ARGS);
+        assert(wibesocket_post_send(NULL, WIBESOCKET_FRAME_TEXT, "x", 1) == WIBESOCKET_ERROR_INVALID_ARGS);
+        assert(wibesocket_get_buffered_amount(NULL) == 0);
+        assert(wibesocket_wait_writable(NULL, 0) == WIBESOCKET_ERROR_INVALID_ARGS);
+    }
 
     /* Optional smoke connect if env set */
     const char* uri = getenv("WIBESOCKET_TEST_ECHO_URI");
@@ -24,7 +36,19 @@ int main(void) {
             const char* msg = "ping-from-c";
             (void)wibesocket_send_text(c, msg, strlen(msg));
             wibesocket_message_t m; memset(&m,0,sizeof(m));
-            (void)wibesocket_recv(c, &m, 1000);
+            if (wibesocket_recv(c, &m, 1000) == WIBESOCKET_OK) wibesocket_release_payload(c);
+            /* corked pair plus a batch: one flush each */
+            assert(wibesocket_send_begin(c) == WIBESOCKET_OK);
+            (void)wibesocket_send_text(c, msg, strlen(msg));
+            (void)wibesocket_send_text(c, msg, strlen(msg));
+            assert(wibesocket_send_commit(c) == WIBESOCKET_OK);
+            struct iovec iov[2] = { { (void*)msg, strlen(msg) }, { (void*)msg, strlen(msg) } };
+            assert(wibesocket_send_batch(c, WIBESOCKET_FRAME_TEXT, iov, 2) == WIBESOCKET_OK);
+            wibesocket_message_t batch[8]; size_t got = 0;
+            if (wibesocket_recv_batch(c, batch, 8, &got, 1000) == WIBESOCKET_OK) {
+                assert(got >= 1 && got <= 8);
+                wibesocket_release_payload(c);
+            }
             (void)wibesocket_send_close(c, WIBESOCKET_CLOSE_NORMAL, "bye");
             (void)wibesocket_close(c);
         }
@@ -0,0 +1,271 @@
+/* Large sends written from their own buffers (zerocopy_threshold) and from caller-donated ones
+ * (wibesocket_send_donated): echoed intact, released exactly once, counted in the backlog */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "wibesocket/wibesocket.h"
+#include "wibesocket/event_loop.h"
+#include "echo_helper.h"
+
+#define BIG (1U << 20)
+
+static uint64_t now_ms(void) {
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)(ts.tv_nsec / 1000000ULL);
+}
+
+static void fill(uint8_t* p, size_t n, unsigned seed) {
+    for (size_t i = 0; i < n; i++) p[i] = (uint8_t)(i * 31 + seed);
+}
+
+static int same(const wibesocket_message_t* m, size_t n, unsigned seed) {
+    if (m->payload_len != n) return 0;
+    const uint8_t* p = (const uint8_t*)m->payload;
+    for (size_t i = 0; i < n; i++) if (p[i] != (uint8_t)(i * 31 + seed)) return 0;
+    return 1;
+}
+
+typedef struct {
+    int   calls;
+    void* buf;
+    size_t len;
+} release_log_t;
+
+static void on_release(void* ctx, void* buf, size_t len) {
+    release_log_t* r = (release_log_t*)ctx;
+    r->calls++;
+    r->buf = buf;
+    r->len = len;
+}
+
+static wibesocket_config_t big_config(void) {
+    wibesocket_config_t cfg; memset(&cfg, 0, sizeof(cfg));
+    cfg.max_frame_size = 4U << 20;
+    cfg.zerocopy_threshold = 64U << 10;
+    return cfg;
+}
+
+/* Large and small messages interleaved: the large ones leave the queue, order holds */
+static void test_threshold_echo(const echo_server_t* srv) {
+    wibesocket_config_t cfg = big_config();
+    wibesocket_conn_t* c = wibesocket_connect(srv->uri, &cfg);
+    assert(c);
+    uint8_t* big = (uint8_t*)malloc(BIG);
+    for (unsigned round = 0; round < 4; round++) {
+        fill(big, BIG, round);
+        assert(wibesocket_send_binary(c, big, BIG) == WIBESOCKET_OK);
+        assert(wibesocket_send_text(c, "between", 7) == WIBESOCKET_OK);
+        fill(big, BIG, round + 100); /* the queued copy is independent of the caller's buffer */
+        assert(wibesocket_send_binary(c, big, 100U << 10) == WIBESOCKET_OK);
+        wibesocket_message_t m;
+        assert(wibesocket_recv(c, &m, 5000) == WIBESOCKET_OK && same(&m, BIG, round));
+        wibesocket_release_payload(c);
+        assert(wibesocket_recv(c, &m, 5000) == WIBESOCKET_OK && m.payload_len == 7);
+        assert(memcmp(m.payload, "between", 7) == 0);
+        wibesocket_release_payload(c);
+        assert(wibesocket_recv(c, &m, 5000) == WIBESOCKET_OK && same(&m, 100U << 10, round + 100));
+        wibesocket_release_payload(c);
+    }
+    assert(wibesocket_get_buffered_amount(c) == 0);
+    free(big);
+    assert(wibesocket_close(c) == WIBESOCKET_OK);
+}
+
+static void test_donated(const echo_server_t* srv) {
+    wibesocket_config_t cfg = big_config();
+    cfg.zerocopy_threshold = 0; /* donation does not depend on the threshold */
+    wibesocket_conn_t* c = wibesocket_connect(srv->uri, &cfg);
+    assert(c);
+    uint8_t ping[4] = { 0 };
+    assert(wibesocket_send_donated(NULL, WIBESOCKET_FRAME_BINARY, ping, 4, NULL, NULL) == WIBESOCKET_ERROR_INVALID_ARGS);
+    assert(wibesocket_send_donated(c, WIBESOCKET_FRAME_PING, ping, 4, NULL, NULL) == WIBESOCKET_ERROR_INVALID_ARGS);
+    assert(wibesocket_send_donated(c, WIBESOCKET_FRAME_BINARY, NULL, 4, NULL, NULL) == WIBESOCKET_ERROR_INVALID_ARGS);
+
+    release_log_t log[3]; memset(log, 0, sizeof(log));
+    static const size_t sizes[3] = { BIG, 0, 200 };
+    uint8_t* bufs[3];
+    for (int i = 0; i < 3; i++) {
+        bufs[i] = (uint8_t*)malloc(sizes[i] ? sizes[i] : 1);
+        fill(bufs[i], sizes[i], (unsigned)i);
+        assert(wibesocket_send_donated(c, WIBESOCKET_FRAME_BINARY, bufs[i], sizes[i], on_release, &log[i]) == WIBESOCKET_OK);
+    }
+    for (int i = 0; i < 3; i++) {
+        wibesocket_message_t m;
+        assert(wibesocket_recv(c, &m, 5000) == WIBESOCKET_OK && same(&m, sizes[i], (unsigned)i));
+        wibesocket_release_payload(c);
+    }
+    /* Released at most once while open, exactly once by the time the connection is gone */
+    for (int i = 0; i < 3; i++) assert(log[i].calls <= 1);
+    assert(wibesocket_close(c) == WIBESOCKET_OK);
+    for (int i = 0; i < 3; i++) {
+        assert(log[i].calls == 1 && log[i].buf == bufs[i] && log[i].len == sizes[i]);
+        free(bufs[i]);
+    }
+}
+
+/* A donated payload counts towards the watermarks; a refused one stays the caller's */
+static void test_donated_backlog(const echo_server_t* srv) {
+    char uri[80]; snprintf(uri, sizeof(uri), "%shold", srv->uri);
+    wibesocket_config_t cfg = big_config();
+    cfg.max_frame_size = 16U << 20;
+    cfg.send_high_watermark = 256U << 10;
+    cfg.send_low_watermark = 64U << 10;
+    atomic_store(&echo_hold, 1);
+    wibesocket_conn_t* c = wibesocket_connect(uri, &cfg);
+    assert(c);
+    size_t n = 8U << 20;
+    uint8_t* first = (uint8_t*)malloc(n);
+    uint8_t* second = (uint8_t*)malloc(1024);
+    fill(first, n, 1);
+    fill(second, 1024, 2);
+    release_log_t log[2]; memset(log, 0, sizeof(log));
+    assert(wibesocket_send_donated(c, WIBESOCKET_FRAME_BINARY, first, n, on_release, &log[0]) == WIBESOCKET_OK);
+    assert(wibesocket_get_buffered_amount(c) > cfg.send_high_watermark);
+    assert(wibesocket_send_donated(c, WIBESOCKET_FRAME_BINARY, second, 1024, on_release, &log[1]) == WIBESOCKET_ERROR_BUFFER_FULL);
+    assert(log[1].calls == 0);
+    for (size_t i = 0; i < 1024; i++) assert(second[i] == (uint8_t)(i * 31 + 2));
+    atomic_store(&echo_hold, 0);
+    assert(wibesocket_wait_writable(c, 5000) == WIBESOCKET_OK);
+    assert(wibesocket_get_buffered_amount(c) <= cfg.send_low_watermark);
+    wibesocket_message_t m;
+    assert(wibesocket_recv(c, &m, 5000) == WIBESOCKET_OK && same(&m, n, 1));
+    wibesocket_release_payload(c);
+    assert(wibesocket_close(c) == WIBESOCKET_OK);
+    assert(log[0].calls == 1);
+    free(first);
+    free(second);
+}
+
+static uint8_t* g_abandoned; /* still the kernel's: kept reachable, never freed */
+
+/* Closed while the kernel still sends from a donated payload: it is not handed back, since
+ * the caller could rewrite bytes that are yet to go out */
+static void test_close_in_flight(const echo_server_t* srv) {
+    char uri[80]; snprintf(uri, sizeof(uri), "%shold", srv->uri);
+    wibesocket_config_t cfg = big_config();
+    cfg.max_frame_size = 16U << 20;
+    cfg.close_timeout_ms = 50;
+    cfg.enable_stats = true;
+    atomic_store(&echo_hold, 1);
+    wibesocket_conn_t* c = wibesocket_connect(uri, &cfg);
+    assert(c);
+    size_t n = 8U << 20;
+    uint8_t* buf = (uint8_t*)malloc(n);
+    fill(buf, n, 3);
+    release_log_t log; memset(&log, 0, sizeof(log));
+    assert(wibesocket_send_donated(c, WIBESOCKET_FRAME_BINARY, buf, n, on_release, &log) == WIBESOCKET_OK);
+    wibesocket_stats_t before, after;
+    wibesocket_get_global_stats(&before);
+    wibesocket_close(c);
+    wibesocket_get_global_stats(&after);
+    assert(log.calls == 0);
+    assert(after.zerocopy_abandoned == before.zerocopy_abandoned + 1);
+    atomic_store(&echo_hold, 0);
+    g_abandoned = buf;
+}
+
+/* Small allocations (queue nodes, not payloads) let through before the rest are refused;
+ * -1 refuses none */
+static int g_small_left = -1;
+
+static void* small_alloc(void* ctx, size_t size) {
+    (void)ctx;
+    if (size < 1024 && g_small_left >= 0 && g_small_left-- == 0) { g_small_left = 0; return NULL; }
+    return malloc(size);
+}
+
+static void small_free(void* ctx, void* ptr, size_t size) {
+    (void)ctx; (void)size;
+    free(ptr);
+}
+
+/* A batch of payloads sent from their own buffers is queued entirely or not at all, even when
+ * the second one's queue node cannot be had */
+static void test_batch_all_or_nothing(const echo_server_t* srv) {
+    static const wibesocket_allocator_t refusing = { small_alloc, small_free, NULL };
+    wibesocket_config_t cfg = big_config();
+    cfg.allocator = &refusing;
+    wibesocket_conn_t* c = wibesocket_connect(srv->uri, &cfg);
+    assert(c);
+    size_t n = 128U << 10;
+    uint8_t* bufs[3];
+    struct iovec iov[3];
+    for (int i = 0; i < 3; i++) {
+        bufs[i] = (uint8_t*)malloc(n);
+        fill(bufs[i], n, (unsigned)i + 10);
+        iov[i].iov_base = bufs[i]; iov[i].iov_len = n;
+    }
+    g_small_left = 1;
+    assert(wibesocket_send_batch(c, WIBESOCKET_FRAME_BINARY, iov, 3) == WIBESOCKET_ERROR_MEMORY);
+    g_small_left = -1;
+    assert(wibesocket_get_buffered_amount(c) == 0);
+    assert(wibesocket_send_text(c, "after", 5) == WIBESOCKET_OK);
+    wibesocket_message_t m;
+    assert(wibesocket_recv(c, &m, 5000) == WIBESOCKET_OK && m.payload_len == 5);
+    wibesocket_release_payload(c);
+
+    assert(wibesocket_send_batch(c, WIBESOCKET_FRAME_BINARY, iov, 3) == WIBESOCKET_OK);
+    for (int i = 0; i < 3; i++) {
+        assert(wibesocket_recv(c, &m, 5000) == WIBESOCKET_OK && same(&m, n, (unsigned)i + 10));
+        wibesocket_release_payload(c);
+    }
+    assert(wibesocket_close(c) == WIBESOCKET_OK);
+    for (int i = 0; i < 3; i++) free(bufs[i]);
+}
+
+typedef struct {
+    int got;
+    int errors;
+} loop_state_t;
+
+static void on_event(wibesocket_loop_t* loop, wibesocket_conn_t* conn, uint32_t events, void* ud) {
+    loop_state_t* st = (loop_state_t*)ud;
+    (void)loop;
+    if (events & WIBESOCKET_EVENT_ERROR) st->errors++;
+    if (!(events & WIBESOCKET_EVENT_READABLE)) return;
+    wibesocket_message_t m;
+    while (wibesocket_recv(conn, &m, 0) == WIBESOCKET_OK) {
+        assert(same(&m, BIG, (unsigned)st->got));
+        wibesocket_release_payload(conn);
+        st->got++;
+    }
+}
+
+/* Completions on the error queue wake the loop without looking like a failed socket */
+static void test_loop_completions(const echo_server_t* srv) {
+    wibesocket_config_t cfg = big_config();
+    wibesocket_loop_t* loop = wibesocket_loop_create();
+    wibesocket_conn_t* c = wibesocket_connect(srv->uri, &cfg);
+    assert(c);
+    loop_state_t st; memset(&st, 0, sizeof(st));
+    assert(wibesocket_loop_add(loop, c, on_event, &st) == WIBESOCKET_OK);
+    uint8_t* big = (uint8_t*)malloc(BIG);
+    uint64_t deadline = now_ms() + 10000;
+    for (int i = 0; i < 8; i++) {
+        fill(big, BIG, (unsigned)i);
+        assert(wibesocket_send_binary(c, big, BIG) == WIBESOCKET_OK);
+        while (st.got <= i && now_ms() < deadline) assert(wibesocket_loop_run_once(loop, 100) >= 0);
+    }
+    for (int i = 0; i < 5; i++) assert(wibesocket_loop_run_once(loop, 10) >= 0);
+    assert(st.got == 8 && st.errors == 0);
+    assert(wibesocket_get_state(c) == WIBESOCKET_STATE_OPEN);
+    free(big);
+    assert(wibesocket_close(c) == WIBESOCKET_OK);
+    wibesocket_loop_destroy(loop);
+}
+
+int main(void) {
+    echo_server_t srv;
+    assert(echo_server_start(&srv) == 0);
+    test_threshold_echo(&srv);
+    test_donated(&srv);
+    test_donated_backlog(&srv);
+    test_batch_all_or_nothing(&srv);
+    test_loop_completions(&srv);
+    test_close_in_flight(&srv);
+    printf("test_zerocopy OK\n");
+    return 0;
+}